@@ -0,0 +1,82 @@
+#include "host_nut_server.h"
+#include <stdio.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "nut_protocol.h"
+#include "report_trace.h"
+
+int host_nut_server_open(int port, int *bound_port)
+{
+    int listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+    if (listen_sock < 0) {
+        perror("socket");
+        return -1;
+    }
+    int opt = 1;
+    setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_ANY),
+    };
+    socklen_t addr_len = sizeof(addr);
+    if (bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_sock, 1) != 0 ||
+        getsockname(listen_sock, (struct sockaddr *)&addr, &addr_len) != 0) {
+        perror("bind/listen");
+        close(listen_sock);
+        return -1;
+    }
+    *bound_port = ntohs(addr.sin_port);
+    return listen_sock;
+}
+
+static void serve_client(int sock, host_nut_hook_t before_command)
+{
+    // Send each reply immediately; clients wait for it before the next command
+    int opt = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    char rx[256];
+    char line[128];
+    size_t len = 0;
+    ssize_t n;
+    while ((n = recv(sock, rx, sizeof(rx), 0)) > 0) {
+        for (ssize_t i = 0; i < n; i++) {
+            if (len < sizeof(line) - 1) {
+                line[len++] = rx[i];
+            }
+            if (rx[i] != '\n') {
+                continue;
+            }
+            line[len] = '\0';
+            len = 0;
+            if (before_command) {
+                before_command();
+            }
+            char reply[NUT_PROTOCOL_REPLY_MAX];
+            uint32_t generation = report_trace_generation();
+            size_t reply_len = nut_protocol_execute(line, reply, sizeof(reply));
+            if (send(sock, reply, reply_len, MSG_NOSIGNAL) < 0) {
+                return;
+            }
+            if (nut_protocol_reply_has_values(reply)) {
+                report_trace_served(REPORT_TRACE_NUT, generation);
+            }
+        }
+    }
+}
+
+void host_nut_server_run(int listen_sock, host_nut_hook_t before_command)
+{
+    for (;;) {
+        int sock = accept(listen_sock, NULL, NULL);
+        if (sock < 0) {
+            break;
+        }
+        serve_client(sock, before_command);
+        close(sock);
+    }
+}
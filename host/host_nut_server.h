@@ -0,0 +1,21 @@
+/*
+ * Host NUT Server
+ *
+ * Serves nut_protocol_execute() on a TCP port using the POSIX socket API, one
+ * client at a time, like the firmware's NUT task.
+ */
+
+#ifndef HOST_NUT_SERVER_H
+#define HOST_NUT_SERVER_H
+
+// Called before each command is executed (may be NULL)
+typedef void (*host_nut_hook_t)(void);
+
+// Bind and listen on port (0 = any free port). Returns the listening socket
+// or -1, and stores the bound port in *bound_port.
+int host_nut_server_open(int port, int *bound_port);
+
+// Accept and serve clients until the listening socket is shut down
+void host_nut_server_run(int listen_sock, host_nut_hook_t before_command);
+
+#endif // HOST_NUT_SERVER_H
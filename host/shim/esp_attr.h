@@ -0,0 +1,8 @@
+#ifndef HOST_ESP_ATTR_H
+#define HOST_ESP_ATTR_H
+
+// Plain .bss on the host; a process start is always a cold boot
+#define RTC_NOINIT_ATTR
+#define IRAM_ATTR
+
+#endif // HOST_ESP_ATTR_H
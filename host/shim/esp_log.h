@@ -0,0 +1,49 @@
+/*
+ * Host logging
+ *
+ * ESP_LOGx and the hex dump helper print to stderr in the firmware's
+ * "L (ms) tag: message" format. The level defaults to WARN so a benchmark run
+ * is not dominated by console output; set UPS_HOST_LOG_LEVEL=0..5 to change it.
+ */
+
+#ifndef HOST_ESP_LOG_H
+#define HOST_ESP_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef enum {
+    ESP_LOG_NONE,
+    ESP_LOG_ERROR,
+    ESP_LOG_WARN,
+    ESP_LOG_INFO,
+    ESP_LOG_DEBUG,
+    ESP_LOG_VERBOSE,
+} esp_log_level_t;
+
+esp_log_level_t host_log_level(void);
+uint32_t esp_log_timestamp(void);
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+void esp_log_buffer_hex_internal(const char *tag, const void *buffer, uint16_t buff_len, esp_log_level_t level);
+
+#define ESP_LOG_LEVEL_LOCAL(level, tag, format, ...) do {                                   \
+        if ((level) <= host_log_level()) {                                                  \
+            esp_log_write(level, tag, "%c (%lu) %s: " format "\n", "NEWIDV"[level],         \
+                          (unsigned long)esp_log_timestamp(), tag, ##__VA_ARGS__);          \
+        }                                                                                   \
+    } while (0)
+
+#define ESP_LOGE(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_ERROR, tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_WARN, tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_INFO, tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_DEBUG, tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...) ESP_LOG_LEVEL_LOCAL(ESP_LOG_VERBOSE, tag, format, ##__VA_ARGS__)
+
+#define ESP_LOG_BUFFER_HEX_LEVEL(tag, buffer, buff_len, level) do {                         \
+        if ((level) <= host_log_level()) {                                                  \
+            esp_log_buffer_hex_internal(tag, buffer, buff_len, level);                      \
+        }                                                                                   \
+    } while (0)
+
+#endif // HOST_ESP_LOG_H
@@ -0,0 +1,32 @@
+/*
+ * Host FreeRTOS subset
+ *
+ * Ticks are milliseconds. A critical section is a pthread mutex, which gives
+ * the same mutual exclusion between host threads that portMUX gives between
+ * cores.
+ */
+
+#ifndef HOST_FREERTOS_H
+#define HOST_FREERTOS_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+
+#define pdTRUE              1
+#define pdFALSE             0
+#define portTICK_PERIOD_MS  1
+#define pdMS_TO_TICKS(ms)   ((TickType_t)(ms))
+
+typedef struct {
+    pthread_mutex_t mutex;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED { PTHREAD_MUTEX_INITIALIZER }
+
+#define taskENTER_CRITICAL(mux) pthread_mutex_lock(&(mux)->mutex)
+#define taskEXIT_CRITICAL(mux)  pthread_mutex_unlock(&(mux)->mutex)
+
+#endif // HOST_FREERTOS_H
@@ -0,0 +1,11 @@
+#ifndef HOST_FREERTOS_TASK_H
+#define HOST_FREERTOS_TASK_H
+
+#include "freertos/FreeRTOS.h"
+
+// Milliseconds since process start
+TickType_t xTaskGetTickCount(void);
+
+void vTaskDelay(TickType_t ticks);
+
+#endif // HOST_FREERTOS_TASK_H
@@ -0,0 +1,312 @@
+/*
+ * POSIX implementation of the IDF/FreeRTOS subset declared by the shim
+ * headers: monotonic (or virtual) time, logging, an in-memory NVS and restart.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include "esp_err.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_system.h"
+#include "nvs.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "host_platform.h"
+
+#define HOST_NVS_MAX_ENTRIES    32
+#define HOST_NVS_MAX_NAMESPACES 16
+#define HOST_SHUTDOWN_HANDLERS  5
+
+// ---- time ----
+
+static int64_t monotonic_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int64_t start_us;
+
+__attribute__((constructor)) static void host_platform_start(void)
+{
+    start_us = monotonic_us();
+}
+
+static bool virtual_clock;
+static int64_t virtual_us;
+
+int64_t esp_timer_get_time(void)
+{
+    if (__atomic_load_n(&virtual_clock, __ATOMIC_ACQUIRE)) {
+        return __atomic_load_n(&virtual_us, __ATOMIC_RELAXED);
+    }
+    return monotonic_us() - start_us;
+}
+
+void host_clock_set_virtual(bool enable)
+{
+    if (enable) {
+        __atomic_store_n(&virtual_us, monotonic_us() - start_us, __ATOMIC_RELAXED);
+    } else {
+        // Continue real time from where the virtual clock stopped
+        start_us = monotonic_us() - __atomic_load_n(&virtual_us, __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&virtual_clock, enable, __ATOMIC_RELEASE);
+}
+
+void host_clock_advance_us(int64_t us)
+{
+    if (__atomic_load_n(&virtual_clock, __ATOMIC_ACQUIRE)) {
+        __atomic_add_fetch(&virtual_us, us, __ATOMIC_RELAXED);
+    }
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(esp_timer_get_time() / 1000);
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct timespec ts = { .tv_sec = ticks / 1000, .tv_nsec = (long)(ticks % 1000) * 1000000L };
+    nanosleep(&ts, NULL);
+}
+
+// ---- logging ----
+
+static esp_log_level_t log_level = ESP_LOG_WARN;
+static pthread_once_t log_level_once = PTHREAD_ONCE_INIT;
+
+static void log_level_load(void)
+{
+    const char *env = getenv("UPS_HOST_LOG_LEVEL");
+    if (env && *env >= '0' && *env <= '5') {
+        log_level = (esp_log_level_t)(*env - '0');
+    }
+}
+
+esp_log_level_t host_log_level(void)
+{
+    pthread_once(&log_level_once, log_level_load);
+    return log_level;
+}
+
+uint32_t esp_log_timestamp(void)
+{
+    return xTaskGetTickCount();
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+    (void)level;
+    (void)tag;
+    va_list ap;
+    va_start(ap, format);
+    vfprintf(stderr, format, ap);
+    va_end(ap);
+}
+
+void esp_log_buffer_hex_internal(const char *tag, const void *buffer, uint16_t buff_len, esp_log_level_t level)
+{
+    const uint8_t *p = buffer;
+    char line[16 * 3 + 1];
+    for (uint16_t i = 0; i < buff_len; i += 16) {
+        size_t n = 0;
+        for (uint16_t j = i; j < buff_len && j < i + 16; j++) {
+            n += snprintf(line + n, sizeof(line) - n, "%02x ", p[j]);
+        }
+        esp_log_write(level, tag, "%c (%lu) %s: %s\n", "NEWIDV"[level],
+                      (unsigned long)esp_log_timestamp(), tag, line);
+    }
+}
+
+const char *esp_err_to_name(esp_err_t code)
+{
+    switch (code) {
+        case ESP_OK:                return "ESP_OK";
+        case ESP_FAIL:              return "ESP_FAIL";
+        case ESP_ERR_NO_MEM:        return "ESP_ERR_NO_MEM";
+        case ESP_ERR_INVALID_ARG:   return "ESP_ERR_INVALID_ARG";
+        case ESP_ERR_INVALID_STATE: return "ESP_ERR_INVALID_STATE";
+        case ESP_ERR_INVALID_SIZE:  return "ESP_ERR_INVALID_SIZE";
+        case ESP_ERR_NOT_FOUND:     return "ESP_ERR_NOT_FOUND";
+        case ESP_ERR_NVS_NOT_FOUND: return "ESP_ERR_NVS_NOT_FOUND";
+        default:                    return "UNKNOWN ERROR";
+    }
+}
+
+// ---- system ----
+
+static shutdown_handler_t shutdown_handlers[HOST_SHUTDOWN_HANDLERS];
+
+esp_reset_reason_t esp_reset_reason(void)
+{
+    return ESP_RST_POWERON;
+}
+
+esp_err_t esp_register_shutdown_handler(shutdown_handler_t handle)
+{
+    for (size_t i = 0; i < HOST_SHUTDOWN_HANDLERS; i++) {
+        if (shutdown_handlers[i] == handle) {
+            return ESP_ERR_INVALID_STATE;
+        }
+        if (shutdown_handlers[i] == NULL) {
+            shutdown_handlers[i] = handle;
+            return ESP_OK;
+        }
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void esp_restart(void)
+{
+    for (size_t i = HOST_SHUTDOWN_HANDLERS; i-- > 0;) {
+        if (shutdown_handlers[i]) {
+            shutdown_handlers[i]();
+        }
+    }
+    exit(0);
+}
+
+// ---- NVS ----
+
+typedef struct {
+    nvs_handle_t ns;            // Namespace index + 1, 0 = free
+    char key[16];               // NVS key length limit
+    size_t length;
+    void *value;
+} host_nvs_entry_t;
+
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+static char nvs_namespaces[HOST_NVS_MAX_NAMESPACES][16];
+static host_nvs_entry_t nvs_entries[HOST_NVS_MAX_ENTRIES];
+
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+    if (strlen(namespace_name) >= sizeof(nvs_namespaces[0])) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    pthread_mutex_lock(&nvs_lock);
+    esp_err_t err = open_mode == NVS_READONLY ? ESP_ERR_NVS_NOT_FOUND : ESP_ERR_NO_MEM;
+    for (size_t i = 0; i < HOST_NVS_MAX_NAMESPACES; i++) {
+        if (strcmp(nvs_namespaces[i], namespace_name) == 0) {
+            *out_handle = i + 1;
+            err = ESP_OK;
+            break;
+        }
+        if (nvs_namespaces[i][0] == '\0') {
+            // Read-only open of a namespace that was never written fails, as on the device
+            if (open_mode == NVS_READWRITE) {
+                strcpy(nvs_namespaces[i], namespace_name);
+                *out_handle = i + 1;
+                err = ESP_OK;
+            }
+            break;
+        }
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+    (void)handle;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    (void)handle;
+    return ESP_OK;
+}
+
+static host_nvs_entry_t *nvs_find(nvs_handle_t handle, const char *key, bool create)
+{
+    host_nvs_entry_t *free_entry = NULL;
+    for (size_t i = 0; i < HOST_NVS_MAX_ENTRIES; i++) {
+        host_nvs_entry_t *e = &nvs_entries[i];
+        if (e->ns == handle && strcmp(e->key, key) == 0) {
+            return e;
+        }
+        if (e->ns == 0 && !free_entry) {
+            free_entry = e;
+        }
+    }
+    if (!create || !free_entry) {
+        return NULL;
+    }
+    free_entry->ns = handle;
+    snprintf(free_entry->key, sizeof(free_entry->key), "%s", key);
+    return free_entry;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+    if (strlen(key) >= sizeof(nvs_entries[0].key)) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    void *copy = malloc(length ? length : 1);
+    if (!copy) {
+        return ESP_ERR_NO_MEM;
+    }
+    memcpy(copy, value, length);
+    pthread_mutex_lock(&nvs_lock);
+    host_nvs_entry_t *e = nvs_find(handle, key, true);
+    if (!e) {
+        pthread_mutex_unlock(&nvs_lock);
+        free(copy);
+        return ESP_ERR_NO_MEM;
+    }
+    free(e->value);
+    e->value = copy;
+    e->length = length;
+    pthread_mutex_unlock(&nvs_lock);
+    return ESP_OK;
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+    pthread_mutex_lock(&nvs_lock);
+    host_nvs_entry_t *e = nvs_find(handle, key, false);
+    esp_err_t err = ESP_OK;
+    if (!e) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (!out_value) {
+        *length = e->length;
+    } else if (*length < e->length) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        memcpy(out_value, e->value, e->length);
+        *length = e->length;
+    }
+    pthread_mutex_unlock(&nvs_lock);
+    return err;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return nvs_set_blob(handle, key, &value, sizeof(value));
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out_value)
+{
+    size_t length = sizeof(*out_value);
+    return nvs_get_blob(handle, key, out_value, &length);
+}
+
+void host_nvs_erase_all(void)
+{
+    pthread_mutex_lock(&nvs_lock);
+    for (size_t i = 0; i < HOST_NVS_MAX_ENTRIES; i++) {
+        free(nvs_entries[i].value);
+    }
+    memset(nvs_entries, 0, sizeof(nvs_entries));
+    memset(nvs_namespaces, 0, sizeof(nvs_namespaces));
+    pthread_mutex_unlock(&nvs_lock);
+}
@@ -0,0 +1,22 @@
+/*
+ * Host platform controls
+ *
+ * Host-only hooks into the shim layer for drivers such as the UPS simulator.
+ * With the virtual clock enabled, esp_timer_get_time() and xTaskGetTickCount()
+ * stop following CLOCK_MONOTONIC and only move through host_clock_advance_us(),
+ * so minutes of UPS time can be replayed in milliseconds.
+ */
+
+#ifndef HOST_PLATFORM_H
+#define HOST_PLATFORM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Freeze the clock at its current value (true) or return to real time (false)
+void host_clock_set_virtual(bool enable);
+
+// Move the virtual clock forward; ignored in real time
+void host_clock_advance_us(int64_t us);
+
+#endif // HOST_PLATFORM_H
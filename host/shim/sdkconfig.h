@@ -0,0 +1,32 @@
+/*
+ * Host build configuration
+ *
+ * Kconfig defaults for the modules in the host core library (see
+ * main/Kconfig.projbuild). Deferred logging is off: logs go straight to stderr.
+ */
+
+#ifndef HOST_SDKCONFIG_H
+#define HOST_SDKCONFIG_H
+
+#define CONFIG_UPS_PQ_NOMINAL_VOLTAGE 230
+#define CONFIG_UPS_PQ_SAG_PERCENT 10
+#define CONFIG_UPS_PQ_SWELL_PERCENT 10
+#define CONFIG_UPS_PQ_TRANSFER_LOW_VOLTAGE 184
+#define CONFIG_UPS_PQ_HYSTERESIS_VOLTAGE 4
+#define CONFIG_UPS_PQ_DEBOUNCE_SAMPLES 2
+#define CONFIG_UPS_PQ_BROWNOUT_MS 60000
+#define CONFIG_UPS_PQ_JOURNAL_SIZE 32
+#define CONFIG_UPS_SOE_JOURNAL_SIZE 128
+#define CONFIG_UPS_NOMINAL_POWER_W 390
+#define CONFIG_UPS_ENERGY_PERSIST_INTERVAL_S 900
+#define CONFIG_UPS_ENERGY_PERSIST_DELTA_WH 50
+#define CONFIG_UPS_BATTERY_MV_PER_COUNT 100
+#define CONFIG_UPS_BATTERY_RATED_CAPACITY_AH_X10 70
+#define CONFIG_UPS_INVERTER_EFFICIENCY_PERCENT 85
+#define CONFIG_UPS_BATTERY_MIN_STEP_MA 2000
+#define CONFIG_UPS_BATTERY_MIN_DISCHARGE_PERCENT 10
+#define CONFIG_UPS_BATTERY_REPLACE_CAPACITY_PERCENT 80
+#define CONFIG_UPS_BATTERY_REPLACE_RESISTANCE_PERCENT 200
+#define CONFIG_UPS_BATTERY_TREND_SIZE 32
+
+#endif // HOST_SDKCONFIG_H
@@ -0,0 +1,256 @@
+/*
+ * Host driver for the firmware core
+ *
+ * Replays a cycle of synthetic CyberPower HID reports through ups_monitor and
+ * times each stage of the data path: HID decoding, the full report pipeline
+ * (power quality, energy meter, battery health), NUT command execution and the
+ * /api JSON renderers. Exits non-zero if any reply is an error or a render is
+ * truncated, so a run under valgrind or the sanitizers doubles as a smoke
+ * check.
+ *
+ *   ups_core_bench [-n iterations] [-v] [-p port]
+ *
+ * -v prints one NUT LIST VAR reply and each JSON body; -p serves the NUT
+ * protocol on a TCP port after the benchmark (one client at a time) so upsc
+ * can be pointed at it.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "ups_hid.h"
+#include "ups_monitor.h"
+#include "nut_protocol.h"
+#include "api_json.h"
+#include "json_writer.h"
+#include "soe_recorder.h"
+#include "energy_meter.h"
+#include "battery_health.h"
+#include "host_nut_server.h"
+
+#define REPORT_PERIOD_MS 100    // Virtual time between replayed reports
+
+typedef struct {
+    uint8_t data[5];
+    uint8_t length;
+} bench_report_t;
+
+// One polling cycle of a VP700ELCD on line power at ~230 V, 18% load
+static const bench_report_t reports[] = {
+    { { UPS_HID_REPORT_BATTERY, 100, 0x88, 0x00 }, 4 },
+    { { UPS_HID_REPORT_STATUS, 0x0b, 0x00 }, 3 },
+    { { UPS_HID_REPORT_RUNTIME, 45 }, 2 },
+    { { UPS_HID_REPORT_VOLTAGE, 0xe6, 0x00, 0xe6, 0x00 }, 5 },
+    { { UPS_HID_REPORT_LOAD, 18 }, 2 },
+    { { UPS_HID_REPORT_ALARM, 2 }, 2 },
+    { { UPS_HID_REPORT_BEEP, 2 }, 2 },
+    { { UPS_HID_REPORT_SYSTEM, 0x10 }, 2 },
+    { { UPS_HID_REPORT_EXTENDED, 0x01, 0x00 }, 3 },
+    { { UPS_HID_REPORT_TEMPERATURE, 25 }, 2 },
+    { { UPS_HID_REPORT_TEMP_RANGE1, 0x0a, 0x00 }, 3 },
+    { { UPS_HID_REPORT_TEMP_RANGE2, 0x32, 0x00 }, 3 },
+    { { UPS_HID_REPORT_SENSOR, 0x00, 0x00 }, 3 },
+};
+
+#define REPORT_COUNT (sizeof(reports) / sizeof(reports[0]))
+
+static uint32_t virtual_ms;
+static volatile size_t sink;    // Keeps results observable to the optimizer
+static int failures;
+
+static int64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void print_result(const char *name, unsigned long ops, int64_t elapsed_ns)
+{
+    double seconds = elapsed_ns / 1e9;
+    printf("%-24s %10lu ops %10.0f ops/s %9.1f ns/op\n",
+           name, ops, seconds > 0 ? ops / seconds : 0.0, ops ? (double)elapsed_ns / ops : 0.0);
+}
+
+static void replay_cycle(void)
+{
+    for (size_t i = 0; i < REPORT_COUNT; i++) {
+        virtual_ms += REPORT_PERIOD_MS;
+        ups_monitor_process_report(reports[i].data, reports[i].length, virtual_ms);
+    }
+}
+
+static size_t nut_command(const char *command, char *reply, size_t size)
+{
+    char line[128];
+    snprintf(line, sizeof(line), "%s\n", command);
+    size_t len = nut_protocol_execute(line, reply, size);
+    if (strncmp(reply, "ERR", 3) == 0) {
+        fprintf(stderr, "NUT '%s' failed: %s", command, reply);
+        failures++;
+    }
+    return len;
+}
+
+typedef void (*render_fn_t)(json_writer_t *w);
+
+static void render_ups_status(json_writer_t *w)
+{
+    api_json_ups_status(w, virtual_ms);
+}
+
+static void render_events(json_writer_t *w)
+{
+    api_json_events(w, 0, esp_timer_get_time());
+}
+
+static const struct {
+    const char *name;
+    render_fn_t render;
+} renderers[] = {
+    { "json_ups_status",     render_ups_status },
+    { "json_energy",         api_json_energy },
+    { "json_power_quality",  api_json_power_quality },
+    { "json_battery_health", api_json_battery_health },
+    { "json_events",         render_events },
+};
+
+static size_t render(render_fn_t fn, char *buf, size_t size, const char *name)
+{
+    json_writer_t w;
+    json_writer_init_buffer(&w, buf, size);
+    fn(&w);
+    if (json_writer_finish(&w) != ESP_OK) {
+        fprintf(stderr, "%s: render failed or truncated\n", name);
+        failures++;
+    }
+    return json_writer_length(&w);
+}
+
+static void bench_decode(unsigned long iterations)
+{
+    ups_hid_data_t data = {0};
+    int64_t start = now_ns();
+    for (unsigned long n = 0; n < iterations; n++) {
+        const bench_report_t *r = &reports[n % REPORT_COUNT];
+        sink += ups_hid_decode(&data, r->data, r->length);
+    }
+    print_result("hid_decode", iterations, now_ns() - start);
+    sink += data.load;
+}
+
+static void bench_pipeline(unsigned long iterations)
+{
+    unsigned long cycles = iterations / REPORT_COUNT + 1;
+    int64_t start = now_ns();
+    for (unsigned long n = 0; n < cycles; n++) {
+        replay_cycle();
+    }
+    print_result("monitor_report", cycles * REPORT_COUNT, now_ns() - start);
+}
+
+static void bench_nut(unsigned long iterations)
+{
+    char reply[NUT_PROTOCOL_REPLY_MAX];
+    static const struct {
+        const char *name;
+        const char *command;
+    } commands[] = {
+        { "nut_list_var", "LIST VAR " NUT_UPS_NAME },
+        { "nut_get_var", "GET VAR " NUT_UPS_NAME " ups.energy.total" },
+        { "nut_list_ups", "LIST UPS" },
+    };
+
+    for (size_t c = 0; c < sizeof(commands) / sizeof(commands[0]); c++) {
+        int64_t start = now_ns();
+        for (unsigned long n = 0; n < iterations; n++) {
+            sink += nut_command(commands[c].command, reply, sizeof(reply));
+        }
+        print_result(commands[c].name, iterations, now_ns() - start);
+    }
+}
+
+static void bench_json(unsigned long iterations)
+{
+    static char buf[16384];
+    for (size_t r = 0; r < sizeof(renderers) / sizeof(renderers[0]); r++) {
+        int64_t start = now_ns();
+        for (unsigned long n = 0; n < iterations; n++) {
+            sink += render(renderers[r].render, buf, sizeof(buf), renderers[r].name);
+        }
+        print_result(renderers[r].name, iterations, now_ns() - start);
+    }
+}
+
+static void dump_outputs(void)
+{
+    char reply[NUT_PROTOCOL_REPLY_MAX];
+    nut_command("LIST VAR " NUT_UPS_NAME, reply, sizeof(reply));
+    fputs(reply, stdout);
+
+    static char buf[16384];
+    for (size_t r = 0; r < sizeof(renderers) / sizeof(renderers[0]); r++) {
+        render(renderers[r].render, buf, sizeof(buf), renderers[r].name);
+        printf("%s: %s\n", renderers[r].name, buf);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    unsigned long iterations = 200000;
+    bool verbose = false;
+    int port = 0;
+    int opt;
+    while ((opt = getopt(argc, argv, "n:vp:")) != -1) {
+        switch (opt) {
+            case 'n': iterations = strtoul(optarg, NULL, 0); break;
+            case 'v': verbose = true; break;
+            case 'p': port = atoi(optarg); break;
+            default:
+                fprintf(stderr, "usage: %s [-n iterations] [-v] [-p port]\n", argv[0]);
+                return 2;
+        }
+    }
+
+    soe_init();
+    energy_meter_init();
+    battery_health_init();
+
+    virtual_ms = xTaskGetTickCount();
+    ups_monitor_device_ready();
+    replay_cycle();
+    if (!ups_monitor_available()) {
+        fprintf(stderr, "UPS not ACTIVE after the first report cycle\n");
+        return 1;
+    }
+
+    bench_decode(iterations);
+    bench_pipeline(iterations);
+    bench_nut(iterations / 10 + 1);
+    bench_json(iterations / 10 + 1);
+
+    if (verbose) {
+        dump_outputs();
+    }
+    if (failures) {
+        fprintf(stderr, "%d failures\n", failures);
+        return 1;
+    }
+    if (port) {
+        int listen_sock = host_nut_server_open(port, &port);
+        if (listen_sock < 0) {
+            return 1;
+        }
+        printf("Serving NUT on port %d\n", port);
+        fflush(stdout);
+        // Keep the values moving between commands
+        host_nut_server_run(listen_sock, replay_cycle);
+        return 1;
+    }
+    return 0;
+}
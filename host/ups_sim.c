@@ -0,0 +1,847 @@
+/*
+ * Simulated UPS
+ *
+ * Plays a scenario script against the firmware core: a modelled VP700ELCD
+ * (mains, load, battery charge and voltage) emits the same HID report cycle as
+ * the real unit and feeds it to ups_monitor_process_report(), the entry point
+ * hid_host_interface_callback() uses. The freshness check, energy meter and
+ * battery health services run every UPS_MONITOR_CHECK_PERIOD_MS, as in
+ * ups_freshness_timer_task().
+ *
+ * Time is virtual: a scenario runs as fast as the core can process reports
+ * unless -r runs it on the real clock. Meanwhile a NUT client thread polls
+ * `GET VAR ups.load` over a loopback socket; the simulator dithers the load by
+ * +-1 % on every load report and records how long each new value takes to
+ * show up in a NUT reply (report-to-NUT visibility, in real microseconds).
+ * The firmware's own report_trace stages are printed as well; they are only
+ * meaningful with -r, since the virtual clock does not move while a report is
+ * processed. -t writes the report_trace spans as Chrome/Perfetto trace JSON.
+ *
+ *   ups_sim [-r] [-v] [-t trace.json] script
+ *
+ * Script, one command per line (# starts a comment, durations take ms/s/m/h):
+ *   rate <reports/s>            report rate while reporting (default 1000)
+ *   load <percent>              output load
+ *   voltage <volts>             mains voltage while on line (default 230)
+ *   online <duration>           on mains, battery charging
+ *   outage <duration>           mains lost, battery discharging under load
+ *   discharge <percent> [limit] on battery until charge <= percent (default limit 2h)
+ *   stall <duration>            connected but no reports
+ *   disconnect <duration>       USB unplugged
+ *   expect state <DISCONNECTED|WAITING|ACTIVE|STALE>
+ *   expect var <name> <=|<|>> <value>
+ *
+ * Every STALE transition is also checked against the freshness timeout, and
+ * every report must leave the monitor ACTIVE. Exits non-zero on any failure.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "host_platform.h"
+#include "host_nut_server.h"
+#include "ups_monitor.h"
+#include "nut_protocol.h"
+#include "latency_hist.h"
+#include "soe_recorder.h"
+#include "energy_meter.h"
+#include "battery_health.h"
+#include "report_trace.h"
+
+#define SIM_MAX_STEPS               256
+#define SIM_FULL_LOAD_RUNTIME_S     240     // Full charge to empty at 100 % load
+#define SIM_RECHARGE_S              28800   // Empty to full on mains
+#define SIM_LOW_BATTERY_PERCENT     20
+#define SIM_NOMINAL_VOLTAGE         230
+#define SIM_DISCHARGE_LIMIT_US      (2LL * 3600 * 1000000)
+#define SIM_TRACE_MAX_EVENTS        500000
+
+// Report 0x21 byte 1 as captured on line power. The firmware passes it through
+// as ups.status.flags; the two bits below are the simulator's own encoding.
+#define SIM_STATUS_LINE             0x0b
+#define SIM_STATUS_AC_PRESENT       0x01
+#define SIM_STATUS_LOW_BATTERY      0x04
+
+typedef enum {
+    STEP_RATE,
+    STEP_LOAD,
+    STEP_VOLTAGE,
+    STEP_ONLINE,
+    STEP_OUTAGE,
+    STEP_DISCHARGE,
+    STEP_STALL,
+    STEP_DISCONNECT,
+    STEP_EXPECT_STATE,
+    STEP_EXPECT_VAR,
+} sim_step_type_t;
+
+typedef struct {
+    sim_step_type_t type;
+    int line;
+    int64_t duration_us;        // Timed steps; limit for STEP_DISCHARGE
+    int value;                  // rate / load / voltage / percent / state
+    char op;                    // STEP_EXPECT_VAR: '=', '<' or '>'
+    char name[32];
+    char expected[32];
+} sim_step_t;
+
+typedef struct {
+    bool connected;             // USB attached
+    bool announced;             // ups_monitor_device_ready() sent since attach
+    bool reporting;
+    bool mains;
+    int mains_voltage;
+    int load;
+    double charge;              // Percent
+    unsigned rate;
+    size_t next_report;         // Position in the report cycle
+    int64_t next_report_us;
+    int64_t next_check_us;
+    int64_t time_us;            // Clock value the model was last updated to
+} sim_model_t;
+
+// Newest load value sent, for the NUT visibility probe
+typedef struct {
+    pthread_mutex_t lock;
+    uint32_t seq;
+    int value;
+    int64_t submit_ns;
+} sim_probe_t;
+
+static sim_step_t steps[SIM_MAX_STEPS];
+static size_t step_count;
+static sim_model_t model = {
+    .mains = true,
+    .mains_voltage = SIM_NOMINAL_VOLTAGE,
+    .load = 20,
+    .charge = 100.0,
+    .rate = 1000,
+};
+static sim_probe_t probe = { .lock = PTHREAD_MUTEX_INITIALIZER };
+static latency_hist_t visibility;
+static volatile bool reader_stop;
+static uint32_t nut_polls;
+static bool realtime;
+static bool verbose;
+static int failures;
+
+static uint64_t reports_sent;
+static int64_t parse_ns;
+static int64_t real_start_ns;
+static int64_t virtual_start_us;
+static int64_t clock_offset_ns;     // real_ns() - esp_timer_get_time() on the real clock
+static ups_connection_state_t last_state = UPS_DISCONNECTED;
+
+static int64_t real_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static double virtual_s(void)
+{
+    return (esp_timer_get_time() - virtual_start_us) / 1e6;
+}
+
+static void fail(int line, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+static void fail(int line, const char *fmt, ...)
+{
+    fprintf(stderr, "FAIL line %d at %.3f s: ", line, virtual_s());
+    va_list ap;
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    fputc('\n', stderr);
+    failures++;
+}
+
+// ---- script ----
+
+static bool parse_duration(const char *text, int64_t *out_us)
+{
+    char *end;
+    double value = strtod(text, &end);
+    if (end == text || value < 0) {
+        return false;
+    }
+    double scale = 1e6;
+    if (strcmp(end, "ms") == 0) {
+        scale = 1e3;
+    } else if (strcmp(end, "m") == 0) {
+        scale = 60e6;
+    } else if (strcmp(end, "h") == 0) {
+        scale = 3600e6;
+    } else if (*end != '\0' && strcmp(end, "s") != 0) {
+        return false;
+    }
+    *out_us = (int64_t)(value * scale);
+    return true;
+}
+
+static bool parse_state(const char *text, int *out)
+{
+    for (int s = UPS_DISCONNECTED; s <= UPS_CONNECTED_STALE; s++) {
+        if (strcasecmp(text, ups_state_name((ups_connection_state_t)s)) == 0) {
+            *out = s;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_step(char *text, int line, sim_step_t *step)
+{
+    char *argv[5] = {0};
+    int argc = 0;
+    for (char *tok = strtok(text, " \t"); tok && argc < 5; tok = strtok(NULL, " \t")) {
+        argv[argc++] = tok;
+    }
+    memset(step, 0, sizeof(*step));
+    step->line = line;
+    const char *cmd = argv[0];
+
+    if (argc == 2 && strcmp(cmd, "rate") == 0) {
+        step->type = STEP_RATE;
+        step->value = atoi(argv[1]);
+        return step->value > 0 && step->value <= 1000000;
+    }
+    if (argc == 2 && strcmp(cmd, "load") == 0) {
+        step->type = STEP_LOAD;
+        step->value = atoi(argv[1]);
+        return step->value >= 0 && step->value <= 100;
+    }
+    if (argc == 2 && strcmp(cmd, "voltage") == 0) {
+        step->type = STEP_VOLTAGE;
+        step->value = atoi(argv[1]);
+        return step->value >= 0 && step->value < 65536;
+    }
+    if (argc == 2 && strcmp(cmd, "online") == 0) {
+        step->type = STEP_ONLINE;
+        return parse_duration(argv[1], &step->duration_us);
+    }
+    if (argc == 2 && strcmp(cmd, "outage") == 0) {
+        step->type = STEP_OUTAGE;
+        return parse_duration(argv[1], &step->duration_us);
+    }
+    if ((argc == 2 || argc == 3) && strcmp(cmd, "discharge") == 0) {
+        step->type = STEP_DISCHARGE;
+        step->value = atoi(argv[1]);
+        step->duration_us = SIM_DISCHARGE_LIMIT_US;
+        return step->value >= 0 && step->value < 100 && (argc == 2 || parse_duration(argv[2], &step->duration_us));
+    }
+    if (argc == 2 && strcmp(cmd, "stall") == 0) {
+        step->type = STEP_STALL;
+        return parse_duration(argv[1], &step->duration_us);
+    }
+    if (argc == 2 && strcmp(cmd, "disconnect") == 0) {
+        step->type = STEP_DISCONNECT;
+        return parse_duration(argv[1], &step->duration_us);
+    }
+    if (argc == 3 && strcmp(cmd, "expect") == 0 && strcmp(argv[1], "state") == 0) {
+        step->type = STEP_EXPECT_STATE;
+        return parse_state(argv[2], &step->value);
+    }
+    if (argc == 5 && strcmp(cmd, "expect") == 0 && strcmp(argv[1], "var") == 0) {
+        step->type = STEP_EXPECT_VAR;
+        step->op = argv[3][0];
+        snprintf(step->name, sizeof(step->name), "%s", argv[2]);
+        snprintf(step->expected, sizeof(step->expected), "%s", argv[4]);
+        return strlen(argv[3]) == 1 && strchr("=<>", step->op);
+    }
+    return false;
+}
+
+static bool load_script(const char *path)
+{
+    FILE *f = fopen(path, "r");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    char text[256];
+    int line = 0;
+    bool ok = true;
+    while (ok && fgets(text, sizeof(text), f)) {
+        line++;
+        char *hash = strchr(text, '#');
+        if (hash) {
+            *hash = '\0';
+        }
+        text[strcspn(text, "\r\n")] = '\0';
+        char *p = text;
+        while (isspace((unsigned char)*p)) {
+            p++;
+        }
+        if (*p == '\0') {
+            continue;
+        }
+        if (step_count == SIM_MAX_STEPS) {
+            fprintf(stderr, "%s:%d: more than %d steps\n", path, line, SIM_MAX_STEPS);
+            ok = false;
+        } else if (!parse_step(p, line, &steps[step_count])) {
+            fprintf(stderr, "%s:%d: cannot parse command\n", path, line);
+            ok = false;
+        } else {
+            step_count++;
+        }
+    }
+    fclose(f);
+    return ok;
+}
+
+// ---- UPS model ----
+
+static void model_update(int64_t dt_us)
+{
+    double dt_s = dt_us / 1e6;
+    if (model.mains) {
+        model.charge += 100.0 * dt_s / SIM_RECHARGE_S;
+    } else {
+        model.charge -= 100.0 * dt_s * model.load / (100.0 * SIM_FULL_LOAD_RUNTIME_S);
+    }
+    model.charge = model.charge < 0 ? 0 : (model.charge > 100 ? 100 : model.charge);
+}
+
+// Float voltage on mains; on battery resting voltage by charge minus the load sag
+static int model_battery_counts(void)
+{
+    int mv = model.mains ? 13600 : 11800 + (int)(12 * model.charge) - 8 * model.load;
+    return mv / CONFIG_UPS_BATTERY_MV_PER_COUNT;
+}
+
+static int model_runtime_min(void)
+{
+    int load = model.load > 0 ? model.load : 1;
+    int runtime = (int)(model.charge * SIM_FULL_LOAD_RUNTIME_S / load / 60);
+    return runtime > 255 ? 255 : runtime;
+}
+
+static int model_status(void)
+{
+    int status = SIM_STATUS_LINE;
+    if (!model.mains) {
+        status &= ~SIM_STATUS_AC_PRESENT;
+    }
+    if (model.charge <= SIM_LOW_BATTERY_PERCENT) {
+        status |= SIM_STATUS_LOW_BATTERY;
+    }
+    return status;
+}
+
+// Next report of the VP700ELCD polling cycle; returns its length
+static size_t model_report(uint8_t *r)
+{
+    static const uint8_t cycle[] = {
+        UPS_HID_REPORT_BATTERY, UPS_HID_REPORT_STATUS, UPS_HID_REPORT_RUNTIME, UPS_HID_REPORT_VOLTAGE,
+        UPS_HID_REPORT_LOAD, UPS_HID_REPORT_ALARM, UPS_HID_REPORT_BEEP, UPS_HID_REPORT_SYSTEM,
+        UPS_HID_REPORT_EXTENDED, UPS_HID_REPORT_TEMPERATURE, UPS_HID_REPORT_TEMP_RANGE1,
+        UPS_HID_REPORT_TEMP_RANGE2, UPS_HID_REPORT_SENSOR,
+    };
+    uint8_t id = cycle[model.next_report];
+    model.next_report = (model.next_report + 1) % sizeof(cycle);
+    r[0] = id;
+
+    switch (id) {
+        case UPS_HID_REPORT_BATTERY: {
+            int counts = model_battery_counts();
+            r[1] = (uint8_t)model.charge;
+            r[2] = counts & 0xff;
+            r[3] = counts >> 8;
+            return 4;
+        }
+        case UPS_HID_REPORT_STATUS:
+            r[1] = model_status();
+            r[2] = 0;
+            return 3;
+        case UPS_HID_REPORT_RUNTIME:
+            r[1] = model_runtime_min();
+            return 2;
+        case UPS_HID_REPORT_VOLTAGE: {
+            int input = model.mains ? model.mains_voltage : 0;
+            r[1] = input & 0xff;
+            r[2] = input >> 8;
+            r[3] = SIM_NOMINAL_VOLTAGE & 0xff;
+            r[4] = SIM_NOMINAL_VOLTAGE >> 8;
+            return 5;
+        }
+        case UPS_HID_REPORT_LOAD: {
+            // Dither by +-1 % so every load report is a new value for the probe
+            pthread_mutex_lock(&probe.lock);
+            probe.seq++;
+            int load = model.load + (int)(probe.seq % 3) - 1;
+            probe.value = load < 0 ? 0 : (load > 100 ? 100 : load);
+            probe.submit_ns = real_ns();
+            r[1] = probe.value;
+            pthread_mutex_unlock(&probe.lock);
+            return 2;
+        }
+        case UPS_HID_REPORT_ALARM:
+        case UPS_HID_REPORT_BEEP:
+            r[1] = 2;
+            return 2;
+        case UPS_HID_REPORT_SYSTEM:
+            r[1] = 0x10;
+            return 2;
+        case UPS_HID_REPORT_EXTENDED:
+            r[1] = 0x01;
+            r[2] = 0;
+            return 3;
+        case UPS_HID_REPORT_TEMPERATURE:
+            r[1] = 25;
+            return 2;
+        case UPS_HID_REPORT_TEMP_RANGE1:
+            r[1] = 0x0a;
+            r[2] = 0;
+            return 3;
+        case UPS_HID_REPORT_TEMP_RANGE2:
+            r[1] = 0x32;
+            r[2] = 0;
+            return 3;
+        default:
+            r[1] = 0;
+            r[2] = 0;
+            return 3;
+    }
+}
+
+// ---- firmware glue ----
+
+static void on_ups_event(ups_monitor_event_t event, uint32_t now_ms)
+{
+    if (event != UPS_MONITOR_STATE_CHANGED) {
+        return;
+    }
+    ups_connection_state_t state = get_ups_state();
+    if (verbose) {
+        printf("%10.3f s  %s -> %s\n", virtual_s(), ups_state_name(last_state), ups_state_name(state));
+    }
+    if (state == UPS_CONNECTED_STALE) {
+        uint32_t gap = now_ms - get_ups_last_data_time();
+        if (gap <= UPS_MONITOR_FRESHNESS_TIMEOUT_MS || gap > UPS_MONITOR_FRESHNESS_TIMEOUT_MS + UPS_MONITOR_CHECK_PERIOD_MS) {
+            fail(0, "STALE after %lu ms without data", (unsigned long)gap);
+        }
+    }
+    last_state = state;
+}
+
+static void send_report(void)
+{
+    uint8_t report[8];
+    size_t length = model_report(report);
+    if (!model.announced) {
+        ups_monitor_device_ready();
+        model.announced = true;
+    }
+    int64_t start = real_ns();
+    report_trace_arrival();
+    ups_monitor_process_report(report, length, xTaskGetTickCount() * portTICK_PERIOD_MS);
+    parse_ns += real_ns() - start;
+    reports_sent++;
+    if (get_ups_state() != UPS_CONNECTED_ACTIVE) {
+        fail(0, "report left the monitor %s", ups_state_name(get_ups_state()));
+    }
+}
+
+// What ups_freshness_timer_task does each period
+static void freshness_check(void)
+{
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    ups_monitor_check_freshness(now_ms);
+    energy_meter_service(now_ms);
+    battery_health_service();
+}
+
+static void advance_to(int64_t t_us)
+{
+    if (realtime) {
+        int64_t due_ns = clock_offset_ns + t_us * 1000;
+        struct timespec ts = { .tv_sec = due_ns / 1000000000, .tv_nsec = due_ns % 1000000000 };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    } else if (t_us > esp_timer_get_time()) {
+        host_clock_advance_us(t_us - esp_timer_get_time());
+    }
+    int64_t now = esp_timer_get_time();
+    model_update(now - model.time_us);
+    model.time_us = now;
+}
+
+// Run the model for duration_us, or until the charge falls to stop_charge
+static void run_for(int64_t duration_us, double stop_charge)
+{
+    int64_t end = esp_timer_get_time() + duration_us;
+    int64_t period_us = 1000000 / model.rate;
+    if (model.reporting && model.next_report_us < esp_timer_get_time()) {
+        model.next_report_us = esp_timer_get_time();
+    }
+    while (esp_timer_get_time() < end && model.charge > stop_charge) {
+        int64_t next = end;
+        if (model.reporting && model.next_report_us < next) {
+            next = model.next_report_us;
+        }
+        if (model.next_check_us < next) {
+            next = model.next_check_us;
+        }
+        advance_to(next);
+        int64_t now = esp_timer_get_time();
+        if (now >= model.next_check_us) {
+            freshness_check();
+            model.next_check_us += UPS_MONITOR_CHECK_PERIOD_MS * 1000LL;
+        }
+        if (model.reporting && now >= model.next_report_us) {
+            send_report();
+            model.next_report_us += period_us > 0 ? period_us : 1;
+        }
+    }
+}
+
+static void expect_var(const sim_step_t *step)
+{
+    char line[96];
+    char reply[NUT_PROTOCOL_REPLY_MAX];
+    snprintf(line, sizeof(line), "GET VAR " NUT_UPS_NAME " %s", step->name);
+    nut_protocol_execute(line, reply, sizeof(reply));
+
+    char *value = strchr(reply, '"');
+    char *end = value ? strchr(value + 1, '"') : NULL;
+    if (!end) {
+        reply[strcspn(reply, "\n")] = '\0';
+        fail(step->line, "%s", reply);
+        return;
+    }
+    *end = '\0';
+    value++;
+    bool ok;
+    if (step->op == '=') {
+        ok = strcmp(value, step->expected) == 0;
+    } else {
+        double actual = atof(value);
+        double expected = atof(step->expected);
+        ok = step->op == '<' ? actual < expected : actual > expected;
+    }
+    if (!ok) {
+        fail(step->line, "%s is %s, expected %c %s", step->name, value, step->op, step->expected);
+    }
+}
+
+static void run_step(const sim_step_t *step)
+{
+    switch (step->type) {
+        case STEP_RATE:
+            model.rate = step->value;
+            break;
+        case STEP_LOAD:
+            model.load = step->value;
+            break;
+        case STEP_VOLTAGE:
+            model.mains_voltage = step->value;
+            break;
+        case STEP_ONLINE:
+        case STEP_OUTAGE:
+            model.connected = true;
+            model.reporting = true;
+            model.mains = step->type == STEP_ONLINE;
+            run_for(step->duration_us, -1);
+            break;
+        case STEP_DISCHARGE:
+            model.connected = true;
+            model.reporting = true;
+            model.mains = false;
+            run_for(step->duration_us, step->value);
+            if (model.charge > step->value) {
+                fail(step->line, "battery still at %.1f %% at the discharge limit", model.charge);
+            }
+            break;
+        case STEP_STALL:
+            model.reporting = false;
+            run_for(step->duration_us, -1);
+            break;
+        case STEP_DISCONNECT:
+            if (model.connected) {
+                ups_monitor_device_gone();
+            }
+            model.connected = false;
+            model.announced = false;
+            model.reporting = false;
+            run_for(step->duration_us, -1);
+            break;
+        case STEP_EXPECT_STATE:
+            if (get_ups_state() != (ups_connection_state_t)step->value) {
+                fail(step->line, "state is %s, expected %s",
+                     ups_state_name(get_ups_state()), ups_state_name((ups_connection_state_t)step->value));
+            }
+            break;
+        case STEP_EXPECT_VAR:
+            expect_var(step);
+            break;
+    }
+}
+
+// ---- NUT visibility probe ----
+
+static void *nut_reader_task(void *arg)
+{
+    int port = *(int *)arg;
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {
+        .sin_family = AF_INET,
+        .sin_port = htons(port),
+        .sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+    };
+    if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        perror("NUT reader connect");
+        return NULL;
+    }
+    int opt = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    static const char cmd[] = "GET VAR " NUT_UPS_NAME " ups.load\n";
+    uint32_t seen_seq = 0;
+    char reply[256];
+    while (!reader_stop) {
+        if (send(sock, cmd, sizeof(cmd) - 1, MSG_NOSIGNAL) < 0) {
+            break;
+        }
+        size_t len = 0;
+        ssize_t n = 0;
+        while (len < sizeof(reply) - 1 && (n = recv(sock, reply + len, sizeof(reply) - 1 - len, 0)) > 0) {
+            len += n;
+            if (reply[len - 1] == '\n') {
+                break;
+            }
+        }
+        if (n <= 0) {
+            break;
+        }
+        int64_t now = real_ns();
+        reply[len] = '\0';
+        nut_polls++;
+
+        const char *quote = strchr(reply, '"');
+        if (!quote) {
+            continue;   // ERR UPS-NOT-FOUND while disconnected
+        }
+        int value = atoi(quote + 1);
+        pthread_mutex_lock(&probe.lock);
+        // A reply older than the report cannot have seen it (the dithered values repeat)
+        if (probe.seq != seen_seq && value == probe.value && now >= probe.submit_ns) {
+            latency_hist_record(&visibility, (uint32_t)((now - probe.submit_ns) / 1000), false);
+            seen_seq = probe.seq;
+        }
+        pthread_mutex_unlock(&probe.lock);
+    }
+    close(sock);
+    return NULL;
+}
+
+static void *nut_server_task(void *arg)
+{
+    host_nut_server_run(*(int *)arg, NULL);
+    return NULL;
+}
+
+// ---- Chrome/Perfetto trace export ----
+
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER;
+static FILE *trace_file;
+static json_writer_t trace_writer;
+static char trace_stage[4096];
+static uint32_t trace_events;
+static uint32_t trace_dropped;
+
+static esp_err_t trace_flush(void *ctx, const char *data, size_t len)
+{
+    return fwrite(data, 1, len, (FILE *)ctx) == len ? ESP_OK : ESP_FAIL;
+}
+
+// One track per stage group: the USB report path and each client kind
+static int trace_tid(report_trace_stage_t stage)
+{
+    return stage <= REPORT_TRACE_PUBLISH ? 1 : 2 + (stage - REPORT_TRACE_NUT);
+}
+
+static void trace_thread_name(int tid, const char *name)
+{
+    json_obj_begin(&trace_writer, NULL);
+    json_str(&trace_writer, "name", "thread_name");
+    json_str(&trace_writer, "ph", "M");
+    json_int(&trace_writer, "pid", 1);
+    json_int(&trace_writer, "tid", tid);
+    json_obj_begin(&trace_writer, "args");
+    json_str(&trace_writer, "name", name);
+    json_obj_end(&trace_writer);
+    json_obj_end(&trace_writer);
+}
+
+static void trace_hook(report_trace_stage_t stage, int64_t start_us, int64_t end_us, uint32_t generation)
+{
+    pthread_mutex_lock(&trace_lock);
+    if (trace_events >= SIM_TRACE_MAX_EVENTS) {
+        trace_dropped++;
+    } else {
+        trace_events++;
+        json_obj_begin(&trace_writer, NULL);
+        json_str(&trace_writer, "name", report_trace_stage_name(stage));
+        json_str(&trace_writer, "cat", "report");
+        json_str(&trace_writer, "ph", "X");
+        json_int(&trace_writer, "ts", start_us - virtual_start_us);
+        json_int(&trace_writer, "dur", end_us - start_us);
+        json_int(&trace_writer, "pid", 1);
+        json_int(&trace_writer, "tid", trace_tid(stage));
+        json_obj_begin(&trace_writer, "args");
+        json_uint(&trace_writer, "generation", generation);
+        json_obj_end(&trace_writer);
+        json_obj_end(&trace_writer);
+    }
+    pthread_mutex_unlock(&trace_lock);
+}
+
+static bool trace_open(const char *path)
+{
+    trace_file = fopen(path, "w");
+    if (!trace_file) {
+        perror(path);
+        return false;
+    }
+    json_writer_init_stream(&trace_writer, trace_stage, sizeof(trace_stage), trace_flush, trace_file);
+    json_obj_begin(&trace_writer, NULL);
+    json_str(&trace_writer, "displayTimeUnit", "ms");
+    json_arr_begin(&trace_writer, "traceEvents");
+    trace_thread_name(1, "usb report");
+    trace_thread_name(trace_tid(REPORT_TRACE_NUT), "nut client");
+    trace_thread_name(trace_tid(REPORT_TRACE_HTTP), "http client");
+    trace_thread_name(trace_tid(REPORT_TRACE_WS), "ws client");
+    report_trace_set_hook(trace_hook);
+    return true;
+}
+
+static void trace_close(void)
+{
+    report_trace_set_hook(NULL);
+    json_arr_end(&trace_writer);
+    json_obj_end(&trace_writer);
+    if (json_writer_finish(&trace_writer) != ESP_OK) {
+        fprintf(stderr, "trace: write failed\n");
+        failures++;
+    }
+    fclose(trace_file);
+    printf("trace       %lu events written, %lu dropped\n", (unsigned long)trace_events, (unsigned long)trace_dropped);
+}
+
+// ---- main ----
+
+static void print_summary(void)
+{
+    double real_s = (real_ns() - real_start_ns) / 1e9;
+    double sim_s = virtual_s();
+    ups_values_t values;
+    get_ups_values(&values);
+
+    printf("simulated   %.1f s in %.3f s real (x%.0f)\n", sim_s, real_s, real_s > 0 ? sim_s / real_s : 0.0);
+    printf("reports     %llu sent, %lu unknown, %.0f reports/s wall\n",
+           (unsigned long long)reports_sent, (unsigned long)values.reports_unknown,
+           real_s > 0 ? reports_sent / real_s : 0.0);
+    printf("parser      %.1f ns/report (ups_monitor_process_report)\n",
+           reports_sent ? (double)parse_ns / reports_sent : 0.0);
+
+    latency_hist_t snap;
+    latency_hist_snapshot(&visibility, &snap);
+    char json[512];
+    json_writer_t w;
+    json_writer_init_buffer(&w, json, sizeof(json));
+    json_obj_begin(&w, NULL);
+    latency_hist_write_json(&w, &snap);
+    json_obj_end(&w);
+    json_writer_finish(&w);
+    printf("nut polls   %lu\n", (unsigned long)nut_polls);
+    printf("visibility  %s\n", json);
+
+    for (size_t i = 0; i < REPORT_TRACE_STAGE_COUNT; i++) {
+        report_trace_get((report_trace_stage_t)i, &snap);
+        if (snap.count == 0) {
+            continue;
+        }
+        printf("trace %-7s count %lu p50 %lu us p99 %lu us max %lu us\n", report_trace_stage_name((report_trace_stage_t)i),
+               (unsigned long)snap.count, (unsigned long)latency_hist_percentile_us(&snap, 50),
+               (unsigned long)latency_hist_percentile_us(&snap, 99), (unsigned long)snap.max_us);
+    }
+    printf("result      %s (%d failures)\n", failures ? "FAIL" : "PASS", failures);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    int opt;
+    while ((opt = getopt(argc, argv, "rvt:")) != -1) {
+        switch (opt) {
+            case 'r': realtime = true; break;
+            case 'v': verbose = true; break;
+            case 't': trace_path = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-r] [-v] [-t trace.json] script\n", argv[0]);
+                return 2;
+        }
+    }
+    if (optind != argc - 1) {
+        fprintf(stderr, "usage: %s [-r] [-v] [-t trace.json] script\n", argv[0]);
+        return 2;
+    }
+    if (!load_script(argv[optind])) {
+        return 2;
+    }
+
+    if (!realtime) {
+        host_clock_set_virtual(true);
+    }
+    soe_init();
+    energy_meter_init();
+    battery_health_init();
+    ups_monitor_set_listener(on_ups_event);
+
+    int port;
+    int listen_sock = host_nut_server_open(0, &port);
+    if (listen_sock < 0) {
+        return 1;
+    }
+    pthread_t server, reader;
+    pthread_create(&server, NULL, nut_server_task, &listen_sock);
+    pthread_create(&reader, NULL, nut_reader_task, &port);
+
+    real_start_ns = real_ns();
+    virtual_start_us = esp_timer_get_time();
+    clock_offset_ns = real_start_ns - virtual_start_us * 1000;
+    model.time_us = virtual_start_us;
+    if (trace_path && !trace_open(trace_path)) {
+        return 1;
+    }
+    model.next_check_us = virtual_start_us + UPS_MONITOR_CHECK_PERIOD_MS * 1000LL;
+    for (size_t i = 0; i < step_count; i++) {
+        run_step(&steps[i]);
+    }
+
+    reader_stop = true;
+    pthread_join(reader, NULL);
+    shutdown(listen_sock, SHUT_RDWR);
+    close(listen_sock);
+    pthread_join(server, NULL);
+
+    if (trace_path) {
+        trace_close();
+    }
+    print_summary();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,156 @@
+#include "api_json.h"
+#include "ups_status.h"
+#include "energy_meter.h"
+#include "power_quality.h"
+#include "battery_health.h"
+#include "soe_recorder.h"
+
+void api_json_ups_status(json_writer_t *w, uint32_t now_ms)
+{
+    ups_connection_state_t state = get_ups_state();
+
+    json_obj_begin(w, NULL);
+    json_str(w, "state", ups_state_name(state));
+    json_str(w, "color", ups_state_color(state));
+    json_uint(w, "ms_since_last", now_ms - get_ups_last_data_time());
+    if (state == UPS_CONNECTED_STALE) {
+        json_uint(w, "stale_duration_ms", get_ups_stale_duration_ms());
+    }
+    if (get_ups_values_restored()) {
+        json_bool(w, "restored", true);
+    }
+    json_obj_end(w);
+}
+
+void api_json_energy(json_writer_t *w)
+{
+    energy_meter_stats_t stats;
+    energy_meter_get_stats(&stats);
+    uint64_t energy_wh = stats.energy_mj / 3600000ULL;
+
+    json_obj_begin(w, NULL);
+    json_uint(w, "energy_wh", energy_wh);
+    json_fixed(w, "energy_kwh", (int64_t)energy_wh, 3);
+    json_uint(w, "realpower_w", stats.realpower_w);
+    json_uint(w, "nominal_power_w", energy_meter_nominal_power_w());
+    json_bool(w, "on_battery", stats.on_battery);
+    json_uint(w, "on_battery_s", stats.on_battery_ms / 1000ULL);
+    json_uint(w, "transfers", stats.transfers);
+    json_uint(w, "persist_writes", stats.persist_writes);
+    json_uint(w, "ms_since_persist", stats.ms_since_persist);
+    json_obj_end(w);
+}
+
+static void write_pq_event(json_writer_t *w, const char *key, const pq_event_t *event)
+{
+    json_obj_begin(w, key);
+    json_str(w, "type", power_quality_event_name(event->type));
+    json_uint(w, "start_ms", event->start_ms);
+    json_uint(w, "duration_ms", event->duration_ms);
+    json_uint(w, "extreme_voltage", event->extreme_voltage);
+    json_obj_end(w);
+}
+
+void api_json_power_quality(json_writer_t *w)
+{
+    pq_stats_t stats;
+    power_quality_get_stats(&stats);
+
+    json_obj_begin(w, NULL);
+    json_str(w, "band", power_quality_band_name(stats.band));
+    json_uint(w, "samples", stats.samples);
+    json_uint(w, "journal_dropped", stats.journal_dropped);
+    json_obj_begin(w, "counts");
+    json_uint(w, "sag", stats.event_counts[PQ_EVENT_SAG]);
+    json_uint(w, "swell", stats.event_counts[PQ_EVENT_SWELL]);
+    json_uint(w, "brownout", stats.event_counts[PQ_EVENT_BROWNOUT]);
+    json_uint(w, "transfer", stats.event_counts[PQ_EVENT_TRANSFER]);
+    json_obj_end(w);
+    if (stats.event_active) {
+        write_pq_event(w, "active", &stats.active);
+    } else {
+        json_null(w, "active");
+    }
+
+    // Journal in small batches on the stack
+    json_arr_begin(w, "events");
+    pq_event_t batch[8];
+    size_t first = 0;
+    size_t n;
+    while ((n = power_quality_get_events(batch, first, sizeof(batch) / sizeof(batch[0]))) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            write_pq_event(w, NULL, &batch[i]);
+        }
+        first += n;
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
+
+void api_json_battery_health(json_writer_t *w)
+{
+    bh_stats_t stats;
+    battery_health_get_stats(&stats);
+
+    json_obj_begin(w, NULL);
+    json_uint(w, "battery_mv", stats.battery_mv);
+    json_uint(w, "current_ma", stats.current_ma);
+    json_bool(w, "on_battery", stats.on_battery);
+    json_uint(w, "resistance_mohm", stats.resistance_mohm);
+    json_uint(w, "resistance_baseline_mohm", stats.resistance_baseline_mohm);
+    json_uint(w, "last_step_mohm", stats.last_step_mohm);
+    json_uint(w, "resistance_samples", stats.resistance_samples);
+    json_uint(w, "capacity_pct", stats.capacity_pct);
+    json_uint(w, "capacity_samples", stats.capacity_samples);
+    json_uint(w, "last_recovery_mv", stats.last_recovery_mv);
+    json_bool(w, "replace_recommended", stats.replace_recommended);
+
+    // Trend in small batches on the stack
+    json_arr_begin(w, "trend");
+    bh_trend_point_t batch[8];
+    size_t first = 0;
+    size_t n;
+    while ((n = battery_health_get_trend(batch, first, sizeof(batch) / sizeof(batch[0]))) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            json_obj_begin(w, NULL);
+            json_uint(w, "seq", batch[i].seq);
+            json_uint(w, "boot", batch[i].boot);
+            json_uint(w, "on_battery_s", batch[i].on_battery_s);
+            json_uint(w, "resistance_mohm", batch[i].resistance_mohm);
+            json_uint(w, "capacity_pct", batch[i].capacity_pct);
+            json_int(w, "temperature", batch[i].temperature);
+            json_obj_end(w);
+        }
+        first += n;
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
+
+void api_json_events(json_writer_t *w, uint32_t since, int64_t now_us)
+{
+    json_obj_begin(w, NULL);
+    json_uint(w, "boot", soe_boot_number());
+    json_int(w, "now_us", now_us);
+    json_uint(w, "capacity", soe_capacity());
+    json_arr_begin(w, "events");
+
+    // Read in small batches; each batch continues after the last sequence number seen
+    soe_record_t batch[16];
+    size_t n;
+    while ((n = soe_read(since, batch, sizeof(batch) / sizeof(batch[0]))) > 0) {
+        for (size_t i = 0; i < n; i++) {
+            const soe_record_t *r = &batch[i];
+            json_obj_begin(w, NULL);
+            json_uint(w, "seq", r->seq);
+            json_uint(w, "boot", r->boot);
+            json_int(w, "t_us", r->timestamp_us);
+            json_str(w, "type", soe_type_name(r->type));
+            json_uint(w, "arg", r->arg);
+            json_obj_end(w);
+        }
+        since = batch[n - 1].seq;
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
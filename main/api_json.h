@@ -0,0 +1,30 @@
+/*
+ * API JSON Rendering
+ *
+ * Bodies of the UPS-domain /api endpoints, written through a json_writer_t so
+ * the same code serves httpd (chunked stream) and the host build (buffer).
+ * Each function writes one complete top-level object.
+ */
+
+#ifndef API_JSON_H
+#define API_JSON_H
+
+#include <stdint.h>
+#include "json_writer.h"
+
+// /api/ups_status
+void api_json_ups_status(json_writer_t *w, uint32_t now_ms);
+
+// /api/energy
+void api_json_energy(json_writer_t *w);
+
+// /api/power_quality (journal oldest first)
+void api_json_power_quality(json_writer_t *w);
+
+// /api/battery_health (trend oldest first)
+void api_json_battery_health(json_writer_t *w);
+
+// /api/events: SOE records with seq > since
+void api_json_events(json_writer_t *w, uint32_t since, int64_t now_us);
+
+#endif // API_JSON_H
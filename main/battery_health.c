@@ -0,0 +1,285 @@
+#include "battery_health.h"
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "nvs.h"
+#include "energy_meter.h"
+#include "soe_recorder.h"
+
+static const char *TAG = "battery-health";
+
+#define BH_NVS_NAMESPACE "battery"
+#define BH_NVS_KEY "health"
+#define BH_BLOB_VERSION 1
+
+#define BH_TREND_SIZE        CONFIG_UPS_BATTERY_TREND_SIZE
+#define BH_MV_PER_COUNT      CONFIG_UPS_BATTERY_MV_PER_COUNT
+#define BH_RATED_MAH         (CONFIG_UPS_BATTERY_RATED_CAPACITY_AH_X10 * 100U)
+#define BH_EFFICIENCY_PCT    CONFIG_UPS_INVERTER_EFFICIENCY_PERCENT
+#define BH_MIN_STEP_MA       CONFIG_UPS_BATTERY_MIN_STEP_MA
+#define BH_MIN_DISCHARGE_PCT CONFIG_UPS_BATTERY_MIN_DISCHARGE_PERCENT
+// Two voltage readings further apart than this are not one load step
+#define BH_STEP_WINDOW_MS    10000
+// Sanity limits for a single resistance sample
+#define BH_MAX_RESISTANCE_MOHM 2000
+// EWMA weight 1/BH_SMOOTHING
+#define BH_SMOOTHING         4
+
+// Persisted layout: smoothed estimates plus the trend ring
+typedef struct {
+    uint32_t version;
+    uint32_t next_seq;
+    uint16_t head;              // Next write position
+    uint16_t count;
+    uint16_t resistance_mohm;
+    uint16_t baseline_mohm;
+    uint16_t capacity_pct;
+    uint16_t reserved;
+    uint32_t resistance_samples;
+    uint32_t capacity_samples;
+    bh_trend_point_t points[BH_TREND_SIZE];
+} bh_blob_t;
+
+static portMUX_TYPE bh_lock = portMUX_INITIALIZER_UNLOCKED;
+static bh_blob_t store;         // Live copy, written to NVS by battery_health_service()
+static bh_blob_t scratch;       // Snapshot being written (service task only)
+static bool trend_pending = false;
+
+// Previous voltage reading (step detection)
+static bool have_prev = false;
+static uint32_t prev_mv = 0;
+static uint32_t prev_ma = 0;
+static uint32_t prev_ms = 0;
+
+// Current discharge session
+static bool on_battery = false;
+static int session_start_charge = 0;
+static uint64_t session_removed_mams = 0;   // mA x ms
+static uint32_t session_end_mv = 0;
+static bool recovery_pending = false;
+static uint32_t last_recovery_mv = 0;
+static uint32_t last_step_mohm = 0;
+static uint32_t battery_mv = 0;
+static uint32_t current_ma = 0;
+static int8_t last_temperature = 0;
+
+static uint16_t smooth(uint16_t average, uint32_t sample, uint32_t samples)
+{
+    if (samples == 0) {
+        return (uint16_t)sample;
+    }
+    int32_t next = average + ((int32_t)sample - (int32_t)average) / BH_SMOOTHING;
+    return (uint16_t)(next < 0 ? 0 : next);
+}
+
+// Battery current from output power: load x nominal / efficiency / V
+static uint32_t battery_current_ma(int load_pct, uint32_t mv)
+{
+    if (mv == 0 || load_pct <= 0) {
+        return 0;
+    }
+    uint64_t battery_mw = (uint64_t)load_pct * energy_meter_nominal_power_w() * 1000U / BH_EFFICIENCY_PCT;
+    return (uint32_t)(battery_mw * 1000U / mv);
+}
+
+// Called with bh_lock held
+static void add_resistance_sample(uint32_t mohm)
+{
+    last_step_mohm = mohm;
+    store.resistance_mohm = smooth(store.resistance_mohm, mohm, store.resistance_samples);
+    if (store.baseline_mohm == 0) {
+        store.baseline_mohm = (uint16_t)mohm;
+    }
+    store.resistance_samples++;
+}
+
+// Called with bh_lock held
+static bool finish_session(int charge_pct)
+{
+    int drop = session_start_charge - charge_pct;
+    if (drop < BH_MIN_DISCHARGE_PCT) {
+        return false;
+    }
+    uint64_t removed_mah = session_removed_mams / 3600000ULL;
+    uint32_t capacity_mah = (uint32_t)(removed_mah * 100U / (uint32_t)drop);
+    uint32_t pct = capacity_mah * 100U / BH_RATED_MAH;
+    if (pct < 1) pct = 1;
+    if (pct > 150) pct = 150;
+    store.capacity_pct = smooth(store.capacity_pct, pct, store.capacity_samples);
+    store.capacity_samples++;
+    return true;
+}
+
+void battery_health_init(void)
+{
+    size_t len = sizeof(store);
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(BH_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(nvs_handle, BH_NVS_KEY, &store, &len);
+        nvs_close(nvs_handle);
+    }
+    if (err == ESP_OK && len == sizeof(store) && store.version == BH_BLOB_VERSION &&
+        store.count <= BH_TREND_SIZE && store.head < BH_TREND_SIZE) {
+        ESP_LOGI(TAG, "Restored: R=%u mOhm (baseline %u), capacity %u%%, %u trend points",
+                 store.resistance_mohm, store.baseline_mohm, store.capacity_pct, store.count);
+    } else {
+        memset(&store, 0, sizeof(store));
+        store.version = BH_BLOB_VERSION;
+        ESP_LOGI(TAG, "No stored battery history, starting fresh");
+    }
+}
+
+void battery_health_update(int battery_raw, int charge_pct, int load_pct, int temperature,
+                           bool now_on_battery, uint32_t now_ms)
+{
+    uint32_t mv = battery_raw > 0 ? (uint32_t)battery_raw * BH_MV_PER_COUNT : 0;
+    // On line power the battery only sees the (small) charge current
+    uint32_t ma = now_on_battery ? battery_current_ma(load_pct, mv) : 0;
+    bool step_logged = false;
+    uint32_t step_mohm = 0;
+    bool session_logged = false;
+
+    taskENTER_CRITICAL(&bh_lock);
+    battery_mv = mv;
+    current_ma = ma;
+    last_temperature = (int8_t)(temperature > 127 ? 127 : (temperature < -128 ? -128 : temperature));
+
+    uint32_t dt = now_ms - prev_ms;
+    bool contiguous = have_prev && mv > 0 && prev_mv > 0 && dt <= BH_STEP_WINDOW_MS;
+
+    // Load step (the transfer itself is a step from ~0 A): R = -dV / dI
+    if (contiguous) {
+        int32_t di = (int32_t)ma - (int32_t)prev_ma;
+        int32_t dv = (int32_t)mv - (int32_t)prev_mv;
+        if ((di >= BH_MIN_STEP_MA || di <= -BH_MIN_STEP_MA) && (int64_t)dv * di < 0) {
+            int32_t mohm = (int32_t)(-(int64_t)dv * 1000 / di);
+            if (mohm > 0 && mohm <= BH_MAX_RESISTANCE_MOHM) {
+                add_resistance_sample((uint32_t)mohm);
+                step_logged = true;
+                step_mohm = (uint32_t)mohm;
+            }
+        }
+    }
+
+    if (now_on_battery && !on_battery) {
+        session_start_charge = charge_pct;
+        session_removed_mams = 0;
+        recovery_pending = false;
+    } else if (now_on_battery && contiguous) {
+        // Hold the previous current over the interval
+        session_removed_mams += (uint64_t)prev_ma * dt;
+    }
+
+    if (!now_on_battery && on_battery) {
+        bool capacity = finish_session(charge_pct);
+        session_end_mv = prev_mv;
+        recovery_pending = true;
+        trend_pending = true;
+        session_logged = capacity;
+    } else if (!now_on_battery && recovery_pending && mv > 0) {
+        // First reading back on line power: rebound from the loaded voltage
+        last_recovery_mv = mv > session_end_mv ? mv - session_end_mv : 0;
+        recovery_pending = false;
+    }
+
+    on_battery = now_on_battery;
+    prev_mv = mv;
+    prev_ma = ma;
+    prev_ms = now_ms;
+    have_prev = true;
+    uint16_t capacity_pct = store.capacity_pct;
+    taskEXIT_CRITICAL(&bh_lock);
+
+    if (step_logged) {
+        ESP_LOGI(TAG, "Load step: R=%lu mOhm", (unsigned long)step_mohm);
+    }
+    if (session_logged) {
+        ESP_LOGI(TAG, "Discharge session: capacity %u%% of rated", capacity_pct);
+    }
+}
+
+void battery_health_service(void)
+{
+    taskENTER_CRITICAL(&bh_lock);
+    bool pending = trend_pending;
+    taskEXIT_CRITICAL(&bh_lock);
+    if (!pending) {
+        return;
+    }
+
+    energy_meter_stats_t energy;
+    energy_meter_get_stats(&energy);
+
+    taskENTER_CRITICAL(&bh_lock);
+    trend_pending = false;
+    bh_trend_point_t *p = &store.points[store.head];
+    p->seq = ++store.next_seq;
+    p->on_battery_s = (uint32_t)(energy.on_battery_ms / 1000ULL);
+    p->boot = soe_boot_number();
+    p->resistance_mohm = store.resistance_mohm;
+    p->capacity_pct = (uint8_t)store.capacity_pct;
+    p->temperature = last_temperature;
+    p->reserved = 0;
+    store.head = (store.head + 1) % BH_TREND_SIZE;
+    if (store.count < BH_TREND_SIZE) {
+        store.count++;
+    }
+    scratch = store;
+    taskEXIT_CRITICAL(&bh_lock);
+
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(BH_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_set_blob(nvs_handle, BH_NVS_KEY, &scratch, sizeof(scratch));
+        if (err == ESP_OK) err = nvs_commit(nvs_handle);
+        nvs_close(nvs_handle);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to persist trend: %s", esp_err_to_name(err));
+    }
+}
+
+void battery_health_get_stats(bh_stats_t *out)
+{
+    taskENTER_CRITICAL(&bh_lock);
+    out->battery_mv = battery_mv;
+    out->current_ma = current_ma;
+    out->on_battery = on_battery;
+    out->resistance_mohm = store.resistance_mohm;
+    out->resistance_baseline_mohm = store.baseline_mohm;
+    out->last_step_mohm = last_step_mohm;
+    out->resistance_samples = store.resistance_samples;
+    out->capacity_pct = store.capacity_pct;
+    out->capacity_samples = store.capacity_samples;
+    out->last_recovery_mv = last_recovery_mv;
+    out->trend_points = store.count;
+    taskEXIT_CRITICAL(&bh_lock);
+
+    out->replace_recommended =
+        (out->capacity_pct != 0 && out->capacity_pct < CONFIG_UPS_BATTERY_REPLACE_CAPACITY_PERCENT) ||
+        (out->resistance_baseline_mohm != 0 &&
+         out->resistance_mohm * 100U >= out->resistance_baseline_mohm * CONFIG_UPS_BATTERY_REPLACE_RESISTANCE_PERCENT);
+}
+
+size_t battery_health_get_trend(bh_trend_point_t *out, size_t first, size_t max_points)
+{
+    taskENTER_CRITICAL(&bh_lock);
+    size_t n = first < store.count ? store.count - first : 0;
+    if (n > max_points) {
+        n = max_points;
+    }
+    size_t oldest = (store.head + BH_TREND_SIZE - store.count) % BH_TREND_SIZE;
+    size_t start = (oldest + first) % BH_TREND_SIZE;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = store.points[(start + i) % BH_TREND_SIZE];
+    }
+    taskEXIT_CRITICAL(&bh_lock);
+    return n;
+}
+
+size_t battery_health_trend_capacity(void)
+{
+    return BH_TREND_SIZE;
+}
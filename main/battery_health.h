@@ -0,0 +1,64 @@
+/*
+ * Battery Health Estimation
+ *
+ * Watches the battery voltage response while the UPS runs on battery. A load
+ * step (including the transfer itself) gives one internal resistance sample
+ * (dV / dI); a discharge session gives one capacity sample (charge removed vs
+ * battery.charge drop). Both are smoothed incrementally, and one trend point is
+ * appended to a small NVS-backed history after every session with new data.
+ */
+
+#ifndef BATTERY_HEALTH_H
+#define BATTERY_HEALTH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// One point of the long-term trend, appended after a discharge session
+typedef struct {
+    uint32_t seq;               // Trend point number, monotonic across reboots
+    uint32_t on_battery_s;      // Cumulative on-battery time when recorded (battery age axis)
+    uint16_t boot;              // SOE boot number when recorded
+    uint16_t resistance_mohm;   // Smoothed internal resistance, 0 = unknown
+    uint8_t capacity_pct;       // Smoothed capacity vs rated, 0 = unknown
+    int8_t temperature;         // UPS temperature reading
+    uint16_t reserved;
+} bh_trend_point_t;
+
+typedef struct {
+    uint32_t battery_mv;            // Latest battery voltage, 0 = not reported
+    uint32_t current_ma;            // Estimated battery discharge current
+    bool on_battery;
+    uint32_t resistance_mohm;       // Smoothed internal resistance, 0 = no estimate yet
+    uint32_t resistance_baseline_mohm;  // First estimate (new battery reference)
+    uint32_t last_step_mohm;        // Most recent single measurement
+    uint32_t resistance_samples;
+    uint32_t capacity_pct;          // Smoothed capacity vs rated, 0 = no estimate yet
+    uint32_t capacity_samples;
+    uint32_t last_recovery_mv;      // Voltage rebound after the last discharge ended
+    bool replace_recommended;
+    uint32_t trend_points;
+} bh_stats_t;
+
+// Restore estimates and trend from NVS. Call after nvs_flash_init().
+void battery_health_init(void);
+
+// Fold one UPS update into the model. battery_raw is the 16-bit battery voltage
+// reading from report 0x20 (bytes 2-3), charge and load in percent.
+void battery_health_update(int battery_raw, int charge_pct, int load_pct, int temperature,
+                           bool on_battery, uint32_t now_ms);
+
+// Persist a pending trend point. Call periodically outside the USB callback.
+void battery_health_service(void);
+
+void battery_health_get_stats(bh_stats_t *out);
+
+// Copy trend points, oldest first, starting at index `first`. Returns the
+// number copied; read in batches until it returns 0.
+size_t battery_health_get_trend(bh_trend_point_t *out, size_t first, size_t max_points);
+
+// Trend capacity (points)
+size_t battery_health_trend_capacity(void);
+
+#endif // BATTERY_HEALTH_H
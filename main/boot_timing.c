@@ -0,0 +1,67 @@
+#include "boot_timing.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+static const char *TAG = "boot";
+
+static const char *const phase_names[BOOT_PHASE_COUNT] = {
+    [BOOT_PHASE_CORE_INIT]      = "core_init",
+    [BOOT_PHASE_USB_HOST]       = "usb_host",
+    [BOOT_PHASE_UPS_ENUMERATED] = "ups_enumerated",
+    [BOOT_PHASE_UPS_DATA]       = "ups_data",
+    [BOOT_PHASE_WIFI_STARTED]   = "wifi_started",
+    [BOOT_PHASE_WIFI_UP]        = "wifi_up",
+    [BOOT_PHASE_NET_SERVICES]   = "net_services",
+};
+
+// 0 = not reached yet
+static uint32_t phase_ms[BOOT_PHASE_COUNT];
+
+void boot_timing_mark(boot_phase_t phase)
+{
+    if (__atomic_load_n(&phase_ms[phase], __ATOMIC_RELAXED) != 0) {
+        return;
+    }
+    uint32_t now_ms = (uint32_t)(esp_timer_get_time() / 1000);
+    if (now_ms == 0) {
+        now_ms = 1;
+    }
+    uint32_t expected = 0;
+    if (!__atomic_compare_exchange_n(&phase_ms[phase], &expected, now_ms, false,
+                                     __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+        return;     // Another task got there first
+    }
+    if (phase == BOOT_PHASE_UPS_DATA && now_ms > BOOT_UPS_DATA_TARGET_MS) {
+        ESP_LOGW(TAG, "%s at %lu ms (target %d ms)", phase_names[phase], (unsigned long)now_ms,
+                 BOOT_UPS_DATA_TARGET_MS);
+    } else {
+        ESP_LOGI(TAG, "%s at %lu ms", phase_names[phase], (unsigned long)now_ms);
+    }
+}
+
+uint32_t boot_timing_get_ms(boot_phase_t phase)
+{
+    return __atomic_load_n(&phase_ms[phase], __ATOMIC_RELAXED);
+}
+
+void boot_timing_write_json(json_writer_t *w)
+{
+    json_obj_begin(w, NULL);
+    json_uint(w, "reset_reason", esp_reset_reason());
+    json_uint(w, "target_ms", BOOT_UPS_DATA_TARGET_MS);
+    json_arr_begin(w, "phases");
+    for (int i = 0; i < BOOT_PHASE_COUNT; i++) {
+        uint32_t ms = boot_timing_get_ms(i);
+        json_obj_begin(w, NULL);
+        json_str(w, "name", phase_names[i]);
+        if (ms) {
+            json_uint(w, "ms", ms);
+        } else {
+            json_null(w, "ms");
+        }
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
@@ -0,0 +1,48 @@
+/*
+ * Boot Phase Timing
+ *
+ * Boot runs as two independent paths: USB host and HID monitoring start
+ * straight after the core services, while Wi-Fi connects in the background
+ * and the NUT server and webserver start once it has an address. Each path
+ * marks its phases here, in ms since the application started (ROM and
+ * second-stage bootloader time are not included):
+ *   core_init       NVS, journals, scheduler and LED ready
+ *   usb_host        USB host library and HID driver installed
+ *   ups_enumerated  first HID device opened
+ *   ups_data        first decoded UPS report; BOOT_UPS_DATA_TARGET_MS is the goal
+ *   wifi_started    Wi-Fi driver started, connecting
+ *   wifi_up         first IP address
+ *   net_services    NUT and HTTP servers listening
+ *
+ * Only the first occurrence of a phase is kept. /api/boot serves the table.
+ */
+
+#ifndef BOOT_TIMING_H
+#define BOOT_TIMING_H
+
+#include <stdint.h>
+#include "json_writer.h"
+
+#define BOOT_UPS_DATA_TARGET_MS 1000
+
+typedef enum {
+    BOOT_PHASE_CORE_INIT = 0,
+    BOOT_PHASE_USB_HOST,
+    BOOT_PHASE_UPS_ENUMERATED,
+    BOOT_PHASE_UPS_DATA,
+    BOOT_PHASE_WIFI_STARTED,
+    BOOT_PHASE_WIFI_UP,
+    BOOT_PHASE_NET_SERVICES,
+    BOOT_PHASE_COUNT
+} boot_phase_t;
+
+// Record the phase if it is the first time. Lock-free, safe from any task.
+void boot_timing_mark(boot_phase_t phase);
+
+// ms since start, 0 if the phase has not been reached
+uint32_t boot_timing_get_ms(boot_phase_t phase);
+
+// {"reset_reason":n,"target_ms":n,"phases":[{"name":...,"ms":n|null},...]}
+void boot_timing_write_json(json_writer_t *w);
+
+#endif // BOOT_TIMING_H
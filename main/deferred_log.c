@@ -0,0 +1,386 @@
+#include "deferred_log.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "task_plan.h"
+
+#if CONFIG_UPS_DLOG_ENABLE
+
+static const char *TAG = "dlog";
+
+#define DLOG_RING_SIZE      CONFIG_UPS_DLOG_RING_SIZE
+#define DLOG_RATE_PER_TAG   CONFIG_UPS_DLOG_RATE_PER_TAG
+#define DLOG_HISTORY_LINES  CONFIG_UPS_DLOG_HISTORY_LINES
+#define DLOG_LINE_MAX       160
+#define DLOG_MAX_TAGS       16
+#define DLOG_DRAIN_PERIOD_MS 20
+#define DLOG_TASK_STACK     CONFIG_UPS_STACK_DLOG_DRAIN
+#define DLOG_TASK_PRIORITY  TASK_PRIO_DLOG
+
+_Static_assert((DLOG_RING_SIZE & (DLOG_RING_SIZE - 1)) == 0, "CONFIG_UPS_DLOG_RING_SIZE must be a power of two");
+
+typedef enum {
+    DLOG_KIND_FORMAT = 0,
+    DLOG_KIND_TEXT,
+    DLOG_KIND_HEX
+} dlog_kind_t;
+
+// One ring slot. `seq` hands the slot between producers and the drain task:
+// seq == position -> free for the producer claiming that position,
+// seq == position + 1 -> written, ready to drain.
+typedef struct {
+    uint32_t seq;
+    uint32_t timestamp_ms;
+    const char *tag;
+    const char *fmt;
+    uint8_t level;
+    uint8_t kind;
+    uint8_t len;                // Argument words or payload bytes
+    union {
+        uintptr_t args[DLOG_MAX_ARGS];
+        uint8_t data[DLOG_DATA_MAX];
+    };
+} dlog_record_t;
+
+typedef struct {
+    const char *tag;            // NULL = free entry, claimed once and kept
+    uint32_t window_s;
+    uint32_t count;
+    uint32_t suppressed;        // Since the drain task last reported it
+} dlog_tag_t;
+
+typedef struct {
+    uint32_t seq;
+    char text[DLOG_LINE_MAX];
+} dlog_line_t;
+
+static dlog_record_t ring[DLOG_RING_SIZE];
+static uint32_t ring_head = 0;          // Next position to claim (producers)
+static uint32_t ring_tail = 0;          // Next position to drain (drain task only)
+static dlog_tag_t tags[DLOG_MAX_TAGS];
+static dlog_stats_t stats = { .ring_size = DLOG_RING_SIZE };
+static bool ring_ready = false;
+
+// Formatted history for /api/logs (drain task writes, HTTP reads)
+static portMUX_TYPE history_lock = portMUX_INITIALIZER_UNLOCKED;
+static dlog_line_t history[DLOG_HISTORY_LINES];
+static uint32_t history_seq = 0;
+
+static TaskHandle_t drain_task_handle = NULL;
+
+static void ring_init(void)
+{
+    for (uint32_t i = 0; i < DLOG_RING_SIZE; i++) {
+        ring[i].seq = i;
+    }
+    __atomic_store_n(&ring_ready, true, __ATOMIC_RELEASE);
+}
+
+// Per-tag rate limit over one-second windows. Lock-free and approximate: a
+// window rollover racing with another writer may let a few extra records in.
+static bool rate_allow(const char *tag, uint32_t now_ms)
+{
+#if DLOG_RATE_PER_TAG > 0
+    dlog_tag_t *entry = NULL;
+    for (size_t i = 0; i < DLOG_MAX_TAGS; i++) {
+        const char *t = __atomic_load_n(&tags[i].tag, __ATOMIC_ACQUIRE);
+        if (t == NULL) {
+            const char *expected = NULL;
+            if (__atomic_compare_exchange_n(&tags[i].tag, &expected, tag, false,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) || expected == tag) {
+                entry = &tags[i];
+                break;
+            }
+            continue;
+        }
+        if (t == tag) {
+            entry = &tags[i];
+            break;
+        }
+    }
+    if (!entry) {
+        return true;            // Table full: unlimited rather than silent
+    }
+    uint32_t window = now_ms / 1000;
+    if (__atomic_load_n(&entry->window_s, __ATOMIC_RELAXED) != window) {
+        __atomic_store_n(&entry->window_s, window, __ATOMIC_RELAXED);
+        __atomic_store_n(&entry->count, 0, __ATOMIC_RELAXED);
+    }
+    if (__atomic_fetch_add(&entry->count, 1, __ATOMIC_RELAXED) >= DLOG_RATE_PER_TAG) {
+        __atomic_add_fetch(&entry->suppressed, 1, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&stats.rate_limited, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+#endif
+    return true;
+}
+
+// Claim a slot, or NULL if the ring is full. Publish it with record_commit().
+static dlog_record_t *record_claim(esp_log_level_t level, const char *tag)
+{
+    if (!__atomic_load_n(&ring_ready, __ATOMIC_ACQUIRE)) {
+        return NULL;
+    }
+    uint32_t now_ms = esp_log_timestamp();
+    if (!rate_allow(tag, now_ms)) {
+        return NULL;
+    }
+
+    uint32_t pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+    dlog_record_t *r;
+    for (;;) {
+        r = &ring[pos & (DLOG_RING_SIZE - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            if (__atomic_compare_exchange_n(&ring_head, &pos, pos + 1, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+        } else if (diff < 0) {
+            __atomic_add_fetch(&stats.dropped, 1, __ATOMIC_RELAXED);
+            return NULL;
+        } else {
+            pos = __atomic_load_n(&ring_head, __ATOMIC_RELAXED);
+        }
+    }
+
+    uint32_t fill = pos + 1 - __atomic_load_n(&ring_tail, __ATOMIC_RELAXED);
+    uint32_t max_fill = __atomic_load_n(&stats.max_fill, __ATOMIC_RELAXED);
+    while (fill > max_fill &&
+           !__atomic_compare_exchange_n(&stats.max_fill, &max_fill, fill, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+
+    r->timestamp_ms = now_ms;
+    r->tag = tag;
+    r->level = (uint8_t)level;
+    return r;
+}
+
+static void record_commit(dlog_record_t *r)
+{
+    __atomic_add_fetch(&stats.written, 1, __ATOMIC_RELAXED);
+    uint32_t pos = r->seq;
+    __atomic_store_n(&r->seq, pos + 1, __ATOMIC_RELEASE);
+}
+
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt, const uintptr_t *args, size_t nargs)
+{
+    dlog_record_t *r = record_claim(level, tag);
+    if (!r) {
+        return;
+    }
+    if (nargs > DLOG_MAX_ARGS) {
+        nargs = DLOG_MAX_ARGS;
+    }
+    r->kind = DLOG_KIND_FORMAT;
+    r->fmt = fmt;
+    r->len = (uint8_t)nargs;
+    memcpy(r->args, args, nargs * sizeof(uintptr_t));
+    record_commit(r);
+}
+
+static void write_data(esp_log_level_t level, const char *tag, dlog_kind_t kind, const char *prefix,
+                       const void *data, size_t len)
+{
+    dlog_record_t *r = record_claim(level, tag);
+    if (!r) {
+        return;
+    }
+    if (len > DLOG_DATA_MAX) {
+        len = DLOG_DATA_MAX;
+    }
+    r->kind = kind;
+    r->fmt = prefix;
+    r->len = (uint8_t)len;
+    memcpy(r->data, data, len);
+    record_commit(r);
+}
+
+void dlog_write_text(esp_log_level_t level, const char *tag, const char *prefix, const void *data, size_t len)
+{
+    write_data(level, tag, DLOG_KIND_TEXT, prefix, data, len);
+}
+
+void dlog_write_hex(esp_log_level_t level, const char *tag, const char *prefix, const void *data, size_t len)
+{
+    write_data(level, tag, DLOG_KIND_HEX, prefix, data, len);
+}
+
+static char level_letter(esp_log_level_t level)
+{
+    switch (level) {
+        case ESP_LOG_ERROR:   return 'E';
+        case ESP_LOG_WARN:    return 'W';
+        case ESP_LOG_INFO:    return 'I';
+        case ESP_LOG_DEBUG:   return 'D';
+        default:              return 'V';
+    }
+}
+
+// Format one record body (no level/timestamp/tag)
+static void format_record(const dlog_record_t *r, char *buf, size_t size)
+{
+    if (r->kind == DLOG_KIND_FORMAT) {
+        // Every argument is one word, so passing all slots works for any
+        // format that consumes r->len of them
+        const uintptr_t *a = r->args;
+        snprintf(buf, size, r->fmt, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+        return;
+    }
+    int n = snprintf(buf, size, "%s", r->fmt ? r->fmt : "");
+    size_t pos = n < 0 ? 0 : ((size_t)n < size ? (size_t)n : size - 1);
+    for (size_t i = 0; i < r->len; i++) {
+        if (r->kind == DLOG_KIND_HEX) {
+            if (pos + 3 >= size) {
+                break;
+            }
+            pos += snprintf(buf + pos, size - pos, "%02X ", r->data[i]);
+        } else {
+            if (pos + 1 >= size) {
+                break;
+            }
+            char c = (char)r->data[i];
+            buf[pos++] = (c == '\r' || c == '\n') ? ' ' : c;
+        }
+    }
+    buf[pos] = '\0';
+}
+
+static void emit(esp_log_level_t level, uint32_t timestamp_ms, const char *tag, const char *body)
+{
+    char line[DLOG_LINE_MAX];
+    snprintf(line, sizeof(line), "%c (%lu) %s: %s", level_letter(level), (unsigned long)timestamp_ms, tag, body);
+    esp_log_write(level, tag, "%s\n", line);
+
+    taskENTER_CRITICAL(&history_lock);
+    history_seq++;
+    dlog_line_t *h = &history[history_seq % DLOG_HISTORY_LINES];
+    h->seq = history_seq;
+    memcpy(h->text, line, sizeof(h->text));
+    stats.lines++;
+    taskEXIT_CRITICAL(&history_lock);
+}
+
+// Report tags that hit the rate limit and records lost to a full ring
+static void report_losses(uint32_t *last_dropped)
+{
+    char body[64];
+    for (size_t i = 0; i < DLOG_MAX_TAGS; i++) {
+        const char *tag = __atomic_load_n(&tags[i].tag, __ATOMIC_ACQUIRE);
+        if (!tag) {
+            break;
+        }
+        uint32_t n = __atomic_exchange_n(&tags[i].suppressed, 0, __ATOMIC_RELAXED);
+        if (n) {
+            snprintf(body, sizeof(body), "%lu messages suppressed (rate limit)", (unsigned long)n);
+            emit(ESP_LOG_WARN, esp_log_timestamp(), tag, body);
+        }
+    }
+    uint32_t dropped = __atomic_load_n(&stats.dropped, __ATOMIC_RELAXED);
+    if (dropped != *last_dropped) {
+        snprintf(body, sizeof(body), "%lu messages dropped (ring full)", (unsigned long)(dropped - *last_dropped));
+        emit(ESP_LOG_WARN, esp_log_timestamp(), TAG, body);
+        *last_dropped = dropped;
+    }
+}
+
+static void dlog_drain_task(void *arg)
+{
+    char body[DLOG_LINE_MAX];
+    uint32_t last_dropped = 0;
+    uint32_t last_report_ms = 0;
+
+    for (;;) {
+        for (;;) {
+            dlog_record_t *r = &ring[ring_tail & (DLOG_RING_SIZE - 1)];
+            if (__atomic_load_n(&r->seq, __ATOMIC_ACQUIRE) != ring_tail + 1) {
+                break;
+            }
+            dlog_record_t copy = *r;
+            __atomic_store_n(&r->seq, ring_tail + DLOG_RING_SIZE, __ATOMIC_RELEASE);
+            __atomic_store_n(&ring_tail, ring_tail + 1, __ATOMIC_RELAXED);
+
+            format_record(&copy, body, sizeof(body));
+            emit((esp_log_level_t)copy.level, copy.timestamp_ms, copy.tag, body);
+        }
+
+        uint32_t now_ms = esp_log_timestamp();
+        if (now_ms - last_report_ms >= 1000) {
+            report_losses(&last_dropped);
+            last_report_ms = now_ms;
+        }
+        vTaskDelay(pdMS_TO_TICKS(DLOG_DRAIN_PERIOD_MS));
+    }
+}
+
+void dlog_init(void)
+{
+    if (!__atomic_load_n(&ring_ready, __ATOMIC_ACQUIRE)) {
+        ring_init();
+    }
+    if (!drain_task_handle &&
+        xTaskCreatePinnedToCore(dlog_drain_task, "dlog_drain", DLOG_TASK_STACK, NULL, DLOG_TASK_PRIORITY,
+                                &drain_task_handle, TASK_CORE_HOUSEKEEPING) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create drain task");
+    }
+}
+
+void dlog_get_stats(dlog_stats_t *out)
+{
+    out->written = __atomic_load_n(&stats.written, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&stats.dropped, __ATOMIC_RELAXED);
+    out->rate_limited = __atomic_load_n(&stats.rate_limited, __ATOMIC_RELAXED);
+    out->max_fill = __atomic_load_n(&stats.max_fill, __ATOMIC_RELAXED);
+    out->ring_size = DLOG_RING_SIZE;
+    taskENTER_CRITICAL(&history_lock);
+    out->lines = stats.lines;
+    taskEXIT_CRITICAL(&history_lock);
+}
+
+uint32_t dlog_history_seq(void)
+{
+    taskENTER_CRITICAL(&history_lock);
+    uint32_t seq = history_seq;
+    taskEXIT_CRITICAL(&history_lock);
+    return seq;
+}
+
+uint32_t dlog_read_history(uint32_t since, uint32_t until, char *buf, size_t size, size_t *len)
+{
+    size_t used = 0;
+    uint32_t last = since;
+
+    uint32_t newest = dlog_history_seq();
+    if (newest > until) {
+        newest = until;
+    }
+
+    uint32_t first = newest > DLOG_HISTORY_LINES ? newest - DLOG_HISTORY_LINES + 1 : 1;
+    if (since + 1 > first) {
+        first = since + 1;
+    }
+    for (uint32_t seq = first; seq <= newest; seq++) {
+        dlog_line_t line;
+        taskENTER_CRITICAL(&history_lock);
+        line = history[seq % DLOG_HISTORY_LINES];
+        taskEXIT_CRITICAL(&history_lock);
+        if (line.seq != seq) {
+            continue;           // Overwritten while we were copying
+        }
+        size_t n = strnlen(line.text, sizeof(line.text));
+        if (used + n + 1 >= size) {
+            break;
+        }
+        memcpy(buf + used, line.text, n);
+        used += n;
+        buf[used++] = '\n';
+        last = seq;
+    }
+    if (size > 0) {
+        buf[used < size ? used : size - 1] = '\0';
+    }
+    *len = used;
+    return last;
+}
+
+#endif // CONFIG_UPS_DLOG_ENABLE
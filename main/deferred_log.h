@@ -0,0 +1,111 @@
+/*
+ * Deferred Logging
+ *
+ * Hot-path logging without formatting on the caller's task. DLOGx() stores the
+ * format string pointer and up to DLOG_MAX_ARGS raw argument words in a
+ * lock-free slot ring; a low-priority drain task formats the records and writes
+ * them to the console (esp_log_write, so per-tag levels still apply) and to a
+ * small line history served at /api/logs.
+ *
+ * Caller cost is one slot claim (compare-and-swap) and a fixed-size copy. When
+ * the ring is full the record is dropped and counted; each tag is also limited
+ * to CONFIG_UPS_DLOG_RATE_PER_TAG records per second. Both are reported by the
+ * drain task once they happen.
+ *
+ * Restrictions, since arguments are captured as machine words and formatted
+ * later:
+ *   - integers, chars and pointers only (no float/double, no 64-bit values)
+ *   - %s arguments must outlive the record (string literals, static tables);
+ *     use DLOG_TEXT() to copy a transient buffer
+ */
+
+#ifndef DEFERRED_LOG_H
+#define DEFERRED_LOG_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_log.h"
+
+#define DLOG_MAX_ARGS 8
+#define DLOG_DATA_MAX (DLOG_MAX_ARGS * sizeof(uintptr_t))  // DLOG_TEXT / DLOG_HEX payload
+
+typedef struct {
+    uint32_t written;           // Records put in the ring
+    uint32_t dropped;           // Ring full
+    uint32_t rate_limited;      // Over the per-tag rate
+    uint32_t max_fill;          // Highest ring occupancy seen
+    uint32_t ring_size;
+    uint32_t lines;             // Lines formatted by the drain task
+} dlog_stats_t;
+
+// Set up the ring and start the drain task. Call first thing in app_main;
+// records written before this are discarded.
+void dlog_init(void);
+
+void dlog_write(esp_log_level_t level, const char *tag, const char *fmt, const uintptr_t *args, size_t nargs);
+void dlog_write_text(esp_log_level_t level, const char *tag, const char *prefix, const void *data, size_t len);
+void dlog_write_hex(esp_log_level_t level, const char *tag, const char *prefix, const void *data, size_t len);
+
+void dlog_get_stats(dlog_stats_t *out);
+
+// Sequence number of the newest history line (0 = none yet)
+uint32_t dlog_history_seq(void);
+
+// Copy history lines in (since, until] into buf, one per line, oldest first.
+// Stops before overflowing buf. Returns the sequence number of the last line
+// copied (or `since` if none).
+uint32_t dlog_read_history(uint32_t since, uint32_t until, char *buf, size_t size, size_t *len);
+
+// Compile-time format checking for the deferred macros; never called
+static inline void dlog_format_check(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+static inline void dlog_format_check(const char *fmt, ...) { (void)fmt; }
+
+#define DLOG_CAT_(a, b) a##b
+#define DLOG_CAT(a, b) DLOG_CAT_(a, b)
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, _5, _6, _7, _8, N, ...) N
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 8, 7, 6, 5, 4, 3, 2, 1, 0)
+// One argument word; 64-bit arguments fail to compile instead of being truncated
+#define DLOG_W(x) ((uintptr_t)(x) + 0 * sizeof(char[sizeof(x) <= sizeof(uintptr_t) ? 1 : -1]))
+#define DLOG_ARGS_0()
+#define DLOG_ARGS_1(a) DLOG_W(a)
+#define DLOG_ARGS_2(a, ...) DLOG_W(a), DLOG_ARGS_1(__VA_ARGS__)
+#define DLOG_ARGS_3(a, ...) DLOG_W(a), DLOG_ARGS_2(__VA_ARGS__)
+#define DLOG_ARGS_4(a, ...) DLOG_W(a), DLOG_ARGS_3(__VA_ARGS__)
+#define DLOG_ARGS_5(a, ...) DLOG_W(a), DLOG_ARGS_4(__VA_ARGS__)
+#define DLOG_ARGS_6(a, ...) DLOG_W(a), DLOG_ARGS_5(__VA_ARGS__)
+#define DLOG_ARGS_7(a, ...) DLOG_W(a), DLOG_ARGS_6(__VA_ARGS__)
+#define DLOG_ARGS_8(a, ...) DLOG_W(a), DLOG_ARGS_7(__VA_ARGS__)
+
+#if CONFIG_UPS_DLOG_ENABLE
+
+#define DLOG(level, tag, fmt, ...) do {                                                     \
+        if (0) dlog_format_check(fmt, ##__VA_ARGS__);                                       \
+        const uintptr_t dlog_args_[] = { 0, DLOG_CAT(DLOG_ARGS_, DLOG_NARGS(__VA_ARGS__))(__VA_ARGS__) }; \
+        dlog_write(level, tag, fmt, dlog_args_ + 1, DLOG_NARGS(__VA_ARGS__));               \
+    } while (0)
+
+// Log prefix followed by a copy of up to DLOG_DATA_MAX bytes of text / hex
+#define DLOG_TEXT(level, tag, prefix, data, len) dlog_write_text(level, tag, prefix, data, len)
+#define DLOG_HEX(level, tag, prefix, data, len)  dlog_write_hex(level, tag, prefix, data, len)
+
+#else
+
+// Deferred logging disabled: log synchronously as before
+#define DLOG(level, tag, fmt, ...) ESP_LOG_LEVEL_LOCAL(level, tag, fmt, ##__VA_ARGS__)
+#define DLOG_TEXT(level, tag, prefix, data, len) \
+    ESP_LOG_LEVEL_LOCAL(level, tag, "%s%.*s", prefix, (int)(len), (const char *)(data))
+#define DLOG_HEX(level, tag, prefix, data, len) do {                                        \
+        ESP_LOG_LEVEL_LOCAL(level, tag, "%s", prefix);                                      \
+        ESP_LOG_BUFFER_HEX_LEVEL(tag, data, len, level);                                    \
+    } while (0)
+
+#endif // CONFIG_UPS_DLOG_ENABLE
+
+#define DLOGE(tag, fmt, ...) DLOG(ESP_LOG_ERROR, tag, fmt, ##__VA_ARGS__)
+#define DLOGW(tag, fmt, ...) DLOG(ESP_LOG_WARN, tag, fmt, ##__VA_ARGS__)
+#define DLOGI(tag, fmt, ...) DLOG(ESP_LOG_INFO, tag, fmt, ##__VA_ARGS__)
+#define DLOGD(tag, fmt, ...) DLOG(ESP_LOG_DEBUG, tag, fmt, ##__VA_ARGS__)
+
+#endif // DEFERRED_LOG_H
@@ -0,0 +1,159 @@
+#include "energy_meter.h"
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "nvs.h"
+
+static const char *TAG = "energy";
+
+#define ENERGY_NVS_NAMESPACE "energy"
+#define ENERGY_NVS_KEY "counters"
+#define ENERGY_BLOB_VERSION 1
+
+#define ENERGY_NOMINAL_W          CONFIG_UPS_NOMINAL_POWER_W
+#define ENERGY_PERSIST_INTERVAL_MS (CONFIG_UPS_ENERGY_PERSIST_INTERVAL_S * 1000U)
+#define ENERGY_PERSIST_DELTA_MJ   ((uint64_t)CONFIG_UPS_ENERGY_PERSIST_DELTA_WH * 3600000ULL)
+// Gaps longer than the data freshness timeout are not integrated
+#define ENERGY_MAX_GAP_MS         10000
+
+// Persisted layout
+typedef struct {
+    uint32_t version;
+    uint32_t transfers;
+    uint64_t energy_mj;
+    uint64_t on_battery_ms;
+} energy_blob_t;
+
+static portMUX_TYPE energy_lock = portMUX_INITIALIZER_UNLOCKED;
+static energy_blob_t counters;      // Live counters
+static energy_blob_t persisted;     // Last values committed to NVS
+static uint32_t last_update_ms = 0;
+static bool have_sample = false;
+static uint32_t last_power_w = 0;
+static bool last_on_battery = false;
+static uint32_t last_persist_ms = 0;
+static uint32_t persist_writes = 0;
+
+static esp_err_t energy_write_nvs(const energy_blob_t *blob)
+{
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(ENERGY_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
+    if (err != ESP_OK) return err;
+    err = nvs_set_blob(nvs_handle, ENERGY_NVS_KEY, blob, sizeof(*blob));
+    if (err == ESP_OK) err = nvs_commit(nvs_handle);
+    nvs_close(nvs_handle);
+    return err;
+}
+
+static void energy_flush(uint32_t now_ms)
+{
+    energy_blob_t snapshot;
+    taskENTER_CRITICAL(&energy_lock);
+    snapshot = counters;
+    taskEXIT_CRITICAL(&energy_lock);
+
+    esp_err_t err = energy_write_nvs(&snapshot);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Failed to persist counters: %s", esp_err_to_name(err));
+        return;
+    }
+    persisted = snapshot;
+    last_persist_ms = now_ms;
+    persist_writes++;
+}
+
+// Runs from esp_restart(): keep whatever was accumulated since the last commit
+static void energy_shutdown_handler(void)
+{
+    if (memcmp(&counters, &persisted, sizeof(counters)) != 0) {
+        energy_write_nvs(&counters);
+    }
+}
+
+esp_err_t energy_meter_init(void)
+{
+    energy_blob_t blob = {0};
+    size_t len = sizeof(blob);
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(ENERGY_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
+    if (err == ESP_OK) {
+        err = nvs_get_blob(nvs_handle, ENERGY_NVS_KEY, &blob, &len);
+        nvs_close(nvs_handle);
+    }
+    if (err == ESP_OK && len == sizeof(blob) && blob.version == ENERGY_BLOB_VERSION) {
+        ESP_LOGI(TAG, "Restored counters: %llu Wh, %llu s on battery, %lu transfers",
+                 (unsigned long long)(blob.energy_mj / 3600000ULL),
+                 (unsigned long long)(blob.on_battery_ms / 1000ULL), (unsigned long)blob.transfers);
+    } else {
+        memset(&blob, 0, sizeof(blob));
+        blob.version = ENERGY_BLOB_VERSION;
+        ESP_LOGI(TAG, "No stored counters, starting from zero");
+    }
+    counters = blob;
+    persisted = blob;
+    return esp_register_shutdown_handler(energy_shutdown_handler);
+}
+
+void energy_meter_update(int load_percent, bool on_battery, uint32_t now_ms)
+{
+    if (load_percent < 0) load_percent = 0;
+    uint32_t power_w = ((uint32_t)load_percent * ENERGY_NOMINAL_W) / 100;
+
+    taskENTER_CRITICAL(&energy_lock);
+    if (have_sample) {
+        uint32_t dt = now_ms - last_update_ms;
+        if (dt <= ENERGY_MAX_GAP_MS) {
+            // Hold the previous reading over the interval (W x ms = mJ)
+            counters.energy_mj += (uint64_t)last_power_w * dt;
+            if (last_on_battery) {
+                counters.on_battery_ms += dt;
+            }
+        }
+    }
+    if (on_battery && (!have_sample || !last_on_battery)) {
+        counters.transfers++;
+    }
+    last_update_ms = now_ms;
+    last_power_w = power_w;
+    last_on_battery = on_battery;
+    have_sample = true;
+    taskEXIT_CRITICAL(&energy_lock);
+}
+
+void energy_meter_service(uint32_t now_ms)
+{
+    taskENTER_CRITICAL(&energy_lock);
+    bool dirty = memcmp(&counters, &persisted, sizeof(counters)) != 0;
+    uint64_t delta_mj = counters.energy_mj - persisted.energy_mj;
+    bool new_transfer = counters.transfers != persisted.transfers;
+    taskEXIT_CRITICAL(&energy_lock);
+
+    if (!dirty) {
+        return;
+    }
+    if (new_transfer || delta_mj >= ENERGY_PERSIST_DELTA_MJ ||
+        now_ms - last_persist_ms >= ENERGY_PERSIST_INTERVAL_MS) {
+        energy_flush(now_ms);
+    }
+}
+
+void energy_meter_get_stats(energy_meter_stats_t *out)
+{
+    taskENTER_CRITICAL(&energy_lock);
+    out->energy_mj = counters.energy_mj;
+    out->on_battery_ms = counters.on_battery_ms;
+    out->transfers = counters.transfers;
+    out->realpower_w = last_power_w;
+    out->on_battery = last_on_battery;
+    out->persist_writes = persist_writes;
+    out->ms_since_persist = xTaskGetTickCount() * portTICK_PERIOD_MS - last_persist_ms;
+    taskEXIT_CRITICAL(&energy_lock);
+}
+
+uint32_t energy_meter_nominal_power_w(void)
+{
+    return ENERGY_NOMINAL_W;
+}
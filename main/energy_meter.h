@@ -0,0 +1,41 @@
+/*
+ * Energy Accounting
+ *
+ * Integrates ups.load x nominal power into energy at every UPS update and keeps
+ * cumulative on-battery time and transfer counters. Counters live in RAM and are
+ * written to NVS only when a time or energy-delta threshold is reached (and on
+ * esp_restart()), so flash is not written per sample.
+ */
+
+#ifndef ENERGY_METER_H
+#define ENERGY_METER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+typedef struct {
+    uint64_t energy_mj;         // Cumulative output energy, millijoules
+    uint64_t on_battery_ms;     // Cumulative time spent on battery
+    uint32_t transfers;         // Number of transfers to battery
+    uint32_t realpower_w;       // Instantaneous output power estimate
+    bool on_battery;
+    uint32_t persist_writes;    // NVS commits since boot
+    uint32_t ms_since_persist;  // Age of the last NVS commit (or of boot)
+} energy_meter_stats_t;
+
+// Load persisted counters from NVS. Call after nvs_flash_init().
+esp_err_t energy_meter_init(void);
+
+// Fold one UPS update into the counters
+void energy_meter_update(int load_percent, bool on_battery, uint32_t now_ms);
+
+// Commit counters to NVS if the coalescing thresholds are reached. Call periodically.
+void energy_meter_service(uint32_t now_ms);
+
+void energy_meter_get_stats(energy_meter_stats_t *out);
+
+// Nominal output power used by the integrator (W)
+uint32_t energy_meter_nominal_power_w(void);
+
+#endif // ENERGY_METER_H
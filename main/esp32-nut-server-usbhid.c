@@ -8,6 +8,7 @@
 #include <stdbool.h>
 #include <string.h>
 #include <unistd.h>
+#include <stddef.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
@@ -24,14 +25,13 @@
 #include "freertos/queue.h"
 
 #include "sys/socket.h"
+#include "sys/select.h"
 #include "netdb.h"
 #include "esp_system.h"
 #include "esp_event.h"
 #include "nvs_flash.h"
 
-#include "led_strip.h"
 
-#include "cJSON.h"
 
 #include "esp_wifi.h"
 #include "esp_event.h"
@@ -40,190 +40,138 @@
 #include "esp_log.h"
 
 #include "ups_models_config.h"
+#include "ups_status.h"
 
 #include <inttypes.h>
 
-#include "esp_timer.h"
+#include "esp_heap_caps.h"
 
 #include "webserver.h"
+#include "power_quality.h"
+#include "soe_recorder.h"
+#include "energy_meter.h"
+#include "battery_health.h"
+#include "status_snapshot.h"
+#include "live_stream.h"
+#include "deferred_log.h"
+#include "supervisor.h"
+#include "ups_monitor.h"
+#include "nut_protocol.h"
+#include "report_trace.h"
+#include "task_stats.h"
+#include "heap_monitor.h"
+#include "scheduler.h"
+#include "persist.h"
+#include "led_status.h"
+#include "task_plan.h"
+#include "sched_bench.h"
+#include "power_mgmt.h"
+#include "boot_timing.h"
+#include "esp_timer.h"
 
-#include "esp_http_client.h"
 #include "esp_http_server.h"
 
-#include "nvs.h"
 
 // Function prototypes for resilience logic
 uint32_t get_ups_stale_duration_ms(void);
 void restart_usb_host(void);
 
-#define NVS_NAMESPACE "ups_recovery"
-#define NVS_KEY "reboot_count"
-
-// === WiFi NVS Management ===
-#define WIFI_NVS_NAMESPACE "wifi_config"
-#define WIFI_SSID_KEY "ssid"
-#define WIFI_PASS_KEY "password"
-
 // === WiFi NVS Management Function Prototypes ===
-static esp_err_t load_wifi_credentials_from_nvs(char* ssid, char* password, size_t max_len);
+static esp_err_t load_wifi_credentials_from_nvs(char* ssid, size_t ssid_len, char* password, size_t pass_len);
 
 // === Button Function Prototypes ===
-static void button_monitor_task(void* pvParameters);
+static void button_init(void);
 
 // === LED Function Prototypes ===
-static void configure_led(void);
-static void set_led_green(void);
-static void set_led_yellow(void);
-static void set_led_red(void);
-static void set_led_white(void);
-static void set_led_purple(void);
-static void set_led_blue(void);
 static void update_led_status(void);
-static void update_led_with_pulse(void);
-static void pulse_timer_callback(void* arg);
 
-// === UPS Data Storage and State Management ===
+// === UPS State (ups_monitor) ===
 #include <stdbool.h>
 #include <stdint.h>
 
-#define UPS_DATA_FRESHNESS_TIMEOUT_MS 10000  // 10 seconds for data freshness
-
-// UPS state enum
-typedef enum {
-    UPS_DISCONNECTED = 0,
-    UPS_CONNECTED_WAITING_DATA,
-    UPS_CONNECTED_ACTIVE,
-    UPS_CONNECTED_STALE
-} ups_connection_state_t;
-
-// UPS data storage struct (17 fields)
-typedef struct {
-    int battery_level;
-    int battery_byte2;
-    int battery_byte3;
-    int status;
-    int status_byte2;
-    int runtime;
-    int input_voltage;
-    int output_voltage;
-    int load;
-    int alarm_control;
-    int beep_control;
-    int system_status;
-    int extended_status;
-    int temperature;
-    int temp_range1;
-    int temp_range2;
-    int additional_sensor;
-} ups_data_store_t;
-
-// Global UPS state
-static ups_connection_state_t ups_state = UPS_DISCONNECTED;
-static ups_data_store_t ups_data = {0};
-static uint32_t ups_last_data_time = 0;  // ms since boot
-static bool ups_available = false;
-
-// --- LED Pulse Tracking Variables (Cosmetic, Safe to Remove) ---
-// These are only used for the RGB LED status indicator. If you want to disable LED logic,
-// you can comment out or remove all code that references these variables and the related functions.
-static uint32_t last_field_update_time = 0;  // ms since boot
-static uint32_t last_pulse_time = 0;         // ms since boot
-static bool pulse_in_progress = false;
-static const uint32_t PULSE_INTERVAL_MS = 30000;  // 30 seconds
-static const uint32_t PULSE_DURATION_MS = 1000;   // 1 second white flash
-// --- End LED Pulse Tracking Variables ---
-
-// --- STALE state tracking ---
-static uint32_t ups_stale_start_time = 0;  // When STALE state began
-
-// --- NVS Counter Helpers ---
-static esp_err_t get_nvs_reboot_counter(uint32_t *value) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) { *value = 0; return ESP_OK; }
-    err = nvs_get_u32(nvs_handle, NVS_KEY, value);
-    nvs_close(nvs_handle);
-    if (err == ESP_ERR_NVS_NOT_FOUND) { *value = 0; return ESP_OK; }
-    return err;
-}
-
-static esp_err_t set_nvs_reboot_counter(uint32_t value) {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) return err;
-    err = nvs_set_u32(nvs_handle, NVS_KEY, value);
-    if (err == ESP_OK) err = nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
-    return err;
+// Push the current UPS values to live dashboards (only changed fields go out)
+static void publish_live_ups(void)
+{
+    ups_values_t values;
+    get_ups_values(&values);
+    energy_meter_stats_t energy;
+    energy_meter_get_stats(&energy);
+    const live_field_t fields[] = {
+        { "state", 0, ups_state_name(get_ups_state()) },
+        { "battery.charge", values.battery_charge, NULL },
+        { "battery.runtime", values.battery_runtime, NULL },
+        { "input.voltage", values.input_voltage, NULL },
+        { "output.voltage", values.output_voltage, NULL },
+        { "ups.load", values.load, NULL },
+        { "ups.realpower", (int)energy.realpower_w, NULL },
+        { "ups.status.flags", values.status_flags, NULL },
+    };
+    live_stream_publish(fields, sizeof(fields) / sizeof(fields[0]));
 }
 
-static esp_err_t increment_nvs_reboot_counter(void) {
-    uint32_t value = 0;
-    get_nvs_reboot_counter(&value);
-    value++;
-    return set_nvs_reboot_counter(value);
+// UPS state changes and reports drive the LED and the live dashboards
+static void on_ups_event(ups_monitor_event_t event, uint32_t now_ms)
+{
+    if (event == UPS_MONITOR_REPORT) {
+        boot_timing_mark(BOOT_PHASE_UPS_DATA);
+        led_status_activity(now_ms);  // White pulse for fresh UPS data
+    }
+    update_led_status();
+    publish_live_ups();
 }
 
-// Background timer task for UPS data freshness checking
-static void ups_freshness_timer_task(void *pvParameters)
+// Scheduler job, every UPS_MONITOR_CHECK_PERIOD_MS: UPS data freshness and
+// the services that piggyback on it
+static void ups_freshness_job(void *arg)
 {
     const char *TAG = "ups-timer";
-    ESP_LOGI(TAG, "UPS freshness timer task started");
-    
-    TickType_t last_log = xTaskGetTickCount();
-    while (1) {
-        uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-        uint32_t time_since_last_data = current_time - ups_last_data_time;
-        
-        // Check if UPS data is stale (no data for more than 10 seconds)
-        if (ups_state == UPS_CONNECTED_ACTIVE && time_since_last_data > UPS_DATA_FRESHNESS_TIMEOUT_MS) {
-            ups_state = UPS_CONNECTED_STALE;
-            ups_available = false;
-            ups_stale_start_time = xTaskGetTickCount() * portTICK_PERIOD_MS;  // Record start time
-            ESP_LOGW(TAG, "UPS state: ACTIVE -> STALE (no data for %lu ms)", time_since_last_data);
-            update_led_with_pulse();  // Update LED when UPS becomes stale
-        }
-        
-        // Log current state every 30 seconds for debugging
-        static uint32_t last_log_time = 0;
-        if (current_time - last_log_time > 30000) {  // 30 seconds
-            if (ups_state == UPS_DISCONNECTED) {
-                ESP_LOGI(TAG, "UPS Timer Check - State: %d, Available: %s, UPS Disconnected", 
-                         ups_state, ups_available ? "YES" : "NO");
-            } else {
-                ESP_LOGI(TAG, "UPS Timer Check - State: %d, Available: %s, Last Data: %lu ms ago", 
-                         ups_state, ups_available ? "YES" : "NO", time_since_last_data);
-            }
-            last_log_time = current_time;
-        }
-        
-        // Check every 2 seconds
-        vTaskDelay(pdMS_TO_TICKS(2000));
-        
-        // Periodically log stack high water mark
-        if (xTaskGetTickCount() - last_log > 30000 / portTICK_PERIOD_MS) {
-            last_log = xTaskGetTickCount();
-            ESP_LOGI("ups_timer", "Stack high water mark: %u bytes", uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t));
+    uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t time_since_last_data = current_time - get_ups_last_data_time();
+    ups_connection_state_t ups_state = get_ups_state();
+
+    // Check if UPS data is stale (no data for more than 10 seconds); the
+    // state listener updates the LED
+    ups_monitor_check_freshness(current_time);
+
+    // Log current state every 30 seconds for debugging
+    static uint32_t last_log_time = 0;
+    if (current_time - last_log_time > 30000) {  // 30 seconds
+        if (ups_state == UPS_DISCONNECTED) {
+            ESP_LOGI(TAG, "UPS Timer Check - State: %d, Available: %s, UPS Disconnected", 
+                     ups_state, ups_monitor_available() ? "YES" : "NO");
+        } else {
+            ESP_LOGI(TAG, "UPS Timer Check - State: %d, Available: %s, Last Data: %lu ms ago", 
+                     ups_state, ups_monitor_available() ? "YES" : "NO", time_since_last_data);
         }
-        
-        static bool esp_restart_attempted = false;
-        uint32_t nvs_reboot_counter = 0;
-        get_nvs_reboot_counter(&nvs_reboot_counter);
-        if (ups_state == UPS_CONNECTED_STALE) {
-            uint32_t stale_ms = get_ups_stale_duration_ms();
-            if (nvs_reboot_counter >= 3) {
-                // Skip all recovery actions, optionally log warning
-            } else {
-                if (stale_ms > 300000 && !esp_restart_attempted) {
-                    increment_nvs_reboot_counter();
-                    esp_restart_attempted = true;
-                    esp_restart();
-                }
-            }
+        last_log_time = current_time;
+    }
+    
+    // Commit energy counters when the coalescing thresholds are reached
+    energy_meter_service(current_time);
+    battery_health_service();
+
+    // Stack peaks per task name (calibration mode only)
+    task_stats_sample();
+    
+    static bool esp_restart_attempted = false;
+    // Served from RAM; flash is written only when the count changes
+    uint32_t reboot_count = persist_get_u32(PERSIST_REBOOT_COUNT);
+    if (get_ups_state() == UPS_CONNECTED_STALE) {
+        uint32_t stale_ms = get_ups_stale_duration_ms();
+        if (reboot_count >= 3) {
+            // Skip all recovery actions, optionally log warning
         } else {
-            esp_restart_attempted = false;
-            set_nvs_reboot_counter(0);
+            if (stale_ms > 300000 && !esp_restart_attempted) {
+                persist_set_u32(PERSIST_REBOOT_COUNT, reboot_count + 1);
+                persist_flush();
+                esp_restart_attempted = true;
+                soe_record(SOE_RESTART_REQUEST, SOE_RESTART_UPS_STALE);
+                esp_restart();
+            }
         }
+    } else {
+        esp_restart_attempted = false;
+        persist_set_u32(PERSIST_REBOOT_COUNT, 0);
     }
 }
 
@@ -250,6 +198,7 @@ static bool waiting_for_initial_data = false;
 static uint32_t device_connection_time = 0;
 static const uint32_t UPS_DATA_TIMEOUT_MS = 1000;  // 1 second to wait for initial data
 static hid_host_device_handle_t current_device_handle = NULL;
+static scheduler_job_t ups_detect_job;              // Armed when a potential UPS enumerates
 
 // Function declarations
 static esp_err_t __attribute__((unused)) init_generic_ups_models(void);
@@ -262,22 +211,10 @@ static void update_json_with_ups_data(const ups_data_t *data);
 static void debug_unknown_ups_model(hid_host_device_handle_t device_handle);
 static void refresh_ups_status_from_hid(bool *beep);
 
-// Pulse timer callback function
-static void pulse_timer_callback(void* arg)
-{
-    pulse_in_progress = false;
-    update_led_status();  // Return to base color
-}
-
 /* It is use for change beep status */
 #define APP_QUIT_PIN GPIO_NUM_0
 #define RGB_LED_PIN GPIO_NUM_48
 
-static led_strip_handle_t led_strip;
-
-// Logging control - set to 0 to disable verbose UPS parsing logs
-#define VERBOSE_UPS_LOGGING 1
-
 static const char *TAG = "ups";
 QueueHandle_t hid_host_event_queue;
 QueueHandle_t timer_queue;
@@ -322,74 +259,6 @@ static const char *hid_proto_name_str[] = {
 
 // =tcp server
 
-static char *ori_json = "{\"battery\":{\"charge\":{\"_root\":\"100\",\"low\":\"20\"},\"charger\":{\"status\":\"charging\"},\"runtime\":\"1104\",\"type\":\"PbAc\"},\"device\":{\"mfr\":\"EATON\",\"model\":\"SANTAK TG-BOX 850\",\"serial\":\"Blank\",\"type\":\"ups\"},\"driver\":{\"name\":\"usbhid-ups\",\"parameter\":{\"pollfreq\":30,\"pollinterval\":2,\"port\":\"/dev/ttyS1\",\"synchronous\":\"no\"},\"version\":{\"_root\":\"2.7.4\",\"data\":\"MGE HID 1.39\",\"internal\":\"0.41\"}},\"input\":{\"transfer\":{\"high\":\"264\",\"low\":\"184\"}},\"outlet\":{\"1\":{\"desc\":\"PowerShare Outlet 1\",\"id\":\"1\",\"status\":\"on\",\"switchable\":\"no\"},\"desc\":\"Main Outlet\",\"id\":\"0\",\"switchable\":\"yes\"},\"output\":{\"frequency\":{\"nominal\":\"50\"},\"voltage\":{\"_root\":\"230.0\",\"nominal\":\"220\"}},\"ups\":{\"beeper\":{\"status\":\"enabled\"},\"delay\":{\"shutdown\":\"20\",\"start\":\"30\"},\"firmware\":\"02.08.0010\",\"load\":\"28\",\"mfr\":\"EATON\",\"model\":\"SANTAK TG-BOX 850\",\"power\":{\"nominal\":\"850\"},\"productid\":\"ffff\",\"serial\":\"Blank\",\"status\":\"OL\",\"timer\":{\"shutdown\":\"0\",\"start\":\"0\"},\"type\":\"offline / line interactive\",\"vendorid\":\"0463\"}}";
-cJSON *json_object;
-
-char nut_list_var_text[2048]="";
-
-void init_json_object()
-{
-    json_object = cJSON_Parse(ori_json);
-}
-
-void gen_nut_list_var_text(cJSON *input, char *parent_path)
-{
-    char *prefix_text = "VAR qnapups ";
-    if (cJSON_IsString(input))
-    {
-        strcat(nut_list_var_text, parent_path);
-        if (input->string[0] != '_')
-        {
-            strcat(nut_list_var_text, ".");
-            strcat(nut_list_var_text, input->string);
-        }
-        strcat(nut_list_var_text, " \"");
-        strcat(nut_list_var_text, input->valuestring);
-        strcat(nut_list_var_text, "\"\n");
-    }
-    else if(cJSON_IsObject(input))
-    {
-        char new_parent_path[64] = "";
-        strcpy(new_parent_path, parent_path);
-        if (input->string != NULL)
-        {
-            if (strlen(new_parent_path) > strlen(prefix_text))
-            {
-                strcat(new_parent_path, ".");
-            }
-            strcat(new_parent_path, input->string);
-        }
-        else
-        {
-            strcat(new_parent_path, prefix_text);
-        }
-        cJSON *child = NULL;
-        cJSON_ArrayForEach(child, input)
-        {
-            gen_nut_list_var_text(child, new_parent_path);
-        }
-    }
-}
-
-/// @brief https://networkupstools.org/docs/developer-guide.chunked/ar01s09.html
-void gen_nut_list_var_text_wrapper()
-{
-    strcpy(nut_list_var_text, "BEGIN LIST VAR qnapups\n");
-    gen_nut_list_var_text(json_object, "");
-    strcat(nut_list_var_text, "END LIST VAR qnapups\n");
-}
-
-bool str_startswith(const char *str, const char *p)
-{
-	int len = strlen(p);
-	if (len <= 0)
-		return 0;
-	if (strncmp(str, p, len) == 0)
-		return 1;
-
-	return 0;
-}
-
 /**
  * @brief Indicates that the file descriptor represents an invalid (uninitialized or closed) socket
  *
@@ -398,13 +267,13 @@ bool str_startswith(const char *str, const char *p)
 #define INVALID_SOCK (-1)
 
 /**
- * @brief Time in ms to yield to all tasks when a non-blocking socket would block
+ * @brief Longest time in ms the NUT task blocks in select()
  *
- * Non-blocking socket operations are typically executed in a separate task validating
- * the socket status. Whenever the socket returns `EAGAIN` (idle status, i.e. would block)
- * we have to yield to all tasks to prevent lower priority tasks from starving.
+ * The task sleeps until a socket is readable, so between NUT polls the CPU can
+ * drop its clock or light-sleep; this bound only paces the supervisor heartbeat
+ * and the idle timeout check.
  */
-#define YIELD_TO_ALL_MS 50
+#define NUT_SELECT_TIMEOUT_MS 1000
 
 /**
  * @brief Utility to log socket errors
@@ -500,6 +369,13 @@ static inline char* get_clients_address(struct sockaddr_storage *source_addr)
 static TaskHandle_t tcp_server_task_handle = NULL;
 static int active_connections_count = 0;
 
+// Sockets live outside the task so a supervisor restart can close them
+#define NUT_MAX_CLIENTS 4
+static int nut_listen_sock = INVALID_SOCK;
+static int nut_sock[NUT_MAX_CLIENTS] = { INVALID_SOCK, INVALID_SOCK, INVALID_SOCK, INVALID_SOCK };
+// Set by the supervisor restart hook; the task closes its sockets and exits
+static bool nut_stop_requested = false;
+
 int get_active_tcp_connections(void) {
     return active_connections_count;
 }
@@ -518,9 +394,9 @@ void tcp_server_task(void *pvParameters)
     struct addrinfo hints = { .ai_socktype = SOCK_STREAM };
     struct addrinfo *address_info;
     int listen_sock = INVALID_SOCK;
-    const size_t max_socks = 4; // Allow up to 4 clients
-    static int sock[4];
-    TickType_t last_activity[4];
+    const size_t max_socks = NUT_MAX_CLIENTS;
+    int *sock = nut_sock;
+    TickType_t last_activity[NUT_MAX_CLIENTS];
 
     for (int i = 0; i < max_socks; ++i) {
         sock[i] = INVALID_SOCK;
@@ -530,6 +406,7 @@ void tcp_server_task(void *pvParameters)
     int res = getaddrinfo("0.0.0.0", "3493", &hints, &address_info);
     if (res != 0 || address_info == NULL) {
         ESP_LOGE(TAG, "couldn't get hostname for 0.0.0.0 getaddrinfo() returns %d, addrinfo=%p", res, address_info);
+        tcp_server_task_handle = NULL;
         vTaskDelete(NULL);
         return;
     }
@@ -538,6 +415,7 @@ void tcp_server_task(void *pvParameters)
     if (listen_sock < 0) {
         log_socket_error(TAG, listen_sock, errno, "Unable to create socket");
         free(address_info);
+        tcp_server_task_handle = NULL;
         vTaskDelete(NULL);
         return;
     }
@@ -548,6 +426,7 @@ void tcp_server_task(void *pvParameters)
         log_socket_error(TAG, listen_sock, errno, "Unable to set socket non blocking");
         close(listen_sock);
         free(address_info);
+        tcp_server_task_handle = NULL;
         vTaskDelete(NULL);
         return;
     }
@@ -557,6 +436,7 @@ void tcp_server_task(void *pvParameters)
         log_socket_error(TAG, listen_sock, errno, "Socket unable to bind");
         close(listen_sock);
         free(address_info);
+        tcp_server_task_handle = NULL;
         vTaskDelete(NULL);
         return;
     }
@@ -567,14 +447,16 @@ void tcp_server_task(void *pvParameters)
         log_socket_error(TAG, listen_sock, errno, "Error occurred during listen");
         close(listen_sock);
         free(address_info);
+        tcp_server_task_handle = NULL;
         vTaskDelete(NULL);
         return;
     }
     ESP_LOGI(TAG, "Socket listening");
     free(address_info);
+    nut_listen_sock = listen_sock;
 
-    TickType_t last_log = xTaskGetTickCount();
-    while (1) {
+    while (!__atomic_load_n(&nut_stop_requested, __ATOMIC_ACQUIRE)) {
+        supervisor_beat(SUPERVISOR_NUT);
         struct sockaddr_storage source_addr;
         socklen_t addr_len = sizeof(source_addr);
         int new_sock_index = 0;
@@ -583,10 +465,37 @@ void tcp_server_task(void *pvParameters)
                 break;
             }
         }
+
+        // Block until a client sends something or connects; the listener is
+        // only watched while a slot is free so a full table doesn't spin
+        fd_set readfds;
+        FD_ZERO(&readfds);
+        int max_fd = -1;
         if (new_sock_index < max_socks) {
+            FD_SET(listen_sock, &readfds);
+            max_fd = listen_sock;
+        }
+        for (int i = 0; i < max_socks; ++i) {
+            if (sock[i] != INVALID_SOCK) {
+                FD_SET(sock[i], &readfds);
+                if (sock[i] > max_fd) max_fd = sock[i];
+            }
+        }
+        struct timeval timeout = { .tv_sec = NUT_SELECT_TIMEOUT_MS / 1000,
+                                   .tv_usec = (NUT_SELECT_TIMEOUT_MS % 1000) * 1000 };
+        int ready = select(max_fd + 1, &readfds, NULL, NULL, &timeout);
+        int64_t wake_us = esp_timer_get_time();
+        if (ready < 0 && errno != EINTR) {
+            log_socket_error(TAG, listen_sock, errno, "select() failed");
+            vTaskDelay(pdMS_TO_TICKS(100));
+        }
+
+        if (ready > 0 && new_sock_index < max_socks && FD_ISSET(listen_sock, &readfds)) {
             sock[new_sock_index] = accept(listen_sock, (struct sockaddr *)&source_addr, &addr_len);
             if (sock[new_sock_index] >= 0) {
                 ESP_LOGI(TAG, "[sock=%d]: Connection accepted from IP:%s", sock[new_sock_index], get_clients_address(&source_addr));
+                soe_record(SOE_NUT_CLIENT_CONNECT, source_addr.ss_family == PF_INET ?
+                           ((struct sockaddr_in *)&source_addr)->sin_addr.s_addr : 0);
                 int flags = fcntl(sock[new_sock_index], F_GETFL);
                 fcntl(sock[new_sock_index], F_SETFL, flags | O_NONBLOCK);
                 last_activity[new_sock_index] = xTaskGetTickCount() * portTICK_PERIOD_MS;
@@ -600,9 +509,18 @@ void tcp_server_task(void *pvParameters)
         TickType_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
         for (int i = 0; i < max_socks; ++i) {
             if (sock[i] != INVALID_SOCK) {
-                int len = try_receive(TAG, sock[i], rx_buffer, sizeof(rx_buffer));
+                int len = 0;
+                if (ready > 0 && FD_ISSET(sock[i], &readfds)) {
+                    len = try_receive(TAG, sock[i], rx_buffer, sizeof(rx_buffer));
+                    // Readable with nothing to read: the client closed or reset
+                    // the connection, which would otherwise keep select() hot
+                    if (len == 0) {
+                        len = -2;
+                    }
+                }
                 if (len < 0) {
                     ESP_LOGI(TAG, "[sock=%d]: try_receive() returned %d -> closing the socket", sock[i], len);
+                    soe_record(SOE_NUT_CLIENT_DISCONNECT, sock[i]);
                     close(sock[i]);
                     sock[i] = INVALID_SOCK;
                     // Update active connection count
@@ -611,160 +529,30 @@ void tcp_server_task(void *pvParameters)
                         if (sock[j] != INVALID_SOCK) active_connections_count++;
                     }
                 } else if (len > 0) {
+                    // Full clock for the reply only; nothing between acquire and
+                    // release can block or leave the loop
+                    power_mgmt_acquire(POWER_LOCK_NET);
+                    int64_t rx_us = esp_timer_get_time();
                     // NUT protocol command parsing
                     rx_buffer[len] = '\0'; // Null-terminate for string ops
-                    ESP_LOGI(TAG, "[NUT] RX from client: %.*s", len, rx_buffer);
+                    DLOG_TEXT(ESP_LOG_INFO, TAG, "[NUT] RX from client: ", rx_buffer, len);
 
-                    // Trim trailing CR/LF
-                    char *cmd = rx_buffer;
-                    while (len > 0 && (cmd[len-1] == '\n' || cmd[len-1] == '\r')) {
-                        cmd[--len] = '\0';
-                    }
+                    char response[NUT_PROTOCOL_REPLY_MAX];
+                    uint32_t generation = report_trace_generation();
+                    size_t response_len = nut_protocol_execute(rx_buffer, response, sizeof(response));
 
-                    const char *response = NULL;
-                    char response_buf[1024];
-                    response_buf[0] = '\0';
-
-                    // Check UPS availability
-                    bool ups_found = (ups_state != UPS_DISCONNECTED && ups_state != UPS_CONNECTED_WAITING_DATA);
-
-                    // LIST UPS
-                    if (strcasecmp(cmd, "LIST UPS") == 0) {
-                        if (ups_found) {
-                            snprintf(response_buf, sizeof(response_buf),
-                                "BEGIN LIST UPS\nUPS VP700ELCD \"CyberPower VP700ELCD\"\nEND LIST UPS\n");
-                        } else {
-                            snprintf(response_buf, sizeof(response_buf), "ERR UPS-NOT-FOUND\n");
-                        }
-                        response = response_buf;
+                    int sent = send(sock[i], response, response_len, 0);
+                    DLOG_TEXT(ESP_LOG_INFO, TAG, "[NUT] TX: ", response, response_len);
+                    if (sent >= 0 && nut_protocol_reply_has_values(response)) {
+                        report_trace_served(REPORT_TRACE_NUT, generation);
                     }
-                    // LIST VAR VP700ELCD
-                    else if (strncasecmp(cmd, "LIST VAR VP700ELCD", 18) == 0) {
-                        if (ups_found) {
-                            // Return all 17 UPS variables
-                            snprintf(response_buf, sizeof(response_buf),
-                                "BEGIN LIST VAR VP700ELCD\n"
-                                "VAR VP700ELCD battery.charge \"%d\"\n"
-                                "VAR VP700ELCD battery.runtime \"%d\"\n"
-                                "VAR VP700ELCD input.voltage \"%d\"\n"
-                                "VAR VP700ELCD output.voltage \"%d\"\n"
-                                "VAR VP700ELCD ups.load \"%d\"\n"
-                                "VAR VP700ELCD ups.status \"%s\"\n"
-                                "VAR VP700ELCD battery.temperature \"%d\"\n"
-                                "VAR VP700ELCD device.mfr \"CyberPower\"\n"
-                                "VAR VP700ELCD device.model \"VP700ELCD\"\n"
-                                "VAR VP700ELCD device.type \"ups\"\n"
-                                "VAR VP700ELCD ups.firmware \"1.0\"\n"
-                                "VAR VP700ELCD battery.type \"PbAc\"\n"
-                                "VAR VP700ELCD ups.power.nominal \"700\"\n"
-                                "VAR VP700ELCD ups.status.flags \"%d\"\n"
-                                "VAR VP700ELCD ups.system.status \"%d\"\n"
-                                "VAR VP700ELCD ups.extended.status \"%d\"\n"
-                                "VAR VP700ELCD ups.alarm.control \"%d\"\n"
-                                "VAR VP700ELCD ups.beep.control \"%d\"\n"
-                                "END LIST VAR VP700ELCD\n",
-                                ups_data.battery_level,
-                                ups_data.runtime,
-                                ups_data.input_voltage,
-                                ups_data.output_voltage,
-                                ups_data.load,
-                                ups_available ? "OL" : "UNKNOWN",
-                                ups_data.temperature,
-                                ups_data.status,
-                                ups_data.system_status,
-                                ups_data.extended_status,
-                                ups_data.alarm_control,
-                                ups_data.beep_control);
-                        } else {
-                            snprintf(response_buf, sizeof(response_buf), "ERR UPS-NOT-FOUND\n");
-                        }
-                        response = response_buf;
-                    }
-                    // GET VAR VP700ELCD <varname>
-                    else if (strncasecmp(cmd, "GET VAR VP700ELCD ", 18) == 0) {
-                        if (ups_found) {
-                            char *var = cmd + 18;
-                            if (strcasecmp(var, "battery.charge") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD battery.charge \"%d\"\n", ups_data.battery_level);
-                            } else if (strcasecmp(var, "battery.runtime") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD battery.runtime \"%d\"\n", ups_data.runtime);
-                            } else if (strcasecmp(var, "input.voltage") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD input.voltage \"%d\"\n", ups_data.input_voltage);
-                            } else if (strcasecmp(var, "output.voltage") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD output.voltage \"%d\"\n", ups_data.output_voltage);
-                            } else if (strcasecmp(var, "ups.load") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD ups.load \"%d\"\n", ups_data.load);
-                            } else if (strcasecmp(var, "ups.status") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD ups.status \"%s\"\n", ups_available ? "OL" : "UNKNOWN");
-                            } else if (strcasecmp(var, "battery.temperature") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD battery.temperature \"%d\"\n", ups_data.temperature);
-                            } else if (strcasecmp(var, "device.mfr") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD device.mfr \"CyberPower\"\n");
-                            } else if (strcasecmp(var, "device.model") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD device.model \"VP700ELCD\"\n");
-                            } else if (strcasecmp(var, "device.type") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD device.type \"ups\"\n");
-                            } else if (strcasecmp(var, "ups.firmware") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD ups.firmware \"1.0\"\n");
-                            } else if (strcasecmp(var, "battery.type") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD battery.type \"PbAc\"\n");
-                            } else if (strcasecmp(var, "ups.power.nominal") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD ups.power.nominal \"700\"\n");
-                            } else if (strcasecmp(var, "ups.status.flags") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD ups.status.flags \"%d\"\n", ups_data.status);
-                            } else if (strcasecmp(var, "ups.system.status") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD ups.system.status \"%d\"\n", ups_data.system_status);
-                            } else if (strcasecmp(var, "ups.extended.status") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD ups.extended.status \"%d\"\n", ups_data.extended_status);
-                            } else if (strcasecmp(var, "ups.alarm.control") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD ups.alarm.control \"%d\"\n", ups_data.alarm_control);
-                            } else if (strcasecmp(var, "ups.beep.control") == 0) {
-                                snprintf(response_buf, sizeof(response_buf),
-                                    "VAR VP700ELCD ups.beep.control \"%d\"\n", ups_data.beep_control);
-                            } else {
-                                snprintf(response_buf, sizeof(response_buf), "ERR VAR-NOT-FOUND\n");
-                            }
-                        } else {
-                            snprintf(response_buf, sizeof(response_buf), "ERR UPS-NOT-FOUND\n");
-                        }
-                        response = response_buf;
-                    }
-                    // Authentication commands (stubbed for Home Assistant compatibility)
-                    else if (str_startswith(cmd, "USERNAME") || str_startswith(cmd, "PASSWORD") || str_startswith(cmd, "LOGIN")) {
-                        snprintf(response_buf, sizeof(response_buf), "OK\n");
-                        response = response_buf;
-                    }
-                    else if (str_startswith(cmd, "LOGOUT")) {
-                        snprintf(response_buf, sizeof(response_buf), "OK Goodbye\n");
-                        response = response_buf;
-                    }
-                    // Unknown command
-                    else {
-                        snprintf(response_buf, sizeof(response_buf), "ERR UNKNOWN-COMMAND\n");
-                        response = response_buf;
-                    }
-
-                    int sent = send(sock[i], response, strlen(response), 0);
-                    ESP_LOGI(TAG, "[sock=%d]: Sent response (%d bytes): %s", sock[i], sent, response);
+                    int64_t sent_us = esp_timer_get_time();
+                    sched_bench_nut_reply((uint32_t)(sent_us - rx_us));
+                    power_mgmt_nut_reply((uint32_t)(sent_us - wake_us));
+                    power_mgmt_release(POWER_LOCK_NET);
                     if (sent < 0) {
                         ESP_LOGE(TAG, "[sock=%d]: Failed to send response: %s", sock[i], strerror(errno));
+                        soe_record(SOE_NUT_CLIENT_DISCONNECT, sock[i]);
                         close(sock[i]);
                         sock[i] = INVALID_SOCK;
                     }
@@ -772,6 +560,7 @@ void tcp_server_task(void *pvParameters)
                 // Idle timeout check
                 if (sock[i] != INVALID_SOCK && (now - last_activity[i]) > TCP_IDLE_TIMEOUT_MS) {
                     ESP_LOGI(TAG, "[sock=%d]: Idle timeout (%d ms), closing socket", sock[i], (int)(now - last_activity[i]));
+                    soe_record(SOE_NUT_CLIENT_DISCONNECT, sock[i]);
                     close(sock[i]);
                     sock[i] = INVALID_SOCK;
                     // Update active connection count
@@ -782,27 +571,74 @@ void tcp_server_task(void *pvParameters)
                 }
             }
         }
-        vTaskDelay(pdMS_TO_TICKS(YIELD_TO_ALL_MS));
-        
-        // Periodically log stack high water mark
-        if (xTaskGetTickCount() - last_log > 30000 / portTICK_PERIOD_MS) {
-            last_log = xTaskGetTickCount();
-            ESP_LOGI("tcp_server", "Stack high water mark: %u bytes", uxTaskGetStackHighWaterMark(NULL) * sizeof(StackType_t));
-        }
     }
-    // Cleanup (should not reach here)
+    // Stop requested by nut_server_restart(): close everything, then clear the
+    // handle last so the restart hook knows the sockets are released
+    ESP_LOGI(TAG, "Stopping");
     if (listen_sock != INVALID_SOCK) {
         close(listen_sock);
+        nut_listen_sock = INVALID_SOCK;
     }
     for (int i = 0; i < max_socks; ++i) {
         if (sock[i] != INVALID_SOCK) {
+            soe_record(SOE_NUT_CLIENT_DISCONNECT, sock[i]);
             close(sock[i]);
+            sock[i] = INVALID_SOCK;
         }
     }
+    active_connections_count = 0;
+    heap_monitor_untag_task(xTaskGetCurrentTaskHandle());
+    __atomic_store_n(&tcp_server_task_handle, NULL, __ATOMIC_RELEASE);
     vTaskDelete(NULL);
-    tcp_server_task_handle = NULL;
 }
 
+static void nut_server_start(void)
+{
+    __atomic_store_n(&nut_stop_requested, false, __ATOMIC_RELEASE);
+    BaseType_t task_created = xTaskCreatePinnedToCore(&tcp_server_task, "tcp_server", CONFIG_UPS_STACK_NUT_SERVER, NULL,
+                                                      TASK_PRIO_NUT, &tcp_server_task_handle, TASK_CORE_NET);
+    if (task_created != pdTRUE) {
+        ESP_LOGE(TAG, "Failed to create NUT server task");
+        tcp_server_task_handle = NULL;
+    }
+    heap_monitor_tag_task(tcp_server_task_handle, HEAP_TAG_NUT);
+}
+
+// How long the restart hook waits for the task to stop on its own; it checks
+// the stop flag at least once per select() timeout
+#define NUT_STOP_TIMEOUT_MS (2 * NUT_SELECT_TIMEOUT_MS + 500)
+
+// Supervisor restart hook. The task is never deleted from the outside: it may
+// be inside lwIP (a select() callback lives on its stack), so it is asked to
+// stop, woken by shutting its sockets down, and left to close them and delete
+// itself. A task that does not get there is wedged, and the device reboots.
+static void nut_server_restart(void)
+{
+    if (__atomic_load_n(&tcp_server_task_handle, __ATOMIC_ACQUIRE)) {
+        __atomic_store_n(&nut_stop_requested, true, __ATOMIC_RELEASE);
+        // shutdown() wakes select() without freeing a socket the task still uses
+        if (nut_listen_sock != INVALID_SOCK) {
+            shutdown(nut_listen_sock, SHUT_RDWR);
+        }
+        for (int i = 0; i < NUT_MAX_CLIENTS; ++i) {
+            if (nut_sock[i] != INVALID_SOCK) {
+                shutdown(nut_sock[i], SHUT_RDWR);
+            }
+        }
+        for (int waited = 0; __atomic_load_n(&tcp_server_task_handle, __ATOMIC_ACQUIRE); waited += 10) {
+            if (waited >= NUT_STOP_TIMEOUT_MS) {
+                ESP_LOGE(TAG, "NUT server did not stop within %d ms, rebooting", NUT_STOP_TIMEOUT_MS);
+                soe_record(SOE_RESTART_REQUEST, SOE_RESTART_SUPERVISOR);
+                vTaskDelay(pdMS_TO_TICKS(100));
+                esp_restart();
+            }
+            vTaskDelay(pdMS_TO_TICKS(10));
+        }
+    }
+    nut_server_start();
+}
+
+
 // =tcp server
 
 /**
@@ -848,195 +684,7 @@ void tcp_server_task(void *pvParameters)
 
 static void hid_host_generic_report_callback(const uint8_t *const data, const int length)
 {
-    if (length < 1) {
-        ESP_LOGW(TAG, "Received empty HID report");
-        return;
-    }
-    
-    uint8_t report_id = data[0];
-    
-    // Update UPS state and timestamp
-    ups_last_data_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    last_field_update_time = ups_last_data_time;  // Track field update time for LED pulse
-    
-    if (ups_state == UPS_DISCONNECTED || ups_state == UPS_CONNECTED_WAITING_DATA) {
-        ups_state = UPS_CONNECTED_ACTIVE;
-        ups_available = true;
-        ups_stale_start_time = 0;  // Reset STALE timer
-        ESP_LOGI(TAG, "UPS state: DISCONNECTED/WAITING -> ACTIVE");
-        update_led_with_pulse();  // Update LED with pulse logic when UPS becomes active
-    } else if (ups_state == UPS_CONNECTED_STALE) {
-        ups_state = UPS_CONNECTED_ACTIVE;
-        ups_stale_start_time = 0;  // Reset STALE timer
-        ESP_LOGI(TAG, "UPS state: STALE -> ACTIVE");
-        update_led_with_pulse();  // Update LED with pulse logic when UPS becomes active
-    } else {
-        // UPS was already active, just update LED with pulse logic
-        update_led_with_pulse();
-    }
-    
-#if VERBOSE_UPS_LOGGING
-    ESP_LOGI(TAG, "=== PARSING REPORT 0x%02X (Length: %d) ===", report_id, length);
-    
-    // Display raw data first
-    ESP_LOGI(TAG, "Raw data:");
-    for (int i = 0; i < length && i < 16; i++) {
-        printf("%02X ", data[i]);
-    }
-    if (length > 16) printf("...");
-    printf("\n");
-#endif
-    
-    // Parse ALL reports with smart length handling
-    switch (report_id) {
-        case 0x20:  // Battery and Load Status
-            ESP_LOGI(TAG, "Report 0x20 - Battery/Status Data:");
-            if (length >= 2) {
-                ups_data.battery_level = data[1];
-                ESP_LOGI(TAG, "  Battery Level: %d%%", ups_data.battery_level);
-            }
-            if (length >= 3) {
-                ups_data.battery_byte2 = data[2];
-                ESP_LOGI(TAG, "  Battery Byte2: %d", ups_data.battery_byte2);
-            }
-            if (length >= 4) {
-                ups_data.battery_byte3 = data[3];
-                ESP_LOGI(TAG, "  Battery Byte3: %d", ups_data.battery_byte3);
-            }
-            break;
-            
-        case 0x21:  // Status Flags
-            ESP_LOGI(TAG, "Report 0x21 - Status Flags:");
-            if (length >= 2) {
-                ups_data.status = data[1];
-                ESP_LOGI(TAG, "  Status: %d", ups_data.status);
-            }
-            if (length >= 3) {
-                ups_data.status_byte2 = data[2];
-                ESP_LOGI(TAG, "  Status Byte2: %d", ups_data.status_byte2);
-            }
-            break;
-            
-        case 0x22:  // Runtime
-            ESP_LOGI(TAG, "Report 0x22 - Runtime Data:");
-            if (length >= 2) {
-                ups_data.runtime = data[1];
-                ESP_LOGI(TAG, "  Runtime: %d minutes", ups_data.runtime);
-            }
-            break;
-            
-        case 0x23:  // Voltage Data
-            ESP_LOGI(TAG, "Report 0x23 - Voltage Data:");
-            if (length >= 3) {
-                ups_data.input_voltage = (data[2] << 8) | data[1];
-                ESP_LOGI(TAG, "  Input Voltage: %d V", ups_data.input_voltage);
-            }
-            if (length >= 5) {
-                ups_data.output_voltage = (data[4] << 8) | data[3];
-                ESP_LOGI(TAG, "  Output Voltage: %d V", ups_data.output_voltage);
-            }
-            break;
-            
-        case 0x25:  // Load Percentage
-            ESP_LOGI(TAG, "Report 0x25 - Load Data:");
-            if (length >= 2) {
-                ups_data.load = data[1];
-                ESP_LOGI(TAG, "  Load: %d%%", ups_data.load);
-            }
-            break;
-            
-        case 0x28:  // Alarm Control
-            ESP_LOGI(TAG, "Report 0x28 - Alarm Control:");
-            if (length >= 2) {
-                ups_data.alarm_control = data[1];
-                ESP_LOGI(TAG, "  Alarm Control: %d", ups_data.alarm_control);
-            }
-            break;
-            
-        case 0x29:  // Beep Control
-            ESP_LOGI(TAG, "Report 0x29 - Beep Control:");
-            if (length >= 2) {
-                ups_data.beep_control = data[1];
-                ESP_LOGI(TAG, "  Beep Control: %d", ups_data.beep_control);
-            }
-            break;
-            
-        case 0x80:  // System Status
-            ESP_LOGI(TAG, "Report 0x80 - System Status:");
-            if (length >= 2) {
-                ups_data.system_status = data[1];
-                ESP_LOGI(TAG, "  System Status: %d", ups_data.system_status);
-            }
-            break;
-            
-        case 0x82:  // Extended Status
-            ESP_LOGI(TAG, "Report 0x82 - Extended Status:");
-            if (length >= 3) {
-                ups_data.extended_status = (data[2] << 8) | data[1];
-                ESP_LOGI(TAG, "  Extended Status: %d", ups_data.extended_status);
-            }
-            break;
-            
-        case 0x85:  // Temperature/Sensor
-            ESP_LOGI(TAG, "Report 0x85 - Temperature/Sensor:");
-            if (length >= 2) {
-                ups_data.temperature = data[1];
-                ESP_LOGI(TAG, "  Temperature: %d", ups_data.temperature);
-            }
-            break;
-            
-        case 0x86:  // Temperature Range 1
-            ESP_LOGI(TAG, "Report 0x86 - Temperature Range 1:");
-            if (length >= 3) {
-                ups_data.temp_range1 = (data[2] << 8) | data[1];
-                ESP_LOGI(TAG, "  Temp Range 1: %d", ups_data.temp_range1);
-            }
-            break;
-            
-        case 0x87:  // Temperature Range 2
-            ESP_LOGI(TAG, "Report 0x87 - Temperature Range 2:");
-            if (length >= 3) {
-                ups_data.temp_range2 = (data[2] << 8) | data[1];
-                ESP_LOGI(TAG, "  Temp Range 2: %d", ups_data.temp_range2);
-            }
-            break;
-            
-        case 0x88:  // Additional Sensor
-            ESP_LOGI(TAG, "Report 0x88 - Additional Sensor:");
-            if (length >= 3) {
-                ups_data.additional_sensor = (data[2] << 8) | data[1];
-                ESP_LOGI(TAG, "  Additional Sensor: %d", ups_data.additional_sensor);
-            }
-            break;
-            
-        default:
-            ESP_LOGI(TAG, "Report 0x%02X - UNKNOWN REPORT TYPE", report_id);
-            ESP_LOGI(TAG, "  Raw data:");
-            for (int i = 0; i < length && i < 16; i++) {
-                printf("%02X ", data[i]);
-            }
-            if (length > 16) printf("...");
-            printf("\n");
-            break;
-    }
-    
-#if VERBOSE_UPS_LOGGING
-    ESP_LOGI(TAG, "=============================");
-#endif
-
-    // Print current UPS data state after each report
-    ESP_LOGI(TAG, "=== CURRENT UPS DATA STATE ===");
-    ESP_LOGI(TAG, "State: %d, Available: %s, Last Data: %lu ms ago (timeout: %d ms)", 
-             ups_state, ups_available ? "YES" : "NO", 
-             xTaskGetTickCount() * portTICK_PERIOD_MS - ups_last_data_time,
-             UPS_DATA_FRESHNESS_TIMEOUT_MS);
-    ESP_LOGI(TAG, "Battery: %d%%, Load: %d%%, Runtime: %d min", 
-             ups_data.battery_level, ups_data.load, ups_data.runtime);
-    ESP_LOGI(TAG, "Input: %d V, Output: %d V, Temp: %d", 
-             ups_data.input_voltage, ups_data.output_voltage, ups_data.temperature);
-    ESP_LOGI(TAG, "Status: %d, System: %d, Extended: %d", 
-             ups_data.status, ups_data.system_status, ups_data.extended_status);
-    ESP_LOGI(TAG, "=============================");
+    ups_monitor_process_report(data, length > 0 ? (size_t)length : 0, xTaskGetTickCount() * portTICK_PERIOD_MS);
 }
 
 /**
@@ -1050,6 +698,7 @@ void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle,
                                  const hid_host_interface_event_t event,
                                  void *arg)
 {
+    int64_t start_us = esp_timer_get_time();
     uint8_t data[64] = {0};
     size_t data_length = 0;
     hid_host_dev_params_t dev_params;
@@ -1058,6 +707,7 @@ void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle,
     switch (event)
     {
     case HID_HOST_INTERFACE_EVENT_INPUT_REPORT:
+        report_trace_arrival();
         ESP_ERROR_CHECK(hid_host_device_get_raw_input_report_data(hid_device_handle,
                                                                   data,
                                                                   64,
@@ -1074,7 +724,7 @@ void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle,
                 waiting_for_initial_data = false;
                 latest_hid_device_handle = hid_device_handle;
                 UPS_DEV_CONNECTED = true;
-                ups_state = UPS_CONNECTED_WAITING_DATA;
+                ups_monitor_device_ready();
                 ESP_LOGI(TAG, "UPS data detected, sending to parsing logic");
                 
                 ESP_LOGI(TAG, "=== UPS PARSING INITIALIZED ===");
@@ -1093,6 +743,7 @@ void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle,
             hid_host_generic_report_callback(data, data_length);
             }
         }
+        sched_bench_usb_report(start_us, esp_timer_get_time());
 
         break;
     case HID_HOST_INTERFACE_EVENT_DISCONNECTED:
@@ -1106,13 +757,11 @@ void hid_host_interface_callback(hid_host_device_handle_t hid_device_handle,
         
         if (hid_device_handle == latest_hid_device_handle) {
         UPS_DEV_CONNECTED = false;
-        ups_state = UPS_DISCONNECTED;
-        ups_available = false;
-        update_led_with_pulse();  // Update LED when UPS disconnects
-            ESP_LOGI(TAG, "UPS state: -> DISCONNECTED");
+        ups_monitor_device_gone();  // The state listener updates the LED
         }
         
         ESP_LOGI(TAG, "USB device disconnected correctly");
+        power_mgmt_release(POWER_LOCK_USB);
         ESP_ERROR_CHECK(hid_host_device_close(hid_device_handle));
         break;
     case HID_HOST_INTERFACE_EVENT_TRANSFER_ERROR:
@@ -1165,6 +814,9 @@ void hid_host_device_event(hid_host_device_handle_t hid_device_handle,
             }
         }
         ESP_ERROR_CHECK(hid_host_device_start(hid_device_handle));
+        // Interrupt transfers are scheduled from here until the close
+        power_mgmt_acquire(POWER_LOCK_USB);
+        boot_timing_mark(BOOT_PHASE_UPS_ENUMERATED);
 
         // Filtering Logic: Only investigate NONE protocol devices for UPS data
         if (dev_params.proto == HID_PROTOCOL_KEYBOARD || dev_params.proto == HID_PROTOCOL_MOUSE) {
@@ -1178,6 +830,7 @@ void hid_host_device_event(hid_host_device_handle_t hid_device_handle,
             waiting_for_initial_data = true;
             device_connection_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
             current_device_handle = hid_device_handle;
+            scheduler_arm(&ups_detect_job, UPS_DATA_TIMEOUT_MS + portTICK_PERIOD_MS);
         }
         
         break;
@@ -1193,13 +846,8 @@ void hid_host_device_event(hid_host_device_handle_t hid_device_handle,
  */
 static void usb_lib_task(void *arg)
 {
-    const gpio_config_t input_pin = {
-        .pin_bit_mask = BIT64(APP_QUIT_PIN),
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-    };
-    ESP_ERROR_CHECK(gpio_config(&input_pin));
-
+    // APP_QUIT_PIN is the BOOT button: button_init() owns its configuration
+    // (input, pull-up, edge interrupt), so it is not touched here
     const usb_host_config_t host_config = {
         .skip_phy_setup = false,
         .intr_flags = ESP_INTR_FLAG_LEVEL1,
@@ -1251,31 +899,24 @@ void __attribute__((unused)) refresh_ups_status_from_hid(bool *beep)
     }
 }
 
-/// @brief to recheck ups status and refresh json object. 
-/// @param pvParameters 
-void timer_task(void *pvParameters)
+// Scheduler job, armed on enumeration: give up on a device that sent no data
+static void ups_detect_timeout(void *arg)
 {
-    // Simple timeout check - no complex queue logic
-    while (true)
-    {
-        // Check for UPS detection timeout
-        if (waiting_for_initial_data && current_device_handle != NULL) {
-            uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-            uint32_t time_since_connection = current_time - device_connection_time;
+    if (waiting_for_initial_data && current_device_handle != NULL) {
+        uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
+        uint32_t time_since_connection = current_time - device_connection_time;
+        
+        if (time_since_connection > UPS_DATA_TIMEOUT_MS) {
+            // Device didn't send data within timeout - not a UPS
+            ESP_LOGI(TAG, "no raw data detected, no UPS connected");
             
-            if (time_since_connection > UPS_DATA_TIMEOUT_MS) {
-                // Device didn't send data within timeout - not a UPS
-                ESP_LOGI(TAG, "no raw data detected, no UPS connected");
-                
-                // Reset filtering state
-                device_is_ups = false;
-                waiting_for_initial_data = false;
-                current_device_handle = NULL;
-            }
+            // Reset filtering state
+            device_is_ups = false;
+            waiting_for_initial_data = false;
+            current_device_handle = NULL;
+        } else {
+            scheduler_arm(&ups_detect_job, UPS_DATA_TIMEOUT_MS - time_since_connection + portTICK_PERIOD_MS);
         }
-
-        // Simple delay instead of queue
-        vTaskDelay(pdMS_TO_TICKS(100));  // Check every 100ms
     }
 }
 
@@ -1295,7 +936,7 @@ void hid_host_task(void *pvParameters)
     // Wait queue
     while (!user_shutdown)
     {
-        if (xQueueReceive(hid_host_event_queue, &evt_queue, pdMS_TO_TICKS(50)))
+        if (xQueueReceive(hid_host_event_queue, &evt_queue, pdMS_TO_TICKS(1000)))
         {
             hid_host_device_event(evt_queue.hid_device_handle,
                                   evt_queue.event,
@@ -1342,76 +983,6 @@ static bool IRAM_ATTR __attribute__((unused)) timer_on_alarm_callback(gptimer_ha
 }
 // ==计时器 Timer
 
-static void __attribute__((unused)) configure_led(void)
-{
-    /* LED strip initialization with the GPIO and pixels number*/
-    led_strip_config_t strip_config = {
-        .strip_gpio_num = RGB_LED_PIN,
-        .max_leds = 1, // Single RGB LED on board
-        .flags.invert_out = false,
-    };
-    led_strip_rmt_config_t rmt_config = {
-        .resolution_hz = 10 * 1000 * 1000, // 10MHz
-        .flags.with_dma = false,
-    };
-    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip));
-    /* Set all LED off to clear all pixels */
-    led_strip_clear(led_strip);
-    /* Ensure the LED is properly initialized */
-    led_strip_refresh(led_strip);
-}
-
-// LED Status Functions
-static void set_led_green(void)
-{
-    led_strip_set_pixel(led_strip, 0, 0, 255, 0);  // Green
-    led_strip_refresh(led_strip);
-}
-
-static void set_led_yellow(void)
-{
-    led_strip_set_pixel(led_strip, 0, 255, 255, 0);  // Yellow
-    led_strip_refresh(led_strip);
-}
-
-static void set_led_red(void)
-{
-    led_strip_set_pixel(led_strip, 0, 255, 0, 0);  // Red
-    led_strip_refresh(led_strip);
-}
-
-static void set_led_white(void)
-{
-    led_strip_set_pixel(led_strip, 0, 255, 255, 255);  // White
-    led_strip_refresh(led_strip);
-}
-
-static void set_led_purple(void)
-{
-    if (led_strip) {
-        esp_err_t ret = led_strip_set_pixel(led_strip, 0, 255, 0, 255);  // Purple
-        if (ret == ESP_OK) {
-            led_strip_refresh(led_strip);
-        } else {
-            ESP_LOGE(TAG, "Failed to set LED purple: %s", esp_err_to_name(ret));
-        }
-    }
-}
-
-static void set_led_blue(void)
-{
-    if (led_strip) {
-        esp_err_t ret = led_strip_set_pixel(led_strip, 0, 0, 0, 255);  // Blue
-        if (ret == ESP_OK) {
-            led_strip_refresh(led_strip);
-        } else {
-            ESP_LOGE(TAG, "Failed to set LED blue: %s", esp_err_to_name(ret));
-        }
-    }
-}
-
-
-
 // WiFi Configuration - Layer 1: Reliable WiFi Connection
 #include "wifi_secrets.h" // <-- User must create this file with their WiFi credentials
 // #define WIFI_SSID "YOUR_WIFI_SSID"
@@ -1439,54 +1010,42 @@ static void update_led_status(void)
     }
     
     // Safely check UPS status
-    if (ups_state == UPS_CONNECTED_ACTIVE && ups_available) {
+    if (ups_monitor_available()) {
         ups_ok = true;
     }
     
     if (wifi_ok && ups_ok) {
         // Green: All good
-        set_led_green();
+        led_status_set_base(LED_BASE_OK);
     } else if (!wifi_ok && !ups_ok) {
         // Red: All fucked up
-        set_led_red();
+        led_status_set_base(LED_BASE_FAULT);
     } else {
         // Yellow: Something wrong (one of them is not OK)
-        set_led_yellow();
+        led_status_set_base(LED_BASE_DEGRADED);
     }
 }
 
-static void update_led_with_pulse(void)
+// Scheduler job, armed on every new IP address: the NUT server and the
+// webserver start on the first one and keep running across reconnects
+static scheduler_job_t net_start_job;
+
+static void net_services_start(void *arg)
 {
-    uint32_t current_time = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    
-    // Check if we should show a white pulse
-    if (!pulse_in_progress && 
-        last_field_update_time > last_pulse_time && 
-        (current_time - last_pulse_time) >= PULSE_INTERVAL_MS) {
-        
-        // Start white pulse
-        pulse_in_progress = true;
-        last_pulse_time = current_time;
-        set_led_white();
-        
-        // Schedule return to base color after pulse duration
-        esp_timer_handle_t pulse_timer;
-        esp_timer_create_args_t timer_args = {
-            .callback = pulse_timer_callback,
-            .arg = NULL,
-            .name = "pulse_timer"
-        };
-        esp_timer_create(&timer_args, &pulse_timer);
-        esp_timer_start_once(pulse_timer, PULSE_DURATION_MS * 1000);  // Convert to microseconds
-        esp_timer_delete(pulse_timer);
-        
+    static bool started = false;
+    if (started) {
         return;
     }
-    
-    // If no pulse needed, show base status
-    if (!pulse_in_progress) {
-        update_led_status();
+    started = true;
+
+    supervisor_register(SUPERVISOR_NUT, "nut", CONFIG_UPS_SUPERVISOR_NUT_TIMEOUT_S * 1000, NULL, nut_server_restart);
+    nut_server_start();
+    // A failed start is retried by the supervisor
+    esp_err_t ret = webserver_start();
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "Failed to start webserver: %s", esp_err_to_name(ret));
     }
+    boot_timing_mark(BOOT_PHASE_NET_SERVICES);
 }
 
 // WiFi event handler
@@ -1497,8 +1056,11 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
         ESP_LOGI(TAG, "WiFi station started, attempting to connect...");
         esp_wifi_connect();
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
+        if (wifi_connected) {
+            soe_record(SOE_WIFI_DOWN, 0);
+        }
         wifi_connected = false;
-        update_led_with_pulse();  // Update LED when WiFi disconnects
+        update_led_status();  // Update LED when WiFi disconnects
         if (wifi_retry_count < WIFI_MAXIMUM_RETRY) {
             ESP_LOGI(TAG, "WiFi disconnected, retrying... (attempt %d/%d)", 
                      wifi_retry_count + 1, WIFI_MAXIMUM_RETRY);
@@ -1511,10 +1073,13 @@ static void wifi_event_handler(void* arg, esp_event_base_t event_base,
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
         ESP_LOGI(TAG, "WiFi connected! IP: " IPSTR, IP2STR(&event->ip_info.ip));
+        soe_record(SOE_WIFI_UP, event->ip_info.ip.addr);
         wifi_connected = true;
         wifi_retry_count = 0;
         xEventGroupSetBits(wifi_event_group, WIFI_CONNECTED_BIT);
-        update_led_with_pulse();  // Update LED when WiFi connects
+        update_led_status();  // Update LED when WiFi connects
+        boot_timing_mark(BOOT_PHASE_WIFI_UP);
+        scheduler_arm(&net_start_job, 0);
     }
 }
 
@@ -1555,7 +1120,7 @@ static esp_err_t wifi_init(void)
     // Load WiFi credentials from NVS or use hardcoded fallback
     char ssid[32] = {0};
     char password[64] = {0};
-    esp_err_t nvs_err = load_wifi_credentials_from_nvs(ssid, password, sizeof(ssid));
+    esp_err_t nvs_err = load_wifi_credentials_from_nvs(ssid, sizeof(ssid), password, sizeof(password));
     if (nvs_err == ESP_OK) {
         ESP_LOGI(TAG, "Using WiFi credentials from NVS");
     } else {
@@ -1586,6 +1151,9 @@ static esp_err_t wifi_init(void)
     
     // Start WiFi
     ESP_ERROR_CHECK(esp_wifi_start());
+    // Driver and lwIP tasks exist now
+    heap_monitor_tag_task(xTaskGetHandle("wifi"), HEAP_TAG_WIFI);
+    heap_monitor_tag_task(xTaskGetHandle("tiT"), HEAP_TAG_WIFI);
     
     ESP_LOGI(TAG, "WiFi initialization complete");
     return ESP_OK;
@@ -1597,7 +1165,7 @@ static esp_err_t wifi_connect_with_timeout(int timeout_ms)
     // Load current WiFi credentials for logging
     char ssid[32] = {0};
     char password[64] = {0};
-    esp_err_t nvs_err = load_wifi_credentials_from_nvs(ssid, password, sizeof(ssid));
+    esp_err_t nvs_err = load_wifi_credentials_from_nvs(ssid, sizeof(ssid), password, sizeof(password));
     if (nvs_err == ESP_OK) {
         ESP_LOGI(TAG, "Connecting to WiFi: %s (from NVS)", ssid);
     } else {
@@ -1618,6 +1186,9 @@ static esp_err_t wifi_connect_with_timeout(int timeout_ms)
         return ESP_OK;
     }
     
+    // Outcome bits of an earlier attempt would end the wait below at once
+    xEventGroupClearBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT);
+
     // Attempt connection with proper error handling
     esp_err_t ret = esp_wifi_connect();
     if (ret != ESP_OK) {
@@ -1661,6 +1232,9 @@ static esp_err_t wifi_connect_with_timeout(int timeout_ms)
 // WiFi reconnection task (runs in background)
 static void wifi_reconnect_task(void *pvParameters)
 {
+    // The first association is driven by the event handler (STA_START and its
+    // retries); take over once it has connected or given up
+    xEventGroupWaitBits(wifi_event_group, WIFI_CONNECTED_BIT | WIFI_FAIL_BIT, pdFALSE, pdFALSE, portMAX_DELAY);
     while (1) {
         if (!wifi_connected) {
             ESP_LOGI(TAG, "WiFi disconnected, attempting reconnection...");
@@ -1670,7 +1244,8 @@ static void wifi_reconnect_task(void *pvParameters)
     }
 }
 
-// Public WiFi connection function
+// Public WiFi connection function. Returns once the driver is started; the
+// connection completes in the background and brings up the network services.
 void connect_to_wifi(void)
 {
     ESP_LOGI(TAG, "Starting WiFi connection...");
@@ -1681,38 +1256,16 @@ void connect_to_wifi(void)
         ESP_LOGE(TAG, "WiFi initialization failed: %s", esp_err_to_name(ret));
         return;
     }
-    
-    // Connect to WiFi with retry logic
-    int retry_count = 0;
-    const int max_retries = 3;
-    
-    while (retry_count < max_retries) {
-        ret = wifi_connect_with_timeout(15000); // 15 second timeout
-        if (ret == ESP_OK) {
-            break;
-        }
-        
-        retry_count++;
-        ESP_LOGW(TAG, "WiFi connection attempt %d failed: %s", retry_count, esp_err_to_name(ret));
-        
-        if (retry_count < max_retries) {
-            ESP_LOGI(TAG, "Retrying WiFi connection in 5 seconds...");
-            vTaskDelay(pdMS_TO_TICKS(5000));
-        }
-    }
-    
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "WiFi connection failed after %d attempts", max_retries);
-        return;
-    }
+    boot_timing_mark(BOOT_PHASE_WIFI_STARTED);
     
     // Start reconnection task
-    xTaskCreate(wifi_reconnect_task, "wifi_reconnect", 4096, NULL, 5, NULL);
+    xTaskCreatePinnedToCore(wifi_reconnect_task, "wifi_reconnect", CONFIG_UPS_STACK_WIFI_RECONNECT, NULL,
+                            TASK_PRIO_WIFI_RECONNECT, NULL, TASK_CORE_NET);
     
-    ESP_LOGI(TAG, "WiFi connection established and monitoring started");
+    ESP_LOGI(TAG, "WiFi connecting in the background");
     
     // Initial LED status update
-    update_led_with_pulse();
+    update_led_status();
 }
 
 // Forward declaration for resilience logic
@@ -1778,96 +1331,65 @@ static void log_scanner_task(void *arg) {
 }
 #endif // ENABLE_LOG_MONITOR
 
-#define HEAP_CRITICAL_THRESHOLD (16 * 1024) // 16 KB
-#define SELF_HTTP_CHECK_INTERVAL_MS 10000
-#define SELF_HTTP_CHECK_FAIL_LIMIT 3
-#define SELF_HTTP_CHECK_TIMEOUT_MS 2000
+#define HEAP_CRITICAL_CHECKS 3     // Consecutive checks below the block floor before restarting
 
-// --- Periodic Heap Check Task ---
-static void heap_check_task(void *pvParameters) {
-    const char *TAG = "heap-check";
-    while (1) {
-        size_t free_heap = esp_get_free_heap_size();
-        ESP_LOGI(TAG, "Heap check: %u bytes free", (unsigned)free_heap);
-        if (free_heap < HEAP_CRITICAL_THRESHOLD) {
-            ESP_LOGE(TAG, "Free heap critically low (%u bytes), rebooting!", (unsigned)free_heap);
-            vTaskDelay(pdMS_TO_TICKS(100));
-            esp_restart();
-        }
-        vTaskDelay(pdMS_TO_TICKS(10000)); // Check every 10s
-    }
-}
+#define HEAP_CHECK_PERIOD_MS 10000
 
-// --- Self-HTTP Health Check Task ---
-static void self_http_check_task(void *pvParameters) {
-    const char *TAG = "self-http-check";
-    int fail_count = 0;
-    int check_count = 0;
-    char url[64];
-    snprintf(url, sizeof(url), "http://127.0.0.1/api/wifi_status");
-    while (1) {
-        check_count++;
-        esp_http_client_config_t config = {
-            .url = url,
-            .timeout_ms = SELF_HTTP_CHECK_TIMEOUT_MS,
-            .disable_auto_redirect = true,
-            .method = HTTP_METHOD_GET,
-            .buffer_size = 256,
-            .buffer_size_tx = 256,
-            .is_async = false,
-            .keep_alive_enable = false,
-        };
-        esp_http_client_handle_t client = esp_http_client_init(&config);
-        if (client) {
-            esp_http_client_set_header(client, "Connection", "close");
-            esp_err_t err = esp_http_client_perform(client);
-            int status = esp_http_client_get_status_code(client);
-            if (err == ESP_OK && status == 200) {
-                ESP_LOGI(TAG, "Self-HTTP check #%d: SUCCESS (status=%d)", check_count, status);
-                fail_count = 0;
-            } else {
-                fail_count++;
-                ESP_LOGW(TAG, "Self-HTTP check #%d: FAIL (status=%d, err=%s, fail_count=%d/%d)", check_count, status, esp_err_to_name(err), fail_count, SELF_HTTP_CHECK_FAIL_LIMIT);
-                if (fail_count >= SELF_HTTP_CHECK_FAIL_LIMIT) {
-                    ESP_LOGE(TAG, "3 consecutive failures, restarting webserver");
-                    webserver_restart();
-                    fail_count = 0;
-                }
-            }
-            esp_http_client_cleanup(client);
-        } else {
-            ESP_LOGE(TAG, "Self-HTTP check #%d: Failed to init HTTP client", check_count);
-            fail_count++;
-        }
-        vTaskDelay(pdMS_TO_TICKS(SELF_HTTP_CHECK_INTERVAL_MS));
+// --- Periodic Heap Check (scheduler job) ---
+static void heap_check_job(void *arg) {
+    const char *TAG = "heap-check";
+    static int critical_checks = 0;
+    heap_region_stats_t heap;
+    heap_monitor_region(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, &heap);
+    ESP_LOGI(TAG, "Heap check: %u of %u bytes free, largest block %u (%u%% fragmented)",
+             (unsigned)heap.free, (unsigned)heap.total, (unsigned)heap.largest_free_block,
+             (unsigned)heap.fragmentation_pct);
+    // A short dip is usually one large transient allocation; fragmentation persists
+    critical_checks = heap.largest_free_block < CONFIG_UPS_HEAP_CRITICAL_BLOCK ? critical_checks + 1 : 0;
+    if (critical_checks >= HEAP_CRITICAL_CHECKS) {
+        ESP_LOGE(TAG, "Largest free block below %d bytes for %d checks (%u bytes free), rebooting!",
+                 CONFIG_UPS_HEAP_CRITICAL_BLOCK, HEAP_CRITICAL_CHECKS, (unsigned)heap.free);
+        soe_record(SOE_RESTART_REQUEST, SOE_RESTART_HEAP_LOW);
+        vTaskDelay(pdMS_TO_TICKS(100));
+        esp_restart();
     }
 }
 
 void app_main(void)
 {
+#if CONFIG_UPS_DLOG_ENABLE
+    // Hot-path logs are queued from here on and formatted by the drain task
+    dlog_init();
+#endif
+    // Recover (or format) the sequence-of-events journal before anything records into it
+    soe_init();
+    // After a warm reset NUT serves the last UPS values until the UPS reports again
+    ups_monitor_init();
+    heap_monitor_init();
+    live_stream_init();
+    ups_monitor_set_listener(on_ups_event);
+
     ESP_ERROR_CHECK(nvs_flash_init());
+    // Settings and counters are read from RAM from here on
+    ESP_ERROR_CHECK(persist_init());
+    // DFS and light sleep; on failure it logs and the chip stays at full clock
+    power_mgmt_init();
+    energy_meter_init();
+    battery_health_init();
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
     
-    // Configure BOOT button (GPIO 0) for continuous monitoring
-    gpio_config_t io_conf = {
-        .pin_bit_mask = (1ULL << GPIO_NUM_0),
-        .mode = GPIO_MODE_INPUT,
-        .pull_up_en = GPIO_PULLUP_ENABLE,
-        .pull_down_en = GPIO_PULLDOWN_DISABLE,
-        .intr_type = GPIO_INTR_DISABLE,
-    };
-    gpio_config(&io_conf);
-    
-    ESP_LOGI(TAG, "BOOT button configured for continuous monitoring");
+    // Periodic jobs run on one scheduler task; jobs registered later join it
+    scheduler_start();
+    led_status_init(RGB_LED_PIN);
+    button_init();
+    // UPS detection timeout, armed when a device enumerates
+    scheduler_add(&ups_detect_job, "ups_detect", 0, ups_detect_timeout, NULL);
+    boot_timing_mark(BOOT_PHASE_CORE_INIT);
     
-    //init_json_object();
     //ESP_ERROR_CHECK(init_generic_ups_models());
     //connect_to_wifi();
-    connect_to_wifi();
     
-    // Start button monitoring task
-    xTaskCreate(button_monitor_task, "button_monitor", 3072, NULL, 5, NULL);
     //SemaphoreHandle_t server_ready = xSemaphoreCreateBinary();
     //assert(server_ready);
     //xTaskCreate(tcp_server_task, "tcp_server", 4096, &server_ready, 5, NULL);
@@ -1894,44 +1416,41 @@ void app_main(void)
     //ESP_ERROR_CHECK(gptimer_enable(gptimer));
     //ESP_ERROR_CHECK(gptimer_start(gptimer));
     BaseType_t task_created;
+    TaskHandle_t usb_task = NULL;
     task_created = xTaskCreatePinnedToCore(usb_lib_task,
                                            "usb_events",
-                                           4096,
+                                           CONFIG_UPS_STACK_USB_EVENTS,
                                            xTaskGetCurrentTaskHandle(),
-                                           2, NULL, 0);
+                                           TASK_PRIO_USB_EVENTS, &usb_task, TASK_CORE_USB);
     assert(task_created == pdTRUE);
+    heap_monitor_tag_task(usb_task, HEAP_TAG_USB);
     ulTaskNotifyTake(false, 1000);
     const hid_host_driver_config_t hid_host_driver_config = {
         .create_background_task = true,
-        .task_priority = 5,
+        .task_priority = TASK_PRIO_HID_DRIVER,
         .stack_size = 4096,
-        .core_id = 0,
+        .core_id = TASK_CORE_USB,
         .callback = hid_host_device_callback,
         .callback_arg = NULL};
     ESP_ERROR_CHECK(hid_host_install(&hid_host_driver_config));
     user_shutdown = false;
-    task_created = xTaskCreate(&hid_host_task, "hid_task", 4 * 1024, NULL, 2, NULL);
-    configure_led();
-    task_created = xTaskCreate(&timer_task, "timer_task", 4 * 1024, NULL, 8, NULL);
-    assert(task_created == pdTRUE);
-    // Start TCP server for NUT protocol
-    task_created = xTaskCreate(&tcp_server_task, "tcp_server", 4096, NULL, 5, &tcp_server_task_handle);
-    assert(task_created == pdTRUE);
+    task_created = xTaskCreatePinnedToCore(&hid_host_task, "hid_task", CONFIG_UPS_STACK_HID_TASK, NULL,
+                                           TASK_PRIO_HID_EVENTS, &usb_task, TASK_CORE_HID_EVENTS);
+    heap_monitor_tag_task(usb_task, HEAP_TAG_USB);
+    // The UPS is monitored from here on, whether or not Wi-Fi ever connects
+    boot_timing_mark(BOOT_PHASE_USB_HOST);
     
-    // Start UPS freshness timer task
-    task_created = xTaskCreate(ups_freshness_timer_task, "ups_timer", 3072, NULL, 3, NULL);
-    assert(task_created == pdTRUE);
+    // UPS data freshness and heap checks
+    static scheduler_job_t ups_freshness_job_entry, heap_check_job_entry;
+    scheduler_add(&ups_freshness_job_entry, "ups_freshness", UPS_MONITOR_CHECK_PERIOD_MS, ups_freshness_job, NULL);
+    scheduler_add(&heap_check_job_entry, "heap_check", HEAP_CHECK_PERIOD_MS, heap_check_job, NULL);
     
-    // Start webserver
-    esp_err_t ret = webserver_start();
-    if (ret != ESP_OK) {
-        ESP_LOGE(TAG, "Failed to start webserver: %s", esp_err_to_name(ret));
-    }
+    // NUT server and webserver start on the first IP address (net_services_start)
+    scheduler_add(&net_start_job, "net_start", 0, net_services_start, NULL);
+    connect_to_wifi();
     
-    // Start heap check task
-    xTaskCreate(heap_check_task, "heap_check", 4096, NULL, 2, NULL);
-    // Start self-HTTP health check task
-    xTaskCreate(self_http_check_task, "self_http_check", 3072, NULL, 2, NULL);
+    // The servers register as they start; the supervisor picks them up then
+    supervisor_start();
 }
 
 //static const char *TAG = "wifi";
@@ -2012,128 +1531,130 @@ static void __attribute__((unused)) debug_unknown_ups_model(hid_host_device_hand
 }
 
 // Load WiFi credentials from NVS
-static esp_err_t load_wifi_credentials_from_nvs(char* ssid, char* password, size_t max_len)
+static esp_err_t load_wifi_credentials_from_nvs(char* ssid, size_t ssid_len, char* password, size_t pass_len)
 {
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(WIFI_NVS_NAMESPACE, NVS_READONLY, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGW(TAG, "Could not open NVS handle for WiFi config: %s", esp_err_to_name(err));
-        return err;
-    }
-    
-    size_t ssid_len = max_len;
-    size_t pass_len = max_len;
-    
-    err = nvs_get_str(nvs_handle, WIFI_SSID_KEY, ssid, &ssid_len);
+    esp_err_t err = persist_get_str(PERSIST_WIFI_SSID, ssid, ssid_len);
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "Could not read SSID from NVS: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
         return err;
     }
     
-    err = nvs_get_str(nvs_handle, WIFI_PASS_KEY, password, &pass_len);
+    err = persist_get_str(PERSIST_WIFI_PASSWORD, password, pass_len);
     if (err != ESP_OK) {
         ESP_LOGW(TAG, "Could not read password from NVS: %s", esp_err_to_name(err));
-        nvs_close(nvs_handle);
         return err;
     }
     
-    nvs_close(nvs_handle);
     ESP_LOGI(TAG, "Loaded WiFi credentials from NVS: SSID=%s", ssid);
     return ESP_OK;
 }
 
-// Button monitoring task for WiFi reset
-static void button_monitor_task(void* pvParameters)
+// BOOT button: the edge interrupt runs the button job, which polls every
+// BUTTON_POLL_MS while the button is held
+#define BUTTON_HOLD_TIME_MS 5000    // 5 seconds
+#define BUTTON_POLL_MS      100
+
+static scheduler_job_t button_job;
+static scheduler_job_t wifi_reset_reboot_job;
+
+static void IRAM_ATTR button_isr(void *arg)
 {
-    const int BUTTON_HOLD_TIME_MS = 5000;  // 5 seconds
-    const int CHECK_INTERVAL_MS = 100;     // Check every 100ms
-    
-    TickType_t button_press_start = 0;
-    bool button_was_pressed = false;
-    bool reset_triggered = false;
-    
-    ESP_LOGI(TAG, "Button monitoring task started");
+    scheduler_trigger_from_isr(&button_job);
+}
+
+static void wifi_reset_reboot(void *arg)
+{
+    soe_record(SOE_RESTART_REQUEST, SOE_RESTART_WIFI_RESET);
+    esp_restart();
+}
+
+// Scheduler job: BOOT button held for 5 s clears the Wi-Fi credentials
+static void button_check(void *arg)
+{
+    static TickType_t button_press_start = 0;
+    static bool button_was_pressed = false;
+    static bool reset_triggered = false;
+
+    // Check if BOOT button is pressed (LOW = pressed due to pullup)
+    bool button_pressed = (gpio_get_level(GPIO_NUM_0) == 0);
     
-    while (1) {
-        // Check if BOOT button is pressed (LOW = pressed due to pullup)
-        bool button_pressed = (gpio_get_level(GPIO_NUM_0) == 0);
+    if (button_pressed && !button_was_pressed) {
+        // Button just pressed - start timing
+        button_press_start = xTaskGetTickCount();
+        button_was_pressed = true;
+        ESP_LOGI(TAG, "BOOT button pressed - start monitoring hold time");
+    }
+    else if (button_pressed && button_was_pressed && !reset_triggered) {
+        // Button still held - check if we've reached the hold time
+        TickType_t current_time = xTaskGetTickCount();
+        TickType_t hold_duration = (current_time - button_press_start) * portTICK_PERIOD_MS;
         
-        if (button_pressed && !button_was_pressed) {
-            // Button just pressed - start timing
-            button_press_start = xTaskGetTickCount();
-            button_was_pressed = true;
-            ESP_LOGI(TAG, "BOOT button pressed - start monitoring hold time");
-        }
-        else if (button_pressed && button_was_pressed && !reset_triggered) {
-            // Button still held - check if we've reached the hold time
-            TickType_t current_time = xTaskGetTickCount();
-            TickType_t hold_duration = (current_time - button_press_start) * portTICK_PERIOD_MS;
+        if (hold_duration >= BUTTON_HOLD_TIME_MS) {
+            // Button held for 5+ seconds - trigger reset
+            reset_triggered = true;
+            ESP_LOGI(TAG, "BOOT button held for 5 seconds - clearing WiFi credentials and rebooting");
             
-            if (hold_duration >= BUTTON_HOLD_TIME_MS) {
-                // Button held for 5+ seconds - trigger reset
-                reset_triggered = true;
-                ESP_LOGI(TAG, "BOOT button held for 5 seconds - clearing WiFi credentials and rebooting");
-                
-                // Turn LED blue to indicate it's safe to release button
-                set_led_blue();
-                
-                // Clear WiFi credentials from NVS
-                nvs_handle_t nvs_handle;
-                esp_err_t err = nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-                if (err == ESP_OK) {
-                    nvs_erase_key(nvs_handle, WIFI_SSID_KEY);
-                    nvs_erase_key(nvs_handle, WIFI_PASS_KEY);
-                    nvs_commit(nvs_handle);
-                    nvs_close(nvs_handle);
-                    ESP_LOGI(TAG, "WiFi credentials cleared from NVS");
-                } else {
-                    ESP_LOGW(TAG, "Failed to clear WiFi credentials: %s", esp_err_to_name(err));
-                }
-                
-                // Wait 2 seconds with blue LED to give user time to release button
-                vTaskDelay(pdMS_TO_TICKS(2000));
-                
-                // Reboot
-                esp_restart();
-            }
-            else if (hold_duration >= 1000) {
-                // Flash purple LED after 1 second to show button is being monitored
-                static TickType_t last_flash = 0;
-                TickType_t current_flash = xTaskGetTickCount();
-                if ((current_flash - last_flash) * portTICK_PERIOD_MS >= 500) {
-                    set_led_purple();
-                    last_flash = current_flash;
-                }
+            // Turn LED blue to indicate it's safe to release button
+            led_status_set_overlay(LED_OVERLAY_WIFI_RESET);
+            
+            // Clear WiFi credentials from NVS
+            persist_erase(PERSIST_WIFI_SSID);
+            persist_erase(PERSIST_WIFI_PASSWORD);
+            esp_err_t err = persist_flush();
+            if (err == ESP_OK) {
+                ESP_LOGI(TAG, "WiFi credentials cleared from NVS");
+            } else {
+                ESP_LOGW(TAG, "Failed to clear WiFi credentials: %s", esp_err_to_name(err));
             }
+            
+            // Reboot in 2 seconds; the blue LED gives the user time to release the button
+            scheduler_arm(&wifi_reset_reboot_job, 2000);
         }
-        else if (!button_pressed && button_was_pressed) {
-            // Button released - reset state
-            button_was_pressed = false;
-            reset_triggered = false;
-            ESP_LOGI(TAG, "BOOT button released");
+        else if (hold_duration >= 1000) {
+            // Flash purple LED after 1 second to show button is being monitored
+            led_status_set_overlay(LED_OVERLAY_BUTTON_HELD);
         }
-        
-        vTaskDelay(pdMS_TO_TICKS(CHECK_INTERVAL_MS));
+    }
+    else if (!button_pressed && button_was_pressed) {
+        // Button released - reset state (a pending reset keeps the LED blue)
+        if (!reset_triggered) {
+            led_status_set_overlay(LED_OVERLAY_NONE);
+        }
+        button_was_pressed = false;
+        reset_triggered = false;
+        ESP_LOGI(TAG, "BOOT button released");
+    }
+    
+    if (button_pressed && !reset_triggered) {
+        scheduler_arm(&button_job, BUTTON_POLL_MS);
+    } else {
+        scheduler_cancel(&button_job);
     }
 }
 
-// Getter for UPS state
-ups_connection_state_t get_ups_state(void) {
-    return ups_state;
-}
-// Getter for last UPS data time
-unsigned int get_ups_last_data_time(void) {
-    return ups_last_data_time;
-}
+static void button_init(void)
+{
+    scheduler_add(&button_job, "button", 0, button_check, NULL);
+    scheduler_add(&wifi_reset_reboot_job, "wifi_reset", 0, wifi_reset_reboot, NULL);
 
-// Getter for STALE duration in ms
-uint32_t get_ups_stale_duration_ms(void) {
-    if (ups_state != UPS_CONNECTED_STALE) {
-        return 0;  // Not stale
+    // BOOT button (GPIO 0), interrupt on both edges
+    gpio_config_t io_conf = {
+        .pin_bit_mask = (1ULL << GPIO_NUM_0),
+        .mode = GPIO_MODE_INPUT,
+        .pull_up_en = GPIO_PULLUP_ENABLE,
+        .pull_down_en = GPIO_PULLDOWN_DISABLE,
+        .intr_type = GPIO_INTR_ANYEDGE,
+    };
+    gpio_config(&io_conf);
+    esp_err_t err = gpio_install_isr_service(0);
+    if (err != ESP_OK && err != ESP_ERR_INVALID_STATE) {     // Already installed is fine
+        ESP_LOGE(TAG, "GPIO ISR service failed: %s", esp_err_to_name(err));
+        return;
     }
-    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    return now - ups_stale_start_time;
+    gpio_isr_handler_add(GPIO_NUM_0, button_isr, NULL);
+    // Pick up a button already held at boot
+    scheduler_arm(&button_job, 0);
+    ESP_LOGI(TAG, "BOOT button configured (edge interrupt)");
 }
 
 // Function prototypes for resilience logic
@@ -0,0 +1,335 @@
+#include "heap_monitor.h"
+#include <string.h>
+#include "esp_heap_caps.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "heap";
+
+#define HEAP_TASK_SLOTS     12
+#define HEAP_BLOCK_SLOTS    512             // Power of two
+#define HEAP_BLOCK_MAX_FILL (HEAP_BLOCK_SLOTS * 3 / 4)
+#define HEAP_TAG_BITS       3
+
+#if CONFIG_UPS_HEAP_ACCOUNTING
+#define HEAP_ACCOUNTING 1
+#else
+#define HEAP_ACCOUNTING 0
+#endif
+
+typedef struct {
+    TaskHandle_t task;
+    heap_tag_t tag;
+} heap_task_tag_t;
+
+// Live allocation of a tagged task; size and tag packed as size << HEAP_TAG_BITS | tag
+typedef struct {
+    uintptr_t ptr;              // 0 = empty
+    uint32_t size_tag;
+} heap_block_t;
+
+static portMUX_TYPE acct_lock = portMUX_INITIALIZER_UNLOCKED;
+static heap_task_tag_t task_tags[HEAP_TASK_SLOTS];
+static size_t task_tag_count = 0;
+static heap_tag_stats_t tag_stats[HEAP_TAG_COUNT];
+static uint32_t alloc_failures = 0;
+static uint32_t last_failed_size = 0;
+
+#if HEAP_ACCOUNTING
+static heap_block_t blocks[HEAP_BLOCK_SLOTS];
+static uint32_t block_count = 0;
+static uint32_t untracked = 0;          // Table full; the block is not attributed
+#endif
+
+static const char *const tag_names[HEAP_TAG_COUNT] = {
+    [HEAP_TAG_OTHER] = "other",
+    [HEAP_TAG_NUT]   = "nut",
+    [HEAP_TAG_HTTPD] = "httpd",
+    [HEAP_TAG_JSON]  = "json",
+    [HEAP_TAG_USB]   = "usb",
+    [HEAP_TAG_WIFI]  = "wifi",
+};
+
+// Caller holds acct_lock
+static IRAM_ATTR heap_task_tag_t *find_task(TaskHandle_t task)
+{
+    for (size_t i = 0; i < task_tag_count; i++) {
+        if (task_tags[i].task == task) {
+            return &task_tags[i];
+        }
+    }
+    return NULL;
+}
+
+static IRAM_ATTR heap_tag_t current_tag(void)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    if (!task) {
+        return HEAP_TAG_OTHER;
+    }
+    heap_task_tag_t *entry = find_task(task);
+    return entry ? entry->tag : HEAP_TAG_OTHER;
+}
+
+static void set_task_tag(TaskHandle_t task, heap_tag_t tag)
+{
+    heap_task_tag_t *entry = find_task(task);
+    if (tag == HEAP_TAG_OTHER) {
+        if (entry) {
+            *entry = task_tags[--task_tag_count];
+        }
+    } else if (entry) {
+        entry->tag = tag;
+    } else if (task_tag_count < HEAP_TASK_SLOTS) {
+        task_tags[task_tag_count++] = (heap_task_tag_t){ .task = task, .tag = tag };
+    }
+}
+
+#if HEAP_ACCOUNTING
+static inline IRAM_ATTR uint32_t block_slot(uintptr_t ptr)
+{
+    return ((uint32_t)(ptr >> 3) * 2654435761u) & (HEAP_BLOCK_SLOTS - 1);
+}
+
+// Linear probing; deletion shifts the following run back so lookups never
+// need tombstones. Caller holds acct_lock.
+static IRAM_ATTR bool block_insert(uintptr_t ptr, uint32_t size_tag)
+{
+    if (block_count >= HEAP_BLOCK_MAX_FILL) {
+        return false;
+    }
+    uint32_t i = block_slot(ptr);
+    while (blocks[i].ptr != 0) {
+        i = (i + 1) & (HEAP_BLOCK_SLOTS - 1);
+    }
+    blocks[i].ptr = ptr;
+    blocks[i].size_tag = size_tag;
+    block_count++;
+    return true;
+}
+
+static IRAM_ATTR bool block_remove(uintptr_t ptr, uint32_t *size_tag)
+{
+    uint32_t i = block_slot(ptr);
+    while (blocks[i].ptr != ptr) {
+        if (blocks[i].ptr == 0) {
+            return false;
+        }
+        i = (i + 1) & (HEAP_BLOCK_SLOTS - 1);
+    }
+    *size_tag = blocks[i].size_tag;
+    uint32_t hole = i;
+    for (;;) {
+        i = (i + 1) & (HEAP_BLOCK_SLOTS - 1);
+        if (blocks[i].ptr == 0) {
+            break;
+        }
+        // Move the entry into the hole unless its home slot lies cyclically in (hole, i]
+        uint32_t home = block_slot(blocks[i].ptr);
+        if (((i - home) & (HEAP_BLOCK_SLOTS - 1)) >= ((i - hole) & (HEAP_BLOCK_SLOTS - 1))) {
+            blocks[hole] = blocks[i];
+            hole = i;
+        }
+    }
+    blocks[hole].ptr = 0;
+    block_count--;
+    return true;
+}
+
+// IDF heap hooks, called after every allocation and before every free
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    if (!ptr || task_tag_count == 0) {
+        return;
+    }
+    portENTER_CRITICAL_SAFE(&acct_lock);
+    heap_tag_t tag = current_tag();
+    if (tag != HEAP_TAG_OTHER) {
+        heap_tag_stats_t *stats = &tag_stats[tag];
+        stats->allocs++;
+        if (block_insert((uintptr_t)ptr, (uint32_t)size << HEAP_TAG_BITS | tag)) {
+            stats->live_bytes += size;
+            stats->live_blocks++;
+            if (stats->live_bytes > stats->peak_bytes) {
+                stats->peak_bytes = stats->live_bytes;
+            }
+        } else {
+            untracked++;
+        }
+    }
+    portEXIT_CRITICAL_SAFE(&acct_lock);
+}
+
+void IRAM_ATTR esp_heap_trace_free_hook(void *ptr)
+{
+    if (!ptr || block_count == 0) {
+        return;
+    }
+    portENTER_CRITICAL_SAFE(&acct_lock);
+    uint32_t size_tag;
+    if (block_remove((uintptr_t)ptr, &size_tag)) {
+        heap_tag_stats_t *stats = &tag_stats[size_tag & ((1 << HEAP_TAG_BITS) - 1)];
+        stats->live_bytes -= size_tag >> HEAP_TAG_BITS;
+        stats->live_blocks--;
+    }
+    portEXIT_CRITICAL_SAFE(&acct_lock);
+}
+#endif // HEAP_ACCOUNTING
+
+static void alloc_failed(size_t size, uint32_t caps, const char *function_name)
+{
+    portENTER_CRITICAL_SAFE(&acct_lock);
+    tag_stats[current_tag()].failed++;
+    alloc_failures++;
+    last_failed_size = size;
+    portEXIT_CRITICAL_SAFE(&acct_lock);
+}
+
+void heap_monitor_init(void)
+{
+    heap_caps_register_failed_alloc_callback(alloc_failed);
+#if !HEAP_ACCOUNTING
+    ESP_LOGI(TAG, "Per-subsystem heap accounting disabled");
+#endif
+}
+
+void heap_monitor_tag_task(TaskHandle_t task, heap_tag_t tag)
+{
+    if (!task) {
+        return;
+    }
+    taskENTER_CRITICAL(&acct_lock);
+    set_task_tag(task, tag);
+    taskEXIT_CRITICAL(&acct_lock);
+}
+
+void heap_monitor_untag_task(TaskHandle_t task)
+{
+    heap_monitor_tag_task(task, HEAP_TAG_OTHER);
+}
+
+heap_tag_t heap_monitor_scope_begin(heap_tag_t tag)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    taskENTER_CRITICAL(&acct_lock);
+    heap_task_tag_t *entry = find_task(task);
+    heap_tag_t previous = entry ? entry->tag : HEAP_TAG_OTHER;
+    set_task_tag(task, tag);
+    taskEXIT_CRITICAL(&acct_lock);
+    return previous;
+}
+
+void heap_monitor_scope_end(heap_tag_t previous)
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    taskENTER_CRITICAL(&acct_lock);
+    set_task_tag(task, previous);
+    taskEXIT_CRITICAL(&acct_lock);
+}
+
+void heap_monitor_region(uint32_t caps, heap_region_stats_t *out)
+{
+    multi_heap_info_t info;
+    heap_caps_get_info(&info, caps);
+    out->total = heap_caps_get_total_size(caps);
+    out->free = info.total_free_bytes;
+    out->largest_free_block = info.largest_free_block;
+    out->minimum_free = info.minimum_free_bytes;
+    out->free_blocks = info.free_blocks;
+    out->fragmentation_pct = info.total_free_bytes ?
+        100 - (uint32_t)((uint64_t)info.largest_free_block * 100 / info.total_free_bytes) : 0;
+}
+
+void heap_monitor_get_tag_stats(heap_tag_t tag, heap_tag_stats_t *out)
+{
+    taskENTER_CRITICAL(&acct_lock);
+    *out = tag_stats[tag];
+    taskEXIT_CRITICAL(&acct_lock);
+}
+
+const char *heap_monitor_tag_name(heap_tag_t tag)
+{
+    return tag < HEAP_TAG_COUNT ? tag_names[tag] : "unknown";
+}
+
+bool heap_monitor_critical(uint32_t *largest_free_block)
+{
+    uint32_t largest = heap_caps_get_largest_free_block(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    if (largest_free_block) {
+        *largest_free_block = largest;
+    }
+    return largest < CONFIG_UPS_HEAP_CRITICAL_BLOCK;
+}
+
+static void write_region(json_writer_t *w, const char *name, uint32_t caps)
+{
+    heap_region_stats_t r;
+    heap_monitor_region(caps, &r);
+    if (r.total == 0) {
+        return;     // No such memory (PSRAM not fitted)
+    }
+    json_obj_begin(w, NULL);
+    json_str(w, "caps", name);
+    json_uint(w, "total", r.total);
+    json_uint(w, "free", r.free);
+    json_uint(w, "largest_free_block", r.largest_free_block);
+    json_uint(w, "minimum_free", r.minimum_free);
+    json_uint(w, "free_blocks", r.free_blocks);
+    json_uint(w, "fragmentation_pct", r.fragmentation_pct);
+    json_obj_end(w);
+}
+
+void heap_monitor_write_json(json_writer_t *w)
+{
+    json_obj_begin(w, NULL);
+    json_uint(w, "critical_block", CONFIG_UPS_HEAP_CRITICAL_BLOCK);
+    json_arr_begin(w, "regions");
+    write_region(w, "default", MALLOC_CAP_DEFAULT);
+    write_region(w, "internal", MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+    write_region(w, "dma", MALLOC_CAP_DMA);
+    write_region(w, "spiram", MALLOC_CAP_SPIRAM);
+    json_arr_end(w);
+
+    heap_tag_stats_t stats[HEAP_TAG_COUNT];
+    taskENTER_CRITICAL(&acct_lock);
+    memcpy(stats, tag_stats, sizeof(stats));
+    uint32_t failures = alloc_failures;
+    uint32_t failed_size = last_failed_size;
+#if HEAP_ACCOUNTING
+    uint32_t blocks_tracked = block_count;
+    uint32_t blocks_untracked = untracked;
+#endif
+    taskEXIT_CRITICAL(&acct_lock);
+
+    json_bool(w, "accounting", HEAP_ACCOUNTING);
+    json_uint(w, "alloc_failures", failures);
+    json_uint(w, "last_failed_size", failed_size);
+#if HEAP_ACCOUNTING
+    json_uint(w, "blocks_tracked", blocks_tracked);
+    json_uint(w, "blocks_untracked", blocks_untracked);
+    // Everything not held by a tagged subsystem
+    uint32_t tracked_bytes = 0;
+    for (int t = HEAP_TAG_OTHER + 1; t < HEAP_TAG_COUNT; t++) {
+        tracked_bytes += stats[t].live_bytes;
+    }
+    uint32_t allocated = heap_caps_get_total_size(MALLOC_CAP_DEFAULT) - heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+    stats[HEAP_TAG_OTHER].live_bytes = allocated > tracked_bytes ? allocated - tracked_bytes : 0;
+#endif
+
+    json_arr_begin(w, "subsystems");
+    for (int t = 0; t < HEAP_TAG_COUNT; t++) {
+        json_obj_begin(w, NULL);
+        json_str(w, "name", tag_names[t]);
+        json_uint(w, "live_bytes", stats[t].live_bytes);
+        if (t != HEAP_TAG_OTHER) {
+            json_uint(w, "live_blocks", stats[t].live_blocks);
+            json_uint(w, "peak_bytes", stats[t].peak_bytes);
+            json_uint(w, "allocs", stats[t].allocs);
+        }
+        json_uint(w, "failed", stats[t].failed);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
@@ -0,0 +1,77 @@
+/*
+ * Heap Monitor
+ *
+ * Heap health per capability (real totals, largest free block, fragmentation)
+ * and live allocations per subsystem. Subsystems are tagged by task: the NUT
+ * server, httpd, the USB tasks and the Wi-Fi/lwIP tasks register their
+ * handles, and JSON rendering is tagged as a scope on the httpd task. The IDF
+ * heap hooks (CONFIG_HEAP_USE_HOOKS) record every allocation made by a tagged
+ * task in a fixed open-addressing table, so frees are attributed to the
+ * subsystem that made the allocation.
+ *
+ * The restart policy keys off the largest free internal block: a heap with
+ * plenty of free bytes in small fragments still fails the allocations Wi-Fi,
+ * lwIP and httpd need.
+ */
+
+#ifndef HEAP_MONITOR_H
+#define HEAP_MONITOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "json_writer.h"
+
+typedef enum {
+    HEAP_TAG_OTHER = 0,         // Untagged tasks; not tracked per block
+    HEAP_TAG_NUT,
+    HEAP_TAG_HTTPD,
+    HEAP_TAG_JSON,
+    HEAP_TAG_USB,
+    HEAP_TAG_WIFI,
+    HEAP_TAG_COUNT
+} heap_tag_t;
+
+typedef struct {
+    uint32_t total;                 // Real heap size for the capability
+    uint32_t free;
+    uint32_t largest_free_block;
+    uint32_t minimum_free;          // Low-water mark since boot
+    uint32_t free_blocks;
+    uint32_t fragmentation_pct;     // 100 - largest_free_block / free
+} heap_region_stats_t;
+
+typedef struct {
+    uint32_t live_bytes;
+    uint32_t live_blocks;
+    uint32_t peak_bytes;
+    uint32_t allocs;
+    uint32_t failed;                // Allocation failures on a task with this tag
+} heap_tag_stats_t;
+
+// Register the allocation-failure callback
+void heap_monitor_init(void);
+
+// Attribute a task's allocations to a subsystem; NULL is ignored.
+// Untag a task before deleting it, the handle may be reused.
+void heap_monitor_tag_task(TaskHandle_t task, heap_tag_t tag);
+void heap_monitor_untag_task(TaskHandle_t task);
+
+// Tag the current task's allocations until heap_monitor_scope_end(returned value)
+heap_tag_t heap_monitor_scope_begin(heap_tag_t tag);
+void heap_monitor_scope_end(heap_tag_t previous);
+
+// Stats for one capability set (MALLOC_CAP_*)
+void heap_monitor_region(uint32_t caps, heap_region_stats_t *out);
+
+void heap_monitor_get_tag_stats(heap_tag_t tag, heap_tag_stats_t *out);
+const char *heap_monitor_tag_name(heap_tag_t tag);
+
+// Largest free internal block is below CONFIG_UPS_HEAP_CRITICAL_BLOCK
+bool heap_monitor_critical(uint32_t *largest_free_block);
+
+// /api/heap: {"regions":[...],"subsystems":[...],...}
+void heap_monitor_write_json(json_writer_t *w);
+
+#endif // HEAP_MONITOR_H
@@ -0,0 +1,286 @@
+#include "json_writer.h"
+#include <string.h>
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static void flush_stage(json_writer_t *w)
+{
+    if (w->len > 0 && !w->failed && w->flush(w->ctx, w->buf, w->len) != ESP_OK) {
+        w->failed = true;
+    }
+    w->len = 0;
+}
+
+static void emit(json_writer_t *w, const char *data, size_t len)
+{
+    if (w->failed) {
+        return;
+    }
+    if (!w->flush) {
+        // Caller buffer: keep one byte for the terminator
+        size_t room = w->size - 1 - w->len;
+        if (len > room) {
+            len = room;
+            w->failed = true;
+        }
+        memcpy(w->buf + w->len, data, len);
+        w->len += len;
+        w->buf[w->len] = '\0';
+        return;
+    }
+    while (len > 0) {
+        size_t room = w->size - w->len;
+        size_t n = len < room ? len : room;
+        memcpy(w->buf + w->len, data, n);
+        w->len += n;
+        data += n;
+        len -= n;
+        if (w->len == w->size) {
+            flush_stage(w);
+            if (w->failed) {
+                return;
+            }
+        }
+    }
+}
+
+static void emit_char(json_writer_t *w, char c)
+{
+    emit(w, &c, 1);
+}
+
+static void emit_escaped(json_writer_t *w, const char *s, size_t len)
+{
+    emit_char(w, '"');
+    size_t run = 0;             // Bytes that need no escaping, emitted in one go
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)s[i];
+        char esc[6];
+        size_t esc_len = 0;
+        switch (c) {
+            case '"':  esc[0] = '\\'; esc[1] = '"';  esc_len = 2; break;
+            case '\\': esc[0] = '\\'; esc[1] = '\\'; esc_len = 2; break;
+            case '\n': esc[0] = '\\'; esc[1] = 'n';  esc_len = 2; break;
+            case '\r': esc[0] = '\\'; esc[1] = 'r';  esc_len = 2; break;
+            case '\t': esc[0] = '\\'; esc[1] = 't';  esc_len = 2; break;
+            case '\b': esc[0] = '\\'; esc[1] = 'b';  esc_len = 2; break;
+            case '\f': esc[0] = '\\'; esc[1] = 'f';  esc_len = 2; break;
+            default:
+                if (c < 0x20) {
+                    memcpy(esc, "\\u00", 4);
+                    esc[4] = hex_digits[c >> 4];
+                    esc[5] = hex_digits[c & 0xF];
+                    esc_len = 6;
+                }
+                break;
+        }
+        if (esc_len) {
+            emit(w, s + i - run, run);
+            emit(w, esc, esc_len);
+            run = 0;
+        } else {
+            run++;
+        }
+    }
+    emit(w, s + len - run, run);
+    emit_char(w, '"');
+}
+
+// Comma and key before a value
+static void begin_value(json_writer_t *w, const char *key)
+{
+    uint32_t bit = 1u << w->depth;
+    if (w->has_items & bit) {
+        emit_char(w, ',');
+    }
+    w->has_items |= bit;
+    if (key) {
+        emit_escaped(w, key, strlen(key));
+        emit_char(w, ':');
+    }
+}
+
+size_t json_format_uint(char *buf, uint64_t v)
+{
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = tmp[n - 1 - i];
+    }
+    buf[n] = '\0';
+    return n;
+}
+
+void json_writer_init_buffer(json_writer_t *w, char *buf, size_t size)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = buf;
+    w->size = size;
+    if (size == 0) {
+        w->failed = true;
+    } else {
+        buf[0] = '\0';
+    }
+}
+
+void json_writer_init_stream(json_writer_t *w, char *stage, size_t stage_size, json_flush_fn_t flush, void *ctx)
+{
+    memset(w, 0, sizeof(*w));
+    w->buf = stage;
+    w->size = stage_size;
+    if (stage_size == 0) {
+        w->failed = true;
+    }
+    w->flush = flush;
+    w->ctx = ctx;
+}
+
+esp_err_t json_writer_finish(json_writer_t *w)
+{
+    if (w->flush) {
+        flush_stage(w);
+    }
+    return (w->failed || w->depth != 0) ? ESP_FAIL : ESP_OK;
+}
+
+size_t json_writer_length(const json_writer_t *w)
+{
+    return w->flush ? 0 : w->len;
+}
+
+static void open_container(json_writer_t *w, const char *key, char c)
+{
+    begin_value(w, key);
+    emit_char(w, c);
+    if (w->depth + 1 >= JSON_WRITER_MAX_DEPTH) {
+        w->failed = true;
+        return;
+    }
+    w->depth++;
+    w->has_items &= ~(1u << w->depth);
+}
+
+static void close_container(json_writer_t *w, char c)
+{
+    if (w->depth == 0) {
+        w->failed = true;
+        return;
+    }
+    w->depth--;
+    emit_char(w, c);
+}
+
+void json_obj_begin(json_writer_t *w, const char *key)
+{
+    open_container(w, key, '{');
+}
+
+void json_obj_end(json_writer_t *w)
+{
+    close_container(w, '}');
+}
+
+void json_arr_begin(json_writer_t *w, const char *key)
+{
+    open_container(w, key, '[');
+}
+
+void json_arr_end(json_writer_t *w)
+{
+    close_container(w, ']');
+}
+
+void json_str(json_writer_t *w, const char *key, const char *value)
+{
+    if (!value) {
+        json_null(w, key);
+        return;
+    }
+    json_strn(w, key, value, strlen(value));
+}
+
+void json_strn(json_writer_t *w, const char *key, const char *value, size_t len)
+{
+    begin_value(w, key);
+    emit_escaped(w, value, len);
+}
+
+void json_uint(json_writer_t *w, const char *key, uint64_t value)
+{
+    char buf[21];
+    size_t n = json_format_uint(buf, value);
+    begin_value(w, key);
+    emit(w, buf, n);
+}
+
+void json_int(json_writer_t *w, const char *key, int64_t value)
+{
+    char buf[22];
+    size_t n = 0;
+    uint64_t magnitude = (uint64_t)value;
+    if (value < 0) {
+        buf[n++] = '-';
+        magnitude = 0 - magnitude;
+    }
+    n += json_format_uint(buf + n, magnitude);
+    begin_value(w, key);
+    emit(w, buf, n);
+}
+
+void json_fixed(json_writer_t *w, const char *key, int64_t value, unsigned decimals)
+{
+    if (decimals == 0) {
+        json_int(w, key, value);
+        return;
+    }
+    if (decimals > 9) {
+        decimals = 9;
+    }
+    uint64_t scale = 1;
+    for (unsigned i = 0; i < decimals; i++) {
+        scale *= 10;
+    }
+    uint64_t magnitude = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+
+    char buf[32];
+    size_t n = 0;
+    if (value < 0) {
+        buf[n++] = '-';
+    }
+    n += json_format_uint(buf + n, magnitude / scale);
+    buf[n++] = '.';
+    uint64_t frac = magnitude % scale;
+    for (unsigned i = decimals; i > 0; i--) {
+        buf[n + i - 1] = (char)('0' + frac % 10);
+        frac /= 10;
+    }
+    n += decimals;
+    begin_value(w, key);
+    emit(w, buf, n);
+}
+
+void json_bool(json_writer_t *w, const char *key, bool value)
+{
+    begin_value(w, key);
+    if (value) {
+        emit(w, "true", 4);
+    } else {
+        emit(w, "false", 5);
+    }
+}
+
+void json_null(json_writer_t *w, const char *key)
+{
+    begin_value(w, key);
+    emit(w, "null", 4);
+}
+
+void json_raw(json_writer_t *w, const char *key, const char *json, size_t len)
+{
+    begin_value(w, key);
+    emit(w, json, len);
+}
@@ -0,0 +1,82 @@
+/*
+ * JSON Writer
+ *
+ * Streaming JSON output without a document tree or heap. Values are appended
+ * as they are produced, either into a caller buffer or into a caller staging
+ * buffer that is flushed through a callback (chunked HTTP responses). Commas
+ * are inserted automatically, strings are escaped, and numbers are formatted
+ * without printf.
+ *
+ * Keys are passed with each value; use NULL inside arrays and for the top
+ * level value:
+ *
+ *   json_writer_t w;
+ *   json_writer_init_buffer(&w, buf, sizeof(buf));
+ *   json_obj_begin(&w, NULL);
+ *   json_str(&w, "ssid", ssid);
+ *   json_arr_begin(&w, "samples");
+ *   json_int(&w, NULL, -3);
+ *   json_arr_end(&w);
+ *   json_obj_end(&w);
+ *   if (json_writer_finish(&w) != ESP_OK) { ... truncated ... }
+ */
+
+#ifndef JSON_WRITER_H
+#define JSON_WRITER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#define JSON_WRITER_MAX_DEPTH  16
+
+// Receives staged output; return ESP_OK to continue
+typedef esp_err_t (*json_flush_fn_t)(void *ctx, const char *data, size_t len);
+
+typedef struct {
+    char *buf;
+    size_t size;
+    size_t len;
+    json_flush_fn_t flush;      // NULL = caller buffer mode
+    void *ctx;
+    uint8_t depth;
+    uint32_t has_items;         // Bit per depth: a value was already written at that level
+    bool failed;                // Buffer overflow, flush error or nesting error
+} json_writer_t;
+
+// Write into buf (always NUL-terminated). Overflow marks the writer failed.
+void json_writer_init_buffer(json_writer_t *w, char *buf, size_t size);
+
+// Collect output in stage and hand it to flush() whenever the stage fills up
+void json_writer_init_stream(json_writer_t *w, char *stage, size_t stage_size, json_flush_fn_t flush, void *ctx);
+
+// Flush what is staged. ESP_OK if every write fit / was accepted and all
+// containers were closed.
+esp_err_t json_writer_finish(json_writer_t *w);
+
+// Bytes written so far in buffer mode
+size_t json_writer_length(const json_writer_t *w);
+
+void json_obj_begin(json_writer_t *w, const char *key);
+void json_obj_end(json_writer_t *w);
+void json_arr_begin(json_writer_t *w, const char *key);
+void json_arr_end(json_writer_t *w);
+
+void json_str(json_writer_t *w, const char *key, const char *value);           // NULL writes null
+void json_strn(json_writer_t *w, const char *key, const char *value, size_t len);
+void json_int(json_writer_t *w, const char *key, int64_t value);
+void json_uint(json_writer_t *w, const char *key, uint64_t value);
+void json_bool(json_writer_t *w, const char *key, bool value);
+void json_null(json_writer_t *w, const char *key);
+
+// value / 10^decimals as a decimal number, e.g. (2305, 1) -> 230.5
+void json_fixed(json_writer_t *w, const char *key, int64_t value, unsigned decimals);
+
+// Already valid JSON text (e.g. a pre-rendered fragment)
+void json_raw(json_writer_t *w, const char *key, const char *json, size_t len);
+
+// Format v into buf (at least 21 bytes) without printf; returns the length
+size_t json_format_uint(char *buf, uint64_t v);
+
+#endif // JSON_WRITER_H
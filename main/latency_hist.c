@@ -0,0 +1,77 @@
+#include "latency_hist.h"
+
+static size_t bucket_index(uint32_t duration_us)
+{
+    uint32_t scaled = duration_us / LATENCY_HIST_MIN_US;
+    if (scaled == 0) {
+        return 0;
+    }
+    size_t i = 32 - __builtin_clz(scaled);
+    return i < LATENCY_HIST_BUCKETS ? i : LATENCY_HIST_BUCKETS - 1;
+}
+
+void latency_hist_record(latency_hist_t *hist, uint32_t duration_us, bool error)
+{
+    __atomic_add_fetch(&hist->buckets[bucket_index(duration_us)], 1, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&hist->count, 1, __ATOMIC_RELAXED);
+    if (error) {
+        __atomic_add_fetch(&hist->errors, 1, __ATOMIC_RELAXED);
+    }
+    uint32_t max = __atomic_load_n(&hist->max_us, __ATOMIC_RELAXED);
+    while (duration_us > max &&
+           !__atomic_compare_exchange_n(&hist->max_us, &max, duration_us, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+void latency_hist_snapshot(const latency_hist_t *hist, latency_hist_t *out)
+{
+    out->count = __atomic_load_n(&hist->count, __ATOMIC_RELAXED);
+    out->errors = __atomic_load_n(&hist->errors, __ATOMIC_RELAXED);
+    out->max_us = __atomic_load_n(&hist->max_us, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        out->buckets[i] = __atomic_load_n(&hist->buckets[i], __ATOMIC_RELAXED);
+    }
+}
+
+uint32_t latency_hist_bucket_bound_us(size_t bucket)
+{
+    return bucket < LATENCY_HIST_BUCKETS - 1 ? (uint32_t)LATENCY_HIST_MIN_US << bucket : 0;
+}
+
+uint32_t latency_hist_percentile_us(const latency_hist_t *snapshot, unsigned percentile)
+{
+    // Use the bucket sum rather than count: a concurrent record may have
+    // bumped one and not yet the other
+    uint64_t total = 0;
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        total += snapshot->buckets[i];
+    }
+    if (total == 0) {
+        return 0;
+    }
+    uint64_t rank = (total * percentile + 99) / 100;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        seen += snapshot->buckets[i];
+        if (seen >= rank && seen > 0) {
+            uint32_t bound = latency_hist_bucket_bound_us(i);
+            return (bound == 0 || bound > snapshot->max_us) ? snapshot->max_us : bound;
+        }
+    }
+    return snapshot->max_us;
+}
+
+void latency_hist_write_json(json_writer_t *w, const latency_hist_t *s)
+{
+    json_uint(w, "count", s->count);
+    json_uint(w, "errors", s->errors);
+    json_uint(w, "max_us", s->max_us);
+    json_uint(w, "p50_us", latency_hist_percentile_us(s, 50));
+    json_uint(w, "p90_us", latency_hist_percentile_us(s, 90));
+    json_uint(w, "p99_us", latency_hist_percentile_us(s, 99));
+    json_arr_begin(w, "buckets");
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        json_uint(w, NULL, s->buckets[i]);
+    }
+    json_arr_end(w);
+}
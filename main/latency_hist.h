@@ -0,0 +1,48 @@
+/*
+ * Latency Histogram
+ *
+ * Fixed log2-bucketed histogram of durations in microseconds. Recording is a
+ * handful of 32-bit atomic increments, so any task (or several) can record
+ * into the same histogram without a lock; readers take a relaxed copy.
+ *
+ * Bucket 0 holds everything below LATENCY_HIST_MIN_US, bucket i (i > 0) holds
+ * [LATENCY_HIST_MIN_US << (i - 1), LATENCY_HIST_MIN_US << i), and the last
+ * bucket is open-ended.
+ */
+
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "json_writer.h"
+
+#define LATENCY_HIST_BUCKETS 16
+#define LATENCY_HIST_MIN_US  64     // Upper bound of bucket 0; the last bound is ~1 s
+
+typedef struct {
+    uint32_t count;
+    uint32_t errors;
+    uint32_t max_us;
+    uint32_t buckets[LATENCY_HIST_BUCKETS];
+} latency_hist_t;
+
+// Record one duration; `error` also bumps the error count
+void latency_hist_record(latency_hist_t *hist, uint32_t duration_us, bool error);
+
+// Consistent-enough copy for reporting (each field is read atomically)
+void latency_hist_snapshot(const latency_hist_t *hist, latency_hist_t *out);
+
+// Upper bound of a bucket in microseconds, 0 for the open-ended last bucket
+uint32_t latency_hist_bucket_bound_us(size_t bucket);
+
+// Upper bound of the bucket holding the given percentile (0-100), 0 if empty.
+// The last bucket reports the recorded maximum.
+uint32_t latency_hist_percentile_us(const latency_hist_t *snapshot, unsigned percentile);
+
+// Write count, errors, max_us, p50_us, p90_us, p99_us and buckets as members
+// of the object currently open in w
+void latency_hist_write_json(json_writer_t *w, const latency_hist_t *snapshot);
+
+#endif // LATENCY_HIST_H
@@ -0,0 +1,140 @@
+#include "led_status.h"
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "led_strip.h"
+#include "scheduler.h"
+
+static const char *TAG = "led";
+
+#define LED_PULSE_INTERVAL_MS   30000   // At most one activity pulse per 30 s
+#define LED_PULSE_MS            1000    // White flash length
+#define LED_NO_COLOR            0xFFFFFFFFu
+
+#define RGB(r, g, b) (((uint32_t)(r) << 16) | ((uint32_t)(g) << 8) | (uint32_t)(b))
+
+typedef struct {
+    uint32_t on;
+    uint32_t off;               // Second blink phase
+    uint32_t half_period_ms;    // 0 = solid
+} led_anim_t;
+
+static const uint32_t base_colors[LED_BASE_COUNT] = {
+    [LED_BASE_OFF]      = RGB(0, 0, 0),
+    [LED_BASE_OK]       = RGB(0, 255, 0),
+    [LED_BASE_DEGRADED] = RGB(255, 255, 0),
+    [LED_BASE_FAULT]    = RGB(255, 0, 0),
+};
+
+static const led_anim_t overlays[LED_OVERLAY_COUNT] = {
+    [LED_OVERLAY_BUTTON_HELD] = { RGB(255, 0, 255), RGB(0, 0, 0), 250 },
+    [LED_OVERLAY_WIFI_RESET]  = { RGB(0, 0, 255), 0, 0 },
+};
+
+static const uint32_t pulse_color = RGB(255, 255, 255);
+
+// Targets, written by any task
+static led_base_t target_base = LED_BASE_OFF;
+static led_overlay_t target_overlay = LED_OVERLAY_NONE;
+static uint32_t pulse_start_ms = 0;
+static uint32_t pulse_end_ms = 0;
+
+// Render job state (scheduler task only)
+static led_strip_handle_t led_strip = NULL;
+static scheduler_job_t render_job;
+static bool ready = false;
+static uint32_t shown = LED_NO_COLOR;
+
+static void led_kick(void)
+{
+    if (__atomic_load_n(&ready, __ATOMIC_ACQUIRE)) {
+        scheduler_arm(&render_job, 0);
+    }
+}
+
+static void led_render(void *arg)
+{
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    led_overlay_t overlay = __atomic_load_n(&target_overlay, __ATOMIC_ACQUIRE);
+    uint32_t pulse_end = __atomic_load_n(&pulse_end_ms, __ATOMIC_ACQUIRE);
+    uint32_t color;
+    uint32_t next_ms = 0;       // Next animation edge, 0 = none
+
+    if (overlay != LED_OVERLAY_NONE) {
+        const led_anim_t *a = &overlays[overlay];
+        color = a->on;
+        if (a->half_period_ms) {
+            color = (now / a->half_period_ms) & 1 ? a->off : a->on;
+            next_ms = a->half_period_ms - now % a->half_period_ms;
+        }
+    } else if ((int32_t)(pulse_end - now) > 0) {
+        color = pulse_color;
+        next_ms = pulse_end - now;
+    } else {
+        color = base_colors[__atomic_load_n(&target_base, __ATOMIC_ACQUIRE)];
+    }
+
+    if (color != shown) {
+        esp_err_t err = led_strip_set_pixel(led_strip, 0, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+        if (err == ESP_OK) {
+            err = led_strip_refresh(led_strip);
+        }
+        if (err == ESP_OK) {
+            shown = color;
+        } else {
+            ESP_LOGE(TAG, "LED update failed: %s", esp_err_to_name(err));
+        }
+    }
+    if (next_ms) {
+        scheduler_arm(&render_job, next_ms);
+    }
+}
+
+void led_status_init(gpio_num_t gpio)
+{
+    /* LED strip initialization with the GPIO and pixels number*/
+    led_strip_config_t strip_config = {
+        .strip_gpio_num = gpio,
+        .max_leds = 1, // Single RGB LED on board
+        .flags.invert_out = false,
+    };
+    led_strip_rmt_config_t rmt_config = {
+        .resolution_hz = 10 * 1000 * 1000, // 10MHz
+        .flags.with_dma = false,
+    };
+    ESP_ERROR_CHECK(led_strip_new_rmt_device(&strip_config, &rmt_config, &led_strip));
+    /* Set all LED off to clear all pixels */
+    led_strip_clear(led_strip);
+    shown = base_colors[LED_BASE_OFF];
+
+    scheduler_add(&render_job, "led", 0, led_render, NULL);
+    __atomic_store_n(&ready, true, __ATOMIC_RELEASE);
+    // Show whatever was set before init
+    led_kick();
+}
+
+void led_status_set_base(led_base_t base)
+{
+    if (__atomic_exchange_n(&target_base, base, __ATOMIC_ACQ_REL) != base) {
+        led_kick();
+    }
+}
+
+void led_status_set_overlay(led_overlay_t overlay)
+{
+    if (__atomic_exchange_n(&target_overlay, overlay, __ATOMIC_ACQ_REL) != overlay) {
+        led_kick();
+    }
+}
+
+void led_status_activity(uint32_t now_ms)
+{
+    // No pulse in the first interval after boot, as before
+    if (now_ms - __atomic_load_n(&pulse_start_ms, __ATOMIC_ACQUIRE) < LED_PULSE_INTERVAL_MS) {
+        return;
+    }
+    __atomic_store_n(&pulse_start_ms, now_ms, __ATOMIC_RELEASE);
+    __atomic_store_n(&pulse_end_ms, now_ms + LED_PULSE_MS, __ATOMIC_RELEASE);
+    led_kick();
+}
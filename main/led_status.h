@@ -0,0 +1,45 @@
+/*
+ * Status LED
+ *
+ * Drives the on-board RGB LED from a few target states: the base colour
+ * (green / yellow / red from Wi-Fi and UPS health), a white activity pulse
+ * for UPS data and the BOOT button overlays. Setters only store the new
+ * target atomically and, if it changed, wake a scheduler job; the job
+ * renders the highest-priority state from a constant table and refreshes
+ * the LED strip only when the colour actually changes. Animation edges (end
+ * of a pulse, blink phase) re-arm the same job, so nothing is allocated and
+ * the UPS report path never waits for the RMT transfer.
+ */
+
+#ifndef LED_STATUS_H
+#define LED_STATUS_H
+
+#include <stdint.h>
+#include "driver/gpio.h"
+
+typedef enum {
+    LED_BASE_OFF = 0,
+    LED_BASE_OK,                // Green: Wi-Fi and UPS fine
+    LED_BASE_DEGRADED,          // Yellow: one of them down
+    LED_BASE_FAULT,             // Red: both down
+    LED_BASE_COUNT
+} led_base_t;
+
+typedef enum {
+    LED_OVERLAY_NONE = 0,
+    LED_OVERLAY_BUTTON_HELD,    // Purple blink: BOOT button held
+    LED_OVERLAY_WIFI_RESET,     // Blue: credentials cleared, safe to release
+    LED_OVERLAY_COUNT
+} led_overlay_t;
+
+// Set up the LED strip on gpio and register the render job. Setters called
+// before this only record the target.
+void led_status_init(gpio_num_t gpio);
+
+void led_status_set_base(led_base_t base);
+void led_status_set_overlay(led_overlay_t overlay);
+
+// UPS data arrived: a one-second white pulse, at most every 30 s
+void led_status_activity(uint32_t now_ms);
+
+#endif // LED_STATUS_H
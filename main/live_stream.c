@@ -0,0 +1,340 @@
+#include "live_stream.h"
+#include <string.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sys/socket.h"
+#include "task_plan.h"
+#include "esp_log.h"
+#include "json_writer.h"
+#include "report_trace.h"
+
+static const char *TAG = "live-stream";
+
+#define LIVE_MAX_SUBSCRIBERS CONFIG_UPS_LIVE_MAX_SUBSCRIBERS
+#define LIVE_BACKLOG         CONFIG_UPS_LIVE_BACKLOG
+#define LIVE_MAX_FIELDS      16
+#define LIVE_MSG_MAX         384
+#define LIVE_TASK_STACK      CONFIG_UPS_STACK_LIVE_STREAM
+#define LIVE_TASK_PRIORITY   TASK_PRIO_LIVE_STREAM
+#define LIVE_SEND_TIMEOUT_MS CONFIG_UPS_LIVE_SEND_TIMEOUT_MS
+
+typedef struct {
+    uint32_t seq;
+    uint16_t len;
+    char data[LIVE_MSG_MAX];
+} live_msg_t;
+
+typedef struct {
+    int fd;                     // -1 = free slot
+    uint32_t next_seq;          // Next ring message to send
+    bool needs_full;            // Send a full snapshot before any delta
+} live_subscriber_t;
+
+static portMUX_TYPE live_lock = portMUX_INITIALIZER_UNLOCKED;
+static SemaphoreHandle_t publish_mutex = NULL;
+static httpd_handle_t live_server = NULL;
+static TaskHandle_t live_task_handle = NULL;
+
+// Latest values (for full snapshots) and the delta ring
+static live_field_t current[LIVE_MAX_FIELDS];
+static size_t current_count = 0;
+static live_msg_t ring[LIVE_BACKLOG];
+static uint32_t ring_head = 0;      // Seq of the newest message, 0 = none yet
+
+static live_subscriber_t subscribers[LIVE_MAX_SUBSCRIBERS];
+static live_stream_stats_t stats;
+
+// Render fields as {"seq":n,"full":b,"ups":{...}}. Returns length, 0 on overflow.
+static size_t render(char *buf, size_t size, uint32_t seq, bool full,
+                     const live_field_t *fields, size_t count)
+{
+    json_writer_t w;
+    json_writer_init_buffer(&w, buf, size);
+    json_obj_begin(&w, NULL);
+    json_uint(&w, "seq", seq);
+    json_bool(&w, "full", full);
+    json_obj_begin(&w, "ups");
+    for (size_t i = 0; i < count; i++) {
+        if (fields[i].text) {
+            json_str(&w, fields[i].name, fields[i].text);
+        } else {
+            json_int(&w, fields[i].name, fields[i].value);
+        }
+    }
+    json_obj_end(&w);
+    json_obj_end(&w);
+    return json_writer_finish(&w) == ESP_OK ? json_writer_length(&w) : 0;
+}
+
+void live_stream_publish(const live_field_t *fields, size_t count)
+{
+    if (!publish_mutex) {
+        return;
+    }
+    if (count > LIVE_MAX_FIELDS) {
+        count = LIVE_MAX_FIELDS;
+    }
+
+    // Publishers (USB callback, freshness task) are serialized so deltas enter
+    // the ring in the order they were computed
+    xSemaphoreTake(publish_mutex, portMAX_DELAY);
+
+    live_field_t changed[LIVE_MAX_FIELDS];
+    size_t changed_count = 0;
+    taskENTER_CRITICAL(&live_lock);
+    for (size_t i = 0; i < count; i++) {
+        if (i >= current_count || current[i].name != fields[i].name ||
+            current[i].value != fields[i].value || current[i].text != fields[i].text) {
+            changed[changed_count++] = fields[i];
+            current[i] = fields[i];
+        }
+    }
+    current_count = count;
+    bool have_subscribers = stats.subscribers > 0;
+    uint32_t seq = ring_head + 1;
+    taskEXIT_CRITICAL(&live_lock);
+
+    // Nothing to say, or nobody to say it to (new subscribers start from a full snapshot)
+    if (changed_count == 0 || !have_subscribers) {
+        xSemaphoreGive(publish_mutex);
+        return;
+    }
+
+    static live_msg_t msg;      // Guarded by publish_mutex
+    msg.seq = seq;
+    msg.len = (uint16_t)render(msg.data, sizeof(msg.data), seq, false, changed, changed_count);
+    if (msg.len > 0) {
+        taskENTER_CRITICAL(&live_lock);
+        ring[(seq - 1) % LIVE_BACKLOG] = msg;
+        ring_head = seq;
+        stats.published++;
+        taskEXIT_CRITICAL(&live_lock);
+    }
+    xSemaphoreGive(publish_mutex);
+
+    if (msg.len > 0 && live_task_handle) {
+        xTaskNotifyGive(live_task_handle);
+    }
+}
+
+void live_stream_init(void)
+{
+    publish_mutex = xSemaphoreCreateMutex();
+}
+
+#if CONFIG_HTTPD_WS_SUPPORT
+
+static void remove_subscriber(size_t i)
+{
+    taskENTER_CRITICAL(&live_lock);
+    if (subscribers[i].fd >= 0) {
+        subscribers[i].fd = -1;
+        stats.subscribers--;
+    }
+    taskEXIT_CRITICAL(&live_lock);
+}
+
+static esp_err_t send_text(httpd_handle_t hd, int fd, const char *data, size_t len)
+{
+    httpd_ws_frame_t frame = {
+        .final = true,
+        .fragmented = false,
+        .type = HTTPD_WS_TYPE_TEXT,
+        .payload = (uint8_t *)data,
+        .len = len
+    };
+    return httpd_ws_send_frame_async(hd, fd, &frame);
+}
+
+// Bring one subscriber up to date. Returns ESP_ERR_NOT_FOUND if the socket is
+// gone and ESP_ERR_TIMEOUT if the subscriber is too slow to keep.
+static esp_err_t service_subscriber(httpd_handle_t hd, size_t i)
+{
+    static live_msg_t msg;      // Broadcaster task only
+    int fd = subscribers[i].fd;
+
+    if (httpd_ws_get_fd_info(hd, fd) != HTTPD_WS_CLIENT_WEBSOCKET) {
+        return ESP_ERR_NOT_FOUND;
+    }
+
+    if (subscribers[i].needs_full) {
+        live_field_t snapshot[LIVE_MAX_FIELDS];
+        taskENTER_CRITICAL(&live_lock);
+        size_t n = current_count;
+        memcpy(snapshot, current, n * sizeof(live_field_t));
+        uint32_t seq = ring_head;
+        subscribers[i].next_seq = seq + 1;
+        subscribers[i].needs_full = false;
+        taskEXIT_CRITICAL(&live_lock);
+
+        msg.len = (uint16_t)render(msg.data, sizeof(msg.data), seq, true, snapshot, n);
+        if (msg.len && send_text(hd, fd, msg.data, msg.len) != ESP_OK) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+
+    for (;;) {
+        taskENTER_CRITICAL(&live_lock);
+        uint32_t head = ring_head;
+        uint32_t next = subscribers[i].next_seq;
+        if (next > head) {
+            taskEXIT_CRITICAL(&live_lock);
+            return ESP_OK;
+        }
+        // Behind the ring: the deltas it missed are gone, so it cannot catch up
+        if (head - next >= LIVE_BACKLOG) {
+            stats.dropped += head - LIVE_BACKLOG + 1 - next;
+            taskEXIT_CRITICAL(&live_lock);
+            return ESP_ERR_TIMEOUT;
+        }
+        msg = ring[(next - 1) % LIVE_BACKLOG];
+        subscribers[i].next_seq = next + 1;
+        taskEXIT_CRITICAL(&live_lock);
+
+        // A failed send may have written part of a frame; the socket is done
+        if (msg.len && msg.seq == next && send_text(hd, fd, msg.data, msg.len) != ESP_OK) {
+            return ESP_ERR_TIMEOUT;
+        }
+    }
+}
+
+static void live_stream_task(void *arg)
+{
+    for (;;) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        httpd_handle_t hd = live_server;
+        if (!hd) {
+            continue;
+        }
+        uint32_t generation = report_trace_generation();
+        bool delivered = false;
+        for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+            if (subscribers[i].fd < 0) {
+                continue;
+            }
+            int fd = subscribers[i].fd;
+            esp_err_t err = service_subscriber(hd, i);
+            if (err == ESP_OK) {
+                delivered = true;
+            } else if (err == ESP_ERR_TIMEOUT) {
+                ESP_LOGW(TAG, "Subscriber fd=%d too slow, disconnecting", fd);
+                remove_subscriber(i);
+                taskENTER_CRITICAL(&live_lock);
+                stats.evicted++;
+                taskEXIT_CRITICAL(&live_lock);
+                httpd_sess_trigger_close(hd, fd);
+            } else {
+                ESP_LOGI(TAG, "Subscriber fd=%d gone", fd);
+                remove_subscriber(i);
+            }
+        }
+        if (delivered) {
+            report_trace_served(REPORT_TRACE_WS, generation);
+        }
+    }
+}
+
+static esp_err_t ws_handler(httpd_req_t *req)
+{
+    int fd = httpd_req_to_sockfd(req);
+
+    if (req->method == HTTP_GET) {
+        // Handshake done: take a subscriber slot or refuse
+        int slot = -1;
+        taskENTER_CRITICAL(&live_lock);
+        for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+            if (subscribers[i].fd == fd) {
+                slot = (int)i;
+                break;
+            }
+            if (slot < 0 && subscribers[i].fd < 0) {
+                slot = (int)i;
+            }
+        }
+        if (slot >= 0) {
+            if (subscribers[slot].fd != fd) {
+                stats.subscribers++;
+            }
+            subscribers[slot].fd = fd;
+            subscribers[slot].needs_full = true;
+        } else {
+            stats.rejected++;
+        }
+        taskEXIT_CRITICAL(&live_lock);
+
+        if (slot < 0) {
+            ESP_LOGW(TAG, "Subscriber cap (%d) reached, refusing fd=%d", LIVE_MAX_SUBSCRIBERS, fd);
+            return ESP_FAIL;
+        }
+        // Bound how long one stalled client can hold up the broadcaster
+        struct timeval timeout = { .tv_sec = LIVE_SEND_TIMEOUT_MS / 1000,
+                                   .tv_usec = (LIVE_SEND_TIMEOUT_MS % 1000) * 1000 };
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        ESP_LOGI(TAG, "Subscriber fd=%d joined", fd);
+        xTaskNotifyGive(live_task_handle);
+        return ESP_OK;
+    }
+
+    // Dashboards do not send anything; drain whatever arrives so the socket stays healthy
+    uint8_t buf[64];
+    httpd_ws_frame_t frame = { .payload = buf };
+    esp_err_t ret = httpd_ws_recv_frame(req, &frame, sizeof(buf));
+    if (ret != ESP_OK) {
+        return ret;
+    }
+    if (frame.type == HTTPD_WS_TYPE_CLOSE) {
+        for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+            if (subscribers[i].fd == fd) {
+                remove_subscriber(i);
+            }
+        }
+    }
+    return ESP_OK;
+}
+
+esp_err_t live_stream_register(httpd_handle_t server)
+{
+    taskENTER_CRITICAL(&live_lock);
+    for (size_t i = 0; i < LIVE_MAX_SUBSCRIBERS; i++) {
+        subscribers[i].fd = -1;
+    }
+    stats.subscribers = 0;
+    live_server = server;
+    taskEXIT_CRITICAL(&live_lock);
+
+    if (!live_task_handle &&
+        xTaskCreatePinnedToCore(live_stream_task, "live_stream", LIVE_TASK_STACK, NULL, LIVE_TASK_PRIORITY,
+                                &live_task_handle, TASK_CORE_NET) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create broadcaster task");
+        return ESP_FAIL;
+    }
+
+    httpd_uri_t ws = {
+        .uri = "/ws",
+        .method = HTTP_GET,
+        .handler = ws_handler,
+        .user_ctx = NULL,
+        .is_websocket = true
+    };
+    return httpd_register_uri_handler(server, &ws);
+}
+
+#else
+
+esp_err_t live_stream_register(httpd_handle_t server)
+{
+    ESP_LOGW(TAG, "CONFIG_HTTPD_WS_SUPPORT is disabled, /ws not available");
+    return ESP_ERR_NOT_SUPPORTED;
+}
+
+#endif // CONFIG_HTTPD_WS_SUPPORT
+
+void live_stream_get_stats(live_stream_stats_t *out)
+{
+    taskENTER_CRITICAL(&live_lock);
+    *out = stats;
+    taskEXIT_CRITICAL(&live_lock);
+}
@@ -0,0 +1,50 @@
+/*
+ * Live Stream
+ *
+ * WebSocket push of UPS updates to dashboards (/ws). The parser publishes the
+ * current field values; only fields that changed are rendered into a small
+ * message ring, and one broadcaster task fans each message out to all
+ * subscribers with httpd_ws_send_frame_async(). New subscribers first get a
+ * full snapshot. Each subscriber socket has a send timeout
+ * (CONFIG_UPS_LIVE_SEND_TIMEOUT_MS), so a stalled client delays the others by
+ * at most that much once: a subscriber whose send times out or that falls
+ * behind the ring is disconnected, and its dashboard reconnects to a fresh
+ * snapshot.
+ */
+
+#ifndef LIVE_STREAM_H
+#define LIVE_STREAM_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_http_server.h"
+
+// One published value. Text fields (text != NULL) compare by pointer, so pass
+// static strings.
+typedef struct {
+    const char *name;
+    int value;
+    const char *text;
+} live_field_t;
+
+typedef struct {
+    uint32_t subscribers;
+    uint32_t published;         // Delta messages put in the ring
+    uint32_t dropped;           // Messages missed by evicted subscribers
+    uint32_t evicted;           // Subscribers disconnected for being too slow
+    uint32_t rejected;          // Connections refused because the cap was reached
+} live_stream_stats_t;
+
+// Create the publisher lock. Call once, before the USB host starts.
+void live_stream_init(void);
+
+// Register /ws on a (re)started server. Drops subscribers of a previous server.
+esp_err_t live_stream_register(httpd_handle_t server);
+
+// Publish the current values. Cheap when nothing changed; never blocks on sockets.
+void live_stream_publish(const live_field_t *fields, size_t count);
+
+void live_stream_get_stats(live_stream_stats_t *out);
+
+#endif // LIVE_STREAM_H
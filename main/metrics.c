@@ -0,0 +1,285 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "ups_status.h"
+#include "status_snapshot.h"
+#include "energy_meter.h"
+#include "power_quality.h"
+#include "battery_health.h"
+#include "live_stream.h"
+#include "webserver.h"
+#include "deferred_log.h"
+#include "supervisor.h"
+#include "heap_monitor.h"
+#include "persist.h"
+#include "esp_heap_caps.h"
+
+static const char *TAG = "metrics";
+
+// System metrics move constantly; rebuild them at most this often
+#define METRICS_SYSTEM_PERIOD_MS 5000
+
+typedef struct {
+    char *buf;
+    size_t cap;
+    size_t len;
+    uint32_t version;
+    bool valid;
+    bool truncated;
+} metrics_section_t;
+
+enum {
+    SECTION_UPS = 0,
+    SECTION_COUNTERS,
+    SECTION_STATUS,
+    SECTION_SYSTEM,
+    SECTION_COUNT
+};
+
+static char ups_buf[1280];
+static char counters_buf[1792];
+static char status_buf[1024];
+static char system_buf[3584];
+
+static metrics_section_t sections[SECTION_COUNT] = {
+    [SECTION_UPS]      = { ups_buf, sizeof(ups_buf) },
+    [SECTION_COUNTERS] = { counters_buf, sizeof(counters_buf) },
+    [SECTION_STATUS]   = { status_buf, sizeof(status_buf) },
+    [SECTION_SYSTEM]   = { system_buf, sizeof(system_buf) },
+};
+
+// Tasks whose stack high-water mark is exported
+static const char *const watched_tasks[] = {
+    "usb_events", "hid_task", "tcp_server", "scheduler", "supervisor",
+    "wifi_reconnect", "live_stream", "httpd", "dlog_drain",
+};
+
+static void section_begin(metrics_section_t *s, uint32_t version)
+{
+    s->len = 0;
+    s->buf[0] = '\0';
+    s->version = version;
+    s->valid = true;
+    s->truncated = false;
+}
+
+static void append(metrics_section_t *s, const char *fmt, ...)
+{
+    if (s->truncated) {
+        return;
+    }
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(s->buf + s->len, s->cap - s->len, fmt, args);
+    va_end(args);
+    if (n < 0 || (size_t)n >= s->cap - s->len) {
+        // Keep whole lines only
+        while (s->len > 0 && s->buf[s->len - 1] != '\n') {
+            s->len--;
+        }
+        s->buf[s->len] = '\0';
+        s->truncated = true;
+        ESP_LOGW(TAG, "Section buffer full (%u bytes)", (unsigned)s->cap);
+        return;
+    }
+    s->len += n;
+}
+
+// "# HELP" / "# TYPE" header
+static void header(metrics_section_t *s, const char *name, const char *type, const char *help)
+{
+    append(s, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+static void gauge(metrics_section_t *s, const char *name, const char *help, long value)
+{
+    header(s, name, "gauge", help);
+    append(s, "%s %ld\n", name, value);
+}
+
+static void counter(metrics_section_t *s, const char *name, const char *help, unsigned long long value)
+{
+    header(s, name, "counter", help);
+    append(s, "%s %llu\n", name, value);
+}
+
+static void render_ups(metrics_section_t *s, const ups_values_t *v)
+{
+    gauge(s, "ups_battery_charge_percent", "battery.charge", v->battery_charge);
+    gauge(s, "ups_battery_runtime_minutes", "battery.runtime", v->battery_runtime);
+    gauge(s, "ups_battery_voltage_raw", "Battery voltage reading (report 0x20 bytes 2-3)", v->battery_raw_voltage);
+    gauge(s, "ups_input_voltage_volts", "input.voltage", v->input_voltage);
+    gauge(s, "ups_output_voltage_volts", "output.voltage", v->output_voltage);
+    gauge(s, "ups_load_percent", "ups.load", v->load);
+    gauge(s, "ups_temperature", "battery.temperature (raw UPS units)", v->temperature);
+    gauge(s, "ups_status_flags", "ups.status.flags", v->status_flags);
+    gauge(s, "ups_system_status", "ups.system.status", v->system_status);
+    gauge(s, "ups_extended_status", "ups.extended.status", v->extended_status);
+    gauge(s, "ups_alarm_control", "ups.alarm.control", v->alarm_control);
+    gauge(s, "ups_beep_control", "ups.beep.control", v->beep_control);
+}
+
+static void render_counters(metrics_section_t *s, const ups_values_t *v)
+{
+    counter(s, "ups_hid_reports_total", "HID reports received", v->reports_total);
+    counter(s, "ups_hid_reports_unknown_total", "HID reports with an unknown report ID", v->reports_unknown);
+    counter(s, "ups_hid_reports_empty_total", "Empty HID reports", v->reports_empty);
+    gauge(s, "ups_last_report_uptime_seconds", "Uptime at the last HID report", (long)(v->last_report_ms / 1000));
+
+    energy_meter_stats_t energy;
+    energy_meter_get_stats(&energy);
+    gauge(s, "ups_realpower_watts", "ups.realpower", (long)energy.realpower_w);
+    gauge(s, "ups_realpower_nominal_watts", "ups.realpower.nominal", (long)energy_meter_nominal_power_w());
+    counter(s, "ups_output_energy_wh_total", "Cumulative output energy", energy.energy_mj / 3600000ULL);
+    counter(s, "ups_on_battery_seconds_total", "Cumulative time on battery", energy.on_battery_ms / 1000ULL);
+    counter(s, "ups_transfers_total", "Transfers to battery", energy.transfers);
+
+    pq_stats_t pq;
+    power_quality_get_stats(&pq);
+    gauge(s, "ups_input_band", "Input voltage band (0 normal, 1 sag, 2 swell, 3 transfer)", pq.band);
+    header(s, "ups_power_events_total", "counter", "Finished power quality events");
+    for (int t = 0; t < PQ_EVENT_TYPE_COUNT; t++) {
+        append(s, "ups_power_events_total{type=\"%s\"} %lu\n",
+               power_quality_event_name((pq_event_type_t)t), (unsigned long)pq.event_counts[t]);
+    }
+
+    bh_stats_t bh;
+    battery_health_get_stats(&bh);
+    gauge(s, "ups_battery_voltage_millivolts", "Battery voltage", (long)bh.battery_mv);
+    gauge(s, "ups_battery_resistance_milliohms", "Smoothed internal resistance, 0 = no estimate", (long)bh.resistance_mohm);
+    gauge(s, "ups_battery_capacity_percent", "Estimated capacity vs rated, 0 = no estimate", (long)bh.capacity_pct);
+    gauge(s, "ups_battery_replace_recommended", "1 when capacity or resistance crossed the replacement limit",
+          bh.replace_recommended ? 1 : 0);
+}
+
+static void render_status(metrics_section_t *s, const status_snapshot_t *snap)
+{
+    header(s, "ups_state", "gauge", "UPS link state machine (1 for the current state)");
+    for (int st = UPS_DISCONNECTED; st <= UPS_CONNECTED_STALE; st++) {
+        append(s, "ups_state{state=\"%s\"} %d\n",
+               ups_state_name((ups_connection_state_t)st), snap->ups_state == st ? 1 : 0);
+    }
+    gauge(s, "nut_server_running", "NUT TCP server task alive", snap->tcp_running ? 1 : 0);
+    gauge(s, "nut_clients", "Connected NUT clients", snap->tcp_connections);
+    gauge(s, "wifi_connected", "Station connected", snap->wifi_connected ? 1 : 0);
+    gauge(s, "wifi_rssi_dbm", "Signal strength (5 dBm resolution)", snap->rssi);
+}
+
+static void render_system(metrics_section_t *s, uint32_t now_ms)
+{
+    gauge(s, "esp_uptime_seconds", "Uptime", (long)(now_ms / 1000));
+    gauge(s, "esp_heap_free_bytes", "Free heap", (long)esp_get_free_heap_size());
+    gauge(s, "esp_heap_min_free_bytes", "Minimum free heap since boot", (long)esp_get_minimum_free_heap_size());
+    heap_region_stats_t heap;
+    heap_monitor_region(MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT, &heap);
+    gauge(s, "esp_heap_internal_total_bytes", "Internal heap size", (long)heap.total);
+    gauge(s, "esp_heap_internal_largest_free_block_bytes", "Largest free internal block", (long)heap.largest_free_block);
+    gauge(s, "esp_heap_internal_fragmentation_percent", "100 - largest free block / free internal heap",
+          (long)heap.fragmentation_pct);
+    header(s, "esp_heap_live_bytes", "gauge", "Live heap allocations per subsystem");
+    for (int t = HEAP_TAG_OTHER + 1; t < HEAP_TAG_COUNT; t++) {
+        heap_tag_stats_t tag;
+        heap_monitor_get_tag_stats((heap_tag_t)t, &tag);
+        append(s, "esp_heap_live_bytes{subsystem=\"%s\"} %lu\n",
+               heap_monitor_tag_name((heap_tag_t)t), (unsigned long)tag.live_bytes);
+    }
+
+    header(s, "esp_task_stack_free_min_bytes", "gauge", "Task stack high-water mark (unused bytes)");
+    for (size_t i = 0; i < sizeof(watched_tasks) / sizeof(watched_tasks[0]); i++) {
+        TaskHandle_t task = xTaskGetHandle(watched_tasks[i]);
+        if (task) {
+            append(s, "esp_task_stack_free_min_bytes{task=\"%s\"} %lu\n",
+                   watched_tasks[i], (unsigned long)uxTaskGetStackHighWaterMark(task));
+        }
+    }
+
+    webserver_stats_t web;
+    webserver_get_stats(&web);
+    gauge(s, "http_sessions_open", "Open HTTP sessions", web.open_sessions);
+    gauge(s, "http_sessions_max", "HTTP session pool size", web.max_sessions);
+    counter(s, "http_sessions_opened_total", "HTTP sessions accepted", web.sessions_opened);
+    counter(s, "http_sessions_idle_reaped_total", "Keep-alive sessions closed for idleness", web.idle_reaped);
+    counter(s, "http_requests_total", "HTTP requests handled", web.requests);
+
+    live_stream_stats_t live;
+    live_stream_get_stats(&live);
+    gauge(s, "http_ws_subscribers", "Live stream subscribers", (long)live.subscribers);
+    counter(s, "http_ws_dropped_total", "Live stream messages missed by evicted subscribers", live.dropped);
+    counter(s, "http_ws_evicted_total", "Live stream subscribers disconnected for being too slow", live.evicted);
+
+    persist_stats_t persist;
+    persist_get_stats(&persist);
+    counter(s, "nvs_state_commits_total", "Persistent state commits to NVS", persist.commits);
+    counter(s, "nvs_state_unchanged_sets_total", "Persistent state sets that matched the cached value", persist.unchanged);
+    counter(s, "nvs_state_commit_errors_total", "Failed persistent state commits", persist.errors);
+
+    header(s, "supervisor_stalls_total", "counter", "Subsystem stalls detected by the supervisor");
+    for (int i = 0; i < SUPERVISOR_CLIENT_COUNT; i++) {
+        supervisor_client_stats_t sup;
+        supervisor_get_stats((supervisor_client_t)i, &sup);
+        if (sup.registered) {
+            append(s, "supervisor_stalls_total{subsystem=\"%s\"} %lu\n", sup.name, (unsigned long)sup.stalls);
+        }
+    }
+    header(s, "supervisor_restarts_total", "counter", "Subsystem restarts by the supervisor");
+    for (int i = 0; i < SUPERVISOR_CLIENT_COUNT; i++) {
+        supervisor_client_stats_t sup;
+        supervisor_get_stats((supervisor_client_t)i, &sup);
+        if (sup.registered) {
+            append(s, "supervisor_restarts_total{subsystem=\"%s\"} %lu\n", sup.name, (unsigned long)sup.restarts);
+        }
+    }
+
+#if CONFIG_UPS_DLOG_ENABLE
+    dlog_stats_t dlog;
+    dlog_get_stats(&dlog);
+    counter(s, "log_records_total", "Deferred log records queued", dlog.written);
+    counter(s, "log_dropped_total", "Deferred log records dropped (ring full)", dlog.dropped);
+    counter(s, "log_rate_limited_total", "Deferred log records over the per-tag rate", dlog.rate_limited);
+    gauge(s, "log_ring_max_fill", "Highest deferred log ring occupancy", (long)dlog.max_fill);
+#endif
+}
+
+size_t metrics_collect(const char **out, size_t max_sections)
+{
+    ups_values_t values;
+    get_ups_values(&values);
+
+    status_snapshot_refresh();
+    status_snapshot_t snap;
+    status_snapshot_get(&snap);
+
+    uint32_t now_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    uint32_t versions[SECTION_COUNT] = {
+        [SECTION_UPS]      = values.version,
+        [SECTION_COUNTERS] = values.reports_total,
+        [SECTION_STATUS]   = snap.version,
+        [SECTION_SYSTEM]   = now_ms / METRICS_SYSTEM_PERIOD_MS,
+    };
+
+    for (int i = 0; i < SECTION_COUNT; i++) {
+        metrics_section_t *s = &sections[i];
+        if (s->valid && s->version == versions[i]) {
+            continue;
+        }
+        section_begin(s, versions[i]);
+        switch (i) {
+            case SECTION_UPS:      render_ups(s, &values); break;
+            case SECTION_COUNTERS: render_counters(s, &values); break;
+            case SECTION_STATUS:   render_status(s, &snap); break;
+            case SECTION_SYSTEM:   render_system(s, now_ms); break;
+        }
+    }
+
+    size_t n = 0;
+    for (int i = 0; i < SECTION_COUNT && n < max_sections; i++) {
+        out[n++] = sections[i].buf;
+    }
+    return n;
+}
@@ -0,0 +1,26 @@
+/*
+ * Prometheus Metrics
+ *
+ * Text exposition for /metrics, kept pre-rendered in a few static sections.
+ * Each section remembers the version of the data it was rendered from and is
+ * only rebuilt when that version moves:
+ *
+ *   UPS values      - ups_values_t.version (parsed values changed)
+ *   Counters        - HID report count (parser, energy, power quality, battery)
+ *   Status          - status snapshot version (state machine, Wi-Fi, NUT)
+ *   System          - time bucket (heap, task stacks, HTTP pool, uptime)
+ *
+ * A scrape refreshes stale sections and sends the buffers as they are.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stddef.h>
+
+// Rebuild stale sections and return pointers to all of them (NUL-terminated
+// text). The buffers stay valid until the next call; call from the httpd task
+// only. Returns the number of sections.
+size_t metrics_collect(const char **sections, size_t max_sections);
+
+#endif // METRICS_H
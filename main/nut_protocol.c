@@ -0,0 +1,264 @@
+#include "nut_protocol.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <stdbool.h>
+#include "ups_monitor.h"
+#include "energy_meter.h"
+#include "battery_health.h"
+
+// Everything a reply can refer to, gathered once per command
+typedef struct {
+    bool online;
+    ups_values_t ups;
+    energy_meter_stats_t energy;
+    unsigned long energy_wh;
+    bh_stats_t battery;
+} nut_view_t;
+
+typedef void (*nut_var_fmt_t)(const nut_view_t *v, char *buf, size_t size);
+
+typedef struct {
+    const char *name;
+    nut_var_fmt_t fmt;          // NULL: constant value below
+    const char *value;
+} nut_var_t;
+
+static void fmt_battery_charge(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.battery_charge);
+}
+
+static void fmt_battery_runtime(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.battery_runtime);
+}
+
+static void fmt_battery_voltage(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%lu.%02lu", (unsigned long)(v->battery.battery_mv / 1000),
+             (unsigned long)(v->battery.battery_mv % 1000 / 10));
+}
+
+static void fmt_input_voltage(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.input_voltage);
+}
+
+static void fmt_output_voltage(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.output_voltage);
+}
+
+static void fmt_load(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.load);
+}
+
+static void fmt_status(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%s", v->online ? "OL" : "UNKNOWN");
+}
+
+// 1 while the values are not live: STALE, or restored after a warm restart
+static void fmt_data_stale(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->online ? 0 : 1);
+}
+
+static void fmt_temperature(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.temperature);
+}
+
+static void fmt_realpower_nominal(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%lu", (unsigned long)energy_meter_nominal_power_w());
+}
+
+static void fmt_realpower(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%lu", (unsigned long)v->energy.realpower_w);
+}
+
+static void fmt_energy_total(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%lu.%03lu", v->energy_wh / 1000, v->energy_wh % 1000);
+}
+
+static void fmt_onbattery_seconds(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%llu", (unsigned long long)(v->energy.on_battery_ms / 1000ULL));
+}
+
+static void fmt_transfer_count(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%lu", (unsigned long)v->energy.transfers);
+}
+
+static void fmt_status_flags(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.status_flags);
+}
+
+static void fmt_system_status(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.system_status);
+}
+
+static void fmt_extended_status(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.extended_status);
+}
+
+static void fmt_alarm_control(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.alarm_control);
+}
+
+static void fmt_beep_control(const nut_view_t *v, char *buf, size_t size)
+{
+    snprintf(buf, size, "%d", v->ups.beep_control);
+}
+
+// LIST VAR order
+static const nut_var_t nut_vars[] = {
+    { "battery.charge",        fmt_battery_charge,    NULL },
+    { "battery.runtime",       fmt_battery_runtime,   NULL },
+    { "battery.voltage",       fmt_battery_voltage,   NULL },
+    { "input.voltage",         fmt_input_voltage,     NULL },
+    { "output.voltage",        fmt_output_voltage,    NULL },
+    { "ups.load",              fmt_load,              NULL },
+    { "ups.status",            fmt_status,            NULL },
+    { "ups.data.stale",        fmt_data_stale,        NULL },
+    { "battery.temperature",   fmt_temperature,       NULL },
+    { "device.mfr",            NULL,                  "CyberPower" },
+    { "device.model",          NULL,                  "VP700ELCD" },
+    { "device.type",           NULL,                  "ups" },
+    { "ups.firmware",          NULL,                  "1.0" },
+    { "battery.type",          NULL,                  "PbAc" },
+    { "ups.power.nominal",     NULL,                  "700" },
+    { "ups.realpower.nominal", fmt_realpower_nominal, NULL },
+    { "ups.realpower",         fmt_realpower,         NULL },
+    { "ups.energy.total",      fmt_energy_total,      NULL },
+    { "ups.onbattery.seconds", fmt_onbattery_seconds, NULL },
+    { "ups.transfer.count",    fmt_transfer_count,    NULL },
+    { "ups.status.flags",      fmt_status_flags,      NULL },
+    { "ups.system.status",     fmt_system_status,     NULL },
+    { "ups.extended.status",   fmt_extended_status,   NULL },
+    { "ups.alarm.control",     fmt_alarm_control,     NULL },
+    { "ups.beep.control",      fmt_beep_control,      NULL },
+};
+
+#define NUT_VAR_COUNT (sizeof(nut_vars) / sizeof(nut_vars[0]))
+
+static void collect_view(nut_view_t *v)
+{
+    v->online = ups_monitor_available();
+    get_ups_values(&v->ups);
+    // Energy counters served as ups.realpower / ups.energy.total / ...
+    energy_meter_get_stats(&v->energy);
+    v->energy_wh = (unsigned long)(v->energy.energy_mj / 3600000ULL);
+    battery_health_get_stats(&v->battery);
+}
+
+// Append `VAR <ups> <name> "<value>"\n`
+static size_t append_var(const nut_view_t *v, const nut_var_t *var, char *out, size_t size, size_t len)
+{
+    char value[32];
+    if (var->fmt) {
+        var->fmt(v, value, sizeof(value));
+    } else {
+        snprintf(value, sizeof(value), "%s", var->value);
+    }
+    if (len < size) {
+        len += snprintf(out + len, size - len, "VAR " NUT_UPS_NAME " %s \"%s\"\n", var->name, value);
+    }
+    return len;
+}
+
+static bool str_startswith(const char *str, const char *p)
+{
+    return strncmp(str, p, strlen(p)) == 0;
+}
+
+static size_t reply(char *out, size_t size, const char *text)
+{
+    return snprintf(out, size, "%s", text);
+}
+
+size_t nut_protocol_execute(char *line, char *out, size_t size)
+{
+    // Trim trailing CR/LF
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) {
+        line[--len] = '\0';
+    }
+    const char *cmd = line;
+    size_t n;
+
+    // Check UPS availability; values restored after a warm restart are served
+    // (flagged stale) until the UPS reports again
+    ups_connection_state_t state = get_ups_state();
+    bool ups_found = (state != UPS_DISCONNECTED && state != UPS_CONNECTED_WAITING_DATA) ||
+                     get_ups_values_restored();
+
+    // LIST UPS
+    if (strcasecmp(cmd, "LIST UPS") == 0) {
+        if (!ups_found) {
+            n = reply(out, size, "ERR UPS-NOT-FOUND\n");
+        } else {
+            n = reply(out, size, "BEGIN LIST UPS\nUPS " NUT_UPS_NAME " \"CyberPower VP700ELCD\"\nEND LIST UPS\n");
+        }
+    }
+    // LIST VAR <ups>
+    else if (strncasecmp(cmd, "LIST VAR " NUT_UPS_NAME, strlen("LIST VAR " NUT_UPS_NAME)) == 0) {
+        if (!ups_found) {
+            n = reply(out, size, "ERR UPS-NOT-FOUND\n");
+        } else {
+            nut_view_t view;
+            collect_view(&view);
+            n = reply(out, size, "BEGIN LIST VAR " NUT_UPS_NAME "\n");
+            for (size_t i = 0; i < NUT_VAR_COUNT; i++) {
+                n = append_var(&view, &nut_vars[i], out, size, n);
+            }
+            if (n < size) {
+                n += reply(out + n, size - n, "END LIST VAR " NUT_UPS_NAME "\n");
+            }
+        }
+    }
+    // GET VAR <ups> <varname>
+    else if (strncasecmp(cmd, "GET VAR " NUT_UPS_NAME " ", strlen("GET VAR " NUT_UPS_NAME " ")) == 0) {
+        if (!ups_found) {
+            n = reply(out, size, "ERR UPS-NOT-FOUND\n");
+        } else {
+            const char *var = cmd + strlen("GET VAR " NUT_UPS_NAME " ");
+            n = reply(out, size, "ERR VAR-NOT-FOUND\n");
+            for (size_t i = 0; i < NUT_VAR_COUNT; i++) {
+                if (strcasecmp(var, nut_vars[i].name) == 0) {
+                    nut_view_t view;
+                    collect_view(&view);
+                    n = append_var(&view, &nut_vars[i], out, size, 0);
+                    break;
+                }
+            }
+        }
+    }
+    // Authentication commands (stubbed for Home Assistant compatibility)
+    else if (str_startswith(cmd, "USERNAME") || str_startswith(cmd, "PASSWORD") || str_startswith(cmd, "LOGIN")) {
+        n = reply(out, size, "OK\n");
+    }
+    else if (str_startswith(cmd, "LOGOUT")) {
+        n = reply(out, size, "OK Goodbye\n");
+    }
+    // Unknown command
+    else {
+        n = reply(out, size, "ERR UNKNOWN-COMMAND\n");
+    }
+    return n < size ? n : (size ? size - 1 : 0);
+}
+
+bool nut_protocol_reply_has_values(const char *reply)
+{
+    return str_startswith(reply, "VAR ") || str_startswith(reply, "BEGIN LIST VAR ");
+}
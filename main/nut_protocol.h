@@ -0,0 +1,29 @@
+/*
+ * NUT Protocol Engine
+ *
+ * Answers the subset of the Network UPS Tools text protocol that upsc, Home
+ * Assistant and Synology/QNAP clients use (LIST UPS, LIST VAR, GET VAR and the
+ * stubbed authentication commands). One command line in, one reply out; the
+ * socket handling lives with the caller.
+ *
+ * Replies are built from the published UPS values (ups_monitor), the energy
+ * meter and the battery health model.
+ */
+
+#ifndef NUT_PROTOCOL_H
+#define NUT_PROTOCOL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+#define NUT_UPS_NAME            "VP700ELCD"
+#define NUT_PROTOCOL_REPLY_MAX  1536    // Fits the full LIST VAR reply
+
+// Execute one command line. Trailing CR/LF is stripped from line in place.
+// Writes a NUL-terminated reply to out and returns its length.
+size_t nut_protocol_execute(char *line, char *out, size_t size);
+
+// The reply carries UPS variable values (LIST VAR / GET VAR)
+bool nut_protocol_reply_has_values(const char *reply);
+
+#endif // NUT_PROTOCOL_H
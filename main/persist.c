@@ -0,0 +1,258 @@
+#include "persist.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "nvs.h"
+#include "scheduler.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "persist";
+
+#define PERSIST_COMMIT_DELAY_MS (CONFIG_UPS_PERSIST_COMMIT_DELAY_S * 1000U)
+#define PERSIST_RETRY_MS        60000   // After a failed commit
+
+typedef enum { PERSIST_U32, PERSIST_STR } persist_type_t;
+
+typedef struct {
+    const char *ns;
+    const char *key;
+    persist_type_t type;
+} persist_def_t;
+
+// Namespaces and keys predate this module; keys sharing a namespace are adjacent
+static const persist_def_t defs[PERSIST_KEY_COUNT] = {
+    [PERSIST_REBOOT_COUNT]  = { "ups_recovery", "reboot_count", PERSIST_U32 },
+    [PERSIST_WIFI_SSID]     = { "wifi_config",  "ssid",         PERSIST_STR },
+    [PERSIST_WIFI_PASSWORD] = { "wifi_config",  "password",     PERSIST_STR },
+};
+
+typedef struct {
+    bool present;
+    bool dirty;
+    uint32_t u32;
+    char str[PERSIST_STR_MAX];
+} persist_value_t;
+
+static persist_value_t values[PERSIST_KEY_COUNT];
+static SemaphoreHandle_t persist_lock = NULL;
+static scheduler_job_t commit_job;
+static bool commit_armed = false;
+static persist_stats_t stats;
+
+static void persist_load(persist_key_t key)
+{
+    const persist_def_t *def = &defs[key];
+    persist_value_t *v = &values[key];
+    nvs_handle_t nvs_handle;
+    esp_err_t err = nvs_open(def->ns, NVS_READONLY, &nvs_handle);
+    if (err != ESP_OK) {
+        return;     // Namespace not created yet
+    }
+    if (def->type == PERSIST_U32) {
+        err = nvs_get_u32(nvs_handle, def->key, &v->u32);
+    } else {
+        size_t len = sizeof(v->str);
+        err = nvs_get_str(nvs_handle, def->key, v->str, &len);
+    }
+    nvs_close(nvs_handle);
+    if (err == ESP_OK) {
+        v->present = true;
+    } else {
+        memset(v, 0, sizeof(*v));
+        if (err != ESP_ERR_NVS_NOT_FOUND) {
+            ESP_LOGW(TAG, "Cannot load %s/%s: %s", def->ns, def->key, esp_err_to_name(err));
+        }
+    }
+}
+
+// Caller holds persist_lock
+static esp_err_t persist_commit_locked(void)
+{
+    esp_err_t result = ESP_OK;
+    size_t i = 0;
+    while (i < PERSIST_KEY_COUNT) {
+        const char *ns = defs[i].ns;
+        size_t end = i;
+        bool dirty = false;
+        while (end < PERSIST_KEY_COUNT && strcmp(defs[end].ns, ns) == 0) {
+            dirty |= values[end].dirty;
+            end++;
+        }
+        if (dirty) {
+            nvs_handle_t nvs_handle;
+            esp_err_t err = nvs_open(ns, NVS_READWRITE, &nvs_handle);
+            bool opened = err == ESP_OK;
+            for (size_t k = i; k < end && err == ESP_OK; k++) {
+                persist_value_t *v = &values[k];
+                if (!v->dirty) {
+                    continue;
+                }
+                if (!v->present) {
+                    err = nvs_erase_key(nvs_handle, defs[k].key);
+                    if (err == ESP_ERR_NVS_NOT_FOUND) {
+                        err = ESP_OK;
+                    }
+                } else if (defs[k].type == PERSIST_U32) {
+                    err = nvs_set_u32(nvs_handle, defs[k].key, v->u32);
+                } else {
+                    err = nvs_set_str(nvs_handle, defs[k].key, v->str);
+                }
+            }
+            if (err == ESP_OK) {
+                err = nvs_commit(nvs_handle);
+            }
+            if (opened) {
+                nvs_close(nvs_handle);
+            }
+            if (err == ESP_OK) {
+                for (size_t k = i; k < end; k++) {
+                    values[k].dirty = false;
+                }
+                stats.commits++;
+            } else {
+                ESP_LOGW(TAG, "Commit of namespace %s failed: %s", ns, esp_err_to_name(err));
+                stats.errors++;
+                result = err;
+            }
+        }
+        i = end;
+    }
+    stats.dirty = result != ESP_OK;
+    return result;
+}
+
+static void persist_commit_job(void *arg)
+{
+    xSemaphoreTake(persist_lock, portMAX_DELAY);
+    commit_armed = false;
+    esp_err_t err = persist_commit_locked();
+    if (err != ESP_OK) {
+        commit_armed = true;
+        scheduler_arm(&commit_job, PERSIST_RETRY_MS);
+    }
+    xSemaphoreGive(persist_lock);
+}
+
+// Caller holds persist_lock. The deadline runs from the first unsaved change,
+// later changes join the same commit.
+static void persist_mark_dirty(persist_key_t key)
+{
+    values[key].dirty = true;
+    stats.sets++;
+    stats.dirty = true;
+    if (!commit_armed) {
+        commit_armed = true;
+        scheduler_arm(&commit_job, PERSIST_COMMIT_DELAY_MS);
+    }
+}
+
+// Runs from esp_restart()
+static void persist_shutdown_handler(void)
+{
+    if (xSemaphoreTake(persist_lock, pdMS_TO_TICKS(100)) == pdTRUE) {
+        if (stats.dirty) {
+            persist_commit_locked();
+        }
+        xSemaphoreGive(persist_lock);
+    }
+}
+
+esp_err_t persist_init(void)
+{
+    persist_lock = xSemaphoreCreateMutex();
+    if (!persist_lock) {
+        return ESP_ERR_NO_MEM;
+    }
+    for (int key = 0; key < PERSIST_KEY_COUNT; key++) {
+        persist_load((persist_key_t)key);
+    }
+    scheduler_add(&commit_job, "persist", 0, persist_commit_job, NULL);
+    ESP_LOGI(TAG, "Loaded %d keys (reboot count %lu, Wi-Fi %s)", PERSIST_KEY_COUNT,
+             (unsigned long)values[PERSIST_REBOOT_COUNT].u32,
+             values[PERSIST_WIFI_SSID].present ? "configured" : "not configured");
+    return esp_register_shutdown_handler(persist_shutdown_handler);
+}
+
+uint32_t persist_get_u32(persist_key_t key)
+{
+    xSemaphoreTake(persist_lock, portMAX_DELAY);
+    uint32_t value = values[key].u32;
+    xSemaphoreGive(persist_lock);
+    return value;
+}
+
+void persist_set_u32(persist_key_t key, uint32_t value)
+{
+    xSemaphoreTake(persist_lock, portMAX_DELAY);
+    persist_value_t *v = &values[key];
+    if (v->present && v->u32 == value) {
+        stats.unchanged++;
+    } else {
+        v->u32 = value;
+        v->present = true;
+        persist_mark_dirty(key);
+    }
+    xSemaphoreGive(persist_lock);
+}
+
+esp_err_t persist_get_str(persist_key_t key, char *buf, size_t len)
+{
+    esp_err_t err = ESP_OK;
+    xSemaphoreTake(persist_lock, portMAX_DELAY);
+    const persist_value_t *v = &values[key];
+    if (!v->present) {
+        err = ESP_ERR_NVS_NOT_FOUND;
+    } else if (strlen(v->str) >= len) {
+        err = ESP_ERR_INVALID_SIZE;
+    } else {
+        strcpy(buf, v->str);
+    }
+    xSemaphoreGive(persist_lock);
+    return err;
+}
+
+esp_err_t persist_set_str(persist_key_t key, const char *value)
+{
+    if (strlen(value) >= PERSIST_STR_MAX) {
+        return ESP_ERR_INVALID_SIZE;
+    }
+    xSemaphoreTake(persist_lock, portMAX_DELAY);
+    persist_value_t *v = &values[key];
+    if (v->present && strcmp(v->str, value) == 0) {
+        stats.unchanged++;
+    } else {
+        strcpy(v->str, value);
+        v->present = true;
+        persist_mark_dirty(key);
+    }
+    xSemaphoreGive(persist_lock);
+    return ESP_OK;
+}
+
+void persist_erase(persist_key_t key)
+{
+    xSemaphoreTake(persist_lock, portMAX_DELAY);
+    persist_value_t *v = &values[key];
+    if (v->present) {
+        memset(v, 0, sizeof(*v));
+        persist_mark_dirty(key);
+    }
+    xSemaphoreGive(persist_lock);
+}
+
+esp_err_t persist_flush(void)
+{
+    xSemaphoreTake(persist_lock, portMAX_DELAY);
+    esp_err_t err = stats.dirty ? persist_commit_locked() : ESP_OK;
+    xSemaphoreGive(persist_lock);
+    return err;
+}
+
+void persist_get_stats(persist_stats_t *out)
+{
+    xSemaphoreTake(persist_lock, portMAX_DELAY);
+    *out = stats;
+    xSemaphoreGive(persist_lock);
+}
@@ -0,0 +1,59 @@
+/*
+ * Persistent State
+ *
+ * Typed settings and counters kept in NVS: every key is loaded once by
+ * persist_init() and read from RAM afterwards. A set that changes a value
+ * marks the key dirty and arms a commit CONFIG_UPS_PERSIST_COMMIT_DELAY_S
+ * later, so a burst of changes costs one flash write and a set that does not
+ * change anything costs none. Dirty keys are also committed on esp_restart().
+ *
+ * Callers that must know the value reached flash (configuration saved from
+ * the web UI, the stale-UPS restart counter) call persist_flush().
+ */
+
+#ifndef PERSIST_H
+#define PERSIST_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "esp_err.h"
+
+typedef enum {
+    PERSIST_REBOOT_COUNT = 0,       // u32: consecutive restarts for a stale UPS
+    PERSIST_WIFI_SSID,              // str
+    PERSIST_WIFI_PASSWORD,          // str
+    PERSIST_KEY_COUNT
+} persist_key_t;
+
+#define PERSIST_STR_MAX 65          // Longest string value, including the terminator
+
+typedef struct {
+    uint32_t commits;               // NVS commits since boot
+    uint32_t sets;                  // Sets that changed a value
+    uint32_t unchanged;             // Sets that matched the cached value (no write)
+    uint32_t errors;                // Failed commits
+    bool dirty;                     // Changes waiting for the commit deadline
+} persist_stats_t;
+
+// Load every key from NVS. Call after nvs_flash_init().
+esp_err_t persist_init(void);
+
+// Cached value; 0 if the key was never set
+uint32_t persist_get_u32(persist_key_t key);
+void persist_set_u32(persist_key_t key, uint32_t value);
+
+// Copy the cached string; ESP_ERR_NVS_NOT_FOUND if unset, ESP_ERR_INVALID_SIZE
+// if it does not fit in len
+esp_err_t persist_get_str(persist_key_t key, char *buf, size_t len);
+esp_err_t persist_set_str(persist_key_t key, const char *value);
+
+// Remove a key (committed like a set)
+void persist_erase(persist_key_t key);
+
+// Commit dirty keys now
+esp_err_t persist_flush(void);
+
+void persist_get_stats(persist_stats_t *out);
+
+#endif // PERSIST_H
@@ -0,0 +1,154 @@
+#include "power_mgmt.h"
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_rom_sys.h"
+#include "latency_hist.h"
+#include "sdkconfig.h"
+#if CONFIG_UPS_PM_ENABLE
+#include "esp_pm.h"
+#endif
+
+static const char *TAG = "pm";
+
+typedef struct {
+    const char *name;
+#if CONFIG_UPS_PM_ENABLE
+    esp_pm_lock_type_t types[2];
+    int type_count;
+    esp_pm_lock_handle_t handles[2];
+#endif
+    // Stats, under pm_lock
+    uint32_t active;            // Outstanding acquires
+    uint32_t acquired;
+    int64_t since_us;           // Start of the current active period
+    uint64_t held_us;           // Completed active periods
+} power_lock_entry_t;
+
+static power_lock_entry_t locks[POWER_LOCK_COUNT] = {
+#if CONFIG_UPS_PM_ENABLE
+    [POWER_LOCK_USB] = { .name = "usb", .types = { ESP_PM_APB_FREQ_MAX, ESP_PM_NO_LIGHT_SLEEP }, .type_count = 2 },
+    [POWER_LOCK_NET] = { .name = "net", .types = { ESP_PM_CPU_FREQ_MAX }, .type_count = 1 },
+#else
+    [POWER_LOCK_USB] = { .name = "usb" },
+    [POWER_LOCK_NET] = { .name = "net" },
+#endif
+};
+
+static portMUX_TYPE pm_lock = portMUX_INITIALIZER_UNLOCKED;
+static bool pm_enabled = false;
+static latency_hist_t nut_wake_to_reply;
+
+esp_err_t power_mgmt_init(void)
+{
+#if CONFIG_UPS_PM_ENABLE
+    esp_pm_config_t config = {
+        .max_freq_mhz = CONFIG_UPS_PM_MAX_FREQ_MHZ,
+        .min_freq_mhz = CONFIG_UPS_PM_MIN_FREQ_MHZ,
+#if CONFIG_UPS_PM_LIGHT_SLEEP
+        .light_sleep_enable = true,
+#endif
+    };
+    esp_err_t err = esp_pm_configure(&config);
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "esp_pm_configure failed: %s", esp_err_to_name(err));
+        return err;
+    }
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        for (int t = 0; t < locks[i].type_count; t++) {
+            err = esp_pm_lock_create(locks[i].types[t], 0, locks[i].name, &locks[i].handles[t]);
+            if (err != ESP_OK) {
+                ESP_LOGE(TAG, "Cannot create %s lock: %s", locks[i].name, esp_err_to_name(err));
+                return err;
+            }
+        }
+    }
+    pm_enabled = true;
+    ESP_LOGI(TAG, "DFS %d-%d MHz, light sleep %s", CONFIG_UPS_PM_MIN_FREQ_MHZ, CONFIG_UPS_PM_MAX_FREQ_MHZ,
+             config.light_sleep_enable ? "on" : "off");
+#endif
+    return ESP_OK;
+}
+
+void power_mgmt_acquire(power_lock_t lock)
+{
+    power_lock_entry_t *l = &locks[lock];
+#if CONFIG_UPS_PM_ENABLE
+    if (pm_enabled) {
+        for (int t = 0; t < l->type_count; t++) {
+            esp_pm_lock_acquire(l->handles[t]);
+        }
+    }
+#endif
+    int64_t now_us = esp_timer_get_time();
+    taskENTER_CRITICAL(&pm_lock);
+    if (l->active++ == 0) {
+        l->since_us = now_us;
+    }
+    l->acquired++;
+    taskEXIT_CRITICAL(&pm_lock);
+}
+
+void power_mgmt_release(power_lock_t lock)
+{
+    power_lock_entry_t *l = &locks[lock];
+    int64_t now_us = esp_timer_get_time();
+    taskENTER_CRITICAL(&pm_lock);
+    if (l->active > 0 && --l->active == 0) {
+        l->held_us += now_us - l->since_us;
+    }
+    taskEXIT_CRITICAL(&pm_lock);
+#if CONFIG_UPS_PM_ENABLE
+    if (pm_enabled) {
+        for (int t = 0; t < l->type_count; t++) {
+            esp_pm_lock_release(l->handles[t]);
+        }
+    }
+#endif
+}
+
+void power_mgmt_nut_reply(uint32_t wake_to_reply_us)
+{
+    latency_hist_record(&nut_wake_to_reply, wake_to_reply_us, false);
+}
+
+void power_mgmt_write_json(json_writer_t *w)
+{
+    json_obj_begin(w, NULL);
+    json_bool(w, "enabled", pm_enabled);
+    json_uint(w, "cpu_mhz", esp_rom_get_cpu_ticks_per_us());
+#if CONFIG_UPS_PM_ENABLE
+    json_uint(w, "min_mhz", CONFIG_UPS_PM_MIN_FREQ_MHZ);
+    json_uint(w, "max_mhz", CONFIG_UPS_PM_MAX_FREQ_MHZ);
+#if CONFIG_UPS_PM_LIGHT_SLEEP
+    json_bool(w, "light_sleep", true);
+#else
+    json_bool(w, "light_sleep", false);
+#endif
+#endif
+
+    int64_t now_us = esp_timer_get_time();
+    json_arr_begin(w, "locks");
+    for (int i = 0; i < POWER_LOCK_COUNT; i++) {
+        taskENTER_CRITICAL(&pm_lock);
+        power_lock_entry_t l = locks[i];
+        taskEXIT_CRITICAL(&pm_lock);
+        uint64_t held_us = l.held_us + (l.active ? (uint64_t)(now_us - l.since_us) : 0);
+        json_obj_begin(w, NULL);
+        json_str(w, "name", l.name);
+        json_uint(w, "active", l.active);
+        json_uint(w, "acquired", l.acquired);
+        json_uint(w, "held_ms", held_us / 1000);
+        json_uint(w, "held_pct", now_us > 0 ? held_us * 100 / (uint64_t)now_us : 0);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+
+    latency_hist_t snapshot;
+    latency_hist_snapshot(&nut_wake_to_reply, &snapshot);
+    json_obj_begin(w, "nut_wake_to_reply");
+    latency_hist_write_json(w, &snapshot);
+    json_obj_end(w);
+    json_obj_end(w);
+}
@@ -0,0 +1,42 @@
+/*
+ * Power Management
+ *
+ * With CONFIG_UPS_PM_ENABLE the CPU clock scales between
+ * CONFIG_UPS_PM_MIN_FREQ_MHZ and CONFIG_UPS_PM_MAX_FREQ_MHZ through esp_pm and,
+ * optionally, the chip light-sleeps whenever every task is blocked. Work that
+ * must not be slowed or slept through holds a lock while it is active:
+ *   usb  a HID device is open (the USB controller needs APB clock and no
+ *        light sleep while interrupt transfers are scheduled)
+ *   net  a NUT command or an HTTP request is being served (full CPU clock)
+ *
+ * NUT wake-to-reply latency (select() returns -> reply sent) is always
+ * recorded, so the same number can be compared with power management on and
+ * off. /api/pm reports the configuration, lock activity and that histogram.
+ */
+
+#ifndef POWER_MGMT_H
+#define POWER_MGMT_H
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "json_writer.h"
+
+typedef enum {
+    POWER_LOCK_USB = 0,
+    POWER_LOCK_NET,
+    POWER_LOCK_COUNT
+} power_lock_t;
+
+// Configure DFS / light sleep and create the locks
+esp_err_t power_mgmt_init(void);
+
+// Counted; every acquire needs one release
+void power_mgmt_acquire(power_lock_t lock);
+void power_mgmt_release(power_lock_t lock);
+
+void power_mgmt_nut_reply(uint32_t wake_to_reply_us);
+
+// {"enabled":bool,"cpu_mhz":n,...,"locks":[...],"nut_wake_to_reply":{...}}
+void power_mgmt_write_json(json_writer_t *w);
+
+#endif // POWER_MGMT_H
@@ -0,0 +1,217 @@
+#include "power_quality.h"
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_log.h"
+#include "soe_recorder.h"
+
+static const char *TAG = "power-quality";
+
+// Thresholds derived from Kconfig (volts)
+#define PQ_NOMINAL_V      CONFIG_UPS_PQ_NOMINAL_VOLTAGE
+#define PQ_SAG_V          (PQ_NOMINAL_V - (PQ_NOMINAL_V * CONFIG_UPS_PQ_SAG_PERCENT) / 100)
+#define PQ_SWELL_V        (PQ_NOMINAL_V + (PQ_NOMINAL_V * CONFIG_UPS_PQ_SWELL_PERCENT) / 100)
+#define PQ_TRANSFER_V     CONFIG_UPS_PQ_TRANSFER_LOW_VOLTAGE
+#define PQ_HYSTERESIS_V   CONFIG_UPS_PQ_HYSTERESIS_VOLTAGE
+#define PQ_DEBOUNCE       CONFIG_UPS_PQ_DEBOUNCE_SAMPLES
+#define PQ_BROWNOUT_MS    CONFIG_UPS_PQ_BROWNOUT_MS
+#define PQ_JOURNAL_SIZE   CONFIG_UPS_PQ_JOURNAL_SIZE
+
+static portMUX_TYPE pq_lock = portMUX_INITIALIZER_UNLOCKED;
+
+// Confirmed state
+static pq_band_t band = PQ_BAND_NORMAL;
+static pq_event_t active_event;
+static uint32_t last_sample_ms = 0;
+
+// Pending band change (debounce)
+static pq_band_t candidate = PQ_BAND_NORMAL;
+static uint8_t candidate_count = 0;
+static uint32_t candidate_start_ms = 0;
+static uint16_t candidate_extreme = 0;
+
+// Finished events (ring buffer)
+static pq_event_t journal[PQ_JOURNAL_SIZE];
+static size_t journal_head = 0;   // Next write position
+static size_t journal_count = 0;
+
+static uint32_t sample_count = 0;
+static uint32_t event_counts[PQ_EVENT_TYPE_COUNT];
+static uint32_t journal_dropped = 0;
+
+static bool band_is_low(pq_band_t b)
+{
+    return b == PQ_BAND_SAG || b == PQ_BAND_TRANSFER;
+}
+
+// Classify a sample. Leaving a band needs the voltage to clear the threshold
+// by the hysteresis margin, entering one only needs to cross it.
+static pq_band_t classify(int v, pq_band_t current)
+{
+    if (v < (current == PQ_BAND_TRANSFER ? PQ_TRANSFER_V + PQ_HYSTERESIS_V : PQ_TRANSFER_V)) {
+        return PQ_BAND_TRANSFER;
+    }
+    if (v < (band_is_low(current) ? PQ_SAG_V + PQ_HYSTERESIS_V : PQ_SAG_V)) {
+        return PQ_BAND_SAG;
+    }
+    if (v > (current == PQ_BAND_SWELL ? PQ_SWELL_V - PQ_HYSTERESIS_V : PQ_SWELL_V)) {
+        return PQ_BAND_SWELL;
+    }
+    return PQ_BAND_NORMAL;
+}
+
+static uint16_t track_extreme(pq_band_t b, uint16_t extreme, int v)
+{
+    uint16_t sample = (v < 0) ? 0 : (v > UINT16_MAX ? UINT16_MAX : (uint16_t)v);
+    if (b == PQ_BAND_SWELL) {
+        return sample > extreme ? sample : extreme;
+    }
+    return sample < extreme ? sample : extreme;
+}
+
+static pq_event_type_t event_type_for(pq_band_t b, uint32_t duration_ms)
+{
+    switch (b) {
+        case PQ_BAND_SWELL:    return PQ_EVENT_SWELL;
+        case PQ_BAND_TRANSFER: return PQ_EVENT_TRANSFER;
+        default:               return duration_ms >= PQ_BROWNOUT_MS ? PQ_EVENT_BROWNOUT : PQ_EVENT_SAG;
+    }
+}
+
+// Called with pq_lock held
+static void close_active_event(uint32_t end_ms)
+{
+    active_event.duration_ms = end_ms - active_event.start_ms;
+    active_event.type = event_type_for(band, active_event.duration_ms);
+
+    if (journal_count == PQ_JOURNAL_SIZE) {
+        journal_dropped++;
+    } else {
+        journal_count++;
+    }
+    journal[journal_head] = active_event;
+    journal_head = (journal_head + 1) % PQ_JOURNAL_SIZE;
+    event_counts[active_event.type]++;
+}
+
+void power_quality_process_sample(int voltage, uint32_t now_ms)
+{
+    bool closed = false;
+    bool band_changed = false;
+    pq_band_t new_band;
+    pq_event_t closed_event;
+
+    taskENTER_CRITICAL(&pq_lock);
+    sample_count++;
+    last_sample_ms = now_ms;
+
+    pq_band_t observed = classify(voltage, band);
+    if (observed == band) {
+        // Still in the confirmed band, drop any pending change
+        candidate_count = 0;
+        if (band != PQ_BAND_NORMAL) {
+            active_event.extreme_voltage = track_extreme(band, active_event.extreme_voltage, voltage);
+        }
+    } else {
+        if (candidate_count == 0 || observed != candidate) {
+            candidate = observed;
+            candidate_count = 0;
+            candidate_start_ms = now_ms;
+            candidate_extreme = (observed == PQ_BAND_SWELL) ? 0 : UINT16_MAX;
+        }
+        candidate_count++;
+        candidate_extreme = track_extreme(candidate, candidate_extreme, voltage);
+
+        if (candidate_count >= PQ_DEBOUNCE) {
+            if (band != PQ_BAND_NORMAL) {
+                close_active_event(candidate_start_ms);
+                closed_event = active_event;
+                closed = true;
+            }
+            band = candidate;
+            band_changed = true;
+            candidate_count = 0;
+            if (band != PQ_BAND_NORMAL) {
+                active_event.type = event_type_for(band, 0);
+                active_event.start_ms = candidate_start_ms;
+                active_event.duration_ms = 0;
+                active_event.extreme_voltage = candidate_extreme;
+            }
+        }
+    }
+    new_band = band;
+    taskEXIT_CRITICAL(&pq_lock);
+
+    if (band_changed) {
+        soe_record(SOE_POWER_BAND, (uint32_t)new_band);
+    }
+    if (closed) {
+        ESP_LOGW(TAG, "%s ended: %lu ms, extreme %u V",
+                 power_quality_event_name(closed_event.type),
+                 (unsigned long)closed_event.duration_ms, closed_event.extreme_voltage);
+    }
+}
+
+pq_band_t power_quality_current_band(void)
+{
+    return band;
+}
+
+void power_quality_get_stats(pq_stats_t *out)
+{
+    taskENTER_CRITICAL(&pq_lock);
+    out->band = band;
+    out->event_active = (band != PQ_BAND_NORMAL);
+    out->active = active_event;
+    if (out->event_active) {
+        out->active.duration_ms = last_sample_ms - active_event.start_ms;
+        out->active.type = event_type_for(band, out->active.duration_ms);
+    }
+    out->samples = sample_count;
+    memcpy(out->event_counts, event_counts, sizeof(event_counts));
+    out->journal_dropped = journal_dropped;
+    taskEXIT_CRITICAL(&pq_lock);
+}
+
+size_t power_quality_get_events(pq_event_t *out, size_t first, size_t max_events)
+{
+    taskENTER_CRITICAL(&pq_lock);
+    size_t n = first < journal_count ? journal_count - first : 0;
+    if (n > max_events) {
+        n = max_events;
+    }
+    size_t oldest = (journal_head + PQ_JOURNAL_SIZE - journal_count) % PQ_JOURNAL_SIZE;
+    size_t start = (oldest + first) % PQ_JOURNAL_SIZE;
+    for (size_t i = 0; i < n; i++) {
+        out[i] = journal[(start + i) % PQ_JOURNAL_SIZE];
+    }
+    taskEXIT_CRITICAL(&pq_lock);
+    return n;
+}
+
+size_t power_quality_journal_capacity(void)
+{
+    return PQ_JOURNAL_SIZE;
+}
+
+const char *power_quality_event_name(pq_event_type_t type)
+{
+    switch (type) {
+        case PQ_EVENT_SAG:      return "sag";
+        case PQ_EVENT_SWELL:    return "swell";
+        case PQ_EVENT_BROWNOUT: return "brownout";
+        case PQ_EVENT_TRANSFER: return "transfer";
+        default:                return "unknown";
+    }
+}
+
+const char *power_quality_band_name(pq_band_t b)
+{
+    switch (b) {
+        case PQ_BAND_NORMAL:   return "normal";
+        case PQ_BAND_SAG:      return "sag";
+        case PQ_BAND_SWELL:    return "swell";
+        case PQ_BAND_TRANSFER: return "transfer";
+        default:               return "unknown";
+    }
+}
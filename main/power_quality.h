@@ -0,0 +1,69 @@
+/*
+ * Power Quality Analyzer
+ *
+ * Streaming classifier for the UPS input voltage. Each sample is folded into a
+ * small state machine (hysteresis + debounce) so no raw samples are buffered.
+ * Finished events are kept in a bounded journal for auditing utility power.
+ */
+
+#ifndef POWER_QUALITY_H
+#define POWER_QUALITY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+// Voltage band the analyzer currently considers confirmed
+typedef enum {
+    PQ_BAND_NORMAL = 0,
+    PQ_BAND_SAG,
+    PQ_BAND_SWELL,
+    PQ_BAND_TRANSFER
+} pq_band_t;
+
+// Event classes recorded in the journal
+typedef enum {
+    PQ_EVENT_SAG = 0,
+    PQ_EVENT_SWELL,
+    PQ_EVENT_BROWNOUT,      // Sag that lasted longer than the brown-out limit
+    PQ_EVENT_TRANSFER,      // Input below the transfer threshold (UPS on battery)
+    PQ_EVENT_TYPE_COUNT
+} pq_event_type_t;
+
+typedef struct {
+    pq_event_type_t type;
+    uint32_t start_ms;          // ms since boot of the first out-of-band sample
+    uint32_t duration_ms;
+    uint16_t extreme_voltage;   // Minimum for sag/brown-out/transfer, maximum for swell
+} pq_event_t;
+
+typedef struct {
+    pq_band_t band;
+    bool event_active;
+    pq_event_t active;          // Valid when event_active, duration is up to the last sample
+    uint32_t samples;
+    uint32_t event_counts[PQ_EVENT_TYPE_COUNT];
+    uint32_t journal_dropped;   // Events overwritten because the journal was full
+} pq_stats_t;
+
+// Feed one input.voltage sample (volts) taken at now_ms
+void power_quality_process_sample(int voltage, uint32_t now_ms);
+
+// Confirmed band (cheap, no copy)
+pq_band_t power_quality_current_band(void);
+
+// Copy the current state and counters
+void power_quality_get_stats(pq_stats_t *out);
+
+// Copy finished events, oldest first, starting at index `first`. Returns the
+// number copied; read in batches until it returns 0. An event finishing
+// between batches of a full journal shifts the indexes by one.
+size_t power_quality_get_events(pq_event_t *out, size_t first, size_t max_events);
+
+// Journal capacity (events)
+size_t power_quality_journal_capacity(void);
+
+const char *power_quality_event_name(pq_event_type_t type);
+const char *power_quality_band_name(pq_band_t band);
+
+#endif // POWER_QUALITY_H
@@ -0,0 +1,149 @@
+#include "report_trace.h"
+#include "freertos/FreeRTOS.h"
+#include "esp_timer.h"
+
+#define CLIENT_STAGES (REPORT_TRACE_STAGE_COUNT - REPORT_TRACE_NUT)
+
+// Oldest change a client stage has not served yet
+typedef struct {
+    uint32_t pending;           // Generation of the oldest unseen change, 0 = none
+    int64_t pending_us;         // Its arrival time
+} trace_client_t;
+
+static latency_hist_t stages[REPORT_TRACE_STAGE_COUNT];
+static report_trace_hook_t trace_hook = NULL;
+
+// Report in flight; only the USB callback task touches these
+static int64_t arrival_us = 0;
+static int64_t parsed_us = 0;
+
+static portMUX_TYPE trace_lock = portMUX_INITIALIZER_UNLOCKED;
+static uint32_t generation = 0;
+static int64_t generation_us = 0;   // Arrival of the newest change
+static trace_client_t clients[CLIENT_STAGES];
+
+static void record(report_trace_stage_t stage, int64_t start_us, int64_t end_us, uint32_t gen)
+{
+    int64_t duration = end_us - start_us;
+    latency_hist_record(&stages[stage], duration > UINT32_MAX ? UINT32_MAX : (uint32_t)duration, false);
+    report_trace_hook_t hook = trace_hook;
+    if (hook) {
+        hook(stage, start_us, end_us, gen);
+    }
+}
+
+void report_trace_arrival(void)
+{
+    arrival_us = esp_timer_get_time();
+}
+
+void report_trace_parsed(void)
+{
+    parsed_us = esp_timer_get_time();
+    // Reports injected without an arrival stamp start here
+    if (arrival_us == 0) {
+        arrival_us = parsed_us;
+    }
+    record(REPORT_TRACE_PARSE, arrival_us, parsed_us, generation);
+}
+
+void report_trace_published(bool changed)
+{
+    int64_t now = esp_timer_get_time();
+    if (parsed_us == 0) {
+        return;
+    }
+    uint32_t gen = generation;
+    if (changed) {
+        taskENTER_CRITICAL(&trace_lock);
+        gen = ++generation;
+        generation_us = arrival_us;
+        for (size_t i = 0; i < CLIENT_STAGES; i++) {
+            if (clients[i].pending == 0) {
+                clients[i].pending = gen;
+                clients[i].pending_us = arrival_us;
+            }
+        }
+        taskEXIT_CRITICAL(&trace_lock);
+    }
+    record(REPORT_TRACE_PUBLISH, parsed_us, now, gen);
+    arrival_us = 0;
+    parsed_us = 0;
+}
+
+uint32_t report_trace_generation(void)
+{
+    return __atomic_load_n(&generation, __ATOMIC_ACQUIRE);
+}
+
+void report_trace_served(report_trace_stage_t stage, uint32_t served)
+{
+    if (stage < REPORT_TRACE_NUT || stage >= REPORT_TRACE_STAGE_COUNT) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    trace_client_t *c = &clients[stage - REPORT_TRACE_NUT];
+
+    taskENTER_CRITICAL(&trace_lock);
+    bool hit = c->pending != 0 && c->pending <= served;
+    int64_t start_us = c->pending_us;
+    uint32_t gen = c->pending;
+    if (hit) {
+        c->pending = 0;
+        // A change published while this reply was being built is still unseen;
+        // the newest arrival stands in for it (off by at most the reply time)
+        if (generation > served) {
+            c->pending = served + 1;
+            c->pending_us = generation_us;
+        }
+    }
+    taskEXIT_CRITICAL(&trace_lock);
+
+    if (hit) {
+        record(stage, start_us, now, gen);
+    }
+}
+
+void report_trace_get(report_trace_stage_t stage, latency_hist_t *out)
+{
+    latency_hist_snapshot(&stages[stage], out);
+}
+
+const char *report_trace_stage_name(report_trace_stage_t stage)
+{
+    switch (stage) {
+        case REPORT_TRACE_PARSE:   return "parse";
+        case REPORT_TRACE_PUBLISH: return "publish";
+        case REPORT_TRACE_NUT:     return "nut";
+        case REPORT_TRACE_HTTP:    return "http";
+        case REPORT_TRACE_WS:      return "ws";
+        default:                   return "unknown";
+    }
+}
+
+void report_trace_set_hook(report_trace_hook_t hook)
+{
+    trace_hook = hook;
+}
+
+void report_trace_write_json(json_writer_t *w)
+{
+    json_obj_begin(w, NULL);
+    json_uint(w, "generation", report_trace_generation());
+    json_arr_begin(w, "bucket_bounds_us");
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        json_uint(w, NULL, latency_hist_bucket_bound_us(i));
+    }
+    json_arr_end(w);
+    json_arr_begin(w, "stages");
+    for (size_t i = 0; i < REPORT_TRACE_STAGE_COUNT; i++) {
+        latency_hist_t hist;
+        latency_hist_snapshot(&stages[i], &hist);
+        json_obj_begin(w, NULL);
+        json_str(w, "stage", report_trace_stage_name((report_trace_stage_t)i));
+        latency_hist_write_json(w, &hist);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+    json_obj_end(w);
+}
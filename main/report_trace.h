@@ -0,0 +1,62 @@
+/*
+ * Report Latency Trace
+ *
+ * Follows UPS reports from USB arrival to the first client that sees them.
+ * The USB callback stamps arrival, ups_monitor stamps decode and publish, and
+ * each exporter (NUT, HTTP, WebSocket) reports when it has sent a reply built
+ * from a given publish generation. All stamps are esp_timer_get_time().
+ *
+ * Stages, each a latency_hist_t:
+ *   parse    arrival -> report decoded
+ *   publish  decoded -> values published to exporters
+ *   nut/http/ws
+ *            arrival of the oldest change a client had not seen -> reply sent
+ *
+ * The client stages are what a shutdown SLA depends on: they include the
+ * client's poll interval, so they read in seconds for polling clients and in
+ * milliseconds for the WebSocket push.
+ */
+
+#ifndef REPORT_TRACE_H
+#define REPORT_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "latency_hist.h"
+#include "json_writer.h"
+
+typedef enum {
+    REPORT_TRACE_PARSE = 0,
+    REPORT_TRACE_PUBLISH,
+    REPORT_TRACE_NUT,
+    REPORT_TRACE_HTTP,
+    REPORT_TRACE_WS,
+    REPORT_TRACE_STAGE_COUNT
+} report_trace_stage_t;
+
+// Optional per-span callback (host trace export); start/end in esp_timer us
+typedef void (*report_trace_hook_t)(report_trace_stage_t stage, int64_t start_us, int64_t end_us,
+                                    uint32_t generation);
+
+// USB callback entry for an input report
+void report_trace_arrival(void);
+
+// ups_monitor: report decoded / values published. `changed` if the published
+// values differ from the previous publish (starts a new generation).
+void report_trace_parsed(void);
+void report_trace_published(bool changed);
+
+// Generation of the values exporters currently see. Read it before building
+// a reply; pass it to report_trace_served() once the reply is sent.
+uint32_t report_trace_generation(void);
+void report_trace_served(report_trace_stage_t stage, uint32_t generation);
+
+void report_trace_get(report_trace_stage_t stage, latency_hist_t *out);
+const char *report_trace_stage_name(report_trace_stage_t stage);
+
+void report_trace_set_hook(report_trace_hook_t hook);
+
+// {"generation":n,"bucket_bounds_us":[...],"stages":[{"stage":"parse",...}]}
+void report_trace_write_json(json_writer_t *w);
+
+#endif // REPORT_TRACE_H
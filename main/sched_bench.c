@@ -0,0 +1,80 @@
+#include "sched_bench.h"
+
+#if CONFIG_UPS_SCHED_BENCHMARK
+
+#include <string.h>
+#include "esp_timer.h"
+#include "latency_hist.h"
+#include "task_plan.h"
+
+typedef enum {
+    BENCH_USB_INTERVAL = 0,
+    BENCH_USB_JITTER,
+    BENCH_USB_CALLBACK,
+    BENCH_NUT_REPLY,
+    BENCH_COUNT
+} bench_hist_t;
+
+static const char *const bench_names[BENCH_COUNT] = {
+    [BENCH_USB_INTERVAL] = "usb_interval",
+    [BENCH_USB_JITTER]   = "usb_jitter",
+    [BENCH_USB_CALLBACK] = "usb_callback",
+    [BENCH_NUT_REPLY]    = "nut_reply",
+};
+
+static latency_hist_t hists[BENCH_COUNT];
+static int64_t since_us = 0;
+
+// HID driver task only
+static int64_t last_report_us = 0;
+static int64_t last_interval_us = -1;
+
+static uint32_t clamp_us(int64_t us)
+{
+    return us < 0 ? 0 : us > UINT32_MAX ? UINT32_MAX : (uint32_t)us;
+}
+
+void sched_bench_usb_report(int64_t start_us, int64_t end_us)
+{
+    if (last_report_us) {
+        int64_t interval = start_us - last_report_us;
+        latency_hist_record(&hists[BENCH_USB_INTERVAL], clamp_us(interval), false);
+        if (last_interval_us >= 0) {
+            int64_t delta = interval - last_interval_us;
+            latency_hist_record(&hists[BENCH_USB_JITTER], clamp_us(delta < 0 ? -delta : delta), false);
+        }
+        last_interval_us = interval;
+    }
+    last_report_us = start_us;
+    latency_hist_record(&hists[BENCH_USB_CALLBACK], clamp_us(end_us - start_us), false);
+}
+
+void sched_bench_nut_reply(uint32_t duration_us)
+{
+    latency_hist_record(&hists[BENCH_NUT_REPLY], duration_us, false);
+}
+
+void sched_bench_reset(void)
+{
+    // Racing recorders may lose a sample or two; fine for a benchmark
+    memset(hists, 0, sizeof(hists));
+    last_interval_us = -1;
+    since_us = esp_timer_get_time();
+}
+
+void sched_bench_write_json(json_writer_t *w)
+{
+    json_obj_begin(w, NULL);
+    json_str(w, "profile", TASK_PROFILE_NAME);
+    json_uint(w, "window_ms", (uint64_t)((esp_timer_get_time() - since_us) / 1000));
+    for (int i = 0; i < BENCH_COUNT; i++) {
+        latency_hist_t snapshot;
+        latency_hist_snapshot(&hists[i], &snapshot);
+        json_obj_begin(w, bench_names[i]);
+        latency_hist_write_json(w, &snapshot);
+        json_obj_end(w);
+    }
+    json_obj_end(w);
+}
+
+#endif // CONFIG_UPS_SCHED_BENCHMARK
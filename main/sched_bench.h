@@ -0,0 +1,44 @@
+/*
+ * Scheduling Benchmark
+ *
+ * With CONFIG_UPS_SCHED_BENCHMARK the firmware measures what the scheduling
+ * profile (task_plan.h) is meant to protect, as latency_hist_t histograms:
+ *   usb_interval  time between HID input report callbacks
+ *   usb_jitter    |interval - previous interval|; with a UPS reporting at a
+ *                 steady rate this is the scheduling jitter of the USB path
+ *   usb_callback  input report callback duration (decode and publish included)
+ *   nut_reply     NUT command received -> reply sent
+ *
+ * tools/sched_bench.py loads Wi-Fi with HTTP traffic, times NUT round trips
+ * from the host and reads these from /api/sched_bench. Without the option
+ * the hooks compile to nothing.
+ */
+
+#ifndef SCHED_BENCH_H
+#define SCHED_BENCH_H
+
+#include <stdint.h>
+#include "sdkconfig.h"
+#include "json_writer.h"
+
+#if CONFIG_UPS_SCHED_BENCHMARK
+
+// HID input report callback ran from start_us to end_us (esp_timer_get_time)
+void sched_bench_usb_report(int64_t start_us, int64_t end_us);
+
+void sched_bench_nut_reply(uint32_t duration_us);
+
+// Clear all histograms
+void sched_bench_reset(void);
+
+// {"profile":"split","usb_interval":{...},"usb_jitter":{...},...}
+void sched_bench_write_json(json_writer_t *w);
+
+#else
+
+static inline void sched_bench_usb_report(int64_t start_us, int64_t end_us) {}
+static inline void sched_bench_nut_reply(uint32_t duration_us) {}
+
+#endif // CONFIG_UPS_SCHED_BENCHMARK
+
+#endif // SCHED_BENCH_H
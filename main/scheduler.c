@@ -0,0 +1,293 @@
+#include "scheduler.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "supervisor.h"
+#include "task_plan.h"
+#include "sdkconfig.h"
+
+static const char *TAG = "scheduler";
+
+#define SCHEDULER_TASK_STACK    CONFIG_UPS_STACK_SCHEDULER
+#define SCHEDULER_TASK_PRIORITY TASK_PRIO_SCHEDULER
+#define SCHEDULER_MAX_JOBS      16
+#define SCHEDULER_MAX_SLEEP_MS  5000    // Wake at least this often to beat the supervisor
+
+#define WHEEL_BITS      6
+#define WHEEL_SIZE      (1u << WHEEL_BITS)
+#define WHEEL_MASK      (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS    4
+#define WHEEL_MAX_DELAY ((1u << (WHEEL_BITS * WHEEL_LEVELS)) - 1)
+
+// Level L holds jobs due in [64^L, 64^(L+1)) ticks, bucketed by their tick >>
+// 6L. A level-L bucket cascades down when the tick reaches the start of its
+// range; level-0 buckets hold exactly the jobs due at that tick.
+static portMUX_TYPE sched_lock = portMUX_INITIALIZER_UNLOCKED;
+static scheduler_job_t *wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static uint32_t wheel_now = 0;          // Last tick processed
+static scheduler_job_t *jobs[SCHEDULER_MAX_JOBS];
+static size_t job_count = 0;
+static TaskHandle_t scheduler_task_handle = NULL;
+
+// Caller holds sched_lock
+static void wheel_insert(scheduler_job_t *job)
+{
+    uint32_t delta = job->expires - wheel_now;
+    if (delta > WHEEL_MAX_DELAY) {
+        job->expires = wheel_now + WHEEL_MAX_DELAY;
+        delta = WHEEL_MAX_DELAY;
+    }
+    int level = 0;
+    while (level < WHEEL_LEVELS - 1 && delta >= (1u << (WHEEL_BITS * (level + 1)))) {
+        level++;
+    }
+    scheduler_job_t **bucket = &wheel[level][(job->expires >> (WHEEL_BITS * level)) & WHEEL_MASK];
+    job->next = *bucket;
+    job->bucket = bucket;
+    job->armed = true;
+    *bucket = job;
+}
+
+static void wheel_remove(scheduler_job_t *job)
+{
+    if (!job->armed) {
+        return;
+    }
+    for (scheduler_job_t **p = job->bucket; *p; p = &(*p)->next) {
+        if (*p == job) {
+            *p = job->next;
+            break;
+        }
+    }
+    job->armed = false;
+    job->bucket = NULL;
+}
+
+// Ticks from wheel_now to the next bucket that expires or cascades; UINT32_MAX if empty
+static uint32_t next_event_distance(void)
+{
+    uint32_t best = UINT32_MAX;
+    for (uint32_t s = 0; s < WHEEL_SIZE; s++) {
+        if (wheel[0][s]) {
+            uint32_t d = (s - wheel_now) & WHEEL_MASK;
+            d = d ? d : WHEEL_SIZE;
+            if (d < best) {
+                best = d;
+            }
+        }
+    }
+    for (int level = 1; level < WHEEL_LEVELS; level++) {
+        uint32_t shift = WHEEL_BITS * level;
+        uint32_t base = (wheel_now & ~((1u << shift) - 1)) + (1u << shift);
+        for (uint32_t s = 0; s < WHEEL_SIZE; s++) {
+            if (wheel[level][s]) {
+                uint32_t k = (s - (base >> shift)) & WHEEL_MASK;
+                uint32_t d = base + (k << shift) - wheel_now;
+                if (d < best) {
+                    best = d;
+                }
+            }
+        }
+    }
+    return best;
+}
+
+// Advance to `now`, cascading on the way; jobs due are unlinked into due[]
+static size_t wheel_advance(uint32_t now, scheduler_job_t **due, uint32_t *due_expires, size_t max_due)
+{
+    size_t n = 0;
+    while (wheel_now != now) {
+        uint32_t d = next_event_distance();
+        if (d > now - wheel_now) {
+            wheel_now = now;
+            break;
+        }
+        wheel_now += d;
+        for (int level = WHEEL_LEVELS - 1; level >= 1; level--) {
+            uint32_t shift = WHEEL_BITS * level;
+            if ((wheel_now & ((1u << shift) - 1)) == 0) {
+                scheduler_job_t *list = wheel[level][(wheel_now >> shift) & WHEEL_MASK];
+                wheel[level][(wheel_now >> shift) & WHEEL_MASK] = NULL;
+                while (list) {
+                    scheduler_job_t *job = list;
+                    list = list->next;
+                    wheel_insert(job);
+                }
+            }
+        }
+        scheduler_job_t **bucket = &wheel[0][wheel_now & WHEEL_MASK];
+        while (*bucket && n < max_due) {
+            scheduler_job_t *job = *bucket;
+            *bucket = job->next;
+            job->armed = false;
+            job->bucket = NULL;
+            due_expires[n] = job->expires;
+            due[n++] = job;
+        }
+    }
+    return n;
+}
+
+static void run_job(scheduler_job_t *job)
+{
+    int64_t start_us = esp_timer_get_time();
+    job->fn(job->arg);
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+    job->runs++;
+    if (elapsed_us > job->max_run_us) {
+        job->max_run_us = elapsed_us;
+    }
+}
+
+static void scheduler_task(void *pvParameters)
+{
+    scheduler_job_t *due[SCHEDULER_MAX_JOBS];
+    uint32_t due_expires[SCHEDULER_MAX_JOBS];
+
+    ESP_LOGI(TAG, "Scheduler started (%u jobs)", (unsigned)job_count);
+    while (1) {
+        supervisor_beat(SUPERVISOR_SCHEDULER);
+
+        for (size_t i = 0; i < job_count; i++) {
+            if (__atomic_exchange_n(&jobs[i]->triggered, false, __ATOMIC_ACQ_REL)) {
+                run_job(jobs[i]);
+            }
+        }
+
+        taskENTER_CRITICAL(&sched_lock);
+        size_t n = wheel_advance(xTaskGetTickCount(), due, due_expires, SCHEDULER_MAX_JOBS);
+        taskEXIT_CRITICAL(&sched_lock);
+
+        for (size_t i = 0; i < n; i++) {
+            scheduler_job_t *job = due[i];
+            run_job(job);
+            if (job->period_ticks == 0) {
+                continue;
+            }
+            // Next run one period after the previous one was due, unless the job re-armed itself
+            taskENTER_CRITICAL(&sched_lock);
+            if (!job->armed) {
+                job->expires = due_expires[i] + job->period_ticks;
+                if ((int32_t)(job->expires - wheel_now) <= 0) {
+                    job->late++;
+                    job->expires = wheel_now + job->period_ticks;
+                }
+                wheel_insert(job);
+            }
+            taskEXIT_CRITICAL(&sched_lock);
+        }
+
+        taskENTER_CRITICAL(&sched_lock);
+        uint32_t sleep = next_event_distance();
+        taskEXIT_CRITICAL(&sched_lock);
+        if (sleep > pdMS_TO_TICKS(SCHEDULER_MAX_SLEEP_MS)) {
+            sleep = pdMS_TO_TICKS(SCHEDULER_MAX_SLEEP_MS);
+        }
+        ulTaskNotifyTake(pdTRUE, sleep);
+    }
+}
+
+// Wake the scheduler so it recomputes its sleep
+static void scheduler_wake(void)
+{
+    if (scheduler_task_handle && xTaskGetCurrentTaskHandle() != scheduler_task_handle) {
+        xTaskNotifyGive(scheduler_task_handle);
+    }
+}
+
+void scheduler_add(scheduler_job_t *job, const char *name, uint32_t period_ms,
+                   scheduler_fn_t fn, void *arg)
+{
+    job->name = name;
+    job->fn = fn;
+    job->arg = arg;
+    job->period_ticks = period_ms ? pdMS_TO_TICKS(period_ms) : 0;
+    if (period_ms && job->period_ticks == 0) {
+        job->period_ticks = 1;
+    }
+    job->armed = false;
+    job->triggered = false;
+    job->bucket = NULL;
+
+    taskENTER_CRITICAL(&sched_lock);
+    bool added = job_count < SCHEDULER_MAX_JOBS;
+    if (added) {
+        if (job_count == 0 && !scheduler_task_handle) {
+            wheel_now = xTaskGetTickCount();
+        }
+        jobs[job_count++] = job;
+    }
+    taskEXIT_CRITICAL(&sched_lock);
+    if (!added) {
+        ESP_LOGE(TAG, "Job table full, %s not scheduled", name);
+        return;
+    }
+    if (period_ms) {
+        scheduler_arm(job, period_ms);
+    }
+}
+
+void scheduler_arm(scheduler_job_t *job, uint32_t delay_ms)
+{
+    uint32_t delay = pdMS_TO_TICKS(delay_ms);
+    taskENTER_CRITICAL(&sched_lock);
+    wheel_remove(job);
+    // At least one tick ahead of anything already processed
+    job->expires = xTaskGetTickCount() + (delay ? delay : 1);
+    if ((int32_t)(job->expires - wheel_now) <= 0) {
+        job->expires = wheel_now + 1;
+    }
+    wheel_insert(job);
+    taskEXIT_CRITICAL(&sched_lock);
+    scheduler_wake();
+}
+
+void scheduler_cancel(scheduler_job_t *job)
+{
+    taskENTER_CRITICAL(&sched_lock);
+    wheel_remove(job);
+    taskEXIT_CRITICAL(&sched_lock);
+}
+
+void IRAM_ATTR scheduler_trigger_from_isr(scheduler_job_t *job)
+{
+    __atomic_store_n(&job->triggered, true, __ATOMIC_RELEASE);
+    if (scheduler_task_handle) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(scheduler_task_handle, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+
+void scheduler_start(void)
+{
+    if (scheduler_task_handle) {
+        return;
+    }
+    supervisor_register(SUPERVISOR_SCHEDULER, "scheduler", CONFIG_UPS_SUPERVISOR_SCHEDULER_TIMEOUT_S * 1000,
+                        NULL, NULL);
+    if (xTaskCreatePinnedToCore(scheduler_task, "scheduler", SCHEDULER_TASK_STACK, NULL,
+                                SCHEDULER_TASK_PRIORITY, &scheduler_task_handle, TASK_CORE_HOUSEKEEPING) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create scheduler task");
+        scheduler_task_handle = NULL;
+    }
+}
+
+void scheduler_write_json(json_writer_t *w, const char *key)
+{
+    json_arr_begin(w, key);
+    for (size_t i = 0; i < job_count; i++) {
+        const scheduler_job_t *job = jobs[i];
+        json_obj_begin(w, NULL);
+        json_str(w, "name", job->name);
+        json_uint(w, "period_ms", (uint64_t)job->period_ticks * portTICK_PERIOD_MS);
+        json_bool(w, "armed", job->armed);
+        json_uint(w, "runs", job->runs);
+        json_uint(w, "late", job->late);
+        json_uint(w, "max_run_us", job->max_run_us);
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+}
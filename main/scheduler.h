@@ -0,0 +1,62 @@
+/*
+ * Periodic Job Scheduler
+ *
+ * One task runs every periodic and deferred job in the firmware (UPS
+ * freshness check, heap check, heap log, UPS detection timeout, BOOT button
+ * hold tracking) instead of one mostly sleeping task per job. Jobs sit in a
+ * hierarchical timer wheel of four 64-slot levels; one wheel tick is one
+ * FreeRTOS tick. The task sleeps until the next occupied slot (or the next
+ * cascade of a higher level), so a 2 s job costs one wake-up per 2 s.
+ *
+ * Jobs run one at a time on the scheduler task and must not block for long:
+ * a slow job delays every other one. Job storage belongs to the caller
+ * (static), so nothing is allocated.
+ */
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "json_writer.h"
+
+typedef void (*scheduler_fn_t)(void *arg);
+
+typedef struct scheduler_job {
+    const char *name;
+    scheduler_fn_t fn;
+    void *arg;
+    uint32_t period_ticks;      // 0 = one-shot
+    // Scheduler state
+    uint32_t expires;           // Wheel tick
+    struct scheduler_job *next;
+    struct scheduler_job **bucket;  // Wheel bucket while armed
+    bool armed;
+    bool triggered;             // Run as soon as possible (scheduler_trigger_from_isr)
+    uint32_t runs;
+    uint32_t late;              // Periodic runs that started a full period late
+    uint32_t max_run_us;
+} scheduler_job_t;
+
+// Register a job. period_ms > 0 arms it to run every period_ms, first after
+// one period; period_ms == 0 registers a one-shot job for scheduler_arm().
+void scheduler_add(scheduler_job_t *job, const char *name, uint32_t period_ms,
+                   scheduler_fn_t fn, void *arg);
+
+// (Re)arm a job to run once after delay_ms (periodic jobs continue at their
+// period from then on). Safe from any task.
+void scheduler_arm(scheduler_job_t *job, uint32_t delay_ms);
+
+// Disarm a job; a pending trigger is kept
+void scheduler_cancel(scheduler_job_t *job);
+
+// Run a registered job on the scheduler task as soon as possible
+void scheduler_trigger_from_isr(scheduler_job_t *job);
+
+// Start the scheduler task (jobs may be added before or after)
+void scheduler_start(void);
+
+// [{"name":...,"period_ms":n,"armed":bool,"runs":n,"late":n,"max_run_us":n}]
+void scheduler_write_json(json_writer_t *w, const char *key);
+
+#endif // SCHEDULER_H
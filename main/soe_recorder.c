@@ -0,0 +1,149 @@
+#include "soe_recorder.h"
+#include <string.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+
+static const char *TAG = "soe";
+
+#define SOE_MAGIC 0x31454F53  // "SOE1"
+#define SOE_SIZE  CONFIG_UPS_SOE_JOURNAL_SIZE
+
+typedef struct {
+    uint32_t magic;
+    uint32_t size;          // Capacity the journal was formatted with
+    uint16_t boot;
+    uint16_t reserved;
+    soe_record_t records[SOE_SIZE];
+} soe_rtc_t;
+
+// Survives warm reboots; validated in soe_init()
+static RTC_NOINIT_ATTR soe_rtc_t soe_rtc;
+
+// Last claimed sequence number. Kept in DRAM because atomic read-modify-write
+// is not available on RTC memory; rebuilt from the records at boot.
+static uint32_t soe_head = 0;
+
+// Scan the preserved records. Returns false if anything looks corrupted.
+static bool soe_scan(uint32_t *max_seq)
+{
+    *max_seq = 0;
+    if (soe_rtc.magic != SOE_MAGIC || soe_rtc.size != SOE_SIZE) {
+        return false;
+    }
+    for (size_t i = 0; i < SOE_SIZE; i++) {
+        const soe_record_t *r = &soe_rtc.records[i];
+        if (r->seq == 0) {
+            continue;
+        }
+        // A record must sit in the slot its sequence number maps to
+        if (r->type >= SOE_TYPE_COUNT || (r->seq - 1) % SOE_SIZE != i) {
+            return false;
+        }
+        if (r->seq > *max_seq) {
+            *max_seq = r->seq;
+        }
+    }
+    return true;
+}
+
+void soe_init(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool cold = (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT);
+    uint32_t max_seq = 0;
+
+    if (cold || !soe_scan(&max_seq)) {
+        memset(&soe_rtc, 0, sizeof(soe_rtc));
+        soe_rtc.magic = SOE_MAGIC;
+        soe_rtc.size = SOE_SIZE;
+        max_seq = 0;
+        ESP_LOGI(TAG, "Journal formatted (%u records)", (unsigned)SOE_SIZE);
+    } else {
+        soe_rtc.boot++;
+        ESP_LOGI(TAG, "Journal preserved across reset, boot #%u, last seq %lu",
+                 soe_rtc.boot, (unsigned long)max_seq);
+    }
+    __atomic_store_n(&soe_head, max_seq, __ATOMIC_RELEASE);
+    soe_record(SOE_BOOT, (uint32_t)reason);
+}
+
+void soe_record(soe_type_t type, uint32_t arg)
+{
+    int64_t now = esp_timer_get_time();
+    uint32_t seq = __atomic_add_fetch(&soe_head, 1, __ATOMIC_RELAXED);
+    soe_record_t *slot = &soe_rtc.records[(seq - 1) % SOE_SIZE];
+
+    // seq == 0 marks the slot as being rewritten so readers skip it
+    __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+    // Keep the data stores below from becoming visible before seq == 0
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->timestamp_us = now;
+    slot->arg = arg;
+    slot->boot = soe_rtc.boot;
+    slot->type = (uint8_t)type;
+    slot->reserved = 0;
+    __atomic_store_n(&slot->seq, seq, __ATOMIC_RELEASE);
+}
+
+size_t soe_read(uint32_t after_seq, soe_record_t *out, size_t max_records)
+{
+    uint32_t head = __atomic_load_n(&soe_head, __ATOMIC_ACQUIRE);
+    uint32_t first = (head > SOE_SIZE) ? head - SOE_SIZE + 1 : 1;
+    if (after_seq + 1 > first) {
+        first = after_seq + 1;
+    }
+
+    size_t n = 0;
+    for (uint32_t seq = first; seq <= head && n < max_records; seq++) {
+        const soe_record_t *slot = &soe_rtc.records[(seq - 1) % SOE_SIZE];
+        uint32_t stored = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (stored == 0 || stored < seq) {
+            // Claimed but not yet published: stop here so an incremental
+            // reader (since=<last seq>) picks it up on the next call
+            break;
+        }
+        if (stored > seq) {
+            continue;   // Already overwritten by a wrap
+        }
+        out[n] = *slot;
+        // Order the copy before the re-check (pairs with the writer's fence)
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+            continue;   // Overwritten by a wrap while copying
+        }
+        out[n].seq = seq;
+        n++;
+    }
+    return n;
+}
+
+uint16_t soe_boot_number(void)
+{
+    return soe_rtc.boot;
+}
+
+size_t soe_capacity(void)
+{
+    return SOE_SIZE;
+}
+
+const char *soe_type_name(uint8_t type)
+{
+    switch (type) {
+        case SOE_BOOT:                  return "boot";
+        case SOE_UPS_STATE:             return "ups_state";
+        case SOE_WIFI_UP:               return "wifi_up";
+        case SOE_WIFI_DOWN:             return "wifi_down";
+        case SOE_WEBSERVER_RESTART:     return "webserver_restart";
+        case SOE_NUT_CLIENT_CONNECT:    return "nut_connect";
+        case SOE_NUT_CLIENT_DISCONNECT: return "nut_disconnect";
+        case SOE_POWER_BAND:            return "power_band";
+        case SOE_RESTART_REQUEST:       return "restart_request";
+        case SOE_SUPERVISOR_STALL:      return "supervisor_stall";
+        default:                        return "unknown";
+    }
+}
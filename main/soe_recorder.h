@@ -0,0 +1,69 @@
+/*
+ * Sequence-of-Events Recorder
+ *
+ * Fixed-size binary journal of system state transitions stamped with the 64-bit
+ * esp_timer clock. Producers never block: a slot is claimed with one atomic
+ * increment, so recording is safe from any task. The journal lives in RTC
+ * no-init memory and survives warm reboots (software reset, panic, watchdog).
+ */
+
+#ifndef SOE_RECORDER_H
+#define SOE_RECORDER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Event types. The meaning of `arg` is given per type.
+typedef enum {
+    SOE_BOOT = 0,               // arg: esp_reset_reason_t
+    SOE_UPS_STATE,              // arg: new ups_connection_state_t
+    SOE_WIFI_UP,                // arg: IPv4 address (network byte order)
+    SOE_WIFI_DOWN,              // arg: 0
+    SOE_WEBSERVER_RESTART,      // arg: 0
+    SOE_NUT_CLIENT_CONNECT,     // arg: client IPv4 address (network byte order)
+    SOE_NUT_CLIENT_DISCONNECT,  // arg: socket number
+    SOE_POWER_BAND,             // arg: new pq_band_t
+    SOE_RESTART_REQUEST,        // arg: soe_restart_reason_t
+    SOE_SUPERVISOR_STALL,       // arg: supervisor_client_t
+    SOE_TYPE_COUNT
+} soe_type_t;
+
+// Why the firmware itself asked for esp_restart()
+typedef enum {
+    SOE_RESTART_HEAP_LOW = 1,
+    SOE_RESTART_UPS_STALE,
+    SOE_RESTART_CONFIG_SAVED,
+    SOE_RESTART_USER_REQUEST,
+    SOE_RESTART_WIFI_RESET,
+    SOE_RESTART_SUPERVISOR
+} soe_restart_reason_t;
+
+typedef struct {
+    int64_t timestamp_us;   // esp_timer_get_time() at the time of the event
+    uint32_t seq;           // Journal-wide sequence number, 0 = empty slot
+    uint32_t arg;
+    uint16_t boot;          // Boot number the event was recorded in
+    uint8_t type;           // soe_type_t
+    uint8_t reserved;
+} soe_record_t;
+
+// Validate or reset the RTC journal. Call once, early in app_main.
+void soe_init(void);
+
+// Append an event. Lock-free, safe to call from any task.
+void soe_record(soe_type_t type, uint32_t arg);
+
+// Copy records with seq > after_seq, oldest first. Stops before a record that
+// is still being written, so a reader resuming from the last seq it got never
+// skips one. Returns the number copied.
+size_t soe_read(uint32_t after_seq, soe_record_t *out, size_t max_records);
+
+// Current boot number (incremented on every warm reboot)
+uint16_t soe_boot_number(void);
+
+// Journal capacity (records)
+size_t soe_capacity(void);
+
+const char *soe_type_name(uint8_t type);
+
+#endif // SOE_RECORDER_H
@@ -0,0 +1,91 @@
+#include "status_snapshot.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_random.h"
+#include "esp_wifi.h"
+#include "esp_netif.h"
+#include "heap_monitor.h"
+#include "esp_heap_caps.h"
+
+// Signal bars have 4 levels; finer RSSI jitter is not worth a new version
+#define STATUS_RSSI_STEP 5
+
+static portMUX_TYPE snapshot_lock = portMUX_INITIALIZER_UNLOCKED;
+static status_snapshot_t published;
+
+// Compare everything except version and clocks
+static bool material_equal(const status_snapshot_t *a, const status_snapshot_t *b)
+{
+    return a->wifi_connected == b->wifi_connected &&
+           strcmp(a->ssid, b->ssid) == 0 &&
+           a->ip == b->ip &&
+           a->rssi == b->rssi &&
+           a->ups_state == b->ups_state &&
+           a->ups_stale_since_ms == b->ups_stale_since_ms &&
+           a->tcp_running == b->tcp_running &&
+           a->tcp_connections == b->tcp_connections &&
+           a->free_heap == b->free_heap &&
+           a->total_heap == b->total_heap &&
+           a->largest_free_block == b->largest_free_block;
+}
+
+void status_snapshot_refresh(void)
+{
+    status_snapshot_t next;
+    memset(&next, 0, sizeof(next));
+
+    wifi_ap_record_t ap_info;
+    if (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK) {
+        next.wifi_connected = true;
+        strncpy(next.ssid, (const char *)ap_info.ssid, sizeof(next.ssid) - 1);
+        // Round towards zero to a multiple of the step
+        next.rssi = (ap_info.rssi / STATUS_RSSI_STEP) * STATUS_RSSI_STEP;
+        esp_netif_ip_info_t ip_info;
+        esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
+        if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
+            next.ip = ip_info.ip.addr;
+        }
+    }
+
+    next.uptime_ms = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    next.ups_state = get_ups_state();
+    next.ups_last_data_ms = get_ups_last_data_time();
+    // Recorded once on the transition, so it stays put across refreshes
+    next.ups_stale_since_ms = get_ups_stale_since_ms();
+
+    next.tcp_running = is_tcp_server_running();
+    next.tcp_connections = get_active_tcp_connections();
+
+    heap_region_stats_t heap;
+    heap_monitor_region(MALLOC_CAP_DEFAULT, &heap);
+    next.free_heap = heap.free & ~1023U;
+    next.total_heap = heap.total;
+    next.memory_percent = heap.total ? (int)(((uint64_t)next.free_heap * 100) / heap.total) : 0;
+    next.largest_free_block = heap.largest_free_block & ~1023U;
+
+    taskENTER_CRITICAL(&snapshot_lock);
+    if (published.boot_nonce == 0) {
+        published.boot_nonce = esp_random() | 1;
+    }
+    next.boot_nonce = published.boot_nonce;
+    next.version = published.version;
+    if (next.version == 0 || !material_equal(&next, &published)) {
+        next.version++;
+    }
+    published = next;
+    taskEXIT_CRITICAL(&snapshot_lock);
+}
+
+void status_snapshot_get(status_snapshot_t *out)
+{
+    taskENTER_CRITICAL(&snapshot_lock);
+    *out = published;
+    taskEXIT_CRITICAL(&snapshot_lock);
+}
+
+uint32_t status_snapshot_version(void)
+{
+    return __atomic_load_n(&published.version, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,58 @@
+/*
+ * Status Snapshot
+ *
+ * One consistent copy of everything the dashboard shows (Wi-Fi, UPS link,
+ * NUT server, ESP health). status_snapshot_refresh() samples all sources in a
+ * single pass and bumps `version` only when a displayed value changes, so
+ * pollers can revalidate with an ETag instead of re-downloading.
+ *
+ * Clocks that move on every UPS report (last data time, uptime) are carried
+ * alongside but do not change the version.
+ */
+
+#ifndef STATUS_SNAPSHOT_H
+#define STATUS_SNAPSHOT_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "ups_status.h"
+
+typedef struct {
+    uint32_t version;           // Bumped on every material change, never 0 after the first refresh
+    uint32_t boot_nonce;        // Random per boot, keeps ETags unique across reboots
+
+    // Wi-Fi
+    bool wifi_connected;
+    char ssid[33];
+    uint32_t ip;                // IPv4, network byte order, 0 = unknown
+    int rssi;                   // Rounded to the signal-bar resolution
+
+    // UPS link
+    ups_connection_state_t ups_state;
+    uint32_t ups_stale_since_ms;    // ms since boot when STALE began, 0 when not stale
+
+    // NUT server
+    bool tcp_running;
+    int tcp_connections;
+
+    // ESP health
+    uint32_t free_heap;         // Rounded down to 1 KB
+    uint32_t total_heap;        // Real size of the default-capability heap
+    int memory_percent;
+    uint32_t largest_free_block;    // Rounded down to 1 KB
+
+    // Clocks (not part of the version)
+    uint32_t ups_last_data_ms;  // ms since boot
+    uint32_t uptime_ms;         // When the snapshot was taken
+} status_snapshot_t;
+
+// Sample all sources and publish a new snapshot
+void status_snapshot_refresh(void);
+
+// Copy the latest published snapshot
+void status_snapshot_get(status_snapshot_t *out);
+
+// Current version without copying
+uint32_t status_snapshot_version(void);
+
+#endif // STATUS_SNAPSHOT_H
@@ -0,0 +1,173 @@
+#include "supervisor.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_task_wdt.h"
+#include "soe_recorder.h"
+#include "task_plan.h"
+
+static const char *TAG = "supervisor";
+
+#define SUPERVISOR_PERIOD_MS        CONFIG_UPS_SUPERVISOR_PERIOD_MS
+#define SUPERVISOR_MAX_RESTARTS     CONFIG_UPS_SUPERVISOR_MAX_RESTARTS
+#define SUPERVISOR_RECOVERY_US      (300LL * 1000000)   // Healthy this long after a restart = recovered
+#define SUPERVISOR_TASK_STACK       CONFIG_UPS_STACK_SUPERVISOR
+#define SUPERVISOR_TASK_PRIORITY    TASK_PRIO_SUPERVISOR
+
+typedef struct {
+    const char *name;
+    uint32_t timeout_ms;
+    supervisor_hook_t poke;
+    supervisor_hook_t restart;
+    uint32_t beats;             // Written by the client, read by the supervisor
+    bool fault;                 // Set by supervisor_report_fault()
+    bool registered;
+    bool stalled;
+    // Supervisor task only
+    uint32_t seen_beats;
+    int64_t last_progress_us;
+    int64_t last_restart_us;
+    uint32_t consecutive_restarts;
+    uint32_t stalls;
+    uint32_t restarts;
+} supervisor_entry_t;
+
+static supervisor_entry_t clients[SUPERVISOR_CLIENT_COUNT];
+static TaskHandle_t supervisor_task_handle = NULL;
+
+void supervisor_register(supervisor_client_t client, const char *name, uint32_t timeout_ms,
+                         supervisor_hook_t poke, supervisor_hook_t restart)
+{
+    if (client >= SUPERVISOR_CLIENT_COUNT) {
+        return;
+    }
+    supervisor_entry_t *c = &clients[client];
+    c->name = name;
+    c->timeout_ms = timeout_ms;
+    c->poke = poke;
+    c->restart = restart;
+    c->seen_beats = __atomic_load_n(&c->beats, __ATOMIC_RELAXED);
+    c->last_progress_us = esp_timer_get_time();
+    __atomic_store_n(&c->registered, true, __ATOMIC_RELEASE);
+}
+
+void supervisor_beat(supervisor_client_t client)
+{
+    __atomic_fetch_add(&clients[client].beats, 1, __ATOMIC_RELAXED);
+}
+
+void supervisor_report_fault(supervisor_client_t client)
+{
+    __atomic_store_n(&clients[client].fault, true, __ATOMIC_RELAXED);
+}
+
+bool supervisor_is_alive(supervisor_client_t client)
+{
+    return !__atomic_load_n(&clients[client].stalled, __ATOMIC_RELAXED);
+}
+
+static void reboot(const supervisor_entry_t *c)
+{
+    ESP_LOGE(TAG, "%s still stalled after %lu restart(s), rebooting", c->name,
+             (unsigned long)c->consecutive_restarts);
+    soe_record(SOE_RESTART_REQUEST, SOE_RESTART_SUPERVISOR);
+    vTaskDelay(pdMS_TO_TICKS(100));
+    esp_restart();
+}
+
+static void check_client(supervisor_client_t id, int64_t now)
+{
+    supervisor_entry_t *c = &clients[id];
+    uint32_t beats = __atomic_load_n(&c->beats, __ATOMIC_RELAXED);
+    bool fault = __atomic_exchange_n(&c->fault, false, __ATOMIC_RELAXED);
+
+    if (beats != c->seen_beats && !fault) {
+        c->seen_beats = beats;
+        c->last_progress_us = now;
+        __atomic_store_n(&c->stalled, false, __ATOMIC_RELAXED);
+        if (c->consecutive_restarts && now - c->last_restart_us > SUPERVISOR_RECOVERY_US) {
+            ESP_LOGI(TAG, "%s recovered", c->name);
+            c->consecutive_restarts = 0;
+        }
+        return;
+    }
+    if (!fault && now - c->last_progress_us < (int64_t)c->timeout_ms * 1000) {
+        return;
+    }
+
+    __atomic_store_n(&c->stalled, true, __ATOMIC_RELAXED);
+    c->stalls++;
+    soe_record(SOE_SUPERVISOR_STALL, id);
+    if (fault) {
+        ESP_LOGW(TAG, "%s reported a fault", c->name);
+    } else {
+        ESP_LOGW(TAG, "%s made no progress for %lld ms", c->name, (now - c->last_progress_us) / 1000);
+    }
+
+    if (!c->restart || c->consecutive_restarts >= SUPERVISOR_MAX_RESTARTS) {
+        reboot(c);
+        return;
+    }
+    c->consecutive_restarts++;
+    c->restarts++;
+    c->last_restart_us = now;
+    ESP_LOGW(TAG, "Restarting %s (%lu/%d)", c->name, (unsigned long)c->consecutive_restarts, SUPERVISOR_MAX_RESTARTS);
+    c->restart();
+    // Give the restarted subsystem a full timeout before judging it again
+    c->seen_beats = __atomic_load_n(&c->beats, __ATOMIC_RELAXED);
+    c->last_progress_us = esp_timer_get_time();
+}
+
+static void supervisor_task(void *arg)
+{
+    esp_err_t err = esp_task_wdt_add(NULL);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "Not subscribed to the task watchdog: %s", esp_err_to_name(err));
+    }
+
+    while (1) {
+        esp_task_wdt_reset();
+        for (int i = 0; i < SUPERVISOR_CLIENT_COUNT; i++) {
+            supervisor_entry_t *c = &clients[i];
+            if (__atomic_load_n(&c->registered, __ATOMIC_ACQUIRE) && c->poke) {
+                c->poke();
+            }
+        }
+        vTaskDelay(pdMS_TO_TICKS(SUPERVISOR_PERIOD_MS));
+        esp_task_wdt_reset();
+
+        int64_t now = esp_timer_get_time();
+        for (int i = 0; i < SUPERVISOR_CLIENT_COUNT; i++) {
+            if (__atomic_load_n(&clients[i].registered, __ATOMIC_ACQUIRE)) {
+                check_client((supervisor_client_t)i, now);
+            }
+        }
+    }
+}
+
+void supervisor_start(void)
+{
+    if (supervisor_task_handle) {
+        return;
+    }
+    if (xTaskCreatePinnedToCore(supervisor_task, "supervisor", SUPERVISOR_TASK_STACK, NULL,
+                                SUPERVISOR_TASK_PRIORITY, &supervisor_task_handle, TASK_CORE_HOUSEKEEPING) != pdPASS) {
+        ESP_LOGE(TAG, "Failed to create supervisor task");
+        return;
+    }
+    ESP_LOGI(TAG, "Supervising every %d ms, %d restart(s) before reboot", SUPERVISOR_PERIOD_MS, SUPERVISOR_MAX_RESTARTS);
+}
+
+void supervisor_get_stats(supervisor_client_t client, supervisor_client_stats_t *out)
+{
+    const supervisor_entry_t *c = &clients[client];
+    out->name = c->name;
+    out->registered = __atomic_load_n(&c->registered, __ATOMIC_ACQUIRE);
+    out->stalled = __atomic_load_n(&c->stalled, __ATOMIC_RELAXED);
+    out->beats = __atomic_load_n(&c->beats, __ATOMIC_RELAXED);
+    out->stalls = c->stalls;
+    out->restarts = c->restarts;
+    out->last_beat_age_ms = out->registered ? (uint32_t)((esp_timer_get_time() - c->last_progress_us) / 1000) : 0;
+}
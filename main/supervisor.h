@@ -0,0 +1,62 @@
+/*
+ * Liveness Supervisor
+ *
+ * Long-running subsystems prove they are making progress by bumping a
+ * heartbeat counter (one atomic increment). A single supervisor task, itself
+ * subscribed to the ESP task watchdog, checks every counter once per period.
+ * A subsystem whose counter has not moved within its timeout is stalled: the
+ * supervisor first calls its restart hook, up to CONFIG_UPS_SUPERVISOR_MAX_RESTARTS
+ * times in a row, and then reboots. A restart hook that itself hangs stops the
+ * supervisor from feeding the task watchdog, which resets the chip.
+ *
+ * Subsystems that cannot beat on their own (the httpd task only runs when a
+ * request arrives) supply a poke hook, called from the supervisor task before
+ * each check, that schedules a beat on the subsystem's own task.
+ */
+
+#ifndef SUPERVISOR_H
+#define SUPERVISOR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef enum {
+    SUPERVISOR_HTTPD = 0,
+    SUPERVISOR_NUT,
+    SUPERVISOR_SCHEDULER,
+    SUPERVISOR_CLIENT_COUNT
+} supervisor_client_t;
+
+typedef void (*supervisor_hook_t)(void);
+
+typedef struct {
+    const char *name;
+    bool registered;
+    bool stalled;               // No progress within the timeout right now
+    uint32_t beats;
+    uint32_t stalls;            // Stalls detected since boot
+    uint32_t restarts;          // Restart hook calls since boot
+    uint32_t last_beat_age_ms;
+} supervisor_client_stats_t;
+
+// Start supervising a client. poke and restart may be NULL; a stalled client
+// without a restart hook reboots the device.
+void supervisor_register(supervisor_client_t client, const char *name, uint32_t timeout_ms,
+                         supervisor_hook_t poke, supervisor_hook_t restart);
+
+// Record progress. Lock-free, safe from any task.
+void supervisor_beat(supervisor_client_t client);
+
+// Treat the client as stalled at the next check regardless of its heartbeat
+// (e.g. a failed deep probe)
+void supervisor_report_fault(supervisor_client_t client);
+
+// True if the client has beaten within its timeout
+bool supervisor_is_alive(supervisor_client_t client);
+
+// Start the supervisor task. Call after the clients are registered.
+void supervisor_start(void);
+
+void supervisor_get_stats(supervisor_client_t client, supervisor_client_stats_t *out);
+
+#endif // SUPERVISOR_H
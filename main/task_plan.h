@@ -0,0 +1,79 @@
+/*
+ * Task Placement
+ *
+ * Core and priority of every task the firmware creates, chosen by the
+ * scheduling profile in Kconfig. Modules create their tasks with these
+ * values instead of local literals, so the whole plan reads in one place.
+ *
+ * Split profile (default on dual-core targets): USB host, the HID driver
+ * (which runs the report callback and the parser) and the HID event task
+ * own core 1. Network services share core 0 with the Wi-Fi driver and the
+ * lwIP task (sdkconfig.defaults pins both there). Housekeeping floats.
+ *
+ * Priority ladder, highest first (IDF system tasks for reference):
+ *   23 wifi, 22 esp_timer, 18 tiT      IDF
+ *   12 usb_events                       USB host library events
+ *   11 HID driver                       report callback, decode, publish
+ *   10 hid_task                         device attach/detach
+ *    7 tcp_server                       NUT replies
+ *    6 httpd
+ *    5 scheduler                        periodic jobs, LED
+ *    4 live_stream, supervisor
+ *    3 wifi_reconnect
+ *    1 dlog_drain
+ *
+ * Legacy profile: the placement before profiles existed (USB on core 0 at
+ * priority 2-5, everything else unpinned), kept to compare against.
+ */
+
+#ifndef TASK_PLAN_H
+#define TASK_PLAN_H
+
+#include "freertos/FreeRTOS.h"
+#include "sdkconfig.h"
+
+#define TASK_CORE_ANY tskNO_AFFINITY
+
+#if CONFIG_UPS_SCHED_PROFILE_SPLIT
+
+#define TASK_PROFILE_NAME           "split"
+#define TASK_CORE_USB               1
+#define TASK_CORE_NET               0
+#define TASK_CORE_HID_EVENTS        TASK_CORE_USB
+
+#define TASK_PRIO_USB_EVENTS        12
+#define TASK_PRIO_HID_DRIVER        11
+#define TASK_PRIO_HID_EVENTS        10
+#define TASK_PRIO_NUT               7
+#define TASK_PRIO_HTTPD             6
+#define TASK_PRIO_SCHEDULER         5
+#define TASK_PRIO_LIVE_STREAM       4
+#define TASK_PRIO_SUPERVISOR        4
+#define TASK_PRIO_WIFI_RECONNECT    3
+#define TASK_PRIO_DLOG              1
+
+#else // CONFIG_UPS_SCHED_PROFILE_LEGACY
+
+#define TASK_PROFILE_NAME           "legacy"
+#define TASK_CORE_USB               0
+#define TASK_CORE_NET               TASK_CORE_ANY
+#define TASK_CORE_HID_EVENTS        TASK_CORE_ANY
+
+#define TASK_PRIO_USB_EVENTS        2
+#define TASK_PRIO_HID_DRIVER        5
+#define TASK_PRIO_HID_EVENTS        2
+#define TASK_PRIO_NUT               5
+#define TASK_PRIO_HTTPD             5
+#define TASK_PRIO_SCHEDULER         5
+#define TASK_PRIO_LIVE_STREAM       4
+#define TASK_PRIO_SUPERVISOR        4
+#define TASK_PRIO_WIFI_RECONNECT    5
+#define TASK_PRIO_DLOG              1
+
+#endif
+
+// Housekeeping runs wherever there is time; the supervisor in particular
+// must not share the fate of a stalled core
+#define TASK_CORE_HOUSEKEEPING      TASK_CORE_ANY
+
+#endif // TASK_PLAN_H
@@ -0,0 +1,291 @@
+#include "task_stats.h"
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "scheduler.h"
+#include "task_plan.h"
+#include "sdkconfig.h"
+
+#define TASK_STATS_MAX_TASKS    32
+#define STACK_MIN_HEADROOM      512     // Suggested size covers peak + at least this
+#define STACK_ROUND             256
+
+// Stacks this firmware sizes, with the Kconfig option behind each
+typedef struct {
+    const char *task;
+    const char *option;         // Without the CONFIG_ prefix
+    uint32_t configured;
+    uint32_t min_bytes;         // Kconfig range minimum
+} task_stack_t;
+
+static const task_stack_t stacks[] = {
+    { "usb_events",     "UPS_STACK_USB_EVENTS",     CONFIG_UPS_STACK_USB_EVENTS,     1536 },
+    { "hid_task",       "UPS_STACK_HID_TASK",       CONFIG_UPS_STACK_HID_TASK,       1536 },
+    { "tcp_server",     "UPS_STACK_NUT_SERVER",     CONFIG_UPS_STACK_NUT_SERVER,     1536 },
+    { "wifi_reconnect", "UPS_STACK_WIFI_RECONNECT", CONFIG_UPS_STACK_WIFI_RECONNECT, 1536 },
+    { "scheduler",      "UPS_STACK_SCHEDULER",      CONFIG_UPS_STACK_SCHEDULER,      1536 },
+    { "supervisor",     "UPS_STACK_SUPERVISOR",     CONFIG_UPS_STACK_SUPERVISOR,     1536 },
+    { "live_stream",    "UPS_STACK_LIVE_STREAM",    CONFIG_UPS_STACK_LIVE_STREAM,    1536 },
+    { "dlog_drain",     "UPS_STACK_DLOG_DRAIN",     CONFIG_UPS_STACK_DLOG_DRAIN,     1536 },
+    { "httpd",          "UPS_HTTPD_STACK_SIZE",     CONFIG_UPS_HTTPD_STACK_SIZE,     4096 },
+};
+
+#define STACK_COUNT (sizeof(stacks) / sizeof(stacks[0]))
+#define NO_SAMPLE   UINT32_MAX
+
+// Lowest free stack seen per entry of stacks[] (calibration mode)
+static uint32_t stack_free_min[STACK_COUNT];
+static uint32_t calibration_samples = 0;
+static bool calibration_started = false;
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+// uxTaskGetSystemState() snapshot and the previous one for CPU deltas; only
+// touched with status_lock held
+static SemaphoreHandle_t status_lock = NULL;
+static TaskStatus_t status[TASK_STATS_MAX_TASKS];
+static struct {
+    UBaseType_t number;
+    configRUN_TIME_COUNTER_TYPE runtime;
+} prev_runtime[TASK_STATS_MAX_TASKS];
+static size_t prev_count = 0;
+static configRUN_TIME_COUNTER_TYPE prev_total = 0;
+static int64_t prev_time_us = 0;
+#endif
+
+static uint32_t task_free_bytes(const char *name)
+{
+    TaskHandle_t task = xTaskGetHandle(name);
+    if (!task) {
+        return NO_SAMPLE;
+    }
+    return (uint32_t)uxTaskGetStackHighWaterMark(task) * sizeof(StackType_t);
+}
+
+void task_stats_sample(void)
+{
+#if CONFIG_UPS_TASK_CALIBRATION
+    if (!calibration_started) {
+        for (size_t i = 0; i < STACK_COUNT; i++) {
+            stack_free_min[i] = NO_SAMPLE;
+        }
+        calibration_started = true;
+    }
+    for (size_t i = 0; i < STACK_COUNT; i++) {
+        uint32_t free_bytes = task_free_bytes(stacks[i].task);
+        if (free_bytes < stack_free_min[i]) {
+            stack_free_min[i] = free_bytes;
+        }
+    }
+    calibration_samples++;
+#endif
+}
+
+// Lowest free stack known for stacks[i]: running task and calibration history
+static uint32_t stack_free_lowest(size_t i)
+{
+    uint32_t free_bytes = task_free_bytes(stacks[i].task);
+    if (calibration_started && stack_free_min[i] < free_bytes) {
+        free_bytes = stack_free_min[i];
+    }
+    return free_bytes;
+}
+
+// Peak use plus margin (at least STACK_MIN_HEADROOM), rounded up to STACK_ROUND
+static uint32_t stack_suggestion(size_t i, uint32_t free_bytes)
+{
+    uint32_t used = stacks[i].configured > free_bytes ? stacks[i].configured - free_bytes : 0;
+    uint32_t size = used + used * CONFIG_UPS_TASK_CALIBRATION_MARGIN_PERCENT / 100;
+    if (size < used + STACK_MIN_HEADROOM) {
+        size = used + STACK_MIN_HEADROOM;
+    }
+    size = (size + STACK_ROUND - 1) / STACK_ROUND * STACK_ROUND;
+    if (size < stacks[i].min_bytes) {
+        size = stacks[i].min_bytes;
+    }
+    return size > 16384 ? 16384 : size;
+}
+
+static void write_stacks(json_writer_t *w)
+{
+    json_arr_begin(w, "stacks");
+    for (size_t i = 0; i < STACK_COUNT; i++) {
+        uint32_t free_bytes = stack_free_lowest(i);
+        json_obj_begin(w, NULL);
+        json_str(w, "task", stacks[i].task);
+        json_str(w, "kconfig", stacks[i].option);
+        json_uint(w, "configured", stacks[i].configured);
+        if (free_bytes == NO_SAMPLE) {
+            // Not running and never sampled
+            json_null(w, "free_min");
+            json_null(w, "suggested");
+        } else {
+            json_uint(w, "free_min", free_bytes);
+            json_uint(w, "peak_used", stacks[i].configured - free_bytes);
+            json_uint(w, "suggested", stack_suggestion(i, free_bytes));
+        }
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+}
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+static const char *task_state_name(eTaskState state)
+{
+    switch (state) {
+        case eRunning:   return "running";
+        case eReady:     return "ready";
+        case eBlocked:   return "blocked";
+        case eSuspended: return "suspended";
+        case eDeleted:   return "deleted";
+        default:         return "invalid";
+    }
+}
+
+static const task_stack_t *stack_entry(const char *name)
+{
+    for (size_t i = 0; i < STACK_COUNT; i++) {
+        if (strcmp(stacks[i].task, name) == 0) {
+            return &stacks[i];
+        }
+    }
+    return NULL;
+}
+
+static configRUN_TIME_COUNTER_TYPE prev_task_runtime(UBaseType_t number)
+{
+    for (size_t i = 0; i < prev_count; i++) {
+        if (prev_runtime[i].number == number) {
+            return prev_runtime[i].runtime;
+        }
+    }
+    return 0;   // Task created within the window
+}
+
+static void write_tasks(json_writer_t *w, int64_t now_us)
+{
+    configRUN_TIME_COUNTER_TYPE total = 0;
+    UBaseType_t count = uxTaskGetSystemState(status, TASK_STATS_MAX_TASKS, &total);
+    if (count == 0) {
+        // More tasks than the snapshot holds
+        json_uint(w, "tasks_total", uxTaskGetNumberOfTasks());
+        json_str(w, "error", "task table full");
+        return;
+    }
+
+    // The counter is esp_timer microseconds, so deltas are exact until it
+    // wraps (32-bit: ~71 minutes between reads); the first read covers uptime
+    int64_t window_us = now_us - prev_time_us;
+    configRUN_TIME_COUNTER_TYPE window = total - prev_total;
+    bool cpu_valid = window > 0 && (uint64_t)window_us <= (uint64_t)(configRUN_TIME_COUNTER_TYPE)~0ULL;
+    json_uint(w, "tasks_total", count);
+    if (cpu_valid) {
+        json_uint(w, "cpu_window_ms", (uint64_t)window / 1000);
+    } else {
+        json_null(w, "cpu_window_ms");
+    }
+
+    json_arr_begin(w, "tasks");
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *t = &status[i];
+        const task_stack_t *entry = stack_entry(t->pcTaskName);
+        json_obj_begin(w, NULL);
+        json_str(w, "name", t->pcTaskName);
+        json_uint(w, "number", t->xTaskNumber);
+        json_str(w, "state", task_state_name(t->eCurrentState));
+        json_uint(w, "priority", t->uxCurrentPriority);
+        json_uint(w, "base_priority", t->uxBasePriority);
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        if (t->xCoreID == tskNO_AFFINITY) {
+            json_int(w, "core", -1);
+        } else {
+            json_int(w, "core", t->xCoreID);
+        }
+#endif
+        json_uint(w, "stack_free_min", (uint32_t)t->usStackHighWaterMark * sizeof(StackType_t));
+        if (entry) {
+            json_uint(w, "stack_size", entry->configured);
+            json_str(w, "kconfig", entry->option);
+        }
+        if (cpu_valid) {
+            // Share of all cores, in 0.1 %
+            uint64_t ran = (configRUN_TIME_COUNTER_TYPE)(t->ulRunTimeCounter - prev_task_runtime(t->xTaskNumber));
+            json_fixed(w, "cpu_pct", (int64_t)(ran * 1000 / ((uint64_t)window * portNUM_PROCESSORS)), 1);
+        } else {
+            json_null(w, "cpu_pct");
+        }
+        json_obj_end(w);
+    }
+    json_arr_end(w);
+
+    for (UBaseType_t i = 0; i < count; i++) {
+        prev_runtime[i].number = status[i].xTaskNumber;
+        prev_runtime[i].runtime = status[i].ulRunTimeCounter;
+    }
+    prev_count = count;
+    prev_total = total;
+    prev_time_us = now_us;
+}
+#endif
+
+void task_stats_write_json(json_writer_t *w)
+{
+    int64_t now_us = esp_timer_get_time();
+    json_obj_begin(w, NULL);
+    json_uint(w, "uptime_ms", (uint64_t)(now_us / 1000));
+    json_uint(w, "cores", portNUM_PROCESSORS);
+    json_str(w, "profile", TASK_PROFILE_NAME);
+    json_bool(w, "calibration", calibration_started);
+    json_uint(w, "calibration_samples", calibration_samples);
+    json_uint(w, "margin_pct", CONFIG_UPS_TASK_CALIBRATION_MARGIN_PERCENT);
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+    if (!status_lock) {
+        status_lock = xSemaphoreCreateMutex();
+    }
+    if (status_lock && xSemaphoreTake(status_lock, pdMS_TO_TICKS(1000)) == pdTRUE) {
+        write_tasks(w, now_us);
+        xSemaphoreGive(status_lock);
+    } else {
+        json_str(w, "error", "busy");
+    }
+#else
+    json_str(w, "error", "CONFIG_FREERTOS_USE_TRACE_FACILITY is off");
+#endif
+
+    write_stacks(w);
+    scheduler_write_json(w, "jobs");
+    json_obj_end(w);
+}
+
+size_t task_stats_kconfig(char *buf, size_t size)
+{
+    size_t len = 0;
+    if (size == 0) {
+        return 0;
+    }
+    buf[0] = '\0';
+    len += snprintf(buf + len, size - len,
+                    "# Task stacks: measured peak + %d%% (at least %d B), %d B steps\n"
+                    "# uptime %llu s, %lu calibration samples\n",
+                    CONFIG_UPS_TASK_CALIBRATION_MARGIN_PERCENT, STACK_MIN_HEADROOM, STACK_ROUND,
+                    (unsigned long long)(esp_timer_get_time() / 1000000), (unsigned long)calibration_samples);
+    for (size_t i = 0; i < STACK_COUNT && len < size; i++) {
+        uint32_t free_bytes = stack_free_lowest(i);
+        if (free_bytes == NO_SAMPLE) {
+            len += snprintf(buf + len, size - len, "# %s: not running, keeping %lu\nCONFIG_%s=%lu\n",
+                            stacks[i].task, (unsigned long)stacks[i].configured,
+                            stacks[i].option, (unsigned long)stacks[i].configured);
+        } else {
+            len += snprintf(buf + len, size - len, "# %s: %lu of %lu used\nCONFIG_%s=%lu\n",
+                            stacks[i].task, (unsigned long)(stacks[i].configured - free_bytes),
+                            (unsigned long)stacks[i].configured,
+                            stacks[i].option, (unsigned long)stack_suggestion(i, free_bytes));
+        }
+    }
+    return len < size ? len : size - 1;
+}
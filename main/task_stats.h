@@ -0,0 +1,32 @@
+/*
+ * Task Statistics
+ *
+ * One view of every FreeRTOS task: state, priority, core affinity, stack
+ * high-water mark and CPU share (from the run-time counters, over the window
+ * since the previous read). Tasks this firmware creates are listed with the
+ * Kconfig option that sizes their stack, so the same data drives stack sizing:
+ * each gets a suggested size of its measured peak plus
+ * CONFIG_UPS_TASK_CALIBRATION_MARGIN_PERCENT, exported as sdkconfig lines for
+ * tools/stack_calibration.py.
+ *
+ * With CONFIG_UPS_TASK_CALIBRATION the peaks are sampled periodically and
+ * kept per task name, so they survive tasks being deleted and recreated.
+ */
+
+#ifndef TASK_STATS_H
+#define TASK_STATS_H
+
+#include <stddef.h>
+#include "json_writer.h"
+
+// Calibration sampler; call every few seconds (no-op unless calibrating)
+void task_stats_sample(void);
+
+// /api/tasks: {"cores":2,"profile":"split","cpu_window_ms":n,"tasks":[...],"stacks":[...],"jobs":[...]}
+void task_stats_write_json(json_writer_t *w);
+
+// /api/tasks?format=kconfig: suggested CONFIG_UPS_STACK_* lines.
+// Returns the length written (truncated to size - 1).
+size_t task_stats_kconfig(char *buf, size_t size);
+
+#endif // TASK_STATS_H
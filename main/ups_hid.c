@@ -0,0 +1,140 @@
+#include "ups_hid.h"
+#include "deferred_log.h"
+
+static const char *TAG = "ups";
+
+bool ups_hid_decode(ups_hid_data_t *data, const uint8_t *report, size_t length)
+{
+    if (length < 1) {
+        return false;
+    }
+
+    uint8_t report_id = report[0];
+    switch (report_id) {
+        case UPS_HID_REPORT_BATTERY:  // Battery and Load Status
+            DLOGI(TAG, "Report 0x20 - Battery/Status Data:");
+            if (length >= 2) {
+                data->battery_level = report[1];
+                DLOGI(TAG, "  Battery Level: %d%%", data->battery_level);
+            }
+            if (length >= 3) {
+                data->battery_byte2 = report[2];
+                DLOGI(TAG, "  Battery Byte2: %d", data->battery_byte2);
+            }
+            if (length >= 4) {
+                data->battery_byte3 = report[3];
+                DLOGI(TAG, "  Battery Byte3: %d", data->battery_byte3);
+            }
+            break;
+
+        case UPS_HID_REPORT_STATUS:  // Status Flags
+            DLOGI(TAG, "Report 0x21 - Status Flags:");
+            if (length >= 2) {
+                data->status = report[1];
+                DLOGI(TAG, "  Status: %d", data->status);
+            }
+            if (length >= 3) {
+                data->status_byte2 = report[2];
+                DLOGI(TAG, "  Status Byte2: %d", data->status_byte2);
+            }
+            break;
+
+        case UPS_HID_REPORT_RUNTIME:  // Runtime
+            DLOGI(TAG, "Report 0x22 - Runtime Data:");
+            if (length >= 2) {
+                data->runtime = report[1];
+                DLOGI(TAG, "  Runtime: %d minutes", data->runtime);
+            }
+            break;
+
+        case UPS_HID_REPORT_VOLTAGE:  // Voltage Data
+            DLOGI(TAG, "Report 0x23 - Voltage Data:");
+            if (length >= 3) {
+                data->input_voltage = (report[2] << 8) | report[1];
+                DLOGI(TAG, "  Input Voltage: %d V", data->input_voltage);
+            }
+            if (length >= 5) {
+                data->output_voltage = (report[4] << 8) | report[3];
+                DLOGI(TAG, "  Output Voltage: %d V", data->output_voltage);
+            }
+            break;
+
+        case UPS_HID_REPORT_LOAD:  // Load Percentage
+            DLOGI(TAG, "Report 0x25 - Load Data:");
+            if (length >= 2) {
+                data->load = report[1];
+                DLOGI(TAG, "  Load: %d%%", data->load);
+            }
+            break;
+
+        case UPS_HID_REPORT_ALARM:  // Alarm Control
+            DLOGI(TAG, "Report 0x28 - Alarm Control:");
+            if (length >= 2) {
+                data->alarm_control = report[1];
+                DLOGI(TAG, "  Alarm Control: %d", data->alarm_control);
+            }
+            break;
+
+        case UPS_HID_REPORT_BEEP:  // Beep Control
+            DLOGI(TAG, "Report 0x29 - Beep Control:");
+            if (length >= 2) {
+                data->beep_control = report[1];
+                DLOGI(TAG, "  Beep Control: %d", data->beep_control);
+            }
+            break;
+
+        case UPS_HID_REPORT_SYSTEM:  // System Status
+            DLOGI(TAG, "Report 0x80 - System Status:");
+            if (length >= 2) {
+                data->system_status = report[1];
+                DLOGI(TAG, "  System Status: %d", data->system_status);
+            }
+            break;
+
+        case UPS_HID_REPORT_EXTENDED:  // Extended Status
+            DLOGI(TAG, "Report 0x82 - Extended Status:");
+            if (length >= 3) {
+                data->extended_status = (report[2] << 8) | report[1];
+                DLOGI(TAG, "  Extended Status: %d", data->extended_status);
+            }
+            break;
+
+        case UPS_HID_REPORT_TEMPERATURE:  // Temperature/Sensor
+            DLOGI(TAG, "Report 0x85 - Temperature/Sensor:");
+            if (length >= 2) {
+                data->temperature = report[1];
+                DLOGI(TAG, "  Temperature: %d", data->temperature);
+            }
+            break;
+
+        case UPS_HID_REPORT_TEMP_RANGE1:  // Temperature Range 1
+            DLOGI(TAG, "Report 0x86 - Temperature Range 1:");
+            if (length >= 3) {
+                data->temp_range1 = (report[2] << 8) | report[1];
+                DLOGI(TAG, "  Temp Range 1: %d", data->temp_range1);
+            }
+            break;
+
+        case UPS_HID_REPORT_TEMP_RANGE2:  // Temperature Range 2
+            DLOGI(TAG, "Report 0x87 - Temperature Range 2:");
+            if (length >= 3) {
+                data->temp_range2 = (report[2] << 8) | report[1];
+                DLOGI(TAG, "  Temp Range 2: %d", data->temp_range2);
+            }
+            break;
+
+        case UPS_HID_REPORT_SENSOR:  // Additional Sensor
+            DLOGI(TAG, "Report 0x88 - Additional Sensor:");
+            if (length >= 3) {
+                data->additional_sensor = (report[2] << 8) | report[1];
+                DLOGI(TAG, "  Additional Sensor: %d", data->additional_sensor);
+            }
+            break;
+
+        default:
+            DLOGI(TAG, "Report 0x%02X - UNKNOWN REPORT TYPE", report_id);
+            DLOG_HEX(ESP_LOG_INFO, TAG, length > 16 ? "  Raw data (first 16): " : "  Raw data: ", report, length < 16 ? length : 16);
+            return false;
+    }
+    return true;
+}
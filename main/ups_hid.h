@@ -0,0 +1,62 @@
+/*
+ * UPS HID Report Decoding
+ *
+ * Turns raw CyberPower HID input reports (report ID in byte 0) into UPS field
+ * values. Pure decoding with no USB or RTOS dependency; fields missing from a
+ * short report keep their previous value.
+ */
+
+#ifndef UPS_HID_H
+#define UPS_HID_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+// Report IDs the decoder understands
+#define UPS_HID_REPORT_BATTERY      0x20
+#define UPS_HID_REPORT_STATUS       0x21
+#define UPS_HID_REPORT_RUNTIME      0x22
+#define UPS_HID_REPORT_VOLTAGE      0x23
+#define UPS_HID_REPORT_LOAD         0x25
+#define UPS_HID_REPORT_ALARM        0x28
+#define UPS_HID_REPORT_BEEP         0x29
+#define UPS_HID_REPORT_SYSTEM       0x80
+#define UPS_HID_REPORT_EXTENDED     0x82
+#define UPS_HID_REPORT_TEMPERATURE  0x85
+#define UPS_HID_REPORT_TEMP_RANGE1  0x86
+#define UPS_HID_REPORT_TEMP_RANGE2  0x87
+#define UPS_HID_REPORT_SENSOR       0x88
+
+// UPS data storage (17 fields)
+typedef struct {
+    int battery_level;
+    int battery_byte2;
+    int battery_byte3;
+    int status;
+    int status_byte2;
+    int runtime;
+    int input_voltage;
+    int output_voltage;
+    int load;
+    int alarm_control;
+    int beep_control;
+    int system_status;
+    int extended_status;
+    int temperature;
+    int temp_range1;
+    int temp_range2;
+    int additional_sensor;
+} ups_hid_data_t;
+
+// Decode one report into data. Returns false for an empty report or an
+// unknown report ID (data is left untouched).
+bool ups_hid_decode(ups_hid_data_t *data, const uint8_t *report, size_t length);
+
+// Report 0x20 bytes 2-3: raw battery voltage
+static inline int ups_hid_battery_raw_voltage(const ups_hid_data_t *data)
+{
+    return (data->battery_byte3 << 8) | data->battery_byte2;
+}
+
+#endif // UPS_HID_H
@@ -0,0 +1,290 @@
+#include "ups_monitor.h"
+#include <string.h>
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "deferred_log.h"
+#include "soe_recorder.h"
+#include "energy_meter.h"
+#include "power_quality.h"
+#include "battery_health.h"
+#include "report_trace.h"
+
+static const char *TAG = "ups";
+
+static ups_connection_state_t ups_state = UPS_DISCONNECTED;
+static ups_hid_data_t ups_data = {0};
+static uint32_t ups_last_data_time = 0;     // ms since boot
+static uint32_t ups_stale_start_time = 0;   // When STALE state began
+static ups_monitor_listener_t ups_listener = NULL;
+
+// Consistent copy of ups_data for exporters (NUT, metrics), published after each report
+static portMUX_TYPE ups_values_lock = portMUX_INITIALIZER_UNLOCKED;
+static ups_values_t ups_values = {0};
+static uint32_t ups_reports_unknown = 0;
+static uint32_t ups_reports_empty = 0;
+
+#define UPS_RTC_MAGIC 0x31535055  // "UPS1"
+
+// Last published report. Rewritten under ups_values_lock after every report;
+// a reset in the middle leaves a checksum mismatch and the copy is ignored.
+typedef struct {
+    uint32_t magic;
+    uint32_t size;              // sizeof(ups_rtc_t), catches a layout change across updates
+    ups_hid_data_t data;        // Decoder state: later partial reports merge as before the reset
+    ups_values_t values;
+    uint32_t checksum;          // FNV-1a over everything above
+} ups_rtc_t;
+
+static RTC_NOINIT_ATTR ups_rtc_t ups_rtc;
+
+static uint32_t ups_rtc_checksum(void)
+{
+    const uint8_t *p = (const uint8_t *)&ups_rtc;
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < offsetof(ups_rtc_t, checksum); i++) {
+        hash = (hash ^ p[i]) * 16777619u;
+    }
+    return hash;
+}
+
+static void notify(ups_monitor_event_t event, uint32_t now_ms)
+{
+    if (ups_listener) {
+        ups_listener(event, now_ms);
+    }
+}
+
+// Record every UPS state transition in the SOE journal
+static void set_ups_state(ups_connection_state_t new_state, uint32_t now_ms)
+{
+    if (ups_state == new_state) {
+        return;
+    }
+    soe_record(SOE_UPS_STATE, (uint32_t)new_state);
+    ups_state = new_state;
+    notify(UPS_MONITOR_STATE_CHANGED, now_ms);
+}
+
+// Returns true if the parsed values changed
+static bool publish_ups_values(void)
+{
+    ups_values_t next = {
+        .battery_charge = ups_data.battery_level,
+        .battery_runtime = ups_data.runtime,
+        .battery_raw_voltage = ups_hid_battery_raw_voltage(&ups_data),
+        .input_voltage = ups_data.input_voltage,
+        .output_voltage = ups_data.output_voltage,
+        .load = ups_data.load,
+        .temperature = ups_data.temperature,
+        .status_flags = ups_data.status,
+        .system_status = ups_data.system_status,
+        .extended_status = ups_data.extended_status,
+        .alarm_control = ups_data.alarm_control,
+        .beep_control = ups_data.beep_control,
+    };
+    taskENTER_CRITICAL(&ups_values_lock);
+    // Compare the parsed values only (everything between version and the counters)
+    bool changed = memcmp(&next.battery_charge, &ups_values.battery_charge,
+                          offsetof(ups_values_t, last_report_ms) - offsetof(ups_values_t, battery_charge)) != 0;
+    next.version = ups_values.version + (changed ? 1 : 0);
+    next.last_report_ms = ups_last_data_time;
+    next.reports_total = ups_values.reports_total + 1;
+    next.reports_unknown = ups_reports_unknown;
+    next.reports_empty = ups_reports_empty;
+    ups_values = next;
+    ups_rtc.magic = UPS_RTC_MAGIC;
+    ups_rtc.size = sizeof(ups_rtc);
+    ups_rtc.data = ups_data;
+    ups_rtc.values = next;
+    ups_rtc.checksum = ups_rtc_checksum();
+    taskEXIT_CRITICAL(&ups_values_lock);
+    return changed;
+}
+
+// Restored values are no longer worth serving
+static void drop_restored(const char *why)
+{
+    taskENTER_CRITICAL(&ups_values_lock);
+    bool restored = ups_values.restored;
+    ups_values.restored = false;
+    taskEXIT_CRITICAL(&ups_values_lock);
+    if (restored) {
+        DLOGI(TAG, "Restored UPS values dropped (%s)", why);
+    }
+}
+
+void ups_monitor_set_listener(ups_monitor_listener_t listener)
+{
+    ups_listener = listener;
+}
+
+void ups_monitor_init(void)
+{
+    esp_reset_reason_t reason = esp_reset_reason();
+    bool cold = (reason == ESP_RST_POWERON || reason == ESP_RST_BROWNOUT);
+    if (cold || ups_rtc.magic != UPS_RTC_MAGIC || ups_rtc.size != sizeof(ups_rtc) ||
+        ups_rtc.checksum != ups_rtc_checksum() || ups_rtc.values.reports_total == 0) {
+        memset(&ups_rtc, 0, sizeof(ups_rtc));
+        return;
+    }
+
+    ups_data = ups_rtc.data;
+    ups_reports_unknown = ups_rtc.values.reports_unknown;
+    ups_reports_empty = ups_rtc.values.reports_empty;
+    taskENTER_CRITICAL(&ups_values_lock);
+    ups_values = ups_rtc.values;
+    ups_values.last_report_ms = 0;      // Before this boot
+    ups_values.restored = true;
+    taskEXIT_CRITICAL(&ups_values_lock);
+    ESP_LOGI(TAG, "Restored UPS values from before the reset (%lu reports, charge %d%%)",
+             (unsigned long)ups_rtc.values.reports_total, ups_rtc.values.battery_charge);
+}
+
+void ups_monitor_device_ready(void)
+{
+    set_ups_state(UPS_CONNECTED_WAITING_DATA, xTaskGetTickCount() * portTICK_PERIOD_MS);
+}
+
+void ups_monitor_device_gone(void)
+{
+    drop_restored("UPS unplugged");
+    set_ups_state(UPS_DISCONNECTED, xTaskGetTickCount() * portTICK_PERIOD_MS);
+    DLOGI(TAG, "UPS state: -> DISCONNECTED");
+}
+
+void ups_monitor_process_report(const uint8_t *report, size_t length, uint32_t now_ms)
+{
+    if (length < 1) {
+        DLOGW(TAG, "Received empty HID report");
+        ups_reports_empty++;
+        return;
+    }
+
+    ups_last_data_time = now_ms;
+    if (ups_state == UPS_DISCONNECTED || ups_state == UPS_CONNECTED_WAITING_DATA) {
+        ups_stale_start_time = 0;
+        set_ups_state(UPS_CONNECTED_ACTIVE, now_ms);
+        DLOGI(TAG, "UPS state: DISCONNECTED/WAITING -> ACTIVE");
+    } else if (ups_state == UPS_CONNECTED_STALE) {
+        ups_stale_start_time = 0;
+        set_ups_state(UPS_CONNECTED_ACTIVE, now_ms);
+        DLOGI(TAG, "UPS state: STALE -> ACTIVE");
+    }
+
+    DLOGI(TAG, "=== PARSING REPORT 0x%02X (Length: %d) ===", report[0], (int)length);
+    DLOG_HEX(ESP_LOG_INFO, TAG, length > 16 ? "Raw data (first 16): " : "Raw data: ", report, length < 16 ? length : 16);
+
+    bool decoded = ups_hid_decode(&ups_data, report, length);
+    report_trace_parsed();
+    if (!decoded) {
+        ups_reports_unknown++;
+    } else if (report[0] == UPS_HID_REPORT_BATTERY) {
+        // Bytes 2-3 carry the battery voltage; each fresh reading feeds the health model
+        battery_health_update(ups_hid_battery_raw_voltage(&ups_data),
+                              ups_data.battery_level, ups_data.load, ups_data.temperature,
+                              power_quality_current_band() == PQ_BAND_TRANSFER, now_ms);
+    } else if (report[0] == UPS_HID_REPORT_VOLTAGE && length >= 3) {
+        power_quality_process_sample(ups_data.input_voltage, now_ms);
+    }
+
+    // Integrate output energy and on-battery time over every update
+    energy_meter_update(ups_data.load, power_quality_current_band() == PQ_BAND_TRANSFER, now_ms);
+    report_trace_published(publish_ups_values());
+    notify(UPS_MONITOR_REPORT, now_ms);
+
+    // Print current UPS data state after each report
+    DLOGI(TAG, "=== CURRENT UPS DATA STATE ===");
+    DLOGI(TAG, "State: %d, Available: %s, Last Data: %lu ms ago (timeout: %d ms)",
+          ups_state, ups_monitor_available() ? "YES" : "NO",
+          (unsigned long)(xTaskGetTickCount() * portTICK_PERIOD_MS - ups_last_data_time),
+          UPS_MONITOR_FRESHNESS_TIMEOUT_MS);
+    DLOGI(TAG, "Battery: %d%%, Load: %d%%, Runtime: %d min",
+          ups_data.battery_level, ups_data.load, ups_data.runtime);
+    DLOGI(TAG, "Input: %d V, Output: %d V, Temp: %d",
+          ups_data.input_voltage, ups_data.output_voltage, ups_data.temperature);
+    DLOGI(TAG, "Status: %d, System: %d, Extended: %d",
+          ups_data.status, ups_data.system_status, ups_data.extended_status);
+    DLOGI(TAG, "=============================");
+}
+
+bool ups_monitor_check_freshness(uint32_t now_ms)
+{
+    if (now_ms > UPS_MONITOR_RESTORED_HOLD_MS) {
+        drop_restored("no live report");
+    }
+    uint32_t time_since_last_data = now_ms - ups_last_data_time;
+    if (ups_state != UPS_CONNECTED_ACTIVE || time_since_last_data <= UPS_MONITOR_FRESHNESS_TIMEOUT_MS) {
+        return false;
+    }
+    ups_stale_start_time = now_ms;
+    set_ups_state(UPS_CONNECTED_STALE, now_ms);
+    ESP_LOGW(TAG, "UPS state: ACTIVE -> STALE (no data for %lu ms)", (unsigned long)time_since_last_data);
+    return true;
+}
+
+bool ups_monitor_available(void)
+{
+    return ups_state == UPS_CONNECTED_ACTIVE;
+}
+
+ups_connection_state_t get_ups_state(void)
+{
+    return ups_state;
+}
+
+bool get_ups_values_restored(void)
+{
+    taskENTER_CRITICAL(&ups_values_lock);
+    bool restored = ups_values.restored;
+    taskEXIT_CRITICAL(&ups_values_lock);
+    return restored;
+}
+
+unsigned int get_ups_last_data_time(void)
+{
+    return ups_last_data_time;
+}
+
+uint32_t get_ups_stale_since_ms(void)
+{
+    return ups_state == UPS_CONNECTED_STALE ? ups_stale_start_time : 0;
+}
+
+uint32_t get_ups_stale_duration_ms(void)
+{
+    if (ups_state != UPS_CONNECTED_STALE) {
+        return 0;  // Not stale
+    }
+    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
+    return now - ups_stale_start_time;
+}
+
+void get_ups_values(ups_values_t *out)
+{
+    taskENTER_CRITICAL(&ups_values_lock);
+    *out = ups_values;
+    out->reports_empty = ups_reports_empty;
+    taskEXIT_CRITICAL(&ups_values_lock);
+}
+
+const char *ups_state_name(ups_connection_state_t state)
+{
+    switch (state) {
+        case UPS_DISCONNECTED:           return "DISCONNECTED";
+        case UPS_CONNECTED_WAITING_DATA: return "WAITING";
+        case UPS_CONNECTED_ACTIVE:       return "ACTIVE";
+        case UPS_CONNECTED_STALE:        return "STALE";
+        default:                         return "UNKNOWN";
+    }
+}
+
+const char *ups_state_color(ups_connection_state_t state)
+{
+    switch (state) {
+        case UPS_CONNECTED_WAITING_DATA: return "yellow";
+        case UPS_CONNECTED_ACTIVE:       return "green";
+        default:                         return "red";
+    }
+}
@@ -0,0 +1,68 @@
+/*
+ * UPS Monitor
+ *
+ * Connection state machine and the current UPS values. The USB side feeds it
+ * device arrival/removal and raw HID reports; a periodic task calls
+ * ups_monitor_check_freshness() to detect a UPS that stopped reporting. Each
+ * report is decoded (ups_hid), fed to the energy, power quality and battery
+ * models, and published as an ups_values_t snapshot (get_ups_values()).
+ *
+ *   DISCONNECTED --device_ready--> WAITING_DATA --report--> ACTIVE
+ *   ACTIVE --no report for UPS_MONITOR_FRESHNESS_TIMEOUT_MS--> STALE --report--> ACTIVE
+ *   any --device_gone--> DISCONNECTED
+ *
+ * Time is passed in by the caller (ms since boot) so the module has no clock
+ * of its own. The getters declared in ups_status.h are implemented here.
+ *
+ * Every published report is also copied, with the decoder state and a
+ * checksum, to RTC memory that survives warm resets (esp_restart, panic,
+ * watchdog). After such a reset ups_monitor_init() publishes that copy
+ * flagged as restored, so NUT keeps answering while the UPS re-enumerates.
+ * The first live report replaces it; without one it is dropped after
+ * UPS_MONITOR_RESTORED_HOLD_MS.
+ */
+
+#ifndef UPS_MONITOR_H
+#define UPS_MONITOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "ups_status.h"
+#include "ups_hid.h"
+
+#define UPS_MONITOR_FRESHNESS_TIMEOUT_MS 10000
+#define UPS_MONITOR_CHECK_PERIOD_MS      2000    // How often the firmware calls ups_monitor_check_freshness()
+#define UPS_MONITOR_RESTORED_HOLD_MS     60000   // Longest time restored values are served without a live report
+
+typedef enum {
+    UPS_MONITOR_STATE_CHANGED = 0,  // get_ups_state() has a new value
+    UPS_MONITOR_REPORT              // A report was processed and published
+} ups_monitor_event_t;
+
+// Called on the task that drove the change (USB callback or freshness check)
+typedef void (*ups_monitor_listener_t)(ups_monitor_event_t event, uint32_t now_ms);
+
+void ups_monitor_set_listener(ups_monitor_listener_t listener);
+
+// Restore the values saved before a warm reset. Call once at boot, before
+// the USB host starts.
+void ups_monitor_init(void);
+
+// A HID device that looks like a UPS sent its first report
+void ups_monitor_device_ready(void);
+
+// The UPS was unplugged
+void ups_monitor_device_gone(void);
+
+// Decode and publish one raw HID input report
+void ups_monitor_process_report(const uint8_t *report, size_t length, uint32_t now_ms);
+
+// ACTIVE -> STALE when no report arrived within the freshness timeout, and
+// restored values expire. Returns true if the state changed.
+bool ups_monitor_check_freshness(uint32_t now_ms);
+
+// UPS connected and reporting (served as ups.status OL)
+bool ups_monitor_available(void);
+
+#endif // UPS_MONITOR_H
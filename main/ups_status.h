@@ -0,0 +1,70 @@
+/*
+ * UPS Status
+ *
+ * Connection state shared between the USB/NUT side (esp32-nut-server-usbhid.c)
+ * and the web server, plus the getters the main file exposes.
+ */
+
+#ifndef UPS_STATUS_H
+#define UPS_STATUS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// UPS state enum
+typedef enum {
+    UPS_DISCONNECTED = 0,
+    UPS_CONNECTED_WAITING_DATA,
+    UPS_CONNECTED_ACTIVE,
+    UPS_CONNECTED_STALE
+} ups_connection_state_t;
+
+// Parsed UPS values and parser counters, published once per HID report
+typedef struct {
+    uint32_t version;           // Bumped whenever a parsed value changes
+    int battery_charge;
+    int battery_runtime;
+    int battery_raw_voltage;    // Report 0x20 bytes 2-3
+    int input_voltage;
+    int output_voltage;
+    int load;
+    int temperature;
+    int status_flags;
+    int system_status;
+    int extended_status;
+    int alarm_control;
+    int beep_control;
+    uint32_t last_report_ms;    // ms since boot
+    uint32_t reports_total;
+    uint32_t reports_unknown;   // Report IDs the parser does not know
+    uint32_t reports_empty;
+    bool restored;              // Carried over a warm restart, no live report since
+} ups_values_t;
+
+ups_connection_state_t get_ups_state(void);
+
+// "ACTIVE", "STALE", ... and the dashboard color for a state
+const char *ups_state_name(ups_connection_state_t state);
+const char *ups_state_color(ups_connection_state_t state);
+
+// Copy the last published values
+void get_ups_values(ups_values_t *out);
+
+// The published values were restored after a warm restart and no live report
+// has replaced them yet
+bool get_ups_values_restored(void);
+
+// Last UPS report, ms since boot
+unsigned int get_ups_last_data_time(void);
+
+// Time spent in STALE, 0 when not stale
+uint32_t get_ups_stale_duration_ms(void);
+
+// When STALE began (ms since boot, recorded on the transition), 0 when not stale
+uint32_t get_ups_stale_since_ms(void);
+
+// NUT server
+int get_active_tcp_connections(void);
+bool is_tcp_server_running(void);
+
+#endif // UPS_STATUS_H
@@ -1,9 +1,9 @@
 #include "webserver.h"
 #include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "esp_log.h"
 #include "esp_http_server.h"
-#include "nvs_flash.h"
-#include "nvs.h"
 #include "esp_system.h"
 #include "esp_wifi.h"
 #include "esp_netif.h"
@@ -11,399 +11,271 @@
 #include <inttypes.h>
 #include "esp_http_client.h"
 #include "esp_timer.h"
-
-// Add UPS state enum definition for use in this file
-typedef enum {
-    UPS_DISCONNECTED = 0,
-    UPS_CONNECTED_WAITING_DATA,
-    UPS_CONNECTED_ACTIVE,
-    UPS_CONNECTED_STALE
-} ups_connection_state_t;
+#include "power_quality.h"
+#include "soe_recorder.h"
+#include "energy_meter.h"
+#include "battery_health.h"
+#include "ups_status.h"
+#include "status_snapshot.h"
+#include "live_stream.h"
+#include "metrics.h"
+#include "latency_hist.h"
+#include "report_trace.h"
+#include "deferred_log.h"
+#include "json_writer.h"
+#include "api_json.h"
+#include "supervisor.h"
+#include "task_stats.h"
+#include "heap_monitor.h"
+#include "esp_heap_caps.h"
+#include "scheduler.h"
+#include "persist.h"
+#include "task_plan.h"
+#include "sched_bench.h"
+#include "power_mgmt.h"
+#include "boot_timing.h"
 
 static const char *TAG = "webserver";
 static httpd_handle_t server = NULL;
 
-// NVS namespace for WiFi credentials
-#define WIFI_NVS_NAMESPACE "wifi_config"
-#define WIFI_SSID_KEY "ssid"
-#define WIFI_PASS_KEY "password"
-
 // Helper for unique request IDs
 static volatile uint32_t webserver_req_counter = 0;
 
 // --- Webserver resilience logic state ---
 #define ACCEPT_ERROR_THRESHOLD 10
 #define ACCEPT_ERROR_WINDOW_MS 10000
-#define FREE_HEAP_CRITICAL (16 * 1024)
 #define SELF_CHECK_URL "http://127.0.0.1/api/wifi_status"
+#define SELF_CHECK_TIMEOUT_MS 2000
+#define SELF_CHECK_FAIL_LIMIT 3
 #define FREE_HEAP_LOG_INTERVAL_MS 20000
 
+// httpd tuning (see "HTTP Server" in menuconfig)
+#define HTTPD_MAX_OPEN_SOCKETS CONFIG_UPS_HTTPD_MAX_OPEN_SOCKETS
+#define HTTPD_IDLE_TIMEOUT_US ((int64_t)CONFIG_UPS_HTTPD_IDLE_TIMEOUT_S * 1000000)
+#define HTTPD_REAP_INTERVAL_MS 5000
+
 static int accept_error_counter = 0;
 static int64_t accept_error_first_ts = 0;
-static esp_timer_handle_t free_heap_log_timer = NULL;
+static scheduler_job_t free_heap_log_job;
 
 // Forward declarations
 static void log_free_heap(void* arg);
 static void reset_accept_error_state(void);
 void handle_accept_error(void);
+#if CONFIG_UPS_SUPERVISOR_HTTP_PROBE
 static bool perform_self_check(void);
+#endif
+
+// Dashboard assets (main/www), gzipped and embedded by main/CMakeLists.txt
+extern const uint8_t index_html_gz_start[] asm("_binary_index_html_gz_start");
+extern const uint8_t index_html_gz_end[]   asm("_binary_index_html_gz_end");
+extern const uint8_t app_js_gz_start[]     asm("_binary_app_js_gz_start");
+extern const uint8_t app_js_gz_end[]       asm("_binary_app_js_gz_end");
+extern const uint8_t app_css_gz_start[]    asm("_binary_app_css_gz_start");
+extern const uint8_t app_css_gz_end[]      asm("_binary_app_css_gz_end");
 
-// HTML content for the main page
-static const char* html_content = 
-    "<!DOCTYPE html>\n"
-    "<html lang=\"en\">\n"
-    "<head>\n"
-    "    <meta charset=\"UTF-8\">\n"
-    "    <meta name=\"viewport\" content=\"width=device-width, initial-scale=1.0\">\n"
-    "    <title>ESP32 UPS Monitor & Configuration</title>\n"
-    "    <style>\n"
-    "        * { margin: 0; padding: 0; box-sizing: border-box; }\n"
-    "        body { font-family: 'Segoe UI', sans-serif; background: linear-gradient(135deg, #667eea 0%, #764ba2 100%); min-height: 100vh; padding: 20px; }\n"
-    "        .container { max-width: 800px; margin: 0 auto; background: white; border-radius: 15px; box-shadow: 0 20px 40px rgba(0,0,0,0.1); overflow: hidden; }\n"
-    "        .header { background: linear-gradient(135deg, #2c3e50 0%, #34495e 100%); color: white; padding: 30px; text-align: center; }\n"
-    "        .header h1 { font-size: 2.5em; margin-bottom: 10px; }\n"
-    "        .content { padding: 30px; }\n"
-    "        .section { background: #f8f9fa; border-radius: 10px; padding: 25px; margin-bottom: 25px; border-left: 5px solid #3498db; }\n"
-    "        .section h2 { color: #2c3e50; margin-bottom: 20px; font-size: 1.5em; }\n"
-    "        .form-group { margin-bottom: 20px; }\n"
-    "        .form-group label { display: block; margin-bottom: 8px; font-weight: 600; color: #2c3e50; }\n"
-    "        .form-group input { width: 100%; padding: 12px; border: 2px solid #e9ecef; border-radius: 8px; font-size: 16px; }\n"
-    "        .btn { padding: 12px 24px; border: none; border-radius: 8px; font-size: 16px; font-weight: 600; cursor: pointer; margin-right: 10px; }\n"
-    "        .btn-primary { background: #3498db; color: white; }\n"
-    "        .btn-secondary { background: #95a5a6; color: white; }\n"
-    "        .btn-danger { background: #e74c3c; color: white; }\n"
-    "        .status { padding: 15px; border-radius: 8px; margin-bottom: 20px; }\n"
-    "        .status.success { background: #d4edda; color: #155724; border: 1px solid #c3e6cb; }\n"
-    "        .status.error { background: #f8d7da; color: #721c24; border: 1px solid #f5c6cb; }\n"
-    "        .status-indicator { display: inline-block; width: 14px; height: 14px; border-radius: 50%; margin-right: 8px; vertical-align: middle; background: #bbb; }\n"
-    "        .status-indicator.green { background: #27ae60; }\n"
-    "        .status-indicator.red { background: #e74c3c; }\n"
-    "        .status-indicator.yellow { background: #f1c40f; }\n"
-    "        .signal-bar { display: inline-block; width: 8px; height: 18px; margin-right: 2px; background: #dfe6e9; border-radius: 2px 2px 0 0; vertical-align: bottom; opacity: 0.5; transition: background 0.2s, opacity 0.2s; }\n"
-    "        .signal-bar.active { background: #3498db; opacity: 1; }\n"
-        "        .signal-inline { display: flex; align-items: center; font-size: 1.1em; color: #495057; gap: 8px; }\n"
-        "        .signal-bars { display: flex; gap: 3px; justify-content: center; }\n"
-        "        .signal-bar-new { width: 8px; height: 20px; border-radius: 2px; background: #e9ecef; transition: all 0.3s ease; }\n"
-        "        .signal-bar-new.active { animation: pulse 2s infinite; }\n"
-        "        .signal-bar-new.active.strong { background: #28a745; box-shadow: 0 0 10px rgba(40, 167, 69, 0.3); }\n"
-        "        .signal-bar-new.active.medium { background: #ffc107; box-shadow: 0 0 10px rgba(255, 193, 7, 0.3); }\n"
-        "        .signal-bar-new.active.weak { background: #dc3545; box-shadow: 0 0 10px rgba(220, 53, 69, 0.3); }\n"
-        "        @keyframes pulse { 0%, 100% { opacity: 1; } 50% { opacity: 0.7; } }\n"
-        "        .signal-percentage { font-size: 1em; font-weight: 500; color: #495057; margin-left: 6px; }\n"
-    "        .footer { background: #ecf0f1; padding: 20px 30px; text-align: center; color: #7f8c8d; }\n"
-    "    </style>\n"
-    "</head>\n"
-    "<body>\n"
-    "    <div class=\"container\">\n"
-    "        <div class=\"header\">\n"
-    "            <h1>ESP32 UPS Monitor & Configuration</h1>\n"
-    "            <p>WiFi Configuration</p>\n"
-    "        </div>\n"
-    "        <div class=\"content\">\n"
-    "            <div class=\"section\">\n"
-    "                <h2>WiFi Configuration</h2>\n"
-    "                <div id=\"status\"></div>\n"
-    "                <form id=\"wifiForm\">\n"
-    "                    <div class=\"form-group\">\n"
-    "                        <label for=\"ssid\">WiFi SSID:</label>\n"
-    "                        <input type=\"text\" id=\"ssid\" name=\"ssid\" placeholder=\"Enter WiFi network name\" required>\n"
-    "                    </div>\n"
-    "                    <div class=\"form-group\">\n"
-    "                        <label for=\"password\">WiFi Password:</label>\n"
-    "                        <input type=\"password\" id=\"password\" name=\"password\" placeholder=\"Enter WiFi password\" required>\n"
-    "                    </div>\n"
-    "                    <button type=\"submit\" class=\"btn btn-primary\">Save & Reboot</button>\n"
-    "                    <button type=\"button\" class=\"btn btn-secondary\" onclick=\"rebootDevice()\">Reboot Only</button>\n"
-    "                </form>\n"
-    "            </div>\n"
-    "            <div class=\"section\">\n"
-    "                <h2>Reset to Factory Settings</h2>\n"
-    "                <p><strong>If you can't connect to WiFi and need to reset to factory settings:</strong></p>\n"
-    "                <ol style=\"margin-left: 20px; line-height: 1.6;\">\n"
-    "                    <li>While the ESP32 is running, hold down the <strong>BOOT button</strong></li>\n"
-    "                    <li>Keep holding for 5 seconds - you'll see the LED turn purple during the countdown</li>\n"
-    "                    <li>When the LED turns <strong>blue</strong>, you can release the button</li>\n"
-    "                    <li>Device will clear WiFi credentials and reboot automatically</li>\n"
-    "                    <li>Device will reboot and connect using factory WiFi settings</li>\n"
-    "                </ol>\n"
-    "                <p style=\"margin-top: 15px; padding: 10px; background: #fff3cd; border: 1px solid #ffeaa7; border-radius: 5px; color: #856404;\">\n"
-    "                    <strong>Note:</strong> This will clear any saved WiFi credentials and restore the original hardcoded settings from the firmware. The LED color changes provide visual feedback: Purple = counting down, Blue = safe to release.\n"
-    "                </p>\n"
-    "            </div>\n"
-    "            <div class=\"section\" id=\"dashboard-section\">\n"
-    "                <h2>System Status Dashboard</h2>\n"
-    "                <div class=\"status-row\">\n"
-    "                    <span id=\"wifi-indicator\" class=\"status-indicator\"></span>\n"
-    "                    <span class=\"status-label\">WiFi Status:</span>\n"
-    "                    <span id=\"wifi-status\" class=\"status-value\"></span>\n"
-    "                </div>\n"
-    "                <div id=\"wifi-details\" style=\"margin-left:32px; color:#636e72; font-size:0.97em; margin-bottom:10px;\"></div>\n"
-    "                <div id=\"wifi-signal-container\" style=\"margin-left:32px; color:#636e72; font-size:0.97em; margin-bottom:10px;\"></div>\n"
-    "                <div class=\"status-row\">\n"
-    "                    <span id=\"ups-indicator\" class=\"status-indicator\"></span>\n"
-    "                    <span class=\"status-label\">UPS Status:</span>\n"
-    "                    <span id=\"ups-status\" class=\"status-value\"></span>\n"
-    "                </div>\n"
-    "                <div id=\"ups-details\" style=\"margin-left:32px; color:#636e72; font-size:0.97em; margin-bottom:10px;\"></div>\n"
-    "                <div class=\"status-row\">\n"
-    "                    <span id=\"tcp-indicator\" class=\"status-indicator\"></span>\n"
-    "                    <span class=\"status-label\">TCP Status:</span>\n"
-    "                    <span id=\"tcp-status\" class=\"status-value\"></span>\n"
-    "                </div>\n"
-    "                <div id=\"tcp-details\" style=\"margin-left:32px; color:#636e72; font-size:0.97em; margin-bottom:10px;\"></div>\n"
-    "                <div class=\"status-row\">\n"
-    "                    <span id=\"esp-indicator\" class=\"status-indicator\"></span>\n"
-    "                    <span class=\"status-label\">ESP Health:</span>\n"
-    "                    <span id=\"esp-status\" class=\"status-value\"></span>\n"
-    "                </div>\n"
-    "                <div id=\"esp-details\" style=\"margin-left:32px; color:#636e72; font-size:0.97em; margin-bottom:10px;\"></div>\n"
-    "            </div>\n"
-    "        </div>\n"
-    "        <div class=\"footer\">\n"
-    "            <p>ESP32 UPS Server - System Status and Configuration Interface</p>\n"
-    "        </div>\n"
-    "    </div>\n"
-    "    <script>\n"
-    "    document.getElementById('wifiForm').addEventListener('submit', function(e) {\n"
-    "        e.preventDefault();\n"
-    "        const formData = new FormData(this);\n"
-    "        const data = {\n"
-    "            ssid: formData.get('ssid'),\n"
-    "            password: formData.get('password')\n"
-    "        };\n"
-    "        fetch('/config', {\n"
-    "            method: 'POST',\n"
-    "            headers: {\n"
-    "                'Content-Type': 'application/json',\n"
-    "            },\n"
-    "            body: JSON.stringify(data)\n"
-    "        })\n"
-    "        .then(response => response.json())\n"
-    "        .then(data => {\n"
-    "            showStatus(data.success ? 'Configuration saved successfully! Device will reboot...' : 'Error: ' + data.message, data.success);\n"
-    "            if (data.success) {\n"
-    "                setTimeout(() => {\n"
-    "                    window.location.reload();\n"
-    "                }, 3000);\n"
-    "            }\n"
-    "        })\n"
-    "        .catch(error => {\n"
-    "            showStatus('Error: ' + error.message, false);\n"
-    "        });\n"
-    "    });\n"
-    "    function rebootDevice() {\n"
-    "        if (confirm('Are you sure you want to reboot the device?')) {\n"
-    "            fetch('/reboot', {\n"
-    "                method: 'POST'\n"
-    "            })\n"
-    "            .then(response => response.json())\n"
-    "            .then(data => {\n"
-    "                showStatus('Device rebooting...', true);\n"
-    "                setTimeout(() => {\n"
-    "                    window.location.reload();\n"
-    "                }, 5000);\n"
-    "            })\n"
-    "            .catch(error => {\n"
-    "                showStatus('Error: ' + error.message, false);\n"
-    "            });\n"
-    "        }\n"
-    "    }\n"
-    "    function showStatus(message, isSuccess) {\n"
-    "        const statusDiv = document.getElementById('status');\n"
-    "        statusDiv.className = 'status ' + (isSuccess ? 'success' : 'error');\n"
-    "        statusDiv.textContent = message;\n"
-    "    }\n"
-    "    const TOTAL_BARS = 10;\n"
-    "    function initializeSignalBars() {\n"
-    "        const signalBarsContainer = document.getElementById('wifi-signal-container');\n"
-    "        signalBarsContainer.innerHTML = '<span class=\"signal-inline\">Signal: <span class=\"signal-bars\" id=\"signalBars\"></span><span class=\"signal-percentage\" id=\"signalValue\">0%</span></span>';\n"
-    "        const barsContainer = document.getElementById('signalBars');\n"
-    "        barsContainer.innerHTML = '';\n"
-    "        for (let i = 0; i < TOTAL_BARS; i++) {\n"
-    "            const bar = document.createElement('div');\n"
-    "            bar.className = 'signal-bar-new';\n"
-    "            bar.id = `bar-${i}`;\n"
-    "            barsContainer.appendChild(bar);\n"
-    "        }\n"
-    "    }\n"
-    "    function setSignalValue(signalStrength) {\n"
-    "        const signalValueElement = document.getElementById('signalValue');\n"
-    "        if (signalValueElement) {\n"
-    "            signalValueElement.textContent = signalStrength + '%';\n"
-    "            const activeBars = Math.round((signalStrength / 100) * TOTAL_BARS);\n"
-    "            for (let i = 0; i < TOTAL_BARS; i++) {\n"
-    "                const bar = document.getElementById(`bar-${i}`);\n"
-    "                if (bar) {\n"
-    "                    bar.className = 'signal-bar-new';\n"
-    "                    if (i < activeBars) {\n"
-    "                        bar.classList.add('active');\n"
-    "                        if (signalStrength >= 70) {\n"
-    "                            bar.classList.add('strong');\n"
-    "                        } else if (signalStrength >= 30) {\n"
-    "                            bar.classList.add('medium');\n"
-    "                        } else {\n"
-    "                            bar.classList.add('weak');\n"
-    "                        }\n"
-    "                    }\n"
-    "                }\n"
-    "            }\n"
-    "        }\n"
-    "    }\n"
-    "    function updateWifiStatus() {\n"
-    "        fetch('/api/wifi_status').then(r => r.json()).then(data => {\n"
-    "            var ind = document.getElementById(\"wifi-indicator\");\n"
-    "            ind.className = 'status-indicator ' + (data.connected ? 'green' : 'red');\n"
-    "            document.getElementById(\"wifi-status\").textContent = data.connected ? 'CONNECTED' : 'DISCONNECTED';\n"
-    "            var percent = (typeof data.signal === 'number') ? Math.max(0, Math.min(100, 2 * (data.signal + 100))) : 0;\n"
-    "            var details = data.connected\n"
-    "                ? (data.ip + ' | ' + data.ssid + ' | ' + percent + '%')\n"
-    "                : 'Not connected';\n"
-    "            document.getElementById(\"wifi-details\").innerHTML = details;\n"
-    "            if (data.connected) {\n"
-    "                setSignalValue(percent);\n"
-    "            } else {\n"
-    "                setSignalValue(0);\n"
-    "            }\n"
-    "        });\n"
-    "    }\n"
-    "    function formatUptime(seconds) {\n"
-    "        if (seconds < 60) {\n"
-    "            return Math.floor(seconds) + ' seconds';\n"
-    "        } else if (seconds < 3600) {\n"
-    "            var minutes = Math.floor(seconds / 60);\n"
-    "            var remainingSeconds = Math.floor(seconds % 60);\n"
-    "            return minutes + ' minutes ' + remainingSeconds + ' seconds';\n"
-    "        } else if (seconds < 86400) {\n"
-    "            var hours = Math.floor(seconds / 3600);\n"
-    "            var minutes = Math.floor((seconds % 3600) / 60);\n"
-    "            var remainingSeconds = Math.floor(seconds % 60);\n"
-    "            return hours + ' hours ' + minutes + ' minutes ' + remainingSeconds + ' seconds';\n"
-    "        } else {\n"
-    "            var days = Math.floor(seconds / 86400);\n"
-    "            var hours = Math.floor((seconds % 86400) / 3600);\n"
-    "            var minutes = Math.floor((seconds % 3600) / 60);\n"
-    "            var remainingSeconds = Math.floor(seconds % 60);\n"
-    "            return days + ' days ' + hours + ' hours ' + minutes + ' minutes ' + remainingSeconds + ' seconds';\n"
-    "        }\n"
-    "    }\n"
-    "    function formatTimeAgo(seconds) {\n"
-    "        if (seconds < 60) {\n"
-    "            return Math.floor(seconds) + ' seconds ago';\n"
-    "        } else if (seconds < 3600) {\n"
-    "            var minutes = Math.floor(seconds / 60);\n"
-    "            var remainingSeconds = Math.floor(seconds % 60);\n"
-    "            return minutes + ' minutes ' + remainingSeconds + ' seconds ago';\n"
-    "        } else if (seconds < 86400) {\n"
-    "            var hours = Math.floor(seconds / 3600);\n"
-    "            var minutes = Math.floor((seconds % 3600) / 60);\n"
-    "            var remainingSeconds = Math.floor(seconds % 60);\n"
-    "            return hours + ' hours ' + minutes + ' minutes ' + remainingSeconds + ' seconds ago';\n"
-    "        } else {\n"
-    "            var days = Math.floor(seconds / 86400);\n"
-    "            var hours = Math.floor((seconds % 86400) / 3600);\n"
-    "            var minutes = Math.floor((seconds % 3600) / 60);\n"
-    "            var remainingSeconds = Math.floor(seconds % 60);\n"
-    "            return days + ' days ' + hours + ' hours ' + minutes + ' minutes ' + remainingSeconds + ' seconds ago';\n"
-    "        }\n"
-    "    }\n"
-    "    function updateUpsStatus() {\n"
-    "        fetch('/api/ups_status').then(r => r.json()).then(data => {\n"
-    "            var ind = document.getElementById(\"ups-indicator\");\n"
-    "            ind.className = 'status-indicator ' + data.color;\n"
-    "            var statusText = data.state;\n"
-    "            var detailsText = '';\n"
-    "            if (data.state === 'STALE' && typeof data.stale_duration_ms === 'number') {\n"
-    "                var staleSeconds = Math.floor(data.stale_duration_ms / 1000);\n"
-    "                statusText += ' (for ' + formatUptime(staleSeconds) + ')';\n"
-    "            }\n"
-    "            document.getElementById(\"ups-status\").textContent = statusText;\n"
-    "            var seconds = data.ms_since_last / 1000;\n"
-    "            var timeAgo = formatTimeAgo(seconds);\n"
-    "            detailsText = 'Last message: ' + timeAgo;\n"
-    "            document.getElementById(\"ups-details\").textContent = detailsText;\n"
-    "        });\n"
-    "    }\n"
-    "    function updateTcpStatus() {\n"
-    "        fetch('/api/tcp_status').then(r => r.json()).then(data => {\n"
-    "            var ind = document.getElementById(\"tcp-indicator\");\n"
-    "            var statusText = '';\n"
-    "            var color = 'red';\n"
-    "            var connectionsText = '';\n"
-    "            if (data.running) {\n"
-    "                if (data.connections > 0) {\n"
-    "                    color = 'green';\n"
-    "                    statusText = 'RUNNING';\n"
-    "                    connectionsText = 'Connections: ' + data.connections + ' connection' + (data.connections !== 1 ? 's' : '');\n"
-    "                } else {\n"
-    "                    color = 'yellow';\n"
-    "                    statusText = 'RUNNING';\n"
-    "                    connectionsText = 'Connections: 0 connections';\n"
-    "                }\n"
-    "            } else {\n"
-    "                color = 'red';\n"
-    "                statusText = 'STOPPED';\n"
-    "                connectionsText = 'Connections: 0 connections';\n"
-    "            }\n"
-    "            ind.className = 'status-indicator ' + color;\n"
-    "            document.getElementById(\"tcp-status\").textContent = statusText;\n"
-    "            document.getElementById(\"tcp-details\").textContent = connectionsText;\n"
-    "        });\n"
-    "    }\n"
-    "    function updateEspHealthStatus() {\n"
-    "        fetch('/api/esp_health').then(r => r.json()).then(data => {\n"
-    "            var ind = document.getElementById(\"esp-indicator\");\n"
-    "            var statusText = '';\n"
-    "            var color = 'red';\n"
-    "            if (data.memory_percent >= 65) {\n"
-    "                color = 'green';\n"
-    "                statusText = 'HEALTHY';\n"
-    "            } else if (data.memory_percent >= 30) {\n"
-    "                color = 'yellow';\n"
-    "                statusText = 'WARNING';\n"
-    "            } else {\n"
-    "                color = 'red';\n"
-    "                statusText = 'CRITICAL';\n"
-    "            }\n"
-    "            ind.className = 'status-indicator ' + color;\n"
-    "            document.getElementById(\"esp-status\").textContent = statusText;\n"
-    "            var freeKB = Math.floor(data.free_heap / 1024);\n"
-    "            var totalKB = Math.floor(data.total_heap / 1024);\n"
-    "            var memoryText = 'Free Memory: ' + freeKB + 'KB out of ' + totalKB + 'KB (' + data.memory_percent + '% Free)';\n"
-    "            var uptimeText = 'Uptime: ' + formatUptime(data.uptime_seconds);\n"
-    "            document.getElementById(\"esp-details\").innerHTML = memoryText + '<br>' + uptimeText;\n"
-    "        });\n"
-    "    }\n"
-    "    initializeSignalBars();\n"
-    "    updateWifiStatus();\n"
-    "    updateUpsStatus();\n"
-    "    updateTcpStatus();\n"
-    "    updateEspHealthStatus();\n"
-    "    setInterval(updateWifiStatus, 5000);\n"
-    "    setInterval(updateUpsStatus, 5000);\n"
-    "    setInterval(updateTcpStatus, 5000);\n"
-    "    setInterval(updateEspHealthStatus, 5000);\n"
-    "    </script>\n"
-    "</body>\n"
-    "</html>";
+typedef struct {
+    const uint8_t *start;
+    const uint8_t *end;
+    const char *content_type;
+    const char *cache_control;
+    char etag[12];              // Strong ETag, filled in by webserver_start()
+} web_asset_t;
+
+// index.html is revalidated on every visit; app.js/app.css are requested with a
+// content hash in the query string, so they can be cached for a year
+static web_asset_t asset_index = { index_html_gz_start, index_html_gz_end, "text/html", "no-cache", "" };
+static web_asset_t asset_app_js = { app_js_gz_start, app_js_gz_end, "application/javascript", "public, max-age=31536000, immutable", "" };
+static web_asset_t asset_app_css = { app_css_gz_start, app_css_gz_end, "text/css", "public, max-age=31536000, immutable", "" };
 
 // --- Periodic free heap logging ---
 static void log_free_heap(void* arg) {
     ESP_LOGI(TAG, "Free heap: %u bytes, Min free heap: %u bytes", (unsigned int)esp_get_free_heap_size(), (unsigned int)esp_get_minimum_free_heap_size());
 }
 
+// Runs on the scheduler task and keeps running across webserver restarts
 static void start_free_heap_logging(void) {
-    if (!free_heap_log_timer) {
+    if (!free_heap_log_job.fn) {
+        scheduler_add(&free_heap_log_job, "heap_log", FREE_HEAP_LOG_INTERVAL_MS, log_free_heap, NULL);
+    }
+}
+
+// --- HTTP session tracking (keep-alive idle reaping) ---
+// All of this runs on the httpd task (open/close callbacks, handlers, queued
+// work), so the table needs no lock.
+typedef struct {
+    int fd;                     // -1 = free
+    int64_t last_activity_us;
+} web_session_t;
+
+static web_session_t web_sessions[HTTPD_MAX_OPEN_SOCKETS];
+static uint32_t web_sessions_opened = 0;
+static uint32_t web_sessions_reaped = 0;
+static int web_sessions_open = 0;
+static esp_timer_handle_t idle_reap_timer = NULL;
+
+static web_session_t *web_session_find(int fd)
+{
+    for (size_t i = 0; i < HTTPD_MAX_OPEN_SOCKETS; i++) {
+        if (web_sessions[i].fd == fd) {
+            return &web_sessions[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t web_session_open(httpd_handle_t hd, int sockfd)
+{
+    web_session_t *s = web_session_find(-1);
+    if (s) {
+        s->fd = sockfd;
+        s->last_activity_us = esp_timer_get_time();
+    }
+    web_sessions_opened++;
+    web_sessions_open++;
+    return ESP_OK;
+}
+
+// With close_fn set, httpd leaves closing the socket to us
+static void web_session_close(httpd_handle_t hd, int sockfd)
+{
+    web_session_t *s = web_session_find(sockfd);
+    if (s) {
+        s->fd = -1;
+    }
+    web_sessions_open--;
+    close(sockfd);
+}
+
+// The request being handled. Handlers only run on the httpd task, one at a time.
+typedef struct {
+    uint32_t id;
+    bool failed;
+} web_request_t;
+
+static web_request_t web_current;
+
+// Count the request as an error even though the handler answered it
+static void web_request_fail(void)
+{
+    web_current.failed = true;
+}
+
+// Count the request and mark its session active
+static void web_request_begin(httpd_req_t *req, int64_t now_us)
+{
+    web_session_t *s = web_session_find(httpd_req_to_sockfd(req));
+    if (s) {
+        s->last_activity_us = now_us;
+    }
+    web_current.id = __atomic_add_fetch(&webserver_req_counter, 1, __ATOMIC_SEQ_CST);
+    web_current.failed = false;
+}
+
+// JSON bodies stream through a json_writer_t straight into chunked responses.
+// Handlers run one at a time on the httpd task, so they share one stage buffer.
+static char web_json_stage[512];
+static heap_tag_t web_json_heap_prev;
+
+static esp_err_t web_json_flush(void *ctx, const char *data, size_t len)
+{
+    return httpd_resp_send_chunk((httpd_req_t *)ctx, data, len);
+}
+
+static void web_json_begin(httpd_req_t *req, json_writer_t *w)
+{
+    httpd_resp_set_type(req, "application/json");
+    json_writer_init_stream(w, web_json_stage, sizeof(web_json_stage), web_json_flush, req);
+    web_json_heap_prev = heap_monitor_scope_begin(HEAP_TAG_JSON);
+}
+
+// Flush and terminate the response. A failed send is returned so httpd drops the socket.
+static esp_err_t web_json_end(httpd_req_t *req, json_writer_t *w)
+{
+    esp_err_t err = json_writer_finish(w);
+    heap_monitor_scope_end(web_json_heap_prev);
+    if (err != ESP_OK) {
+        ESP_LOGW(TAG, "JSON response for %s failed", req->uri);
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return err;
+}
+
+// {"success":...,"message":...} used by the configuration endpoints
+static esp_err_t web_send_result(httpd_req_t *req, bool success, const char *message)
+{
+    json_writer_t w;
+    web_json_begin(req, &w);
+    json_obj_begin(&w, NULL);
+    json_bool(&w, "success", success);
+    json_str(&w, "message", message);
+    json_obj_end(&w);
+    return web_json_end(req, &w);
+}
+
+// Runs on the httpd task via httpd_queue_work
+static void web_reap_idle_sessions(void *arg)
+{
+    httpd_handle_t hd = server;
+    if (!hd) {
+        return;
+    }
+    int64_t now = esp_timer_get_time();
+    for (size_t i = 0; i < HTTPD_MAX_OPEN_SOCKETS; i++) {
+        int fd = web_sessions[i].fd;
+        if (fd < 0 || now - web_sessions[i].last_activity_us < HTTPD_IDLE_TIMEOUT_US) {
+            continue;
+        }
+#if CONFIG_HTTPD_WS_SUPPORT
+        // Live stream subscribers are idle by design
+        if (httpd_ws_get_fd_info(hd, fd) == HTTPD_WS_CLIENT_WEBSOCKET) {
+            continue;
+        }
+#endif
+        ESP_LOGI(TAG, "Closing idle HTTP session fd=%d", fd);
+        web_sessions_reaped++;
+        httpd_sess_trigger_close(hd, fd);
+        web_sessions[i].last_activity_us = now;     // Do not trigger twice before close_fn runs
+    }
+}
+
+static void idle_reap_timer_cb(void *arg)
+{
+    if (server) {
+        httpd_queue_work(server, web_reap_idle_sessions, NULL);
+    }
+}
+
+static void start_idle_reaping(void) {
+    if (!idle_reap_timer) {
         const esp_timer_create_args_t timer_args = {
-            .callback = &log_free_heap,
+            .callback = &idle_reap_timer_cb,
             .arg = NULL,
             .dispatch_method = ESP_TIMER_TASK,
-            .name = "heaplog"
+            .name = "httpreap"
         };
-        esp_timer_create(&timer_args, &free_heap_log_timer);
-        esp_timer_start_periodic(free_heap_log_timer, FREE_HEAP_LOG_INTERVAL_MS * 1000);
+        esp_timer_create(&timer_args, &idle_reap_timer);
+        esp_timer_start_periodic(idle_reap_timer, HTTPD_REAP_INTERVAL_MS * 1000);
+    }
+}
+
+static void stop_idle_reaping(void) {
+    if (idle_reap_timer) {
+        esp_timer_stop(idle_reap_timer);
+        esp_timer_delete(idle_reap_timer);
+        idle_reap_timer = NULL;
     }
 }
 
+void webserver_get_stats(webserver_stats_t *out)
+{
+    out->open_sessions = web_sessions_open;
+    out->max_sessions = HTTPD_MAX_OPEN_SOCKETS;
+    out->sessions_opened = web_sessions_opened;
+    out->idle_reaped = web_sessions_reaped;
+    out->requests = __atomic_load_n(&webserver_req_counter, __ATOMIC_RELAXED);
+}
+
 static void reset_accept_error_state(void) {
     accept_error_counter = 0;
     accept_error_first_ts = 0;
@@ -420,22 +292,22 @@ void handle_accept_error(void) {
     accept_error_counter++;
     if ((now - accept_error_first_ts) < ACCEPT_ERROR_WINDOW_MS) {
         if (accept_error_counter > ACCEPT_ERROR_THRESHOLD) {
-            // Burst detected, proceed to memory check and self-check
-            if (esp_get_free_heap_size() < FREE_HEAP_CRITICAL) {
-                ESP_LOGE(TAG, "[RESILIENCE] Heap critically low (%u bytes), rebooting system", (unsigned int)esp_get_free_heap_size());
+            // Burst detected, proceed to memory check and heartbeat check
+            uint32_t largest_block;
+            if (heap_monitor_critical(&largest_block)) {
+                ESP_LOGE(TAG, "[RESILIENCE] Largest free block critically small (%u bytes, %u free), rebooting system",
+                         (unsigned int)largest_block, (unsigned int)esp_get_free_heap_size());
+                soe_record(SOE_RESTART_REQUEST, SOE_RESTART_HEAP_LOW);
                 esp_restart();
                 return;
             }
-            ESP_LOGW(TAG, "[RESILIENCE] Accept error burst detected, performing self-check");
-            if (!perform_self_check()) {
-                ESP_LOGE(TAG, "[RESILIENCE] Self-check failed, restarting webserver");
-                if (server) {
-                    httpd_stop(server);
-                    server = NULL;
-                }
-                webserver_start();
+            // Leave the restart decision to the supervisor, which also counts it
+            // towards its reboot escalation
+            if (!supervisor_is_alive(SUPERVISOR_HTTPD)) {
+                ESP_LOGE(TAG, "[RESILIENCE] Accept error burst and no httpd heartbeat, requesting restart");
+                supervisor_report_fault(SUPERVISOR_HTTPD);
             } else {
-                ESP_LOGI(TAG, "[RESILIENCE] Self-check succeeded, not restarting webserver");
+                ESP_LOGW(TAG, "[RESILIENCE] Accept error burst detected, httpd heartbeat is fine");
             }
             reset_accept_error_state();
         }
@@ -445,15 +317,27 @@ void handle_accept_error(void) {
     }
 }
 
-// --- Self-check: always use new TCP connection ---
+// --- Liveness ---
+// Runs on the httpd task: getting here proves the server loop is still serving
+// its control queue
+static void web_heartbeat_work(void *arg)
+{
+    supervisor_beat(SUPERVISOR_HTTPD);
+}
+
+#if CONFIG_UPS_SUPERVISOR_HTTP_PROBE
+// Deep probe: a real request over a new TCP connection
 static bool perform_self_check(void) {
     esp_http_client_config_t config = {
         .url = SELF_CHECK_URL,
         .method = HTTP_METHOD_GET,
-        .timeout_ms = 2000,
+        .timeout_ms = SELF_CHECK_TIMEOUT_MS,
         .disable_auto_redirect = true,
     };
     esp_http_client_handle_t client = esp_http_client_init(&config);
+    if (!client) {
+        return false;
+    }
     esp_http_client_set_header(client, "Connection", "close");
     esp_err_t err = esp_http_client_perform(client);
     int status = esp_http_client_get_status_code(client);
@@ -464,70 +348,80 @@ static bool perform_self_check(void) {
     ESP_LOGW(TAG, "[RESILIENCE] Self-check HTTP error: %s, status: %d", esp_err_to_name(err), status);
     return false;
 }
+#endif
 
-// --- TCP Status API Handler ---
-extern int get_active_tcp_connections(void);
-extern bool is_tcp_server_running(void);
+// Supervisor poke, on the supervisor task once per period
+static void web_supervisor_poke(void)
+{
+    if (server) {
+        httpd_queue_work(server, web_heartbeat_work, NULL);
+    }
+#if CONFIG_UPS_SUPERVISOR_HTTP_PROBE
+    static int64_t last_probe_us = 0;
+    static int probe_failures = 0;
+    int64_t now = esp_timer_get_time();
+    if (server && now - last_probe_us >= (int64_t)CONFIG_UPS_SUPERVISOR_HTTP_PROBE_INTERVAL_S * 1000000) {
+        last_probe_us = now;
+        if (perform_self_check()) {
+            probe_failures = 0;
+        } else if (++probe_failures >= SELF_CHECK_FAIL_LIMIT) {
+            probe_failures = 0;
+            supervisor_report_fault(SUPERVISOR_HTTPD);
+        }
+    }
+#endif
+}
 
+// --- TCP Status API Handler ---
 static esp_err_t tcp_status_get_handler(httpd_req_t *req)
 {
-    uint32_t req_id = __atomic_add_fetch(&webserver_req_counter, 1, __ATOMIC_SEQ_CST);
-    ESP_LOGI(TAG, "[REQ %lu] tcp_status_get_handler START uri=%s", (unsigned long)req_id, req->uri);
-    httpd_resp_set_hdr(req, "Connection", "close");
-    char response[128];
-    bool running = is_tcp_server_running();
-    int connections = get_active_tcp_connections();
-    snprintf(response, sizeof(response),
-        "{\"running\":%s,\"connections\":%d}",
-        running ? "true" : "false", connections);
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
-    ESP_LOGI(TAG, "[REQ %lu] tcp_status_get_handler END", (unsigned long)req_id);
-    return ESP_OK;
+    json_writer_t w;
+    web_json_begin(req, &w);
+    json_obj_begin(&w, NULL);
+    json_bool(&w, "running", is_tcp_server_running());
+    json_int(&w, "connections", get_active_tcp_connections());
+    json_obj_end(&w);
+    return web_json_end(req, &w);
 }
 
 // --- ESP Health API Handler ---
 static esp_err_t esp_health_get_handler(httpd_req_t *req)
 {
-    uint32_t req_id = __atomic_add_fetch(&webserver_req_counter, 1, __ATOMIC_SEQ_CST);
-    ESP_LOGI(TAG, "[REQ %lu] esp_health_get_handler START uri=%s", (unsigned long)req_id, req->uri);
-    httpd_resp_set_hdr(req, "Connection", "close");
-    
-    // Get memory information
-    size_t free_heap = esp_get_free_heap_size();
-    
-    // ESP32-S3 has approximately 512KB of SRAM, but actual available heap is less
-    // Using a conservative estimate of 320KB total heap for calculation
-    const size_t total_heap_estimate = 320 * 1024; // 320KB in bytes
-    int memory_percent = (int)((free_heap * 100) / total_heap_estimate);
-    
-    // Get uptime in seconds
-    int64_t uptime_us = esp_timer_get_time();
-    int64_t uptime_seconds = uptime_us / 1000000;
-    
-    char response[256];
-    snprintf(response, sizeof(response),
-        "{\"free_heap\":%u,\"total_heap\":%u,\"memory_percent\":%d,\"uptime_seconds\":%lld}",
-        (unsigned int)free_heap, (unsigned int)total_heap_estimate, memory_percent, (long long)uptime_seconds);
+    // Default-capability heap, the one malloc() draws from
+    heap_region_stats_t heap;
+    heap_monitor_region(MALLOC_CAP_DEFAULT, &heap);
+    int memory_percent = heap.total ? (int)((uint64_t)heap.free * 100 / heap.total) : 0;
     
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
-    ESP_LOGI(TAG, "[REQ %lu] esp_health_get_handler END", (unsigned long)req_id);
-    return ESP_OK;
+    json_writer_t w;
+    web_json_begin(req, &w);
+    json_obj_begin(&w, NULL);
+    json_uint(&w, "free_heap", heap.free);
+    json_uint(&w, "total_heap", heap.total);
+    json_int(&w, "memory_percent", memory_percent);
+    json_uint(&w, "min_free_heap", heap.minimum_free);
+    json_uint(&w, "largest_free_block", heap.largest_free_block);
+    json_uint(&w, "fragmentation_pct", heap.fragmentation_pct);
+    json_int(&w, "uptime_seconds", esp_timer_get_time() / 1000000);
+    json_obj_begin(&w, "http");
+    json_int(&w, "open_sessions", web_sessions_open);
+    json_int(&w, "max_sessions", HTTPD_MAX_OPEN_SOCKETS);
+    json_uint(&w, "sessions_opened", web_sessions_opened);
+    json_uint(&w, "idle_reaped", web_sessions_reaped);
+    json_obj_end(&w);
+    json_obj_end(&w);
+    return web_json_end(req, &w);
 }
 
 // WiFi configuration handler
 static esp_err_t config_post_handler(httpd_req_t *req)
 {
-    uint32_t req_id = __atomic_add_fetch(&webserver_req_counter, 1, __ATOMIC_SEQ_CST);
-    ESP_LOGI(TAG, "[REQ %lu] config_post_handler START uri=%s", (unsigned long)req_id, req->uri);
+    uint32_t req_id = web_current.id;
     httpd_resp_set_hdr(req, "Connection", "close");
     char content[512];
     int received = httpd_req_recv(req, content, sizeof(content) - 1);
     if (received <= 0) {
         ESP_LOGW(TAG, "[REQ %lu] config_post_handler FAILED to receive data", (unsigned long)req_id);
         httpd_resp_send_err(req, HTTPD_400_BAD_REQUEST, "Failed to receive data");
-        ESP_LOGI(TAG, "[REQ %lu] config_post_handler END (error)", (unsigned long)req_id);
         return ESP_FAIL;
     }
     content[received] = '\0';
@@ -566,66 +460,39 @@ static esp_err_t config_post_handler(httpd_req_t *req)
     
     if (strlen(ssid) == 0 || strlen(password) == 0) {
         ESP_LOGW(TAG, "[REQ %lu] config_post_handler MISSING SSID or password", (unsigned long)req_id);
-        const char* error_response = "{\"success\":false,\"message\":\"Missing SSID or password\"}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, error_response, HTTPD_RESP_USE_STRLEN);
-        ESP_LOGI(TAG, "[REQ %lu] config_post_handler END (missing data)", (unsigned long)req_id);
-        return ESP_OK;
-    }
-    
-    // Save to NVS
-    nvs_handle_t nvs_handle;
-    esp_err_t err = nvs_open(WIFI_NVS_NAMESPACE, NVS_READWRITE, &nvs_handle);
-    if (err != ESP_OK) {
-        ESP_LOGE(TAG, "[REQ %lu] config_post_handler Error opening NVS handle: %s", (unsigned long)req_id, esp_err_to_name(err));
-        const char* error_response = "{\"success\":false,\"message\":\"Failed to open NVS\"}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, error_response, HTTPD_RESP_USE_STRLEN);
-        ESP_LOGI(TAG, "[REQ %lu] config_post_handler END (NVS error)", (unsigned long)req_id);
-        return ESP_OK;
+        web_request_fail();
+        return web_send_result(req, false, "Missing SSID or password");
     }
     
-    err = nvs_set_str(nvs_handle, WIFI_SSID_KEY, ssid);
+    // Save to NVS (committed now, the device reboots right after)
+    esp_err_t err = persist_set_str(PERSIST_WIFI_SSID, ssid);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "[REQ %lu] config_post_handler Error saving SSID: %s", (unsigned long)req_id, esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        const char* error_response = "{\"success\":false,\"message\":\"Failed to save SSID\"}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, error_response, HTTPD_RESP_USE_STRLEN);
-        ESP_LOGI(TAG, "[REQ %lu] config_post_handler END (NVS error)", (unsigned long)req_id);
-        return ESP_OK;
+        web_request_fail();
+        return web_send_result(req, false, "Failed to save SSID");
     }
     
-    err = nvs_set_str(nvs_handle, WIFI_PASS_KEY, password);
+    err = persist_set_str(PERSIST_WIFI_PASSWORD, password);
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "[REQ %lu] config_post_handler Error saving password: %s", (unsigned long)req_id, esp_err_to_name(err));
-        nvs_close(nvs_handle);
-        const char* error_response = "{\"success\":false,\"message\":\"Failed to save password\"}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, error_response, HTTPD_RESP_USE_STRLEN);
-        ESP_LOGI(TAG, "[REQ %lu] config_post_handler END (NVS error)", (unsigned long)req_id);
-        return ESP_OK;
+        web_request_fail();
+        return web_send_result(req, false, "Failed to save password");
     }
     
-    err = nvs_commit(nvs_handle);
-    nvs_close(nvs_handle);
+    err = persist_flush();
     
     if (err != ESP_OK) {
         ESP_LOGE(TAG, "[REQ %lu] config_post_handler Error committing NVS: %s", (unsigned long)req_id, esp_err_to_name(err));
-        const char* error_response = "{\"success\":false,\"message\":\"Failed to commit configuration\"}";
-        httpd_resp_set_type(req, "application/json");
-        httpd_resp_send(req, error_response, HTTPD_RESP_USE_STRLEN);
-        ESP_LOGI(TAG, "[REQ %lu] config_post_handler END (NVS error)", (unsigned long)req_id);
-        return ESP_OK;
+        web_request_fail();
+        return web_send_result(req, false, "Failed to commit configuration");
     }
     
-    ESP_LOGI(TAG, "[REQ %lu] config_post_handler END (success)", (unsigned long)req_id);
-    const char* success_response = "{\"success\":true,\"message\":\"Configuration saved successfully\"}";
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, success_response, HTTPD_RESP_USE_STRLEN);
+    ESP_LOGI(TAG, "[REQ %lu] config_post_handler configuration saved", (unsigned long)req_id);
+    web_send_result(req, true, "Configuration saved successfully");
     
     // Schedule reboot after a short delay
     vTaskDelay(pdMS_TO_TICKS(1000));
+    soe_record(SOE_RESTART_REQUEST, SOE_RESTART_CONFIG_SAVED);
     esp_restart();
     
     return ESP_OK;
@@ -634,110 +501,454 @@ static esp_err_t config_post_handler(httpd_req_t *req)
 // Reboot handler
 static esp_err_t reboot_post_handler(httpd_req_t *req)
 {
-    uint32_t req_id = __atomic_add_fetch(&webserver_req_counter, 1, __ATOMIC_SEQ_CST);
-    ESP_LOGI(TAG, "[REQ %lu] reboot_post_handler START uri=%s", (unsigned long)req_id, req->uri);
     httpd_resp_set_hdr(req, "Connection", "close");
-    const char* response = "{\"success\":true,\"message\":\"Rebooting...\"}";
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
+    web_send_result(req, true, "Rebooting...");
     
     // Schedule reboot after a short delay
     vTaskDelay(pdMS_TO_TICKS(1000));
+    soe_record(SOE_RESTART_REQUEST, SOE_RESTART_USER_REQUEST);
     esp_restart();
     
-    ESP_LOGI(TAG, "[REQ %lu] reboot_post_handler END", (unsigned long)req_id);
     return ESP_OK;
 }
 
-// Root page handler
-static esp_err_t root_get_handler(httpd_req_t *req)
+// Static asset handler (user_ctx = web_asset_t): gzip body, strong ETag, 304 on match
+static esp_err_t asset_get_handler(httpd_req_t *req)
 {
-    uint32_t req_id = __atomic_add_fetch(&webserver_req_counter, 1, __ATOMIC_SEQ_CST);
-    ESP_LOGI(TAG, "[REQ %lu] root_get_handler START uri=%s", (unsigned long)req_id, req->uri);
-    httpd_resp_set_hdr(req, "Connection", "close");
-    httpd_resp_set_type(req, "text/html");
-    httpd_resp_send(req, html_content, HTTPD_RESP_USE_STRLEN);
-    ESP_LOGI(TAG, "[REQ %lu] root_get_handler END", (unsigned long)req_id);
+    const web_asset_t *asset = (const web_asset_t *)req->user_ctx;
+    httpd_resp_set_hdr(req, "ETag", asset->etag);
+    httpd_resp_set_hdr(req, "Cache-Control", asset->cache_control);
+
+    char if_none_match[16];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, asset->etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
+
+    // Every browser we serve accepts gzip; there is no uncompressed copy on flash
+    httpd_resp_set_type(req, asset->content_type);
+    httpd_resp_set_hdr(req, "Content-Encoding", "gzip");
+    httpd_resp_send(req, (const char *)asset->start, asset->end - asset->start);
     return ESP_OK;
 }
 
+// FNV-1a over the compressed bytes; stable for a given build
+static void web_asset_init_etag(web_asset_t *asset)
+{
+    uint32_t hash = 2166136261u;
+    for (const uint8_t *p = asset->start; p < asset->end; p++) {
+        hash = (hash ^ *p) * 16777619u;
+    }
+    snprintf(asset->etag, sizeof(asset->etag), "\"%08lx\"", (unsigned long)hash);
+}
+
 // WiFi status handler
 static esp_err_t wifi_status_get_handler(httpd_req_t *req)
 {
-    uint32_t req_id = __atomic_add_fetch(&webserver_req_counter, 1, __ATOMIC_SEQ_CST);
-    ESP_LOGI(TAG, "[REQ %lu] wifi_status_get_handler START uri=%s", (unsigned long)req_id, req->uri);
-    httpd_resp_set_hdr(req, "Connection", "close");
     wifi_ap_record_t ap_info;
     esp_netif_ip_info_t ip_info;
-    char response[512];
     
     // Get WiFi connection status
     bool connected = (esp_wifi_sta_get_ap_info(&ap_info) == ESP_OK);
     
+    json_writer_t w;
+    web_json_begin(req, &w);
+    json_obj_begin(&w, NULL);
+    json_bool(&w, "connected", connected);
     if (connected) {
+        json_str(&w, "ssid", (const char *)ap_info.ssid);
         // Get IP address
         esp_netif_t *netif = esp_netif_get_handle_from_ifkey("WIFI_STA_DEF");
         if (netif && esp_netif_get_ip_info(netif, &ip_info) == ESP_OK) {
-            snprintf(response, sizeof(response),
-                "{\"connected\":true,\"ssid\":\"%s\",\"ip\":\"%u.%u.%u.%u\",\"signal\":%d}",
-                ap_info.ssid,
-                ip4_addr1_16(&ip_info.ip),
-                ip4_addr2_16(&ip_info.ip),
-                ip4_addr3_16(&ip_info.ip),
-                ip4_addr4_16(&ip_info.ip),
-                ap_info.rssi);
+            char ip[16];
+            esp_ip4addr_ntoa(&ip_info.ip, ip, sizeof(ip));
+            json_str(&w, "ip", ip);
         } else {
-            snprintf(response, sizeof(response),
-                "{\"connected\":true,\"ssid\":\"%s\",\"ip\":\"unknown\",\"signal\":%d}",
-                ap_info.ssid, ap_info.rssi);
+            json_str(&w, "ip", "unknown");
         }
+        json_int(&w, "signal", ap_info.rssi);
     } else {
-        snprintf(response, sizeof(response),
-            "{\"connected\":false,\"ssid\":\"\",\"ip\":\"\",\"signal\":0}");
+        json_str(&w, "ssid", "");
+        json_str(&w, "ip", "");
+        json_int(&w, "signal", 0);
     }
-    
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
-    ESP_LOGI(TAG, "[REQ %lu] wifi_status_get_handler END", (unsigned long)req_id);
-    return ESP_OK;
+    json_obj_end(&w);
+    return web_json_end(req, &w);
 }
 
 // UPS status handler
 static esp_err_t ups_status_get_handler(httpd_req_t *req)
 {
-    uint32_t req_id = __atomic_add_fetch(&webserver_req_counter, 1, __ATOMIC_SEQ_CST);
-    ESP_LOGI(TAG, "[REQ %lu] ups_status_get_handler START uri=%s", (unsigned long)req_id, req->uri);
-    httpd_resp_set_hdr(req, "Connection", "close");
-    extern ups_connection_state_t get_ups_state(void);
-    extern unsigned int get_ups_last_data_time(void);
-    extern uint32_t get_ups_stale_duration_ms(void);
-    char response[160];
-    const char *state_str = "UNKNOWN";
-    const char *color = "red";
-    uint32_t now = xTaskGetTickCount() * portTICK_PERIOD_MS;
-    uint32_t ms_since_last = now - get_ups_last_data_time();
-    uint32_t stale_duration = 0;
-    switch (get_ups_state()) {
-        case 0: state_str = "DISCONNECTED"; color = "red"; break;
-        case 1: state_str = "WAITING"; color = "yellow"; break;
-        case 2: state_str = "ACTIVE"; color = "green"; break;
-        case 3: state_str = "STALE"; color = "red"; stale_duration = get_ups_stale_duration_ms(); break;
-    }
-    if (stale_duration > 0) {
-        snprintf(response, sizeof(response),
-            "{\"state\":\"%s\",\"color\":\"%s\",\"ms_since_last\":%lu,\"stale_duration_ms\":%lu}",
-            state_str, color, (unsigned long)ms_since_last, (unsigned long)stale_duration);
+    json_writer_t w;
+    web_json_begin(req, &w);
+    api_json_ups_status(&w, xTaskGetTickCount() * portTICK_PERIOD_MS);
+    return web_json_end(req, &w);
+}
+
+// Aggregated dashboard status: one snapshot, revalidated with ETag / If-None-Match.
+// The live clocks travel in headers so a 304 still lets the page update ages.
+static esp_err_t status_get_handler(httpd_req_t *req)
+{
+    status_snapshot_refresh();
+    status_snapshot_t snap;
+    status_snapshot_get(&snap);
+
+    char etag[32];
+    char uptime_hdr[12];
+    char last_data_hdr[12];
+    snprintf(etag, sizeof(etag), "W/\"%08lx-%lu\"", (unsigned long)snap.boot_nonce, (unsigned long)snap.version);
+    snprintf(uptime_hdr, sizeof(uptime_hdr), "%lu", (unsigned long)snap.uptime_ms);
+    snprintf(last_data_hdr, sizeof(last_data_hdr), "%lu", (unsigned long)snap.ups_last_data_ms);
+    httpd_resp_set_hdr(req, "ETag", etag);
+    httpd_resp_set_hdr(req, "Cache-Control", "no-cache");
+    httpd_resp_set_hdr(req, "X-Uptime-Ms", uptime_hdr);
+    httpd_resp_set_hdr(req, "X-Ups-Last-Data-Ms", last_data_hdr);
+
+    char if_none_match[40];
+    if (httpd_req_get_hdr_value_str(req, "If-None-Match", if_none_match, sizeof(if_none_match)) == ESP_OK &&
+        strcmp(if_none_match, etag) == 0) {
+        httpd_resp_set_status(req, "304 Not Modified");
+        httpd_resp_send(req, NULL, 0);
+        return ESP_OK;
+    }
+
+    json_writer_t w;
+    web_json_begin(req, &w);
+    json_obj_begin(&w, NULL);
+    json_uint(&w, "version", snap.version);
+
+    json_obj_begin(&w, "wifi");
+    json_bool(&w, "connected", snap.wifi_connected);
+    json_str(&w, "ssid", snap.ssid);
+    if (!snap.wifi_connected) {
+        json_str(&w, "ip", "");
+    } else if (snap.ip) {
+        char ip[16];
+        esp_ip4_addr_t addr = { .addr = snap.ip };
+        esp_ip4addr_ntoa(&addr, ip, sizeof(ip));
+        json_str(&w, "ip", ip);
     } else {
-        snprintf(response, sizeof(response),
-            "{\"state\":\"%s\",\"color\":\"%s\",\"ms_since_last\":%lu}",
-            state_str, color, (unsigned long)ms_since_last);
+        json_str(&w, "ip", "unknown");
     }
-    httpd_resp_set_type(req, "application/json");
-    httpd_resp_send(req, response, HTTPD_RESP_USE_STRLEN);
-    ESP_LOGI(TAG, "[REQ %lu] ups_status_get_handler END", (unsigned long)req_id);
+    json_int(&w, "signal", snap.rssi);
+    json_obj_end(&w);
+
+    json_obj_begin(&w, "ups");
+    json_str(&w, "state", ups_state_name(snap.ups_state));
+    json_str(&w, "color", ups_state_color(snap.ups_state));
+    json_uint(&w, "last_data_ms", snap.ups_last_data_ms);
+    json_uint(&w, "stale_since_ms", snap.ups_stale_since_ms);
+    json_obj_end(&w);
+
+    json_obj_begin(&w, "tcp");
+    json_bool(&w, "running", snap.tcp_running);
+    json_int(&w, "connections", snap.tcp_connections);
+    json_obj_end(&w);
+
+    json_obj_begin(&w, "esp");
+    json_uint(&w, "free_heap", snap.free_heap);
+    json_uint(&w, "total_heap", snap.total_heap);
+    json_int(&w, "memory_percent", snap.memory_percent);
+    json_uint(&w, "largest_free_block", snap.largest_free_block);
+    json_obj_end(&w);
+
+    json_uint(&w, "uptime_ms", snap.uptime_ms);
+    json_obj_end(&w);
+    return web_json_end(req, &w);
+}
+
+// Power quality handler: current band, counters and the event journal
+static esp_err_t power_quality_get_handler(httpd_req_t *req)
+{
+    json_writer_t w;
+    web_json_begin(req, &w);
+    api_json_power_quality(&w);
+    return web_json_end(req, &w);
+}
+
+// Energy accounting handler
+static esp_err_t energy_get_handler(httpd_req_t *req)
+{
+    json_writer_t w;
+    web_json_begin(req, &w);
+    api_json_energy(&w);
+    return web_json_end(req, &w);
+}
+
+// Battery health handler: current estimates and the long-term trend
+static esp_err_t battery_health_get_handler(httpd_req_t *req)
+{
+    json_writer_t w;
+    web_json_begin(req, &w);
+    api_json_battery_health(&w);
+    return web_json_end(req, &w);
+}
+
+// Sequence-of-events handler: /api/events?since=<seq> returns records newer than seq
+static esp_err_t events_get_handler(httpd_req_t *req)
+{
+    uint32_t since = 0;
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = strtoul(value, NULL, 10);
+    }
+
+    json_writer_t w;
+    web_json_begin(req, &w);
+    api_json_events(&w, since, esp_timer_get_time());
+    return web_json_end(req, &w);
+}
+
+// Prometheus scrape: pre-rendered sections, rebuilt only when their data changed
+static esp_err_t metrics_get_handler(httpd_req_t *req)
+{
+    httpd_resp_set_type(req, "text/plain; version=0.0.4");
+
+    const char *sections[8];
+    size_t count = metrics_collect(sections, sizeof(sections) / sizeof(sections[0]));
+    for (size_t i = 0; i < count; i++) {
+        httpd_resp_send_chunk(req, sections[i], HTTPD_RESP_USE_STRLEN);
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
     return ESP_OK;
 }
 
+static esp_err_t http_stats_get_handler(httpd_req_t *req);
+static esp_err_t latency_get_handler(httpd_req_t *req);
+static esp_err_t tasks_get_handler(httpd_req_t *req);
+static esp_err_t heap_get_handler(httpd_req_t *req);
+static esp_err_t pm_get_handler(httpd_req_t *req);
+static esp_err_t boot_get_handler(httpd_req_t *req);
+#if CONFIG_UPS_DLOG_ENABLE
+static esp_err_t logs_get_handler(httpd_req_t *req);
+#endif
+#if CONFIG_UPS_SCHED_BENCHMARK
+static esp_err_t sched_bench_get_handler(httpd_req_t *req);
+#endif
+
+// Every route goes through web_route_dispatch, which times the real handler
+typedef struct {
+    httpd_uri_t uri;            // Real handler and user_ctx
+    bool traced;                // Response carries UPS values (report_trace http stage)
+    latency_hist_t latency;
+} web_route_t;
+
+static web_route_t web_routes[] = {
+    { { .uri = "/",                   .method = HTTP_GET,  .handler = asset_get_handler,          .user_ctx = &asset_index } },
+    { { .uri = "/app.js",             .method = HTTP_GET,  .handler = asset_get_handler,          .user_ctx = &asset_app_js } },
+    { { .uri = "/app.css",            .method = HTTP_GET,  .handler = asset_get_handler,          .user_ctx = &asset_app_css } },
+    { { .uri = "/config",             .method = HTTP_POST, .handler = config_post_handler } },
+    { { .uri = "/reboot",             .method = HTTP_POST, .handler = reboot_post_handler } },
+    { { .uri = "/api/wifi_status",    .method = HTTP_GET,  .handler = wifi_status_get_handler } },
+    { { .uri = "/api/ups_status",     .method = HTTP_GET,  .handler = ups_status_get_handler },     .traced = true },
+    { { .uri = "/api/tcp_status",     .method = HTTP_GET,  .handler = tcp_status_get_handler } },
+    { { .uri = "/api/esp_health",     .method = HTTP_GET,  .handler = esp_health_get_handler } },
+    { { .uri = "/api/status",         .method = HTTP_GET,  .handler = status_get_handler } },
+    { { .uri = "/api/power_quality",  .method = HTTP_GET,  .handler = power_quality_get_handler } },
+    { { .uri = "/api/events",         .method = HTTP_GET,  .handler = events_get_handler } },
+    { { .uri = "/api/energy",         .method = HTTP_GET,  .handler = energy_get_handler } },
+    { { .uri = "/api/battery_health", .method = HTTP_GET,  .handler = battery_health_get_handler } },
+    { { .uri = "/api/http_stats",     .method = HTTP_GET,  .handler = http_stats_get_handler } },
+    { { .uri = "/api/latency",        .method = HTTP_GET,  .handler = latency_get_handler } },
+    { { .uri = "/api/tasks",          .method = HTTP_GET,  .handler = tasks_get_handler } },
+    { { .uri = "/api/heap",           .method = HTTP_GET,  .handler = heap_get_handler } },
+    { { .uri = "/api/pm",             .method = HTTP_GET,  .handler = pm_get_handler } },
+    { { .uri = "/api/boot",           .method = HTTP_GET,  .handler = boot_get_handler } },
+    { { .uri = "/metrics",            .method = HTTP_GET,  .handler = metrics_get_handler },        .traced = true },
+#if CONFIG_UPS_DLOG_ENABLE
+    { { .uri = "/api/logs",           .method = HTTP_GET,  .handler = logs_get_handler } },
+#endif
+#if CONFIG_UPS_SCHED_BENCHMARK
+    { { .uri = "/api/sched_bench",    .method = HTTP_GET,  .handler = sched_bench_get_handler } },
+#endif
+};
+
+#define WEB_ROUTE_COUNT (sizeof(web_routes) / sizeof(web_routes[0]))
+
+static esp_err_t web_route_dispatch(httpd_req_t *req)
+{
+    web_route_t *route = (web_route_t *)req->user_ctx;
+    int64_t start_us = esp_timer_get_time();
+    web_request_begin(req, start_us);
+#if CONFIG_UPS_HTTPD_REQUEST_LOG
+    DLOGI(TAG, "[REQ %lu] %s START", (unsigned long)web_current.id, route->uri.uri);
+#endif
+
+    req->user_ctx = route->uri.user_ctx;
+    uint32_t generation = report_trace_generation();
+    power_mgmt_acquire(POWER_LOCK_NET);
+    esp_err_t ret = route->uri.handler(req);
+    power_mgmt_release(POWER_LOCK_NET);
+
+    uint32_t elapsed_us = (uint32_t)(esp_timer_get_time() - start_us);
+    latency_hist_record(&route->latency, elapsed_us, ret != ESP_OK || web_current.failed);
+    if (route->traced && ret == ESP_OK && !web_current.failed) {
+        report_trace_served(REPORT_TRACE_HTTP, generation);
+    }
+#if CONFIG_UPS_HTTPD_REQUEST_LOG
+    DLOGI(TAG, "[REQ %lu] %s END %s %lu us", (unsigned long)web_current.id, route->uri.uri,
+             (ret != ESP_OK || web_current.failed) ? "error" : "ok", (unsigned long)elapsed_us);
+#endif
+    return ret;
+}
+
+// Per-route request counts, errors and latency histograms since boot
+static esp_err_t http_stats_get_handler(httpd_req_t *req)
+{
+    json_writer_t w;
+    web_json_begin(req, &w);
+    json_obj_begin(&w, NULL);
+    json_uint(&w, "requests", __atomic_load_n(&webserver_req_counter, __ATOMIC_RELAXED));
+    json_arr_begin(&w, "bucket_bounds_us");
+    for (size_t i = 0; i < LATENCY_HIST_BUCKETS; i++) {
+        json_uint(&w, NULL, latency_hist_bucket_bound_us(i));
+    }
+    json_arr_end(&w);
+
+    json_arr_begin(&w, "routes");
+    for (size_t i = 0; i < WEB_ROUTE_COUNT; i++) {
+        latency_hist_t hist;
+        latency_hist_snapshot(&web_routes[i].latency, &hist);
+        json_obj_begin(&w, NULL);
+        json_str(&w, "uri", web_routes[i].uri.uri);
+        json_str(&w, "method", web_routes[i].uri.method == HTTP_POST ? "POST" : "GET");
+        latency_hist_write_json(&w, &hist);
+        json_obj_end(&w);
+    }
+    json_arr_end(&w);
+    json_obj_end(&w);
+    return web_json_end(req, &w);
+}
+
+// Report-to-client latency per stage (USB arrival, decode, publish, NUT/HTTP/WS reply)
+static esp_err_t latency_get_handler(httpd_req_t *req)
+{
+    json_writer_t w;
+    web_json_begin(req, &w);
+    report_trace_write_json(&w);
+    return web_json_end(req, &w);
+}
+
+// Per-task state, priority, core, stack and CPU share. ?format=kconfig returns
+// the suggested stack sizes as sdkconfig lines (tools/stack_calibration.py).
+static esp_err_t tasks_get_handler(httpd_req_t *req)
+{
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "format", value, sizeof(value)) == ESP_OK &&
+        strcmp(value, "kconfig") == 0) {
+        char text[1536];
+        size_t len = task_stats_kconfig(text, sizeof(text));
+        httpd_resp_set_type(req, "text/plain; charset=utf-8");
+        httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+        return httpd_resp_send(req, text, len);
+    }
+
+    json_writer_t w;
+    web_json_begin(req, &w);
+    task_stats_write_json(&w);
+    return web_json_end(req, &w);
+}
+
+// Heap per capability and live allocations per subsystem
+static esp_err_t heap_get_handler(httpd_req_t *req)
+{
+    json_writer_t w;
+    web_json_begin(req, &w);
+    heap_monitor_write_json(&w);
+    return web_json_end(req, &w);
+}
+
+// DFS / light sleep configuration, lock activity and NUT wake-to-reply latency
+static esp_err_t pm_get_handler(httpd_req_t *req)
+{
+    json_writer_t w;
+    web_json_begin(req, &w);
+    power_mgmt_write_json(&w);
+    return web_json_end(req, &w);
+}
+
+// When each boot phase was reached, in ms since the application started
+static esp_err_t boot_get_handler(httpd_req_t *req)
+{
+    json_writer_t w;
+    web_json_begin(req, &w);
+    boot_timing_write_json(&w);
+    return web_json_end(req, &w);
+}
+
+#if CONFIG_UPS_SCHED_BENCHMARK
+// USB jitter and NUT reply histograms for the active scheduling profile.
+// ?reset=1 clears them after the response is built (tools/sched_bench.py).
+static esp_err_t sched_bench_get_handler(httpd_req_t *req)
+{
+    char query[32];
+    char value[4];
+    bool reset = httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+                 httpd_query_key_value(query, "reset", value, sizeof(value)) == ESP_OK &&
+                 strcmp(value, "1") == 0;
+
+    json_writer_t w;
+    web_json_begin(req, &w);
+    sched_bench_write_json(&w);
+    if (reset) {
+        sched_bench_reset();
+    }
+    return web_json_end(req, &w);
+}
+#endif
+
+#if CONFIG_UPS_DLOG_ENABLE
+// Recent log lines as text. /api/logs?since=<seq> returns only newer lines;
+// X-Log-Seq carries the sequence number to pass next time.
+static esp_err_t logs_get_handler(httpd_req_t *req)
+{
+    uint32_t since = 0;
+    char query[32];
+    char value[12];
+    if (httpd_req_get_url_query_str(req, query, sizeof(query)) == ESP_OK &&
+        httpd_query_key_value(query, "since", value, sizeof(value)) == ESP_OK) {
+        since = strtoul(value, NULL, 10);
+    }
+
+    dlog_stats_t stats;
+    dlog_get_stats(&stats);
+    char stats_hdr[64];
+    snprintf(stats_hdr, sizeof(stats_hdr), "written=%lu dropped=%lu rate_limited=%lu",
+             (unsigned long)stats.written, (unsigned long)stats.dropped, (unsigned long)stats.rate_limited);
+
+    httpd_resp_set_type(req, "text/plain; charset=utf-8");
+    httpd_resp_set_hdr(req, "Cache-Control", "no-store");
+    httpd_resp_set_hdr(req, "X-Log-Stats", stats_hdr);
+
+    // Pin the range first so X-Log-Seq matches the body exactly
+    uint32_t until = dlog_history_seq();
+    if (since > until) {
+        since = 0;      // Sequence from before a reboot
+    }
+    char seq_hdr[12];
+    snprintf(seq_hdr, sizeof(seq_hdr), "%lu", (unsigned long)until);
+    httpd_resp_set_hdr(req, "X-Log-Seq", seq_hdr);
+
+    char chunk[512];
+    for (;;) {
+        size_t len;
+        since = dlog_read_history(since, until, chunk, sizeof(chunk), &len);
+        if (len == 0) {
+            break;
+        }
+        httpd_resp_send_chunk(req, chunk, len);
+    }
+    httpd_resp_send_chunk(req, NULL, 0);
+    return ESP_OK;
+}
+#endif
+
 // Start the webserver
 esp_err_t webserver_start(void)
 {
@@ -745,70 +956,53 @@ esp_err_t webserver_start(void)
         ESP_LOGI(TAG, "Webserver already running");
         return ESP_OK;
     }
+    static bool supervised = false;
+    if (!supervised) {
+        // A failed start is retried by the supervisor through webserver_restart()
+        supervisor_register(SUPERVISOR_HTTPD, "httpd", CONFIG_UPS_SUPERVISOR_HTTPD_TIMEOUT_S * 1000,
+                            web_supervisor_poke, webserver_restart);
+        supervised = true;
+    }
     start_free_heap_logging();
     
+    web_asset_init_etag(&asset_index);
+    web_asset_init_etag(&asset_app_js);
+    web_asset_init_etag(&asset_app_css);
+
+    for (size_t i = 0; i < HTTPD_MAX_OPEN_SOCKETS; i++) {
+        web_sessions[i].fd = -1;
+    }
+    web_sessions_open = 0;
+
     httpd_config_t config = HTTPD_DEFAULT_CONFIG();
     config.uri_match_fn = httpd_uri_match_wildcard;
+    config.max_uri_handlers = WEB_ROUTE_COUNT + 1;     // + /ws
+    // Persistent connections: when the pool is full the least recently used
+    // session is closed instead of refusing the new connection
+    config.max_open_sockets = HTTPD_MAX_OPEN_SOCKETS;
+    config.backlog_conn = CONFIG_UPS_HTTPD_BACKLOG;
+    config.stack_size = CONFIG_UPS_HTTPD_STACK_SIZE;
+    config.task_priority = TASK_PRIO_HTTPD;
+    config.core_id = TASK_CORE_NET;
+    config.lru_purge_enable = true;
+    config.open_fn = web_session_open;
+    config.close_fn = web_session_close;
     
     if (httpd_start(&server, &config) == ESP_OK) {
-        // Register URI handlers
-        httpd_uri_t root = {
-            .uri = "/",
-            .method = HTTP_GET,
-            .handler = root_get_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &root);
-        
-        httpd_uri_t config_post = {
-            .uri = "/config",
-            .method = HTTP_POST,
-            .handler = config_post_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &config_post);
-        
-        httpd_uri_t reboot_post = {
-            .uri = "/reboot",
-            .method = HTTP_POST,
-            .handler = reboot_post_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &reboot_post);
-        
-        httpd_uri_t wifi_status = {
-            .uri = "/api/wifi_status",
-            .method = HTTP_GET,
-            .handler = wifi_status_get_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &wifi_status);
-        
-        httpd_uri_t ups_status = {
-            .uri = "/api/ups_status",
-            .method = HTTP_GET,
-            .handler = ups_status_get_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &ups_status);
-
-        httpd_uri_t tcp_status = {
-            .uri = "/api/tcp_status",
-            .method = HTTP_GET,
-            .handler = tcp_status_get_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &tcp_status);
+        heap_monitor_tag_task(xTaskGetHandle("httpd"), HEAP_TAG_HTTPD);
+        for (size_t i = 0; i < WEB_ROUTE_COUNT; i++) {
+            httpd_uri_t uri = web_routes[i].uri;
+            uri.handler = web_route_dispatch;
+            uri.user_ctx = &web_routes[i];
+            httpd_register_uri_handler(server, &uri);
+        }
 
-        httpd_uri_t esp_health = {
-            .uri = "/api/esp_health",
-            .method = HTTP_GET,
-            .handler = esp_health_get_handler,
-            .user_ctx = NULL
-        };
-        httpd_register_uri_handler(server, &esp_health);
+        // WebSocket push for dashboards
+        live_stream_register(server);
         
-        ESP_LOGI(TAG, "Webserver started on port %d", config.server_port);
+        start_idle_reaping();
+        ESP_LOGI(TAG, "Webserver started on port %d (%d sockets, backlog %d, keep-alive idle %d s)",
+                 config.server_port, config.max_open_sockets, config.backlog_conn, CONFIG_UPS_HTTPD_IDLE_TIMEOUT_S);
         return ESP_OK;
     } else {
         ESP_LOGE(TAG, "Failed to start webserver");
@@ -817,18 +1011,15 @@ esp_err_t webserver_start(void)
 } 
 
 void webserver_restart(void) {
-    ESP_LOGW(TAG, "Restarting webserver due to health check failure");
+    ESP_LOGW(TAG, "Restarting webserver");
+    soe_record(SOE_WEBSERVER_RESTART, 0);
     // Stop the webserver if running
     if (server) {
+        heap_monitor_untag_task(xTaskGetHandle("httpd"));
         httpd_stop(server);
         server = NULL;
     }
-    // Stop and delete the heap log timer if running
-    if (free_heap_log_timer) {
-        esp_timer_stop(free_heap_log_timer);
-        esp_timer_delete(free_heap_log_timer);
-        free_heap_log_timer = NULL;
-    }
+    stop_idle_reaping();
     // Start the webserver again
     webserver_start();
 } 
\ No newline at end of file
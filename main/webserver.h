@@ -1,8 +1,18 @@
 #ifndef WEBSERVER_H
 #define WEBSERVER_H
 
+#include <stdint.h>
 #include "esp_err.h"
 
+// HTTP session counters (keep-alive pool)
+typedef struct {
+    int open_sessions;
+    int max_sessions;
+    uint32_t sessions_opened;
+    uint32_t idle_reaped;
+    uint32_t requests;
+} webserver_stats_t;
+
 // Start the webserver
 esp_err_t webserver_start(void);
 
@@ -11,4 +21,6 @@ void handle_accept_error(void);
 
 void webserver_restart(void);
 
+void webserver_get_stats(webserver_stats_t *out);
+
 #endif // WEBSERVER_H 
\ No newline at end of file
@@ -0,0 +1,245 @@
+document.getElementById('wifiForm').addEventListener('submit', function(e) {
+    e.preventDefault();
+    const formData = new FormData(this);
+    const data = {
+        ssid: formData.get('ssid'),
+        password: formData.get('password')
+    };
+    fetch('/config', {
+        method: 'POST',
+        headers: {
+            'Content-Type': 'application/json',
+        },
+        body: JSON.stringify(data)
+    })
+    .then(response => response.json())
+    .then(data => {
+        showStatus(data.success ? 'Configuration saved successfully! Device will reboot...' : 'Error: ' + data.message, data.success);
+        if (data.success) {
+            setTimeout(() => {
+                window.location.reload();
+            }, 3000);
+        }
+    })
+    .catch(error => {
+        showStatus('Error: ' + error.message, false);
+    });
+});
+function rebootDevice() {
+    if (confirm('Are you sure you want to reboot the device?')) {
+        fetch('/reboot', {
+            method: 'POST'
+        })
+        .then(response => response.json())
+        .then(data => {
+            showStatus('Device rebooting...', true);
+            setTimeout(() => {
+                window.location.reload();
+            }, 5000);
+        })
+        .catch(error => {
+            showStatus('Error: ' + error.message, false);
+        });
+    }
+}
+function showStatus(message, isSuccess) {
+    const statusDiv = document.getElementById('status');
+    statusDiv.className = 'status ' + (isSuccess ? 'success' : 'error');
+    statusDiv.textContent = message;
+}
+const TOTAL_BARS = 10;
+function initializeSignalBars() {
+    const signalBarsContainer = document.getElementById('wifi-signal-container');
+    signalBarsContainer.innerHTML = '<span class="signal-inline">Signal: <span class="signal-bars" id="signalBars"></span><span class="signal-percentage" id="signalValue">0%</span></span>';
+    const barsContainer = document.getElementById('signalBars');
+    barsContainer.innerHTML = '';
+    for (let i = 0; i < TOTAL_BARS; i++) {
+        const bar = document.createElement('div');
+        bar.className = 'signal-bar-new';
+        bar.id = `bar-${i}`;
+        barsContainer.appendChild(bar);
+    }
+}
+function setSignalValue(signalStrength) {
+    const signalValueElement = document.getElementById('signalValue');
+    if (signalValueElement) {
+        signalValueElement.textContent = signalStrength + '%';
+        const activeBars = Math.round((signalStrength / 100) * TOTAL_BARS);
+        for (let i = 0; i < TOTAL_BARS; i++) {
+            const bar = document.getElementById(`bar-${i}`);
+            if (bar) {
+                bar.className = 'signal-bar-new';
+                if (i < activeBars) {
+                    bar.classList.add('active');
+                    if (signalStrength >= 70) {
+                        bar.classList.add('strong');
+                    } else if (signalStrength >= 30) {
+                        bar.classList.add('medium');
+                    } else {
+                        bar.classList.add('weak');
+                    }
+                }
+            }
+        }
+    }
+}
+function renderWifiStatus(data) {
+    var ind = document.getElementById("wifi-indicator");
+    ind.className = 'status-indicator ' + (data.connected ? 'green' : 'red');
+    document.getElementById("wifi-status").textContent = data.connected ? 'CONNECTED' : 'DISCONNECTED';
+    var percent = (typeof data.signal === 'number') ? Math.max(0, Math.min(100, 2 * (data.signal + 100))) : 0;
+    var details = data.connected
+        ? (data.ip + ' | ' + data.ssid + ' | ' + percent + '%')
+        : 'Not connected';
+    document.getElementById("wifi-details").innerHTML = details;
+    if (data.connected) {
+        setSignalValue(percent);
+    } else {
+        setSignalValue(0);
+    }
+}
+function formatUptime(seconds) {
+    if (seconds < 60) {
+        return Math.floor(seconds) + ' seconds';
+    } else if (seconds < 3600) {
+        var minutes = Math.floor(seconds / 60);
+        var remainingSeconds = Math.floor(seconds % 60);
+        return minutes + ' minutes ' + remainingSeconds + ' seconds';
+    } else if (seconds < 86400) {
+        var hours = Math.floor(seconds / 3600);
+        var minutes = Math.floor((seconds % 3600) / 60);
+        var remainingSeconds = Math.floor(seconds % 60);
+        return hours + ' hours ' + minutes + ' minutes ' + remainingSeconds + ' seconds';
+    } else {
+        var days = Math.floor(seconds / 86400);
+        var hours = Math.floor((seconds % 86400) / 3600);
+        var minutes = Math.floor((seconds % 3600) / 60);
+        var remainingSeconds = Math.floor(seconds % 60);
+        return days + ' days ' + hours + ' hours ' + minutes + ' minutes ' + remainingSeconds + ' seconds';
+    }
+}
+function formatTimeAgo(seconds) {
+    if (seconds < 60) {
+        return Math.floor(seconds) + ' seconds ago';
+    } else if (seconds < 3600) {
+        var minutes = Math.floor(seconds / 60);
+        var remainingSeconds = Math.floor(seconds % 60);
+        return minutes + ' minutes ' + remainingSeconds + ' seconds ago';
+    } else if (seconds < 86400) {
+        var hours = Math.floor(seconds / 3600);
+        var minutes = Math.floor((seconds % 3600) / 60);
+        var remainingSeconds = Math.floor(seconds % 60);
+        return hours + ' hours ' + minutes + ' minutes ' + remainingSeconds + ' seconds ago';
+    } else {
+        var days = Math.floor(seconds / 86400);
+        var hours = Math.floor((seconds % 86400) / 3600);
+        var minutes = Math.floor((seconds % 3600) / 60);
+        var remainingSeconds = Math.floor(seconds % 60);
+        return days + ' days ' + hours + ' hours ' + minutes + ' minutes ' + remainingSeconds + ' seconds ago';
+    }
+}
+function renderUpsStatus(data, uptimeMs, lastDataMs) {
+    var ind = document.getElementById("ups-indicator");
+    ind.className = 'status-indicator ' + data.color;
+    var statusText = data.state;
+    var detailsText = '';
+    if (data.state === 'STALE' && data.stale_since_ms > 0) {
+        var staleSeconds = Math.floor((uptimeMs - data.stale_since_ms) / 1000);
+        statusText += ' (for ' + formatUptime(staleSeconds) + ')';
+    }
+    document.getElementById("ups-status").textContent = statusText;
+    var seconds = Math.max(0, uptimeMs - lastDataMs) / 1000;
+    var timeAgo = formatTimeAgo(seconds);
+    detailsText = 'Last message: ' + timeAgo;
+    document.getElementById("ups-details").textContent = detailsText;
+}
+function renderTcpStatus(data) {
+    var ind = document.getElementById("tcp-indicator");
+    var statusText = '';
+    var color = 'red';
+    var connectionsText = '';
+    if (data.running) {
+        if (data.connections > 0) {
+            color = 'green';
+            statusText = 'RUNNING';
+            connectionsText = 'Connections: ' + data.connections + ' connection' + (data.connections !== 1 ? 's' : '');
+        } else {
+            color = 'yellow';
+            statusText = 'RUNNING';
+            connectionsText = 'Connections: 0 connections';
+        }
+    } else {
+        color = 'red';
+        statusText = 'STOPPED';
+        connectionsText = 'Connections: 0 connections';
+    }
+    ind.className = 'status-indicator ' + color;
+    document.getElementById("tcp-status").textContent = statusText;
+    document.getElementById("tcp-details").textContent = connectionsText;
+}
+function renderEspHealthStatus(data, uptimeMs) {
+    var ind = document.getElementById("esp-indicator");
+    var statusText = '';
+    var color = 'red';
+    if (data.memory_percent >= 65) {
+        color = 'green';
+        statusText = 'HEALTHY';
+    } else if (data.memory_percent >= 30) {
+        color = 'yellow';
+        statusText = 'WARNING';
+    } else {
+        color = 'red';
+        statusText = 'CRITICAL';
+    }
+    ind.className = 'status-indicator ' + color;
+    document.getElementById("esp-status").textContent = statusText;
+    var freeKB = Math.floor(data.free_heap / 1024);
+    var totalKB = Math.floor(data.total_heap / 1024);
+    var memoryText = 'Free Memory: ' + freeKB + 'KB out of ' + totalKB + 'KB (' + data.memory_percent + '% Free)';
+    if (data.largest_free_block !== undefined) {
+        memoryText += '<br>Largest Free Block: ' + Math.floor(data.largest_free_block / 1024) + 'KB';
+    }
+    var uptimeText = 'Uptime: ' + formatUptime(uptimeMs / 1000);
+    document.getElementById("esp-details").innerHTML = memoryText + '<br>' + uptimeText;
+}
+// One poll for all four cards; unchanged snapshots come back as 304
+var statusEtag = null;
+var statusData = null;
+function updateStatus() {
+    var headers = statusEtag ? { 'If-None-Match': statusEtag } : {};
+    fetch('/api/status', { cache: 'no-store', headers: headers }).then(r => {
+        var uptimeMs = parseInt(r.headers.get('X-Uptime-Ms'), 10);
+        var lastDataMs = parseInt(r.headers.get('X-Ups-Last-Data-Ms'), 10);
+        if (r.status === 304 && statusData) {
+            return { data: statusData, uptimeMs: uptimeMs, lastDataMs: lastDataMs };
+        }
+        statusEtag = r.headers.get('ETag');
+        return r.json().then(data => ({ data: data, uptimeMs: uptimeMs, lastDataMs: lastDataMs }));
+    }).then(s => {
+        statusData = s.data;
+        if (isNaN(s.uptimeMs)) s.uptimeMs = s.data.uptime_ms;
+        if (isNaN(s.lastDataMs)) s.lastDataMs = s.data.ups.last_data_ms;
+        renderWifiStatus(s.data.wifi);
+        renderUpsStatus(s.data.ups, s.uptimeMs, s.lastDataMs);
+        renderTcpStatus(s.data.tcp);
+        renderEspHealthStatus(s.data.esp, s.uptimeMs);
+    });
+}
+// Live UPS updates over WebSocket; the 5 s poll still covers the other cards
+function connectLive() {
+    if (!window.WebSocket) return;
+    var ws = new WebSocket('ws://' + location.host + '/ws');
+    ws.onmessage = e => {
+        var m = JSON.parse(e.data);
+        if (!m.ups || !m.ups.state) return;
+        var colors = { ACTIVE: 'green', WAITING: 'yellow' };
+        document.getElementById("ups-indicator").className = 'status-indicator ' + (colors[m.ups.state] || 'red');
+        document.getElementById("ups-status").textContent = m.ups.state;
+        document.getElementById("ups-details").textContent = 'Last message: ' + formatTimeAgo(0);
+    };
+    ws.onclose = () => setTimeout(connectLive, 5000);
+}
+initializeSignalBars();
+connectLive();
+updateStatus();
+setInterval(updateStatus, 5000);
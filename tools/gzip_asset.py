@@ -0,0 +1,22 @@
+#!/usr/bin/env python3
+"""Gzip one dashboard asset for embedding (build step of main/CMakeLists.txt).
+
+The output is reproducible (no file name, mtime 0), so unchanged sources keep
+the same bytes and therefore the same ETag on the device.
+"""
+import gzip
+import sys
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit('usage: gzip_asset.py <input> <output.gz>')
+    with open(sys.argv[1], 'rb') as f:
+        data = f.read()
+    with open(sys.argv[2], 'wb') as f:
+        with gzip.GzipFile(filename='', mode='wb', compresslevel=9, fileobj=f, mtime=0) as gz:
+            gz.write(data)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,152 @@
+#!/usr/bin/env python3
+"""Host-side load test for the ESP32 web API.
+
+Runs N concurrent clients against one endpoint and reports how many requests
+failed at connect/accept time, plus latency percentiles. Each client either
+reuses one persistent connection (keep-alive) or opens a new connection per
+request, which is what every client had to do while the firmware forced
+"Connection: close".
+
+Compare firmware versions by running the same command against each:
+
+    python3 tools/http_load_test.py 192.168.1.50 --concurrency 8 --requests 50
+    python3 tools/http_load_test.py 192.168.1.50 --mode close --concurrency 8
+
+With --mode both, the two client behaviours run back to back against the same
+device.
+"""
+import argparse
+import http.client
+import json
+import socket
+import threading
+import time
+
+
+class Result:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.ok = 0
+        self.http_errors = 0
+        self.connect_errors = 0     # refused / reset / timeout while connecting or sending
+        self.connections = 0
+        self.latencies = []
+
+    def add(self, **kw):
+        with self.lock:
+            for k, v in kw.items():
+                if k == 'latency':
+                    self.latencies.append(v)
+                else:
+                    setattr(self, k, getattr(self, k) + v)
+
+
+def worker(args, keepalive, result):
+    conn = None
+    for _ in range(args.requests):
+        try:
+            if conn is None:
+                conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+                result.add(connections=1)
+            headers = {} if keepalive else {'Connection': 'close'}
+            start = time.monotonic()
+            conn.request('GET', args.path, headers=headers)
+            resp = conn.getresponse()
+            resp.read()
+            elapsed = time.monotonic() - start
+            if 200 <= resp.status < 400:
+                result.add(ok=1, latency=elapsed)
+            else:
+                result.add(http_errors=1)
+            if not keepalive or resp.will_close:
+                conn.close()
+                conn = None
+        except (ConnectionError, socket.timeout, OSError, http.client.HTTPException):
+            result.add(connect_errors=1)
+            if conn is not None:
+                conn.close()
+            conn = None
+        if args.interval:
+            time.sleep(args.interval)
+    if conn is not None:
+        conn.close()
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def run(args, keepalive):
+    result = Result()
+    threads = [threading.Thread(target=worker, args=(args, keepalive, result)) for _ in range(args.concurrency)]
+    start = time.monotonic()
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    duration = time.monotonic() - start
+
+    total = args.concurrency * args.requests
+    print(f"--- {'keep-alive' if keepalive else 'connection: close'} ---")
+    print(f"requests        {total} ({args.concurrency} clients x {args.requests}) in {duration:.1f} s, "
+          f"{result.ok / duration:.1f} req/s")
+    print(f"ok              {result.ok}")
+    print(f"http errors     {result.http_errors}")
+    print(f"connect errors  {result.connect_errors} ({100.0 * result.connect_errors / total:.1f}%)")
+    print(f"tcp connections {result.connections}")
+    ms = [x * 1000 for x in result.latencies]
+    print(f"latency ms      p50 {percentile(ms, 50):.1f}  p95 {percentile(ms, 95):.1f}  "
+          f"p99 {percentile(ms, 99):.1f}  max {max(ms) if ms else 0:.1f}")
+
+
+def print_device_stats(args):
+    try:
+        conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+        conn.request('GET', '/api/esp_health')
+        data = json.loads(conn.getresponse().read())
+        conn.close()
+    except (OSError, ValueError, http.client.HTTPException) as e:
+        print(f"device stats unavailable: {e}")
+        return
+    http_stats = data.get('http')
+    if http_stats:
+        print(f"device          {http_stats}")
+    print(f"device heap     {data.get('free_heap')} bytes free")
+    try:
+        conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+        conn.request('GET', '/api/http_stats')
+        routes = json.loads(conn.getresponse().read()).get('routes', [])
+        conn.close()
+    except (OSError, ValueError, http.client.HTTPException):
+        return
+    for route in routes:
+        if route.get('uri') == args.path:
+            print(f"device handler  {route['count']} requests, {route['errors']} errors, "
+                  f"p50 {route['p50_us']} us  p90 {route['p90_us']} us  p99 {route['p99_us']} us  "
+                  f"max {route['max_us']} us")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--path', default='/api/status')
+    parser.add_argument('--concurrency', type=int, default=8)
+    parser.add_argument('--requests', type=int, default=50, help='requests per client')
+    parser.add_argument('--interval', type=float, default=0.0, help='pause between requests of one client (s)')
+    parser.add_argument('--timeout', type=float, default=5.0)
+    parser.add_argument('--mode', choices=('keepalive', 'close', 'both'), default='keepalive')
+    args = parser.parse_args()
+
+    if args.mode in ('close', 'both'):
+        run(args, keepalive=False)
+    if args.mode in ('keepalive', 'both'):
+        run(args, keepalive=True)
+    print_device_stats(args)
+
+
+if __name__ == '__main__':
+    main()
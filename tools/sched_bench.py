@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Compare scheduling profiles under Wi-Fi load.
+
+Build the firmware with "Scheduling benchmark mode" (menuconfig, Task
+Scheduling) and one profile, flash it, attach the UPS and run:
+
+    python3 tools/sched_bench.py 192.168.1.50 --duration 60
+    python3 tools/sched_bench.py 192.168.1.50 --duration 60 --load 0   # idle baseline
+
+The tool clears the device histograms, keeps --load HTTP clients requesting
+--path over keep-alive connections (Wi-Fi and lwIP work on the device) while
+one NUT client times GET VAR round trips, then prints the device-side USB
+report interval, jitter and callback time and NUT reply time next to the
+host-measured NUT round trip. Repeat with the other profile and compare;
+--json prints one JSON line per run for collecting results.
+"""
+import argparse
+import http.client
+import json
+import socket
+import threading
+import time
+
+
+def http_get_json(args, path):
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    try:
+        conn.request('GET', path)
+        resp = conn.getresponse()
+        body = resp.read()
+        if resp.status != 200:
+            raise OSError(f"{path}: HTTP {resp.status}")
+        return json.loads(body)
+    finally:
+        conn.close()
+
+
+def http_load(args, stop, counts):
+    conn = None
+    while not stop.is_set():
+        try:
+            if conn is None:
+                conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+            conn.request('GET', args.path)
+            resp = conn.getresponse()
+            resp.read()
+            counts['http'] += 1
+            if resp.will_close:
+                conn.close()
+                conn = None
+        except (OSError, http.client.HTTPException):
+            counts['http_errors'] += 1
+            if conn is not None:
+                conn.close()
+            conn = None
+            time.sleep(0.1)
+    if conn is not None:
+        conn.close()
+
+
+def nut_probe(args, stop, rtts, counts):
+    command = f"GET VAR {args.ups} battery.charge\n".encode()
+    sock = None
+    while not stop.is_set():
+        try:
+            if sock is None:
+                sock = socket.create_connection((args.host, args.nut_port), timeout=args.timeout)
+            start = time.monotonic()
+            sock.sendall(command)
+            reply = b''
+            while not reply.endswith(b'\n'):
+                chunk = sock.recv(256)
+                if not chunk:
+                    raise ConnectionError('closed')
+                reply += chunk
+            rtts.append((time.monotonic() - start) * 1000)
+        except OSError:
+            counts['nut_errors'] += 1
+            if sock is not None:
+                sock.close()
+            sock = None
+        time.sleep(args.nut_interval)
+    if sock is not None:
+        sock.close()
+
+
+def percentile(values, p):
+    if not values:
+        return 0.0
+    values = sorted(values)
+    return values[min(len(values) - 1, int(len(values) * p / 100))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--nut-port', type=int, default=3493)
+    parser.add_argument('--ups', default='VP700ELCD', help='UPS name for GET VAR')
+    parser.add_argument('--path', default='/api/status', help='HTTP load endpoint')
+    parser.add_argument('--load', type=int, default=4, help='concurrent HTTP clients (0 = no load)')
+    parser.add_argument('--duration', type=float, default=30.0, help='seconds')
+    parser.add_argument('--nut-interval', type=float, default=0.05, help='pause between NUT probes (s)')
+    parser.add_argument('--timeout', type=float, default=5.0)
+    parser.add_argument('--json', action='store_true', help='print one JSON line instead of a table')
+    args = parser.parse_args()
+
+    http_get_json(args, '/api/sched_bench?reset=1')
+
+    stop = threading.Event()
+    counts = {'http': 0, 'http_errors': 0, 'nut_errors': 0}
+    rtts = []
+    threads = [threading.Thread(target=http_load, args=(args, stop, counts)) for _ in range(args.load)]
+    threads.append(threading.Thread(target=nut_probe, args=(args, stop, rtts, counts)))
+    for t in threads:
+        t.start()
+    time.sleep(args.duration)
+    stop.set()
+    for t in threads:
+        t.join()
+
+    device = http_get_json(args, '/api/sched_bench')
+    nut_rtt = {
+        'count': len(rtts),
+        'p50_ms': round(percentile(rtts, 50), 2),
+        'p99_ms': round(percentile(rtts, 99), 2),
+        'max_ms': round(max(rtts), 2) if rtts else 0,
+    }
+    if args.json:
+        print(json.dumps({'profile': device.get('profile'), 'load': args.load, 'duration_s': args.duration,
+                          'http_requests': counts['http'], 'http_errors': counts['http_errors'],
+                          'nut_errors': counts['nut_errors'], 'nut_rtt': nut_rtt, 'device': device}))
+        return
+
+    print(f"profile         {device.get('profile')}  ({args.load} HTTP clients, {args.duration:.0f} s)")
+    print(f"http load       {counts['http'] / args.duration:.1f} req/s, {counts['http_errors']} errors")
+    for name in ('usb_interval', 'usb_jitter', 'usb_callback', 'nut_reply'):
+        h = device.get(name, {})
+        print(f"{name:<15} n {h.get('count', 0):<6} p50 {h.get('p50_us', 0)} us  p90 {h.get('p90_us', 0)} us  "
+              f"p99 {h.get('p99_us', 0)} us  max {h.get('max_us', 0)} us")
+    print(f"nut round trip  n {nut_rtt['count']:<6} p50 {nut_rtt['p50_ms']} ms  p99 {nut_rtt['p99_ms']} ms  "
+          f"max {nut_rtt['max_ms']} ms  ({counts['nut_errors']} errors)")
+
+
+if __name__ == '__main__':
+    main()
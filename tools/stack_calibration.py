@@ -0,0 +1,82 @@
+#!/usr/bin/env python3
+"""Write measured task stack sizes into sdkconfig.defaults.
+
+Fetches /api/tasks?format=kconfig from a running device and merges the
+suggested CONFIG_UPS_STACK_* (and CONFIG_UPS_HTTPD_STACK_SIZE) lines into
+sdkconfig.defaults, replacing earlier values. Each suggestion is the task's
+measured peak stack use plus the calibration margin, so run the device under a
+representative load first: UPS attached, dashboard open, NUT clients polling,
+and for example
+
+    python3 tools/http_load_test.py 192.168.1.50 --concurrency 8 --requests 200
+
+Build with "Stack calibration mode" (menuconfig, Task Stacks) so peaks are kept
+across task restarts, then:
+
+    python3 tools/stack_calibration.py 192.168.1.50
+    python3 tools/stack_calibration.py 192.168.1.50 --dry-run
+
+sdkconfig.defaults only applies when sdkconfig is generated; delete sdkconfig
+(or run idf.py reconfigure after removing the lines there) to pick up the
+new sizes.
+"""
+import argparse
+import http.client
+import os
+import re
+import sys
+
+OPTION_LINE = re.compile(r'^(CONFIG_UPS_(?:STACK_[A-Z_]+|HTTPD_STACK_SIZE))=(\d+)$')
+SECTION = '# Task stacks (tools/stack_calibration.py)'
+
+
+def fetch(args):
+    conn = http.client.HTTPConnection(args.host, args.port, timeout=args.timeout)
+    conn.request('GET', '/api/tasks?format=kconfig')
+    resp = conn.getresponse()
+    body = resp.read().decode()
+    conn.close()
+    if resp.status != 200:
+        raise RuntimeError(f"HTTP {resp.status}")
+    return body
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('host')
+    parser.add_argument('--port', type=int, default=80)
+    parser.add_argument('--timeout', type=float, default=5.0)
+    parser.add_argument('--defaults', default=os.path.join(os.path.dirname(__file__), '..', 'sdkconfig.defaults'))
+    parser.add_argument('--dry-run', action='store_true', help='print the suggestions only')
+    args = parser.parse_args()
+
+    try:
+        body = fetch(args)
+    except (OSError, RuntimeError, http.client.HTTPException) as e:
+        sys.exit(f"cannot read /api/tasks: {e}")
+    print(body, end='')
+
+    suggested = {}
+    for line in body.splitlines():
+        m = OPTION_LINE.match(line.strip())
+        if m:
+            suggested[m.group(1)] = m.group(2)
+    if not suggested:
+        sys.exit("no stack options in the reply")
+    if args.dry_run:
+        return
+
+    with open(args.defaults) as f:
+        lines = f.read().splitlines()
+    # Drop earlier values and the section header, then append the new section
+    kept = [line for line in lines if not OPTION_LINE.match(line.strip()) and line != SECTION]
+    while kept and not kept[-1].strip():
+        kept.pop()
+    kept += ['', SECTION] + [f"{name}={value}" for name, value in suggested.items()]
+    with open(args.defaults, 'w') as f:
+        f.write('\n'.join(kept) + '\n')
+    print(f"updated {os.path.normpath(args.defaults)} ({len(suggested)} options)")
+
+
+if __name__ == '__main__':
+    main()